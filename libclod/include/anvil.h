@@ -82,6 +82,51 @@ static const char* anvil_result_string(const anvil_result res) {
     }
 }
 
+//=======//
+// Codec //
+//=======//
+
+/**
+ * compression and decompression contexts and scratch buffers,
+ * for deflate (region files) and LZ4 and LZMA (Distant Horizons LODs).
+ *
+ * contexts are created the first time they are needed and reused afterwards,
+ * so opening one codec per worker thread and passing it to every call that thread makes
+ * avoids recreating them for every region file or LOD.
+ *
+ * it is not thread safe.
+ *
+ * @see anvil_codec_open
+ * @see anvil_chunk_read_ex
+ * @see anvil_chunk_write_ex
+ * @see anvil_rewriter_open
+ * @see dh_compress_ex
+ * @see anvil_codec_close
+ */
+struct anvil_codec;
+
+/**
+ * opens a codec.
+ *
+ * @param[out] codec_out handle to the codec.
+ * @param[in] alloc (nullable) private memory allocation methods.
+ *  if non-null all fields must be non-null and valid.
+ * @retval ANVIL_OK on success.
+ * @retval ANVIL_ALLOC_FAILED memory allocation failed.
+ * @retval ANVIL_INVALID_USAGE given arguments were invalid.
+ */
+anvil_result anvil_codec_open(
+    struct anvil_codec **codec_out,
+    const anvil_allocator *alloc
+);
+
+/**
+ * releases resources associated with the codec.
+ * it must not be in use by anything else.
+ * @param[in] codec handle to the codec.
+ */
+void anvil_codec_close(struct anvil_codec *codec);
+
 //=============//
 // Anvil World //
 //=============//
@@ -447,6 +492,22 @@ anvil_result anvil_chunk_read(
     struct anvil_region_file *region_file
 );
 
+/**
+ * equivalent to @link anvil_chunk_read @endlink, decompressing with the given codec
+ * instead of one owned by the region file.
+ *
+ * @param[in] codec (nullable) codec to use. if null, the region file's own codec is used.
+ */
+anvil_result anvil_chunk_read_ex(
+    void *restrict out,
+    size_t out_cap,
+    size_t *out_len,
+    int64_t chunk_x,
+    int64_t chunk_z,
+    struct anvil_region_file *region_file,
+    struct anvil_codec *codec
+);
+
 /**
  * Type of compression
  *
@@ -485,6 +546,23 @@ anvil_result anvil_chunk_write(
     struct anvil_region_file *region_file
 );
 
+/**
+ * equivalent to @link anvil_chunk_write @endlink, compressing with the given codec
+ * instead of one owned by the region file.
+ *
+ * @param[in] codec (nullable) codec to use. if null, the region file's own codec is used.
+ */
+anvil_result anvil_chunk_write_ex(
+    const void *restrict in,
+    size_t in_len,
+    double compression_level,
+    anvil_compression compression,
+    int64_t chunk_x,
+    int64_t chunk_z,
+    struct anvil_region_file *region_file,
+    struct anvil_codec *codec
+);
+
 /**
  * Flushes changes made to the region file
  * and releases resources associated with the region file.
@@ -500,6 +578,189 @@ anvil_result anvil_chunk_write(
  */
 anvil_result anvil_region_file_close(struct anvil_region_file *region_file);
 
+//=================//
+// Region Rewriter //
+//=================//
+
+/**
+ * holds the buffers and codec used to rewrite region files,
+ * so that they are reused across every chunk and region file it rewrites.
+ *
+ * it is not thread safe. for concurrent rewriting open one rewriter per thread.
+ *
+ * @see anvil_rewriter_open
+ * @see anvil_region_recompress
+ * @see anvil_region_dir_recompress
+ * @see anvil_world_recompress
+ * @see anvil_region_compact
+ * @see anvil_rewriter_close
+ */
+struct anvil_rewriter;
+
+/**
+ * opens a region rewriter.
+ *
+ * @param[out] rewriter_out handle to the rewriter.
+ * @param[in] codec (nullable) codec used to recompress chunks.
+ *  it must outlive the rewriter. if null, the rewriter opens its own.
+ * @param[in] alloc (nullable) private memory allocation methods.
+ *  if non-null all fields must be non-null and valid.
+ * @retval ANVIL_OK on success.
+ * @retval ANVIL_ALLOC_FAILED memory allocation failed.
+ * @retval ANVIL_INVALID_USAGE given arguments were invalid.
+ */
+anvil_result anvil_rewriter_open(
+    struct anvil_rewriter **rewriter_out,
+    struct anvil_codec *codec,
+    const anvil_allocator *alloc
+);
+
+/**
+ * rewrites a region file with every chunk recompressed.
+ *
+ * the new file is written alongside the original with a ".tmp" suffix,
+ * with chunks laid out in header order with no gaps between them,
+ * and is renamed over the original once it is complete and synced.
+ * if any error occurs the original file is left untouched.
+ *
+ * chunks that are stored externally or with a compression type that is not understood are copied as they are.
+ * chunks that would no longer fit in a region file after recompressing are copied as they are.
+ * chunk modification times are preserved.
+ *
+ * the region file must not be open elsewhere while it is rewritten.
+ *
+ * @param[in] rewriter handle to the rewriter.
+ * @param[in] region_dir directory containing the region file.
+ * @param[in] region_x region x coordinate.
+ * @param[in] region_z region z coordinate.
+ * @param[in] compression type of compression to recompress chunks with.
+ * @param[in] compression_level [0, 1] how much the data should be compressed at the expense of CPU time.
+ * @retval ANVIL_OK on success.
+ * @retval ANVIL_INVALID_USAGE given arguments were invalid.
+ * @retval ANVIL_UNSUPPORTED_COMPRESSION compression is not supported.
+ * @retval ANVIL_NOT_EXIST the region file does not exist.
+ * @retval ANVIL_MALFORMED the region file is corrupted.
+ * @retval ANVIL_DISK_FULL there is not enough space on the disk to write the new file.
+ * @retval ANVIL_ALLOC_FAILED memory allocation failed.
+ * @retval ANVIL_IO_ERROR an IO error occurred and errno is set.
+ */
+anvil_result anvil_region_recompress(
+    struct anvil_rewriter *rewriter,
+    const struct anvil_region_dir *region_dir,
+    int64_t region_x,
+    int64_t region_z,
+    anvil_compression compression,
+    double compression_level
+);
+
+/**
+ * recompresses every region file in the region directory, spread over a number of threads.
+ *
+ * the given rewriter is used by the calling thread, and every other thread opens its own,
+ * with its own codec, using the region directory's allocator.
+ * region files that are removed while this runs are skipped.
+ * after the first failure no more region files are started, and those not yet started are left as they were.
+ *
+ * @param[in] rewriter handle to the rewriter used by the calling thread.
+ * @param[in] region_dir handle to the region directory.
+ * @param[in] compression type of compression to recompress chunks with.
+ * @param[in] compression_level [0, 1] how much the data should be compressed at the expense of CPU time.
+ * @param[in] threads number of threads to use, including the calling thread. 0 is treated as 1.
+ * @return see @link anvil_region_recompress @endlink.
+ */
+anvil_result anvil_region_dir_recompress(
+    struct anvil_rewriter *rewriter,
+    const struct anvil_region_dir *region_dir,
+    anvil_compression compression,
+    double compression_level,
+    unsigned threads
+);
+
+/**
+ * recompresses every region file in the world's region, entities and poi directories,
+ * for the overworld, the nether and the end.
+ *
+ * @param[in] rewriter handle to the rewriter used by the calling thread.
+ * @param[in] world handle to the world.
+ * @param[in] compression type of compression to recompress chunks with.
+ * @param[in] compression_level [0, 1] how much the data should be compressed at the expense of CPU time.
+ * @param[in] threads number of threads to use, including the calling thread.
+ * @return see @link anvil_region_recompress @endlink.
+ */
+anvil_result anvil_world_recompress(
+    struct anvil_rewriter *rewriter,
+    const struct anvil_world *world,
+    anvil_compression compression,
+    double compression_level,
+    unsigned threads
+);
+
+/**
+ * rewrites a region file with every chunk moved next to each other in header order,
+ * removing the free sectors left behind as chunks grow, shrink and move.
+ *
+ * the header is checked for chunks that overlap or lie outside the file before anything is written.
+ * a last sector cut short by the end of the file is accepted, and is padded out in the new file.
+ * chunk data is copied as it is, and region files that are already compact are not rewritten.
+ * the new file replaces the original in the same way as @link anvil_region_recompress @endlink.
+ *
+ * the region file must not be open elsewhere while it is rewritten.
+ *
+ * @param[in] rewriter handle to the rewriter.
+ * @param[in] region_dir directory containing the region file.
+ * @param[in] region_x region x coordinate.
+ * @param[in] region_z region z coordinate.
+ * @retval ANVIL_OK on success.
+ * @retval ANVIL_INVALID_USAGE given arguments were invalid.
+ * @retval ANVIL_NOT_EXIST the region file does not exist.
+ * @retval ANVIL_MALFORMED the region file is corrupted.
+ * @retval ANVIL_DISK_FULL there is not enough space on the disk to write the new file.
+ * @retval ANVIL_ALLOC_FAILED memory allocation failed.
+ * @retval ANVIL_IO_ERROR an IO error occurred and errno is set.
+ */
+anvil_result anvil_region_compact(
+    struct anvil_rewriter *rewriter,
+    const struct anvil_region_dir *region_dir,
+    int64_t region_x,
+    int64_t region_z
+);
+
+/**
+ * compacts every region file in the region directory, spread over a number of threads.
+ *
+ * each thread opens its own rewriter with the region directory's allocator.
+ * region files that are removed while this runs are skipped.
+ * after the first failure no more region files are started.
+ *
+ * @param[in] region_dir handle to the region directory.
+ * @param[in] threads number of threads to use, including the calling thread.
+ *  0 or 1 compacts on the calling thread only.
+ * @return see @link anvil_region_compact @endlink.
+ */
+anvil_result anvil_region_dir_compact(
+    const struct anvil_region_dir *region_dir,
+    unsigned threads
+);
+
+/**
+ * compacts every region file in the world's region, entities and poi directories,
+ * for the overworld, the nether and the end.
+ *
+ * @param[in] world handle to the world.
+ * @param[in] threads number of threads to use, including the calling thread.
+ * @return see @link anvil_region_compact @endlink.
+ */
+anvil_result anvil_world_compact(
+    const struct anvil_world *world,
+    unsigned threads
+);
+
+/**
+ * releases resources associated with the rewriter.
+ * @param[in] rewriter handle to the rewriter.
+ */
+void anvil_rewriter_close(struct anvil_rewriter *rewriter);
+
 /**
  * @}
  */
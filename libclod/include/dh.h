@@ -21,7 +21,8 @@ typedef enum dh_result {
     DH_ERR_ALLOC,               // memory allocation failure.
     DH_ERR_MALFORMED,           // data is malformed.
     DH_ERR_UNSUPPORTED,         // the operation is currently unsupported.
-    DH_ERR_COMPRESS             // compression or decompression failed.
+    DH_ERR_COMPRESS,            // compression or decompression failed.
+    DH_DONE,                    // an iteration is finished.
 } dh_result;
 
 #define DH_DATA_COMPRESSION_UNCOMPRESSED 0
@@ -29,11 +30,18 @@ typedef enum dh_result {
 #define DH_DATA_COMPRESSION_ZSTD 2
 #define DH_DATA_COMPRESSION_LZMA2 3
 
+/**
+ * may be combined with a compression mode to split datapoint fields into separate planes before compression.
+ * LODs in planar form are not understood by DH, and must be converted before they are stored.
+ */
+#define DH_DATA_COMPRESSION_PLANAR 0x100
+#define DH_DATA_COMPRESSION_MODE_MASK 0xFF
+
 #define DH_LOD_CLEAR (struct dh_lod) {\
     0, 0, 0, 0, 0, DH_DATA_COMPRESSION_UNCOMPRESSED, \
     nullptr, 0, 0, \
     nullptr, 0, 0, \
-    false, \
+    false, 0, \
     nullptr, nullptr\
 }
 
@@ -49,11 +57,12 @@ struct dh_lod {
     size_t  mapping_len;                // size of the mapping.
     size_t  mapping_cap;                // size of allocated mapping.
 
-    char   *lod_arr;                    // lod data in serialised form.
+    char   *lod_arr;                    // lod data in serialised form. see dh_lod_serialise.
     size_t  lod_len;                    // length of serialised lod data.
     size_t  lod_cap;                    // size of allocated array.
 
     bool has_data;                      // true if the LOD contains any non-empty columns.
+    int32_t checksum;                   // CRC32 of the uncompressed LOD data. set when the LOD is serialised.
 
     void *(*realloc)(void*, size_t);    // used to allocate and free memory. methods will set this if it is nullptr.
     void *__internal;                   // internal usage.
@@ -70,9 +79,9 @@ dh_result dh_from_chunks(
 /**
  * creates a LOD with the given mip level using data from the given LODs.
  *
- * it does not currently support arbitrary generation, and instead
- * only supports 2x2, 4x4, 8x8, 16x16, 32x32 and 64x64 input lods of the same mip level,
+ * it only supports 2x2, 4x4, 8x8, 16x16, 32x32 and 64x64 input lods of the same mip level,
  * to generate a +1,  +2,  +3,  +4,    +5    and +6 mip level LOD respectively.
+ * dh_lod_mip_any handles anything else.
  *
  * notably, 64x64 input lods is about a gigabyte of LOD data.
  * that is a truly insane amount of memory for this task.
@@ -90,6 +99,81 @@ dh_result dh_lod_mip(
     size_t num_lods       // number of source LODs.
 );
 
+/**
+ * equivalent to dh_lod_mip, decompressing the source LODs with the given codec.
+ */
+dh_result dh_lod_mip_ex(
+    struct dh_lod *lod,         // destination LOD.
+    int64_t mip_level,          // mip level to generate.
+    struct dh_lod **lods,       // source LODs.
+    size_t num_lods,            // number of source LODs.
+    struct anvil_codec *codec   // (nullable) codec to decompress with.
+);
+
+/**
+ * how the id of each mipped datapoint is picked from the datapoints beneath it.
+ * each is its own specialisation of the mip kernel, so picking one costs nothing per datapoint.
+ */
+#define DH_MIP_MODE 0               // the id covering the most columns. ties go to the id above.
+#define DH_MIP_SURFACE 1            // as DH_MIP_MODE, but air only wins where nothing else is, so the top of every column stays visible.
+#define DH_MIP_HEIGHT_WEIGHTED 2    // as DH_MIP_MODE, with each column's vote weighted by the height of its datapoint, favouring long runs.
+#define DH_MIP_FAST 3               // the top left column, as it is. for mip levels only seen from very far away.
+
+/**
+ * equivalent to dh_lod_mip_ex, picking ids with the given policy.
+ * light is averaged over every column with all policies but DH_MIP_FAST, which keeps the column's own.
+ */
+dh_result dh_lod_mip_policy(
+    struct dh_lod *lod,         // destination LOD.
+    int64_t mip_level,          // mip level to generate.
+    struct dh_lod **lods,       // source LODs.
+    size_t num_lods,            // number of source LODs.
+    struct anvil_codec *codec,  // (nullable) codec to decompress with.
+    int64_t policy              // one of DH_MIP_MODE, DH_MIP_SURFACE, DH_MIP_HEIGHT_WEIGHTED or DH_MIP_FAST.
+);
+
+/**
+ * creates the LOD at the given mip level and position from any LODs beneath it.
+ *
+ * sources can be of any lower mip level, at any position, and in any order.
+ * those outside the destination are skipped, as are null sources,
+ * and parts of the destination without a source are left empty.
+ * sources shouldn't overlap each other, overlapping sources are both counted.
+ *
+ * each source is merged down to the destination's resolution on its own,
+ * then added to running per-column summaries weighted by the area it covers,
+ * so sources are only needed one at a time.
+ * each span of a column takes the id covering the most area, from a summary of a few ids per span,
+ * which is exact unless more ids than that share a span.
+ *
+ * it returns DH_ERR_INVALID_ARGUMENT for sources that aren't below the mip level.
+ */
+dh_result dh_lod_mip_any(
+    struct dh_lod *lod,         // destination LOD.
+    int64_t mip_level,          // mip level to generate.
+    int64_t x,                  // destination x position.
+    int64_t z,                  // destination z position.
+    struct dh_lod **lods,       // source LODs.
+    size_t num_lods,            // number of source LODs.
+    struct anvil_codec *codec   // (nullable) codec to decompress sources with.
+);
+
+/**
+ * equivalent to dh_lod_mip_any, reading sources one at a time from next until it returns 0.
+ * next fills src, which is reused between calls, returning 1 for a source and -1 on error.
+ *
+ * it returns DH_ERR_INVALID_ARGUMENT if next fails.
+ */
+dh_result dh_lod_mip_stream(
+    struct dh_lod *lod,                             // destination LOD.
+    int64_t mip_level,                              // mip level to generate.
+    int64_t x,                                      // destination x position.
+    int64_t z,                                      // destination z position.
+    int (*next)(struct dh_lod *src, void *user),    // reads the next source LOD into src.
+    void *user,                                     // passed to next.
+    struct anvil_codec *codec                       // (nullable) codec to decompress sources with.
+);
+
 /**
  * returns the mapping in serialised form.
  * 
@@ -103,9 +187,22 @@ dh_result dh_lod_serialise_mapping(
     size_t *n_bytes
 );
 
+/**
+ * replaces the LOD's mapping with one in serialised form, as stored by DH.
+ * the mapping is expected to be compressed with the LOD's compression mode.
+ */
+dh_result dh_lod_deserialise_mapping(
+    struct dh_lod *lod,
+    const char *in,
+    size_t in_len
+);
+
 /**
  * converts the format from its current compression format to the requested format,
  * it takes uncompressed as an argument and is the correct method to use for decompression.
+ *
+ * DH_DATA_COMPRESSION_PLANAR can be added to any mode, which compresses LZ4 and LZMA2 LODs
+ * considerably better and decompresses LZ4 faster, but is private to this library.
  * 
  * a compression level of .5 is expected to be a reasonable
  * compression level for all compression types,
@@ -118,6 +215,108 @@ dh_result dh_compress(
     double level
 );
 
+/**
+ * equivalent to dh_compress, using the compression contexts in the codec
+ * instead of ones kept by the LOD.
+ *
+ * the codec may be null, in which case it is identical to dh_compress.
+ */
+dh_result dh_compress_ex(
+    struct dh_lod *lod,
+    int64_t compression_mode,
+    double level,
+    struct anvil_codec *codec
+);
+
+/**
+ * writes the LOD's data into lod_arr, uncompressed, and sets its checksum.
+ *
+ * dh_from_chunks, the mip functions and dh_lod_compact keep the data they make decoded in memory,
+ * and don't write lod_arr until it's needed, so stages that follow each other don't each
+ * re-read and rewrite every datapoint. the library serialises LODs whenever it reads lod_arr -
+ * compressing, storing, iterating, verifying and trimming all do.
+ * lod_arr, lod_len and checksum are only meaningful to anything else after this has been called.
+ *
+ * it does nothing if lod_arr is already up to date.
+ */
+dh_result dh_lod_serialise(
+    struct dh_lod *lod
+);
+
+/**
+ * checks the LOD's data against its checksum, decompressing it if needed,
+ * and that it has every column and only uses ids in its mapping.
+ *
+ * it returns DH_ERR_MALFORMED if the data doesn't match or is cut short,
+ * and DH_ERR_UNSUPPORTED for compression modes that can't be streamed.
+ */
+dh_result dh_lod_verify(
+    struct dh_lod *lod,
+    struct anvil_codec *codec   // (nullable) codec to decompress with.
+);
+
+/**
+ * caps the number of datapoints in every column of the LOD, merging datapoints underground first.
+ *
+ * columns with more than max_datapoints are compacted from depth blocks beneath their first datapoint
+ * without sky light - the first that can't be seen from above - downwards, by splitting what's there into
+ * groups of similar height that each become one datapoint with the id and light of the group's tallest datapoint.
+ * if that isn't enough to meet the budget, compaction starts higher up the column.
+ * columns within budget are left as they are.
+ *
+ * dh_from_chunks only joins identical neighbours, so noisy caves can leave columns with hundreds of datapoints,
+ * and shorter columns make everything after generation cheaper.
+ * the LOD is decompressed, and left uncompressed.
+ */
+dh_result dh_lod_compact(
+    struct dh_lod *lod,
+    int64_t depth,              // blocks beneath the first datapoint without sky light that are kept as they are.
+    size_t max_datapoints,      // most datapoints a column may have. at least 1.
+    struct anvil_codec *codec   // (nullable) codec to decompress with.
+);
+
+/**
+ * a beacon found while generating a LOD, with the colour of its beam.
+ */
+struct dh_beacon {
+    int64_t x;
+    int64_t y;
+    int64_t z;
+    uint8_t r;
+    uint8_t g;
+    uint8_t b;
+};
+
+/**
+ * the beacons in the chunks a LOD was last generated from, by dh_from_chunks or dh_lod_add_beacons.
+ * they are stored with the LOD by dh_db_store, replacing the beacons stored in its area.
+ *
+ * it returns DH_ERR_UNSUPPORTED if the LOD wasn't generated from chunks,
+ * i.e. it was loaded or mipped into since.
+ */
+dh_result dh_lod_beacons(
+    struct dh_lod *lod,
+    const struct dh_beacon **beacons,
+    size_t *num_beacons
+);
+
+/**
+ * adds the beacons in one of a LOD's chunks to its beacons, for LODs that aren't made with dh_from_chunks.
+ * chunk is the chunk's uncompressed NBT, as anvil_chunk_read gives it.
+ *
+ * each beam takes the colour of the stained glass and panes above its beacon in its chunk,
+ * the first glass replacing the default white and each one after being averaged in.
+ * the first call since the LOD's data was replaced, e.g. by dh_lod_recycle, starts its beacons again,
+ * so it's called for each chunk once the LOD's data is made.
+ *
+ * it returns DH_ERR_MALFORMED if the chunk's NBT is.
+ */
+dh_result dh_lod_add_beacons(
+    struct dh_lod *lod,
+    char *chunk,
+    size_t chunk_size
+);
+
 /**
  * frees temporary resources, reducing the size of the LOD to a minimum required to hold the LODs data.
  * the LOD retains its data and is valid.
@@ -126,6 +325,20 @@ void dh_lod_trim(
     struct dh_lod *lod
 );
 
+/**
+ * empties the LOD so it can be used for another, at the given mip level and position.
+ *
+ * unlike freeing it and starting again, it keeps its buffers, mapping strings and compression contexts,
+ * which are sized for LODs like the last one - LZMA2 contexts in particular are expensive to make.
+ * pipelines making many LODs can keep recycled LODs in a dh_lod_pool.
+ */
+void dh_lod_recycle(
+    struct dh_lod *lod,
+    int64_t mip_level,
+    int64_t x,
+    int64_t z
+);
+
 /**
  * frees resources associated with the lod. the LOD must not be reused.
  */
@@ -133,6 +346,233 @@ void dh_lod_free(
     struct dh_lod *lod
 );
 
+/**
+ * a free list of recycled LODs, for pipelines making many LODs one after another.
+ * LODs given back keep their buffers, mapping strings and compression contexts for the LODs taken after them.
+ * a pool isn't shared between threads, each one keeps its own.
+ */
+struct dh_lod_pool;
+
+/**
+ * makes a pool holding up to max_lods spare LODs, allocated with realloc_f.
+ * it returns null if the pool couldn't be allocated.
+ */
+struct dh_lod_pool *dh_lod_pool_new(
+    size_t max_lods,
+    void *(*realloc_f)(void*, size_t)   // (nullable) allocator for the pool and its LODs, realloc if null.
+);
+
+/**
+ * takes a spare LOD from the pool, recycled to the given mip level and position with dh_lod_recycle,
+ * or makes a new empty one if there are none.
+ * it returns null if a new LOD couldn't be allocated.
+ */
+struct dh_lod *dh_lod_pool_take(
+    struct dh_lod_pool *pool,
+    int64_t mip_level,
+    int64_t x,
+    int64_t z
+);
+
+/**
+ * gives a LOD taken from the pool back to it, freeing it if the pool already holds max_lods.
+ */
+void dh_lod_pool_give(
+    struct dh_lod_pool *pool,
+    struct dh_lod *lod
+);
+
+/**
+ * frees the pool and its spare LODs. LODs taken from it have to be given back first.
+ */
+void dh_lod_pool_free(
+    struct dh_lod_pool *pool
+);
+
+//==================//
+// Arena Allocation //
+//==================//
+
+/**
+ * a bump allocator for LODs, to use as their realloc.
+ *
+ * allocating is taking the next bytes of a block, and freeing does nothing, other than for the last allocation.
+ * everything is given back at once by resetting the arena, which keeps its blocks for next time,
+ * so a pipeline that repeats the same work, e.g. generating, compressing and storing a LOD
+ * before freeing it and resetting, stops calling the system allocator once it's been through once.
+ * pass an anvil_codec to the _ex functions so compression contexts outlive the LOD.
+ *
+ * realloc has no room for an argument, so dh_arena_realloc allocates from whichever arena is bound to
+ * the calling thread. each thread, e.g. each worker, binds its own, and an arena's LODs stay on its thread.
+ */
+struct dh_arena;
+
+/**
+ * makes an arena, which takes memory from the system in blocks of at least block_size bytes.
+ * a block_size of 0 uses a default of 4MiB.
+ * it returns null if the arena couldn't be allocated.
+ */
+struct dh_arena *dh_arena_new(
+    size_t block_size
+);
+
+/**
+ * makes dh_arena_realloc allocate from the arena on the calling thread, or from nothing if it's null.
+ */
+void dh_arena_bind(
+    struct dh_arena *arena
+);
+
+/**
+ * a realloc for LODs, allocating from the calling thread's arena.
+ * with no arena bound it fails to allocate, and frees nothing.
+ */
+void *dh_arena_realloc(
+    void *ptr,
+    size_t size
+);
+
+/**
+ * frees every allocation made from the arena at once, keeping its memory for the allocations after it.
+ * LODs allocated from the arena must be freed first, or not used again.
+ */
+void dh_arena_reset(
+    struct dh_arena *arena
+);
+
+/**
+ * the bytes the arena has taken from the system, which stops growing once its workload fits.
+ */
+size_t dh_arena_reserved(
+    const struct dh_arena *arena
+);
+
+/**
+ * returns the arena's memory to the system, unbinding it from the calling thread if it's bound.
+ */
+void dh_arena_free(
+    struct dh_arena *arena
+);
+
+//===============//
+// Memory Budget //
+//===============//
+
+/**
+ * a limit on the memory taken by LODs using dh_budget_realloc, shared by every thread in the process,
+ * so conversions running side by side keep within it together.
+ *
+ * going over it doesn't make anything fail, allocations are only counted. pipelines are expected to
+ * hold back new work while dh_budget_near is true - dh_db_build_mips_ex, whose LODs all use it,
+ * finishes the tiles it's started before starting another, and writes LODs waiting on their siblings
+ * to a temporary file instead of keeping them in memory.
+ */
+
+/**
+ * sets the budget in bytes. 0, the default, is no limit.
+ */
+void dh_budget_set(
+    size_t bytes
+);
+
+/**
+ * the bytes allocated by dh_budget_realloc that haven't been freed.
+ */
+size_t dh_budget_used(void);
+
+/**
+ * true if there is a budget and less than an eighth of it is left.
+ */
+bool dh_budget_near(void);
+
+/**
+ * a realloc for LODs, counting what it allocates against the budget.
+ */
+void *dh_budget_realloc(
+    void *ptr,
+    size_t size
+);
+
+//================//
+// Column Reading //
+//================//
+
+/**
+ * reads a LOD's columns one at a time, decompressing only as much as is needed for the next column.
+ *
+ * LZ4 LODs are decompressed through a small window, so reading the first few columns,
+ * or stopping part way through, doesn't cost decompressing the entire LOD.
+ * uncompressed LODs are read in place.
+ * other compression modes are not supported.
+ */
+struct dh_column_iter;
+
+/**
+ * begins reading the LOD's columns.
+ * the LOD must not be changed or freed until the iteration is closed.
+ */
+dh_result dh_column_iter_open(
+    struct dh_column_iter **iter_out,   // handle to the iteration.
+    struct dh_lod *lod,                 // LOD to read. it is serialised first.
+    struct anvil_codec *codec           // (nullable) codec to decompress with.
+);
+
+/**
+ * reads the next column.
+ *
+ * datapoints points to the column's serialised datapoints, and is valid until the next call.
+ * it returns DH_DONE after the last column.
+ */
+dh_result dh_column_iter_next(
+    struct dh_column_iter *iter,
+    const char **datapoints,            // the column's datapoints.
+    size_t *num_datapoints              // number of datapoints in the column.
+);
+
+/**
+ * skips over the next n columns.
+ * it returns DH_DONE if there were fewer than n columns left.
+ */
+dh_result dh_column_iter_skip(
+    struct dh_column_iter *iter,
+    size_t n
+);
+
+/**
+ * releases resources associated with the iteration.
+ */
+void dh_column_iter_close(
+    struct dh_column_iter *iter
+);
+
+/**
+ * finds where each of the LOD's columns starts, so any column can be read without reading the ones before it.
+ * the LOD is serialised and decompressed first.
+ *
+ * offsets has 64 * 64 + 1 entries: the position in lod_arr of each column's datapoint count, in x major order,
+ * then the end of the last column. the offsets are kept with the LOD, so finding them again is free,
+ * and they stay valid until the LOD's data is changed, compressed or freed.
+ */
+dh_result dh_lod_column_offsets(
+    struct dh_lod *lod,
+    const uint32_t **offsets,           // the column offsets.
+    struct anvil_codec *codec           // (nullable) codec to decompress with.
+);
+
+/**
+ * reads a single column of the LOD, by its position in the LOD.
+ *
+ * datapoints points to the column's serialised datapoints in lod_arr,
+ * and is valid until the LOD's data is changed, compressed or freed.
+ */
+dh_result dh_lod_column(
+    struct dh_lod *lod,
+    int64_t x,                          // column x, from 0 to 63.
+    int64_t z,                          // column z, from 0 to 63.
+    const char **datapoints,            // the column's datapoints.
+    size_t *num_datapoints,             // number of datapoints in the column.
+    struct anvil_codec *codec           // (nullable) codec to decompress with.
+);
 
 //==================//
 // SQlite3 Database //
@@ -140,9 +580,378 @@ void dh_lod_free(
 
 struct dh_db;
 struct dh_db *dh_db_open(const char *path);
+
+/**
+ * opens the database for writing a large number of LODs, i.e. converting a world for the first time.
+ *
+ * the database is locked exclusively and written in a single transaction that is committed on close,
+ * with a large page cache and memory mapping, and bigger pages if the database is new.
+ * the ApplyToParent index is dropped and recreated on close.
+ *
+ * LODs are written fastest when stored in (mip level, x, z) order.
+ * other processes can't read the database until it is closed,
+ * and nothing is written if the process ends before then.
+ */
+#define DH_DB_BULK_LOAD 1
+
+/**
+ * buffers stored LODs and writes them sorted by mip level then Morton (Z-order) position,
+ * so LODs that are close together end up close together in the database file.
+ * this makes reading an area touch fewer pages, and inserts faster.
+ *
+ * LODs are written when around 64MB are buffered, on dh_db_flush and on close,
+ * and before anything else reads or modifies the database.
+ * errors writing them are returned from whichever call wrote them, and the LODs are kept to be written again.
+ * a batch that fails is rolled back, except with DH_DB_BULK_LOAD, where the LODs before the failure stay written.
+ */
+#define DH_DB_SORTED_WRITES 2
+
+struct dh_db *dh_db_open_ex(const char *path, unsigned flags);
 void dh_db_close(struct dh_db *db);
+
+/**
+ * equivalent to dh_db_close, returning -1 if anything couldn't be written.
+ * this includes LODs still buffered by DH_DB_SORTED_WRITES, and committing a DH_DB_BULK_LOAD.
+ * the database is closed either way.
+ */
+int dh_db_close_ex(struct dh_db *db);
+
+/**
+ * stores a LOD, replacing the stored LOD at the same position and mip level.
+ * if the stored LOD has the same checksum it is left untouched.
+ */
 int dh_db_store(const struct dh_db *db, struct dh_lod *lod);
 
+/**
+ * equivalent to dh_db_store.
+ * if apply_to_parent is set, DH is told the LOD has changed and will update the LODs above it.
+ * this should be set when replacing a LOD that has already been stored.
+ */
+int dh_db_store_ex(const struct dh_db *db, struct dh_lod *lod, bool apply_to_parent);
+
+/**
+ * equivalent to dh_db_store_ex, also setting ApplyToChildren on the stored row.
+ * it is for LODs above mip level 0 built from the ones beneath them, as dh_db_build_mips stores them.
+ */
+int dh_db_store_mip(const struct dh_db *db, struct dh_lod *lod, bool apply_to_parent);
+
+/**
+ * writes LODs buffered by DH_DB_SORTED_WRITES.
+ */
+int dh_db_flush(const struct dh_db *db);
+
+/**
+ * copies the database at path to out_path with LODs laid out in (mip level, Morton position) order,
+ * the same order DH_DB_SORTED_WRITES writes them in.
+ * existing databases are written in whatever order their LODs were generated,
+ * so reading an area can touch a page per LOD.
+ *
+ * the database at path is only read, and may be open elsewhere. out_path must not exist.
+ */
+int dh_db_recluster(const char *path, const char *out_path);
+
+/**
+ * reads the stored LOD at a position and mip level into lod, reusing its buffers.
+ *
+ * the LOD is left compressed as it was stored, with its mapping parsed.
+ * heights aren't stored, so height is 0.
+ *
+ * it returns 0 on success, 1 if there is no LOD stored there and -1 on error.
+ */
+int dh_db_load(
+    const struct dh_db *db,
+    int64_t mip_level,
+    int64_t x,
+    int64_t z,
+    struct dh_lod *lod
+);
+
+/**
+ * iterates over stored LODs of a mip level within an inclusive range of positions,
+ * in x then z order. the range may cover the entire level to stream every LOD in it.
+ */
+struct dh_db_cursor;
+
+int dh_db_cursor_open(
+    struct dh_db_cursor **cursor_out,
+    const struct dh_db *db,
+    int64_t mip_level,
+    int64_t min_x,
+    int64_t min_z,
+    int64_t max_x,
+    int64_t max_z
+);
+
+/**
+ * reads the next LOD into lod, the same as dh_db_load.
+ * it returns 1 if a LOD was read, 0 after the last LOD and -1 on error.
+ */
+int dh_db_cursor_next(struct dh_db_cursor *cursor, struct dh_lod *lod);
+
+void dh_db_cursor_close(struct dh_db_cursor *cursor);
+
+/**
+ * deletes stored LODs of a mip level within an inclusive range of positions,
+ * i.e. so an area can be regenerated from scratch.
+ */
+int dh_db_delete(
+    const struct dh_db *db,
+    int64_t mip_level,
+    int64_t min_x,
+    int64_t min_z,
+    int64_t max_x,
+    int64_t max_z
+);
+
+/**
+ * clears ApplyToParent on stored LODs of a mip level within an inclusive range of positions,
+ * once the LODs above them have been regenerated.
+ */
+int dh_db_applied(
+    const struct dh_db *db,
+    int64_t mip_level,
+    int64_t min_x,
+    int64_t min_z,
+    int64_t max_x,
+    int64_t max_z
+);
+
+/**
+ * generates and stores mip levels 1 to top_level from the mip level 0 LODs in the database.
+ *
+ * the range is in mip level 0 positions, and every top_level LOD overlapping it is built.
+ * each is built depth first, visiting its 2x2 children in Morton order,
+ * so only four LODs per level are held at once and memory is bounded by top_level, not world size.
+ * positions with no stored LODs beneath them are skipped.
+ *
+ * LODs are stored with the given compression and ApplyToChildren set, see dh_db_store_mip.
+ * top_level LODs are stored with ApplyToParent set so DH carries the changes further up,
+ * and ApplyToParent is cleared on the LODs they were built from.
+ */
+int dh_db_build_mips(
+    const struct dh_db *db,
+    int64_t top_level,
+    int64_t min_x,
+    int64_t min_z,
+    int64_t max_x,
+    int64_t max_z,
+    int64_t compression_mode,
+    double compression_level,
+    struct anvil_codec *codec   // (nullable) codec to compress and decompress with.
+);
+
+/**
+ * equivalent to dh_db_build_mips, building LODs on the given number of threads, including the calling thread.
+ *
+ * a LOD can be built once its 2x2 children are, and LODs that are ready are built by whichever thread is free.
+ * each thread finishes the LODs it started before starting others, and a LOD's children are freed once it's built,
+ * so around 4 LODs per level per thread are held at once.
+ * the database is only used by one thread at a time, it has to be usable from threads other than the one that opened it.
+ *
+ * the given codec is used by the calling thread, and every other thread opens its own.
+ * with more than one thread, LODs are stored in no particular order.
+ *
+ * LODs are allocated with dh_budget_realloc. while the memory budget is nearly used up,
+ * no new top level LODs are started until the ones being built are done, and built LODs waiting on
+ * their siblings are written to a temporary file, to be read back when their parent is built.
+ */
+int dh_db_build_mips_ex(
+    const struct dh_db *db,
+    int64_t top_level,
+    int64_t min_x,
+    int64_t min_z,
+    int64_t max_x,
+    int64_t max_z,
+    int64_t compression_mode,
+    double compression_level,
+    struct anvil_codec *codec,  // (nullable) codec to compress and decompress with on the calling thread.
+    unsigned threads            // number of threads. 0 is treated as 1.
+);
+
+/**
+ * builds the LOD at the given mip level and position into lod, from the stored LODs of source_level beneath it.
+ * sources are streamed from the database one at a time, and missing ones are left empty.
+ * the LOD isn't stored.
+ *
+ * it returns 0 if the LOD was built, 1 if there are no stored LODs beneath it and -1 on error.
+ */
+int dh_db_mip_any(
+    const struct dh_db *db,
+    int64_t mip_level,
+    int64_t x,
+    int64_t z,
+    int64_t source_level,
+    struct dh_lod *lod,
+    struct anvil_codec *codec   // (nullable) codec to decompress with.
+);
+
+/**
+ * state of the 4x4 chunks that make up a LOD, compared to what was recorded in the ChunkHash table.
+ * chunks are in the same order as dh_from_chunks.
+ */
+struct dh_chunk_state {
+    int64_t lod_x;                      // LOD x position.
+    int64_t lod_z;                      // LOD z position.
+    uint32_t mtime[16];                 // chunk mtimes from the region file.
+    int32_t hash[16];                   // hash of chunk data. only computed for chunks whose mtime changed.
+    bool stale[16];                     // the chunk's record is out of date.
+    bool changed;                       // chunk data has changed, and the LOD should be regenerated.
+};
+
+/**
+ * checks if the chunks making up a LOD have changed since they were last recorded.
+ *
+ * mtimes in the region header are compared first, and only chunks with a different mtime
+ * are decompressed and hashed, so checking an unchanged LOD costs 16 lookups and no decompression.
+ * a chunk that was saved without its data changing doesn't count as changed.
+ *
+ * the ChunkHash table's LastModifiedUnixDateTime holds the chunk's mtime from the region header
+ * in milliseconds, as DH writes it, and ChunkHash holds a CRC32 of the decompressed chunk data.
+ *
+ * it returns 1 if the LOD should be regenerated, 0 if not and -1 on error.
+ */
+int dh_db_chunks_changed(
+    struct dh_db *db,
+    struct anvil_region_file *region_file,  // region file containing the chunks.
+    struct anvil_codec *codec,              // (nullable) codec to decompress with.
+    int64_t lod_x,                          // LOD x position.
+    int64_t lod_z,                          // LOD z position.
+    struct dh_chunk_state *state            // destination for the chunks' state.
+);
+
+/**
+ * records the state of stale chunks in the ChunkHash table.
+ * this should be done once the regenerated LOD has been stored, so an interrupted run regenerates it again next time.
+ * LODs waiting to be written are flushed first, and nothing is recorded if that fails.
+ */
+int dh_db_chunks_record(const struct dh_db *db, const struct dh_chunk_state *state);
+
+/**
+ * brings the LODs made from a region file up to date with it.
+ *
+ * each of the region's 8x8 mip level 0 LODs is checked with dh_db_chunks_changed, and only the ones whose chunks
+ * have changed are made by generate, i.e. by reading their 4x4 chunks and passing them to dh_from_chunks,
+ * and replaced with ApplyToParent set. generate returns anything other than DH_OK to fail the update.
+ * their chunks are recorded once they've been written, so a failed update redoes them next time.
+ * then only their ancestors, up to top_level, are rebuilt with dh_db_mip_any and stored as dh_db_build_mips does.
+ *
+ * it returns the number of mip level 0 LODs regenerated, or -1 on error.
+ */
+int dh_db_update_region(
+    struct dh_db *db,
+    struct anvil_region_file *region_file,  // region file the LODs are made from.
+    int64_t region_x,                       // region x position.
+    int64_t region_z,                       // region z position.
+    int64_t top_level,                      // highest mip level to rebuild. 0 rebuilds none.
+    int64_t compression_mode,
+    double compression_level,
+    struct anvil_codec *codec,              // (nullable) codec to compress and decompress with.
+    dh_result (*generate)(int64_t lod_x, int64_t lod_z, struct dh_lod *lod, void *user),  // makes a changed LOD.
+    void *user                              // passed to generate.
+);
+
+/**
+ * equivalent to dh_db_update_region, generating and mipping into a LOD taken from the given pool,
+ * which is given back once the region is done. each LOD is recycled to its position before it's generated.
+ *
+ * updating many regions with the same pool keeps the LOD's buffers and compression contexts between them.
+ */
+int dh_db_update_region_ex(
+    struct dh_db *db,
+    struct anvil_region_file *region_file,  // region file the LODs are made from.
+    int64_t region_x,                       // region x position.
+    int64_t region_z,                       // region z position.
+    int64_t top_level,                      // highest mip level to rebuild. 0 rebuilds none.
+    int64_t compression_mode,
+    double compression_level,
+    struct anvil_codec *codec,              // (nullable) codec to compress and decompress with.
+    dh_result (*generate)(int64_t lod_x, int64_t lod_z, struct dh_lod *lod, void *user),  // makes a changed LOD.
+    void *user,                             // passed to generate.
+    struct dh_lod_pool *pool                // (nullable) pool to take the LOD from, a new LOD is used if null.
+);
+
+//=================//
+// Storage Backend //
+//=================//
+
+/**
+ * a place LODs are stored, behind a common set of methods.
+ *
+ * store handles are opaque to the caller and are only passed back to the backend that opened them.
+ * get returns 0 on success, 1 if there is no LOD stored there and -1 on error.
+ * range reads every stored LOD of a mip level within an inclusive range of positions into lod,
+ * calling each for every one. it returns -1 on error, 0 once done,
+ * or the value each returned if it wasn't 0, stopping early.
+ * the other methods return 0 on success and -1 on error.
+ * close frees the handle either way, and fails if anything stored couldn't be written.
+ */
+struct dh_store_backend {
+    const char *name;
+
+    void *(*open)(const char *path, unsigned flags);
+    int (*put)(void *store, struct dh_lod *lod, bool apply_to_parent);
+    int (*get)(void *store, int64_t mip_level, int64_t x, int64_t z, struct dh_lod *lod);
+    int (*range)(
+        void *store,
+        int64_t mip_level,
+        int64_t min_x,
+        int64_t min_z,
+        int64_t max_x,
+        int64_t max_z,
+        struct dh_lod *lod,
+        int (*each)(struct dh_lod *lod, void *user),
+        void *user
+    );
+    int (*delete)(void *store, int64_t mip_level, int64_t min_x, int64_t min_z, int64_t max_x, int64_t max_z);
+    int (*close)(void *store);
+};
+
+/**
+ * the DH database. flags are those taken by dh_db_open_ex.
+ */
+extern const struct dh_store_backend dh_store_sqlite;
+
+/**
+ * a single append-only file, memory mapped for reading, with a Morton ordered index at its end.
+ * it has none of SQLite's per row overhead, and is meant for distributing pre-generated LODs
+ * to clients that only read them. it isn't understood by DH.
+ *
+ * stored LODs are appended, and replacing or deleting a LOD leaves its old copy in the file.
+ * the index is written on close, and if the file isn't closed everything stored since it was opened is lost.
+ * flags are unused.
+ */
+extern const struct dh_store_backend dh_store_flat;
+
+/**
+ * a FullData table in PostgreSQL, with the same columns as DH's, for a LOD store shared between servers.
+ * the path is a libpq connection string, and flags are unused.
+ * if libpq wasn't found when the library was built, opening it always fails.
+ *
+ * stored LODs are sent in batches of around 32MB with a binary COPY, and merged into FullData,
+ * so a position stored more than once in a batch keeps the last LOD stored.
+ * batches are also sent before reading or deleting, and on close.
+ */
+extern const struct dh_store_backend dh_store_postgres;
+
+struct dh_store;
+
+struct dh_store *dh_store_open(const struct dh_store_backend *backend, const char *path, unsigned flags);
+int dh_store_put(struct dh_store *store, struct dh_lod *lod, bool apply_to_parent);
+int dh_store_get(struct dh_store *store, int64_t mip_level, int64_t x, int64_t z, struct dh_lod *lod);
+int dh_store_range(
+    struct dh_store *store,
+    int64_t mip_level,
+    int64_t min_x,
+    int64_t min_z,
+    int64_t max_x,
+    int64_t max_z,
+    struct dh_lod *lod,
+    int (*each)(struct dh_lod *lod, void *user),
+    void *user
+);
+int dh_store_delete(struct dh_store *store, int64_t mip_level, int64_t min_x, int64_t min_z, int64_t max_x, int64_t max_z);
+int dh_store_close(struct dh_store *store);
+
 /**
  * @}
  */
\ No newline at end of file
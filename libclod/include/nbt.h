@@ -267,26 +267,26 @@ int16_t nbt_short(const char *payload) {
 static __nbt_nonnull(1)
 int32_t nbt_int(const char *payload) {
     __nbt_assert(payload != nullptr);
-    return 
-        ((int32_t)(unsigned char)payload[0]<<24) +
-        ((int32_t)(unsigned char)payload[1]<<16) +
-        ((int32_t)(unsigned char)payload[2]<<8) +
-        ((int32_t)(unsigned char)payload[3]);
+    return (int32_t)(
+        ((uint32_t)(unsigned char)payload[0]<<24) +
+        ((uint32_t)(unsigned char)payload[1]<<16) +
+        ((uint32_t)(unsigned char)payload[2]<<8) +
+        ((uint32_t)(unsigned char)payload[3]));
 }
 
 /** (8) parses a long payload. payload must not be nullptr. */
 static __nbt_nonnull(1)
 int64_t nbt_long(const char *payload) {
     __nbt_assert(payload != nullptr);
-    return 
-        ((int64_t)(unsigned char)payload[0]<<56) +
-        ((int64_t)(unsigned char)payload[1]<<48) +
-        ((int64_t)(unsigned char)payload[2]<<40) +
-        ((int64_t)(unsigned char)payload[3]<<32) +
-        ((int64_t)(unsigned char)payload[4]<<24) +
-        ((int64_t)(unsigned char)payload[5]<<16) +
-        ((int64_t)(unsigned char)payload[6]<<8) +
-        ((int64_t)(unsigned char)payload[7]);
+    return (int64_t)(
+        ((uint64_t)(unsigned char)payload[0]<<56) +
+        ((uint64_t)(unsigned char)payload[1]<<48) +
+        ((uint64_t)(unsigned char)payload[2]<<40) +
+        ((uint64_t)(unsigned char)payload[3]<<32) +
+        ((uint64_t)(unsigned char)payload[4]<<24) +
+        ((uint64_t)(unsigned char)payload[5]<<16) +
+        ((uint64_t)(unsigned char)payload[6]<<8) +
+        ((uint64_t)(unsigned char)payload[7]));
 }
 
 /** (4) parses a float payload. payload must not be nullptr. */
@@ -293,6 +293,9 @@ int anvil_parse_sections_ex(
     const struct anvil_chunk chunk,
     void *(*realloc_f)(void*, size_t)
 ) {
+    sections->section_list = nullptr;
+    sections->block_entities = nullptr;
+
     if (chunk.data_size == 0) {
         sections->len = 0;
         return 0;
@@ -305,11 +308,11 @@ int anvil_parse_sections_ex(
 
     sections->realloc = realloc_f != nullptr ? realloc_f : realloc;
 
-    char *section_list = nullptr;
     int64_t section_min_y = INT64_MIN;
     const char* end = nbt_named(nbt_payload(chunk.data, NBT_COMPOUND, chunk.data + chunk.data_size),
                           chunk.data + chunk.data_size,
-                          "sections", strlen("sections"), NBT_LIST, &section_list,
+                          "sections", strlen("sections"), NBT_LIST, &sections->section_list,
+                          "block_entities", strlen("block_entities"), NBT_LIST, &sections->block_entities,
                           "xPos", strlen("xPos"), NBT_ANY_INTEGER, &sections->x,
                           "yPos", strlen("yPos"), NBT_ANY_INTEGER, &section_min_y,
                           "zPos", strlen("zPos"), NBT_ANY_INTEGER, &sections->z,
@@ -317,6 +320,7 @@ int anvil_parse_sections_ex(
                           nullptr
     );
 
+    char *section_list = sections->section_list;
     if (section_list == nullptr || end == nullptr || section_min_y == INT64_MIN)
         return -1;
 
@@ -0,0 +1,137 @@
+/**
+ * @private
+ */
+
+#include <libdeflate.h>
+#include <lzma.h>
+#include <lz4frame.h>
+
+#include "anvil.h"
+#include "compress.h"
+
+anvil_result anvil_codec_open(
+    struct anvil_codec **codec_out,
+    const anvil_allocator *alloc
+) {
+    if (codec_out == nullptr) return ANVIL_INVALID_USAGE;
+
+    if (alloc == nullptr)
+        alloc = &default_anvil_allocator;
+    else if (
+        alloc->malloc == nullptr ||
+        alloc->calloc == nullptr ||
+        alloc->free == nullptr ||
+        alloc->realloc == nullptr
+    ) {
+        return ANVIL_INVALID_USAGE;
+    }
+
+    struct anvil_codec *codec = alloc->malloc(sizeof(struct anvil_codec));
+    if (codec == nullptr) {
+        return ANVIL_ALLOC_FAILED;
+    }
+
+    codec->alloc = alloc;
+    codec->deflate_level = -1;
+    codec->deflate_compressor = nullptr;
+    codec->deflate_decompressor = nullptr;
+    codec->lz4_ctx = nullptr;
+    codec->lz4_dctx = nullptr;
+    codec->in_buffer = nullptr;
+    codec->in_buffer_cap = 0;
+    codec->out_buffer = nullptr;
+    codec->out_buffer_cap = 0;
+
+    // the streams are made here so that compress_lzma and decompress_lzma never allocate them,
+    // which would otherwise be done with whichever allocator the caller happened to pass.
+    codec->lzma_ctx = alloc->malloc(sizeof(lzma_stream));
+    codec->lzma_dctx = alloc->malloc(sizeof(lzma_stream));
+    if (codec->lzma_ctx == nullptr || codec->lzma_dctx == nullptr) {
+        alloc->free(codec->lzma_ctx);
+        alloc->free(codec->lzma_dctx);
+        alloc->free(codec);
+        return ANVIL_ALLOC_FAILED;
+    }
+
+    *(lzma_stream*)codec->lzma_ctx = (lzma_stream)LZMA_STREAM_INIT;
+    *(lzma_stream*)codec->lzma_dctx = (lzma_stream)LZMA_STREAM_INIT;
+
+    *codec_out = codec;
+    return ANVIL_OK;
+}
+
+void anvil_codec_close(struct anvil_codec *codec) {
+    if (codec == nullptr) return;
+
+    if (codec->deflate_compressor != nullptr)
+        libdeflate_free_compressor(codec->deflate_compressor);
+    if (codec->deflate_decompressor != nullptr)
+        libdeflate_free_decompressor(codec->deflate_decompressor);
+    if (codec->lz4_ctx != nullptr)
+        LZ4F_freeCompressionContext(codec->lz4_ctx);
+    if (codec->lz4_dctx != nullptr)
+        LZ4F_freeDecompressionContext(codec->lz4_dctx);
+
+    lzma_end(codec->lzma_ctx);
+    lzma_end(codec->lzma_dctx);
+
+    codec->alloc->free(codec->lzma_ctx);
+    codec->alloc->free(codec->lzma_dctx);
+    codec->alloc->free(codec->in_buffer);
+    codec->alloc->free(codec->out_buffer);
+    codec->alloc->free(codec);
+}
+
+struct libdeflate_decompressor *codec_deflate_decompressor(
+    struct anvil_codec *codec
+) {
+    if (codec->deflate_decompressor == nullptr) {
+        struct libdeflate_options opts = {0};
+        opts.sizeof_options = sizeof(opts);
+        opts.malloc_func = codec->alloc->malloc;
+        opts.free_func = codec->alloc->free;
+        codec->deflate_decompressor = libdeflate_alloc_decompressor_ex(&opts);
+    }
+    return codec->deflate_decompressor;
+}
+
+struct libdeflate_compressor *codec_deflate_compressor(
+    struct anvil_codec *codec,
+    const int compression_level
+) {
+    if (
+        codec->deflate_compressor != nullptr &&
+        codec->deflate_level != compression_level
+    ) {
+        libdeflate_free_compressor(codec->deflate_compressor);
+        codec->deflate_compressor = nullptr;
+    }
+
+    if (codec->deflate_compressor == nullptr) {
+        struct libdeflate_options opts = {0};
+        opts.sizeof_options = sizeof(opts);
+        opts.malloc_func = codec->alloc->malloc;
+        opts.free_func = codec->alloc->free;
+        codec->deflate_compressor = libdeflate_alloc_compressor_ex(compression_level, &opts);
+        codec->deflate_level = compression_level;
+    }
+
+    return codec->deflate_compressor;
+}
+
+anvil_result codec_ensure(
+    const struct anvil_codec *codec,
+    char **buffer,
+    size_t *buffer_cap,
+    const size_t n
+) {
+    if (*buffer_cap < n) {
+        char *new = codec->alloc->realloc(*buffer, n);
+        if (new == nullptr) return ANVIL_ALLOC_FAILED;
+
+        *buffer = new;
+        *buffer_cap = n;
+    }
+
+    return ANVIL_OK;
+}
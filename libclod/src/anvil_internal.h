@@ -1,8 +1,57 @@
 #pragma once
 
+#include <assert.h>
 #include <anvil.h>
 #include "os.h"
 
+//====================//
+// Region File Layout //
+//====================//
+
+#define SIZE_X 32
+#define SIZE_Z 32
+
+#define SECTOR_SIZE 4096
+#define MTIME_OFFSET (SIZE_X * SIZE_Z * 4)
+#define HEADER_SIZE (2 * SIZE_X * SIZE_Z * 4)
+
+#define mod(a, b)\
+    ((((a) % (b)) + (b)) % (b))
+
+#define chunk_index(chunk_x, chunk_z)\
+    ((mod((chunk_x), SIZE_X) * SIZE_Z + mod((chunk_z), SIZE_Z)) * 4)
+
+#define get_chunk_sector_offset(data, index)\
+    (uint32_t)(unsigned char)((data) + (index))[0] << (2 * 8) |\
+    (uint32_t)(unsigned char)((data) + (index))[1] << (1 * 8) |\
+    (uint32_t)(unsigned char)((data) + (index))[2] << (0 * 8) ;\
+
+#define get_chunk_sector_count(data, index)\
+    (uint8_t)(unsigned char)((data) + (index))[3];
+
+#define get_chunk_mtime(data, index)\
+    (uint32_t)(unsigned char)((data) + (index) + SECTOR_SIZE)[0] << (3 * 8) |\
+    (uint32_t)(unsigned char)((data) + (index) + SECTOR_SIZE)[1] << (2 * 8) |\
+    (uint32_t)(unsigned char)((data) + (index) + SECTOR_SIZE)[2] << (1 * 8) |\
+    (uint32_t)(unsigned char)((data) + (index) + SECTOR_SIZE)[3] << (0 * 8) ;\
+
+#define set_sector_offset(data, index, offset)\
+    assert((offset) <= (1ULL<<24) - 1);\
+    ((data) + (index))[0] = (uint32_t)(offset) >> (2 * 8);\
+    ((data) + (index))[1] = (uint32_t)(offset) >> (1 * 8);\
+    ((data) + (index))[2] = (uint32_t)(offset) >> (0 * 8);
+
+#define set_sector_count(data, index, count) \
+    assert((count) <= (1ULL<<8) - 1);\
+    ((data) + (index))[3] = (count);
+
+#define set_chunk_mtime(data, index, mtime)\
+    assert((mtime) <= (1ULL<<32) - 1);\
+    ((data) + (index) + SECTOR_SIZE)[0] = (uint32_t)(mtime) >> (3 * 8);\
+    ((data) + (index) + SECTOR_SIZE)[1] = (uint32_t)(mtime) >> (2 * 8);\
+    ((data) + (index) + SECTOR_SIZE)[2] = (uint32_t)(mtime) >> (1 * 8);\
+    ((data) + (index) + SECTOR_SIZE)[3] = (uint32_t)(mtime) >> (0 * 8);
+
 /**
  * the posix operating systems provide openat and other *at methods
  * to make the kinds of file operations we make here more robust.
@@ -41,3 +90,33 @@ anvil_result anvil_region_file_openat(
 
     const anvil_allocator *alloc
 );
+
+anvil_result anvil_region_recompressat(
+    struct anvil_rewriter *rewriter,
+    int64_t region_x,
+    int64_t region_z,
+    const char *region_extension,
+
+#ifdef POSIX
+    int dir_fd,
+#else
+#error not implemented
+#endif
+
+    anvil_compression compression,
+    double compression_level
+);
+
+anvil_result anvil_region_compactat(
+    struct anvil_rewriter *rewriter,
+    int64_t region_x,
+    int64_t region_z,
+    const char *region_extension,
+
+#ifdef POSIX
+    int dir_fd
+#else
+#error not implemented
+#endif
+
+);
@@ -4,8 +4,10 @@
 
 #include <assert.h>
 #include <errno.h>
+#include <stdatomic.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <threads.h>
 
 #include "anvil.h"
 #include "anvil_internal.h"
@@ -261,9 +263,15 @@ anvil_result anvil_region_iter_open(
 
 #ifdef POSIX
 
+    // the iteration gets its own descriptor, as closedir closes the one it was opened with,
+    // and a shared one would share its position with every other reader of the directory.
     region_iter->ent_fd = -1;
-    region_iter->dir = fdopendir(region_dir->dir_fd);
+    const int dir_fd = openat(region_dir->dir_fd, ".", O_RDONLY | O_DIRECTORY);
+    region_iter->dir = dir_fd < 0 ? nullptr : fdopendir(dir_fd);
     if (region_iter->dir == nullptr) {
+        const auto err = errno;
+        if (dir_fd >= 0) close(dir_fd);
+        errno = err;
         region_dir->alloc->free(region_iter);
         switch (errno) {
         case ENOENT: return ANVIL_NOT_EXIST;
@@ -322,6 +330,7 @@ anvil_result anvil_region_iter_next(
 
     if (region_iter->ent_fd >= 0) {
         close(region_iter->ent_fd);
+        region_iter->ent_fd = -1;
     }
 
 next_file:
@@ -359,6 +368,10 @@ next_file:
 
     struct stat st;
     if (fstat(region_iter->ent_fd, &st)) {
+        const int err = errno;
+        close(region_iter->ent_fd);
+        region_iter->ent_fd = -1;
+        errno = err;
         switch (errno) {
         case EACCES: case ELOOP: case ENAMETOOLONG: case ENOENT: case EOVERFLOW:
             errno = 0; goto next_file;
@@ -380,7 +393,7 @@ next_file:
 #not implemented
 #endif
 
-    return ANVIL_OK;
+    return ANVIL_NEXT;
 }
 
 anvil_result anvil_region_iter_open_file(
@@ -562,6 +575,296 @@ try_region_name_again:
     return ANVIL_OK;
 }
 
+anvil_result anvil_region_recompress(
+    struct anvil_rewriter *rewriter,
+    const struct anvil_region_dir *region_dir,
+    const int64_t region_x,
+    const int64_t region_z,
+    const anvil_compression compression,
+    const double compression_level
+) {
+    if (region_dir == nullptr) {
+        return ANVIL_INVALID_USAGE;
+    }
+
+    return anvil_region_recompressat(
+        rewriter,
+        region_x,
+        region_z,
+        region_dir->region_extension,
+#ifdef POSIX
+        region_dir->dir_fd,
+#else
+#error not implemented
+#endif
+        compression,
+        compression_level
+    );
+}
+
+/**
+ * lists the coordinates of every region file in the directory.
+ *
+ * rewriting region files adds and renames files in the directory,
+ * and readdir makes no promises about entries that change during iteration,
+ * so the complete list is taken before any region is touched.
+ *
+ * @param[out] regions_out pairs of region x and z coordinates. must be freed.
+ * @param[out] regions_len_out number of regions.
+ */
+static anvil_result list_regions(
+    const struct anvil_region_dir *region_dir,
+    int64_t **regions_out,
+    size_t *regions_len_out
+) {
+    int64_t *regions = nullptr;
+    size_t regions_len = 0;
+    size_t regions_cap = 0;
+
+#ifdef POSIX
+
+    // opened again rather than duplicated, as a duplicate shares its position with the original.
+    const int fd = openat(region_dir->dir_fd, ".", O_RDONLY | O_DIRECTORY);
+    if (fd < 0) {
+        switch (errno) {
+        case ENOMEM: errno = 0; return ANVIL_ALLOC_FAILED;
+        default: return ANVIL_IO_ERROR;
+        }
+    }
+
+    DIR *dir = fdopendir(fd);
+    if (dir == nullptr) {
+        const auto err = errno;
+        close(fd);
+        errno = err;
+
+        switch (errno) {
+        case ENOMEM: errno = 0; return ANVIL_ALLOC_FAILED;
+        default: return ANVIL_IO_ERROR;
+        }
+    }
+
+    errno = 0;
+    const struct dirent *ent;
+    while ((ent = readdir(dir)) != nullptr) {
+        int64_t region_x, region_z;
+        if (!validate_region_filename(region_dir, ent->d_name, &region_x, &region_z))
+            continue;
+
+        if (regions_len == regions_cap) {
+            const size_t new_cap = regions_cap == 0 ? 64 : regions_cap * 2;
+            int64_t *new = region_dir->alloc->realloc(regions, new_cap * 2 * sizeof(int64_t));
+            if (new == nullptr) {
+                region_dir->alloc->free(regions);
+                closedir(dir);
+                return ANVIL_ALLOC_FAILED;
+            }
+
+            regions = new;
+            regions_cap = new_cap;
+        }
+
+        regions[regions_len * 2 + 0] = region_x;
+        regions[regions_len * 2 + 1] = region_z;
+        regions_len++;
+    }
+
+    if (errno != 0) {
+        const auto err = errno;
+        region_dir->alloc->free(regions);
+        closedir(dir);
+        errno = err;
+        return ANVIL_IO_ERROR;
+    }
+
+    closedir(dir);
+
+#else
+#error not implemented
+#endif
+
+    *regions_out = regions;
+    *regions_len_out = regions_len;
+    return ANVIL_OK;
+}
+
+anvil_result anvil_region_compact(
+    struct anvil_rewriter *rewriter,
+    const struct anvil_region_dir *region_dir,
+    const int64_t region_x,
+    const int64_t region_z
+) {
+    if (region_dir == nullptr) {
+        return ANVIL_INVALID_USAGE;
+    }
+
+    return anvil_region_compactat(
+        rewriter,
+        region_x,
+        region_z,
+        region_dir->region_extension,
+#ifdef POSIX
+        region_dir->dir_fd
+#else
+#error not implemented
+#endif
+    );
+}
+
+/// @private
+struct rewrite_job {
+    const struct anvil_region_dir *region_dir;
+    const int64_t *regions;
+    size_t regions_len;
+
+    bool recompress;                /** recompress chunks, rather than only compacting. */
+    anvil_compression compression;
+    double compression_level;
+
+    atomic_size_t next; /** index of the next region to be rewritten. */
+    atomic_bool failed; /** set by the first worker to fail, stopping the others. */
+    anvil_result res;   /** result of the first failure. */
+    int err;            /** errno of the first failure. */
+};
+
+/**
+ * rewrites regions from the job until there are none left or a worker fails.
+ */
+static void rewrite_regions(struct rewrite_job *job, struct anvil_rewriter *rewriter, anvil_result res) {
+    while (res == ANVIL_OK && !atomic_load(&job->failed)) {
+        const size_t i = atomic_fetch_add(&job->next, 1);
+        if (i >= job->regions_len) break;
+
+        res = job->recompress
+            ? anvil_region_recompress(
+                rewriter,
+                job->region_dir,
+                job->regions[i * 2 + 0],
+                job->regions[i * 2 + 1],
+                job->compression,
+                job->compression_level
+            )
+            : anvil_region_compact(
+                rewriter,
+                job->region_dir,
+                job->regions[i * 2 + 0],
+                job->regions[i * 2 + 1]
+            );
+
+        // removed in the meantime.
+        if (res == ANVIL_NOT_EXIST) res = ANVIL_OK;
+    }
+
+    const auto err = errno;
+    if (res != ANVIL_OK && !atomic_exchange(&job->failed, true)) {
+        job->res = res;
+        job->err = err;
+    }
+}
+
+/**
+ * a worker with its own rewriter, and so its own codec.
+ */
+static int rewrite_worker(void *arg) {
+    struct rewrite_job *job = arg;
+
+    struct anvil_rewriter *rewriter = nullptr;
+    const anvil_result res = anvil_rewriter_open(&rewriter, nullptr, job->region_dir->alloc);
+    rewrite_regions(job, rewriter, res);
+
+    anvil_rewriter_close(rewriter);
+    return 0;
+}
+
+/**
+ * rewrites every region file in the region directory, spread over a number of threads.
+ * the calling thread is one of them, and uses the given rewriter if there is one.
+ */
+static anvil_result rewrite_dir(
+    struct anvil_rewriter *rewriter,
+    const struct anvil_region_dir *region_dir,
+    unsigned threads,
+    const bool recompress,
+    const anvil_compression compression,
+    const double compression_level
+) {
+    int64_t *regions;
+    size_t regions_len;
+    const anvil_result res = list_regions(region_dir, &regions, &regions_len);
+    if (res != ANVIL_OK) return res;
+
+    struct rewrite_job job = {
+        .region_dir = region_dir,
+        .regions = regions,
+        .regions_len = regions_len,
+        .recompress = recompress,
+        .compression = compression,
+        .compression_level = compression_level,
+        .res = ANVIL_OK,
+        .err = 0,
+    };
+    atomic_init(&job.next, 0);
+    atomic_init(&job.failed, false);
+
+    if (threads > regions_len) threads = regions_len;
+    if (threads == 0) threads = 1;
+
+    // if threads can't be made we just get on with it with fewer.
+    thrd_t *workers = nullptr;
+    unsigned started = 0;
+    if (threads > 1) {
+        workers = region_dir->alloc->malloc(sizeof(thrd_t) * (threads - 1));
+        if (workers != nullptr) {
+            while (started < threads - 1 && thrd_create(&workers[started], rewrite_worker, &job) == thrd_success)
+                started++;
+        }
+    }
+
+    if (rewriter != nullptr) {
+        rewrite_regions(&job, rewriter, ANVIL_OK);
+    } else {
+        rewrite_worker(&job);
+    }
+
+    for (unsigned i = 0; i < started; i++) {
+        thrd_join(workers[i], nullptr);
+    }
+
+    region_dir->alloc->free(workers);
+    region_dir->alloc->free(regions);
+
+    errno = job.err;
+    return job.res;
+}
+
+anvil_result anvil_region_dir_recompress(
+    struct anvil_rewriter *rewriter,
+    const struct anvil_region_dir *region_dir,
+    const anvil_compression compression,
+    const double compression_level,
+    const unsigned threads
+) {
+    if (
+        rewriter == nullptr ||
+        region_dir == nullptr
+    ) {
+        return ANVIL_INVALID_USAGE;
+    }
+
+    return rewrite_dir(rewriter, region_dir, threads, true, compression, compression_level);
+}
+
+anvil_result anvil_region_dir_compact(
+    const struct anvil_region_dir *region_dir,
+    const unsigned threads
+) {
+    if (region_dir == nullptr) {
+        return ANVIL_INVALID_USAGE;
+    }
+
+    return rewrite_dir(nullptr, region_dir, threads, false, ANVIL_COMPRESSION_NONE, 0.0);
+}
+
 void anvil_region_dir_close(struct anvil_region_dir *region_dir) {
 #ifdef POSIX
     close(region_dir->dir_fd);
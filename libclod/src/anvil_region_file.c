@@ -5,6 +5,8 @@
 #include <stdlib.h>
 
 #include "anvil.h"
+#include "anvil_internal.h"
+#include "compress.h"
 #include "os.h"
 
 #ifdef POSIX
@@ -16,50 +18,6 @@
 #error "windows methods not implemented yet"
 #endif
 
-#define SIZE_X 32
-#define SIZE_Z 32
-
-#define SECTOR_SIZE 4096
-#define MTIME_OFFSET (SIZE_X * SIZE_Z * 4)
-#define HEADER_SIZE (2 * SIZE_X * SIZE_Z * 4)
-
-#define mod(a, b)\
-    ((((a) % (b)) + (b)) % (b))
-
-#define chunk_index(chunk_x, chunk_z)\
-    ((mod((chunk_x), SIZE_X) * SIZE_Z + mod((chunk_z), SIZE_Z)) * 4)
-
-#define get_chunk_sector_offset(data, index)\
-    (uint32_t)(unsigned char)((data) + (index))[0] << (2 * 8) |\
-    (uint32_t)(unsigned char)((data) + (index))[1] << (1 * 8) |\
-    (uint32_t)(unsigned char)((data) + (index))[2] << (0 * 8) ;\
-
-#define get_chunk_sector_count(data, index)\
-    (uint8_t)(unsigned char)((data) + (index))[3];
-
-#define get_chunk_mtime(data, index)\
-    (uint32_t)(unsigned char)((data) + (index) + SECTOR_SIZE)[0] << (3 * 8) |\
-    (uint32_t)(unsigned char)((data) + (index) + SECTOR_SIZE)[1] << (2 * 8) |\
-    (uint32_t)(unsigned char)((data) + (index) + SECTOR_SIZE)[2] << (1 * 8) |\
-    (uint32_t)(unsigned char)((data) + (index) + SECTOR_SIZE)[3] << (0 * 8) ;\
-
-#define set_sector_offset(data, index, offset)\
-    assert((offset) <= (1ULL<<24) - 1);\
-    ((data) + (index))[0] = (uint32_t)(offset) >> (2 * 8);\
-    ((data) + (index))[1] = (uint32_t)(offset) >> (1 * 8);\
-    ((data) + (index))[2] = (uint32_t)(offset) >> (0 * 8);
-
-#define set_sector_count(data, index, count) \
-    assert((count) <= (1ULL<<8) - 1);\
-    ((data) + (index))[3] = (count);
-
-#define set_chunk_mtime(data, index, mtime)\
-    assert((mtime) <= (1ULL<<32) - 1);\
-    ((data) + (index) + SECTOR_SIZE)[0] = (uint32_t)(mtime) >> (3 * 8);\
-    ((data) + (index) + SECTOR_SIZE)[1] = (uint32_t)(mtime) >> (2 * 8);\
-    ((data) + (index) + SECTOR_SIZE)[2] = (uint32_t)(mtime) >> (1 * 8);\
-    ((data) + (index) + SECTOR_SIZE)[3] = (uint32_t)(mtime) >> (0 * 8);
-
 /// @private
 struct anvil_region_file {
     /**
@@ -84,12 +42,7 @@ struct anvil_region_file {
     char *tmp_string;
     size_t tmp_string_cap;
 
-    char *tmp_buffer;
-    size_t tmp_buffer_cap;
-
-    int compression_level;
-    struct libdeflate_compressor *libdeflate_compressor;
-    struct libdeflate_decompressor *libdeflate_decompressor;
+    struct anvil_codec *codec; /** (nullable) used when the caller doesn't give one. */
 
 #ifdef POSIX
     int fd;
@@ -144,41 +97,22 @@ static anvil_result handle_malformed(struct anvil_region_file *region_file) {
 #endif
 }
 
-static struct libdeflate_decompressor *get_decompressor(
-    struct anvil_region_file *region_file
-) {
-    if (region_file->libdeflate_decompressor == nullptr) {
-        struct libdeflate_options opts = {0};
-        opts.sizeof_options = sizeof(opts);
-        opts.malloc_func = region_file->alloc->malloc;
-        opts.free_func = region_file->alloc->free;
-        region_file->libdeflate_decompressor = libdeflate_alloc_decompressor_ex(&opts);
-    }
-    return region_file->libdeflate_decompressor;
-}
-
-static struct libdeflate_compressor *get_compressor(
-    const int compression_level,
-    struct anvil_region_file *region_file
+/**
+ * returns the given codec,
+ * or if it is null the region file's own codec, opening it if needed.
+ */
+static struct anvil_codec *get_codec(
+    struct anvil_region_file *region_file,
+    struct anvil_codec *codec
 ) {
-    if (
-        region_file->libdeflate_compressor != nullptr &&
-        region_file->compression_level != compression_level
-    ) {
-        libdeflate_free_compressor(region_file->libdeflate_compressor);
-        region_file->libdeflate_compressor = nullptr;
-    }
+    if (codec != nullptr) return codec;
 
-    if (region_file->libdeflate_compressor == nullptr) {
-        struct libdeflate_options opts = {0};
-        opts.sizeof_options = sizeof(opts);
-        opts.malloc_func = region_file->alloc->malloc;
-        opts.free_func = region_file->alloc->free;
-        region_file->libdeflate_compressor = libdeflate_alloc_compressor_ex(compression_level, &opts);
-        region_file->compression_level = compression_level;
+    if (region_file->codec == nullptr) {
+        if (anvil_codec_open(&region_file->codec, region_file->alloc) != ANVIL_OK) {
+            return nullptr;
+        }
     }
-
-    return region_file->libdeflate_compressor;
+    return region_file->codec;
 }
 
 anvil_result anvil_region_file_open(
@@ -225,11 +159,7 @@ anvil_result anvil_region_file_open(
     region_file->alloc = alloc;
     region_file->tmp_string = nullptr;
     region_file->tmp_string_cap = 0;
-    region_file->tmp_buffer = nullptr;
-    region_file->tmp_buffer_cap = 0;
-    region_file->compression_level = 0;
-    region_file->libdeflate_compressor = nullptr;
-    region_file->libdeflate_decompressor = nullptr;
+    region_file->codec = nullptr;
     for (uint16_t i = 0; i < SIZE_X * SIZE_Z; i++) {
         region_file->chunk_order[i] = i;
     }
@@ -345,7 +275,7 @@ uint32_t anvil_chunk_mtime(
 }
 
 anvil_result decompress(
-    struct anvil_region_file *region_file,
+    struct anvil_codec *codec,
     const unsigned char compression_type,
     const char *in,
     const size_t in_len,
@@ -365,7 +295,7 @@ anvil_result decompress(
         return ANVIL_OK;
     }
     case ANVIL_COMPRESSION_GZIP: {
-        struct libdeflate_decompressor *decompressor = get_decompressor(region_file);
+        struct libdeflate_decompressor *decompressor = codec_deflate_decompressor(codec);
         if (decompressor == nullptr) {
             return ANVIL_ALLOC_FAILED;
         }
@@ -393,12 +323,12 @@ anvil_result decompress(
         }
     }
     case ANVIL_COMPRESSION_ZLIB: {
-        struct libdeflate_decompressor *decompressor = get_decompressor(region_file);
+        struct libdeflate_decompressor *decompressor = codec_deflate_decompressor(codec);
         if (decompressor == nullptr) {
             return ANVIL_ALLOC_FAILED;
         }
 
-        const enum libdeflate_result res = libdeflate_gzip_decompress(
+        const enum libdeflate_result res = libdeflate_zlib_decompress(
             decompressor,
             in,
             in_len,
@@ -433,6 +363,18 @@ anvil_result anvil_chunk_read(
     const int64_t chunk_x,
     const int64_t chunk_z,
     struct anvil_region_file *region_file
+) {
+    return anvil_chunk_read_ex(out, out_cap, out_len, chunk_x, chunk_z, region_file, nullptr);
+}
+
+anvil_result anvil_chunk_read_ex(
+    void *restrict out,
+    const size_t out_cap,
+    size_t *out_len,
+    const int64_t chunk_x,
+    const int64_t chunk_z,
+    struct anvil_region_file *region_file,
+    struct anvil_codec *codec
 ) {
     if (region_file == nullptr) return ANVIL_INVALID_USAGE;
     if (region_file->file == nullptr) {
@@ -543,8 +485,9 @@ anvil_result anvil_chunk_read(
         cursor = region_file->file + sector_offset * SECTOR_SIZE + 5;
     }
 
-    const anvil_result res = decompress(
-        region_file,
+    codec = get_codec(region_file, codec);
+    const anvil_result res = codec == nullptr ? ANVIL_ALLOC_FAILED : decompress(
+        codec,
         compression_type,
         cursor,
         chunk_size,
@@ -669,13 +612,26 @@ static anvil_result resize(
 }
 
 anvil_result anvil_chunk_write(
+    const void *restrict in,
+    const size_t in_len,
+    const double compression_level,
+    const anvil_compression compression,
+    const int64_t chunk_x,
+    const int64_t chunk_z,
+    struct anvil_region_file *region_file
+) {
+    return anvil_chunk_write_ex(in, in_len, compression_level, compression, chunk_x, chunk_z, region_file, nullptr);
+}
+
+anvil_result anvil_chunk_write_ex(
     const void *restrict in,
     size_t in_len,
     double compression_level,
-    enum anvil_compression compression,
+    anvil_compression compression,
     int64_t chunk_x,
     int64_t chunk_z,
-    struct anvil_region_file *region_file
+    struct anvil_region_file *region_file,
+    struct anvil_codec *codec
 ) {
     if (
         region_file == nullptr ||
@@ -695,67 +651,65 @@ anvil_result anvil_chunk_write(
         break;
     }
     case ANVIL_COMPRESSION_GZIP: {
-        struct libdeflate_compressor *compressor = get_compressor((int)(compression_level * 12.0), region_file);
+        codec = get_codec(region_file, codec);
+        if (codec == nullptr) {
+            return ANVIL_ALLOC_FAILED;
+        }
+
+        struct libdeflate_compressor *compressor = codec_deflate_compressor(codec, (int)(compression_level * 12.0));
         if (compressor == nullptr) {
             return ANVIL_ALLOC_FAILED;
         }
 
         const size_t max_size = libdeflate_gzip_compress_bound(compressor, in_len);
-        if (region_file->tmp_buffer_cap < max_size) {
-            char *new = region_file->alloc->realloc(region_file->tmp_buffer, max_size);
-            if (new == nullptr) {
-                return ANVIL_ALLOC_FAILED;
-            }
-
-            region_file->tmp_buffer = new;
-            region_file->tmp_buffer_cap = max_size;
+        if (codec_ensure(codec, &codec->out_buffer, &codec->out_buffer_cap, max_size) != ANVIL_OK) {
+            return ANVIL_ALLOC_FAILED;
         }
 
         chunk_size = libdeflate_gzip_compress(
             compressor,
             in,
             in_len,
-            region_file->tmp_buffer,
-            region_file->tmp_buffer_cap
+            codec->out_buffer,
+            codec->out_buffer_cap
         );
 
         // this should never happen as we grew the buffer to the maximum theoretical size.
         // compression doesn't have any other failure modes (perhaps except SIGBUS/SIGSEGV).
         assert(chunk_size > 0);
 
-        chunk_data = region_file->tmp_buffer;
+        chunk_data = codec->out_buffer;
         break;
     }
     case ANVIL_COMPRESSION_ZLIB: {
-        struct libdeflate_compressor *compressor = get_compressor((int)(compression_level * 12.0), region_file);
+        codec = get_codec(region_file, codec);
+        if (codec == nullptr) {
+            return ANVIL_ALLOC_FAILED;
+        }
+
+        struct libdeflate_compressor *compressor = codec_deflate_compressor(codec, (int)(compression_level * 12.0));
         if (compressor == nullptr) {
             return ANVIL_ALLOC_FAILED;
         }
 
         const size_t max_size = libdeflate_zlib_compress_bound(compressor, in_len);
-        if (region_file->tmp_buffer_cap < max_size) {
-            char *new = region_file->alloc->realloc(region_file->tmp_buffer, max_size);
-            if (new == nullptr) {
-                return ANVIL_ALLOC_FAILED;
-            }
-
-            region_file->tmp_buffer = new;
-            region_file->tmp_buffer_cap = max_size;
+        if (codec_ensure(codec, &codec->out_buffer, &codec->out_buffer_cap, max_size) != ANVIL_OK) {
+            return ANVIL_ALLOC_FAILED;
         }
 
         chunk_size = libdeflate_zlib_compress(
             compressor,
             in,
             in_len,
-            region_file->tmp_buffer,
-            region_file->tmp_buffer_cap
+            codec->out_buffer,
+            codec->out_buffer_cap
         );
 
         // this should never happen as we grew the buffer to the maximum theoretical size.
         // compression doesn't have any other failure modes (perhaps except SIGBUS/SIGSEGV).
         assert(chunk_size > 0);
 
-        chunk_data = region_file->tmp_buffer;
+        chunk_data = codec->out_buffer;
         break;
     }
     default: return ANVIL_UNSUPPORTED_COMPRESSION;
@@ -796,12 +750,7 @@ anvil_result anvil_region_file_close(struct anvil_region_file *region_file) {
     region_file->alloc->free(region_file->path);
     if (region_file->tmp_string != nullptr)
         region_file->alloc->free(region_file->tmp_string);
-    if (region_file->tmp_buffer != nullptr)
-        region_file->alloc->free(region_file->tmp_buffer);
-    if (region_file->libdeflate_compressor != nullptr)
-        libdeflate_free_compressor(region_file->libdeflate_compressor);
-    if (region_file->libdeflate_decompressor != nullptr)
-        libdeflate_free_decompressor(region_file->libdeflate_decompressor);
+    anvil_codec_close(region_file->codec);
 
 #ifdef POSIX
 
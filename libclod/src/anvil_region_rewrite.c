@@ -0,0 +1,715 @@
+/**
+ * @private
+ */
+
+#include <assert.h>
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <libdeflate.h>
+
+#include "anvil.h"
+#include "anvil_internal.h"
+#include "compress.h"
+#include "os.h"
+
+#ifdef POSIX
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#else
+#error not implemented
+#endif
+
+#define CHUNK_MAX_SECTORS 255
+#define CHUNK_BUFFER_START (256 * 1024)
+
+/// @private
+struct anvil_rewriter {
+    const anvil_allocator *alloc;
+
+    struct anvil_codec *codec;  /** compression contexts, and buffers for chunk data. */
+    bool owns_codec;            /** if the codec was opened by, and is closed with, the rewriter. */
+
+    char *name;                 /** name of the region file being rewritten. */
+    size_t name_cap;
+
+    char *tmp_name;             /** name of the file the region is rewritten into. */
+    size_t tmp_name_cap;
+
+    uint8_t *sector_map;        /** one bit per sector of the original file, set where chunk data lives. */
+    size_t sector_map_cap;
+
+    char header[HEADER_SIZE];
+};
+
+anvil_result anvil_rewriter_open(
+    struct anvil_rewriter **rewriter_out,
+    struct anvil_codec *codec,
+    const anvil_allocator *alloc
+) {
+    if (rewriter_out == nullptr) return ANVIL_INVALID_USAGE;
+
+    if (alloc == nullptr)
+        alloc = &default_anvil_allocator;
+    else if (
+        alloc->malloc == nullptr ||
+        alloc->calloc == nullptr ||
+        alloc->free == nullptr ||
+        alloc->realloc == nullptr
+    ) {
+        return ANVIL_INVALID_USAGE;
+    }
+
+    struct anvil_rewriter *rewriter = alloc->malloc(sizeof(struct anvil_rewriter));
+    if (rewriter == nullptr) {
+        return ANVIL_ALLOC_FAILED;
+    }
+
+    rewriter->alloc = alloc;
+    rewriter->codec = codec;
+    rewriter->owns_codec = codec == nullptr;
+    rewriter->name = nullptr;
+    rewriter->name_cap = 0;
+    rewriter->tmp_name = nullptr;
+    rewriter->tmp_name_cap = 0;
+    rewriter->sector_map = nullptr;
+    rewriter->sector_map_cap = 0;
+
+    if (rewriter->owns_codec) {
+        const anvil_result res = anvil_codec_open(&rewriter->codec, alloc);
+        if (res != ANVIL_OK) {
+            alloc->free(rewriter);
+            return res;
+        }
+    }
+
+    *rewriter_out = rewriter;
+    return ANVIL_OK;
+}
+
+void anvil_rewriter_close(struct anvil_rewriter *rewriter) {
+    if (rewriter == nullptr) return;
+
+    if (rewriter->owns_codec)
+        anvil_codec_close(rewriter->codec);
+
+    rewriter->alloc->free(rewriter->name);
+    rewriter->alloc->free(rewriter->tmp_name);
+    rewriter->alloc->free(rewriter->sector_map);
+    rewriter->alloc->free(rewriter);
+}
+
+static anvil_result ensure(
+    const anvil_allocator *alloc,
+    char **buffer,
+    size_t *buffer_cap,
+    const size_t n
+) {
+    if (*buffer_cap < n) {
+        char *new = alloc->realloc(*buffer, n);
+        if (new == nullptr) return ANVIL_ALLOC_FAILED;
+
+        *buffer = new;
+        *buffer_cap = n;
+    }
+
+    return ANVIL_OK;
+}
+
+static anvil_result inflate_chunk(
+    struct anvil_rewriter *rewriter,
+    const uint8_t compression_type,
+    const char *in,
+    const size_t in_len,
+    size_t *out_len
+) {
+    struct libdeflate_decompressor *decompressor = codec_deflate_decompressor(rewriter->codec);
+    if (decompressor == nullptr) {
+        return ANVIL_ALLOC_FAILED;
+    }
+
+    if (rewriter->codec->in_buffer_cap == 0) {
+        const anvil_result res = codec_ensure(
+            rewriter->codec,
+            &rewriter->codec->in_buffer,
+            &rewriter->codec->in_buffer_cap,
+            in_len * 4 > CHUNK_BUFFER_START ? in_len * 4 : CHUNK_BUFFER_START
+        );
+        if (res != ANVIL_OK) return res;
+    }
+
+    while (true) {
+        enum libdeflate_result res;
+        if (compression_type == ANVIL_COMPRESSION_GZIP) {
+            res = libdeflate_gzip_decompress(
+                decompressor,
+                in,
+                in_len,
+                rewriter->codec->in_buffer,
+                rewriter->codec->in_buffer_cap,
+                out_len
+            );
+        } else {
+            res = libdeflate_zlib_decompress(
+                decompressor,
+                in,
+                in_len,
+                rewriter->codec->in_buffer,
+                rewriter->codec->in_buffer_cap,
+                out_len
+            );
+        }
+
+        switch (res) {
+        case LIBDEFLATE_SUCCESS: return ANVIL_OK;
+        case LIBDEFLATE_INSUFFICIENT_SPACE: {
+            const anvil_result grow = codec_ensure(
+                rewriter->codec,
+                &rewriter->codec->in_buffer,
+                &rewriter->codec->in_buffer_cap,
+                rewriter->codec->in_buffer_cap * 2
+            );
+            if (grow != ANVIL_OK) return grow;
+            continue;
+        }
+        default: return ANVIL_MALFORMED;
+        }
+    }
+}
+
+static anvil_result copy_frame(
+    struct anvil_rewriter *rewriter,
+    const char *frame,
+    const size_t payload_len,
+    size_t *out_len
+) {
+    const anvil_result res = codec_ensure(
+        rewriter->codec,
+        &rewriter->codec->out_buffer,
+        &rewriter->codec->out_buffer_cap,
+        payload_len + 4 + SECTOR_SIZE
+    );
+    if (res != ANVIL_OK) return res;
+
+    memcpy(rewriter->codec->out_buffer, frame, payload_len + 4);
+    *out_len = payload_len + 4;
+    return ANVIL_OK;
+}
+
+/**
+ * frames the chunk in the output buffer,
+ * recompressing it if asked to and the compression type is understood.
+ *
+ * @param[out] frame_len length of the framed chunk, excluding sector padding.
+ */
+static anvil_result frame_chunk(
+    struct anvil_rewriter *rewriter,
+    const char *frame,
+    const size_t frame_len,
+    const bool recompress,
+    const anvil_compression compression,
+    const double compression_level,
+    size_t *out_len
+) {
+    if (frame_len < 5) {
+        return ANVIL_MALFORMED;
+    }
+
+    const size_t payload_len =
+        (size_t)(unsigned char)frame[0] << (3 * 8) |
+        (size_t)(unsigned char)frame[1] << (2 * 8) |
+        (size_t)(unsigned char)frame[2] << (1 * 8) |
+        (size_t)(unsigned char)frame[3] << (0 * 8) ;
+    const uint8_t compression_type = (uint8_t)frame[4];
+
+    if (payload_len == 0 || payload_len + 4 > frame_len) {
+        return ANVIL_MALFORMED;
+    }
+
+    if (!recompress) {
+        return copy_frame(rewriter, frame, payload_len, out_len);
+    }
+
+    const char *payload = frame + 5;
+    const char *data;
+    size_t data_len;
+    anvil_result res;
+
+    switch (compression_type) {
+    case ANVIL_COMPRESSION_NONE: {
+        data = payload;
+        data_len = payload_len - 1;
+        break;
+    }
+    case ANVIL_COMPRESSION_GZIP:
+    case ANVIL_COMPRESSION_ZLIB: {
+        res = inflate_chunk(rewriter, compression_type, payload, payload_len - 1, &data_len);
+        if (res != ANVIL_OK) return res;
+        data = rewriter->codec->in_buffer;
+        break;
+    }
+    default: {
+        // external chunks and compression we don't understand are copied as they are.
+        return copy_frame(rewriter, frame, payload_len, out_len);
+    }
+    }
+
+    size_t compressed_len;
+    switch (compression) {
+    case ANVIL_COMPRESSION_NONE: {
+        res = codec_ensure(rewriter->codec, &rewriter->codec->out_buffer, &rewriter->codec->out_buffer_cap, 5 + data_len + SECTOR_SIZE);
+        if (res != ANVIL_OK) return res;
+
+        memcpy(rewriter->codec->out_buffer + 5, data, data_len);
+        compressed_len = data_len;
+        break;
+    }
+    case ANVIL_COMPRESSION_GZIP:
+    case ANVIL_COMPRESSION_ZLIB: {
+        struct libdeflate_compressor *compressor = codec_deflate_compressor(rewriter->codec, (int)(compression_level * 12.0));
+        if (compressor == nullptr) {
+            return ANVIL_ALLOC_FAILED;
+        }
+
+        const size_t max_size = compression == ANVIL_COMPRESSION_GZIP
+            ? libdeflate_gzip_compress_bound(compressor, data_len)
+            : libdeflate_zlib_compress_bound(compressor, data_len);
+
+        res = codec_ensure(rewriter->codec, &rewriter->codec->out_buffer, &rewriter->codec->out_buffer_cap, 5 + max_size + SECTOR_SIZE);
+        if (res != ANVIL_OK) return res;
+
+        compressed_len = compression == ANVIL_COMPRESSION_GZIP
+            ? libdeflate_gzip_compress(compressor, data, data_len, rewriter->codec->out_buffer + 5, max_size)
+            : libdeflate_zlib_compress(compressor, data, data_len, rewriter->codec->out_buffer + 5, max_size);
+
+        // this should never happen as we grew the buffer to the maximum theoretical size.
+        assert(compressed_len > 0);
+        break;
+    }
+    default: return ANVIL_UNSUPPORTED_COMPRESSION;
+    }
+
+    if (5 + compressed_len > CHUNK_MAX_SECTORS * SECTOR_SIZE) {
+        // the recompressed chunk doesn't fit in the region file anymore, but the original did.
+        return copy_frame(rewriter, frame, payload_len, out_len);
+    }
+
+    rewriter->codec->out_buffer[0] = (char)((compressed_len + 1) >> (3 * 8));
+    rewriter->codec->out_buffer[1] = (char)((compressed_len + 1) >> (2 * 8));
+    rewriter->codec->out_buffer[2] = (char)((compressed_len + 1) >> (1 * 8));
+    rewriter->codec->out_buffer[3] = (char)((compressed_len + 1) >> (0 * 8));
+    rewriter->codec->out_buffer[4] = (char)compression;
+
+    *out_len = 5 + compressed_len;
+    return ANVIL_OK;
+}
+
+#ifdef POSIX
+
+static anvil_result write_all(
+    const int fd,
+    const char *data,
+    size_t n,
+    off_t offset
+) {
+    while (n > 0) {
+        const ssize_t w = pwrite(fd, data, n, offset);
+        if (w < 0) {
+            if (errno == EINTR) continue;
+            switch (errno) {
+            case EDQUOT:
+            case ENOSPC: errno = 0; return ANVIL_DISK_FULL;
+            default: return ANVIL_IO_ERROR;
+            }
+        }
+
+        data += w;
+        n -= w;
+        offset += w;
+    }
+
+    return ANVIL_OK;
+}
+
+#endif
+
+/**
+ * builds the map of sectors holding chunk data from the header,
+ * checking that every chunk lies inside the file and that no two chunks share a sector.
+ *
+ * @param[out] compact set if the file is already in the layout a rewrite would produce;
+ *  chunks in header order with no free sectors between or after them.
+ */
+static anvil_result check_layout(
+    struct anvil_rewriter *rewriter,
+    const char *file,
+    const size_t size,
+    bool *compact
+) {
+    const size_t sectors = (size + SECTOR_SIZE - 1) / SECTOR_SIZE;
+
+    const anvil_result res = ensure(
+        rewriter->alloc,
+        (char**)&rewriter->sector_map,
+        &rewriter->sector_map_cap,
+        (sectors + 7) / 8
+    );
+    if (res != ANVIL_OK) return res;
+    memset(rewriter->sector_map, 0, (sectors + 7) / 8);
+
+    size_t live = HEADER_SIZE / SECTOR_SIZE;
+    size_t next_sector = HEADER_SIZE / SECTOR_SIZE;
+    bool in_order = true;
+
+    for (int64_t i = 0; i < SIZE_X * SIZE_Z; i++) {
+        const size_t sector_offset = get_chunk_sector_offset(file, i * 4);
+        const size_t sector_count = get_chunk_sector_count(file, i * 4);
+
+        if (sector_offset == 0 && sector_count == 0) continue;
+
+        // the last chunk's final sector may be cut short, as the file isn't always padded to a whole sector.
+        if (
+            sector_offset < HEADER_SIZE / SECTOR_SIZE ||
+            sector_offset + sector_count > sectors ||
+            sector_count == 0
+        ) {
+            return ANVIL_MALFORMED;
+        }
+
+        for (size_t s = sector_offset; s < sector_offset + sector_count; s++) {
+            if (rewriter->sector_map[s / 8] & 1 << s % 8) {
+                return ANVIL_MALFORMED;
+            }
+            rewriter->sector_map[s / 8] |= 1 << s % 8;
+        }
+
+        in_order &= sector_offset == next_sector;
+        next_sector = sector_offset + sector_count;
+        live += sector_count;
+    }
+
+    *compact = in_order && live == sectors && size == sectors * SECTOR_SIZE;
+    return ANVIL_OK;
+}
+
+/**
+ * writes every chunk in the mapped region file into fd,
+ * in chunk order, without gaps.
+ * the layout must have been checked with check_layout.
+ */
+static anvil_result rewrite(
+    struct anvil_rewriter *rewriter,
+    const char *file,
+    const size_t size,
+    const int fd,
+    const bool recompress,
+    const anvil_compression compression,
+    const double compression_level
+) {
+    memset(rewriter->header, 0, MTIME_OFFSET);
+    memcpy(rewriter->header + MTIME_OFFSET, file + MTIME_OFFSET, HEADER_SIZE - MTIME_OFFSET);
+
+    size_t sector = HEADER_SIZE / SECTOR_SIZE;
+
+    for (int64_t i = 0; i < SIZE_X * SIZE_Z; i++) {
+        const size_t sector_offset = get_chunk_sector_offset(file, i * 4);
+        const size_t sector_count = get_chunk_sector_count(file, i * 4);
+
+        if (sector_offset == 0 && sector_count == 0) {
+            set_chunk_mtime(rewriter->header, i * 4, 0);
+            continue;
+        }
+
+        // a frame in a cut short last sector ends with the file.
+        size_t available = sector_count * SECTOR_SIZE;
+        if (available > size - sector_offset * SECTOR_SIZE) available = size - sector_offset * SECTOR_SIZE;
+
+        size_t frame_len;
+        const anvil_result res = frame_chunk(
+            rewriter,
+            file + sector_offset * SECTOR_SIZE,
+            available,
+            recompress,
+            compression,
+            compression_level,
+            &frame_len
+        );
+        if (res != ANVIL_OK) return res;
+
+        const size_t new_sector_count = (frame_len + SECTOR_SIZE - 1) / SECTOR_SIZE;
+        memset(rewriter->codec->out_buffer + frame_len, 0, new_sector_count * SECTOR_SIZE - frame_len);
+
+#ifdef POSIX
+        const anvil_result w = write_all(
+            fd,
+            rewriter->codec->out_buffer,
+            new_sector_count * SECTOR_SIZE,
+            (off_t)(sector * SECTOR_SIZE)
+        );
+        if (w != ANVIL_OK) return w;
+#else
+#error not implemented
+#endif
+
+        set_sector_offset(rewriter->header, i * 4, sector);
+        set_sector_count(rewriter->header, i * 4, new_sector_count);
+        sector += new_sector_count;
+    }
+
+#ifdef POSIX
+    return write_all(fd, rewriter->header, HEADER_SIZE, 0);
+#else
+#error not implemented
+#endif
+}
+
+static anvil_result format_names(
+    struct anvil_rewriter *rewriter,
+    const int64_t region_x,
+    const int64_t region_z,
+    const char *region_extension
+) {
+try_region_name_again:
+    const int name_len = anvil_region_filename(
+        rewriter->name,
+        rewriter->name_cap,
+        "r",
+        region_x,
+        region_z,
+        region_extension
+    );
+
+    if (name_len >= rewriter->name_cap) {
+        const anvil_result res = ensure(rewriter->alloc, &rewriter->name, &rewriter->name_cap, name_len + 1);
+        if (res != ANVIL_OK) return res;
+        goto try_region_name_again;
+    }
+
+try_tmp_name_again:
+    const int tmp_name_len = snprintf(rewriter->tmp_name, rewriter->tmp_name_cap, "%s.tmp", rewriter->name);
+
+    if (tmp_name_len >= rewriter->tmp_name_cap) {
+        const anvil_result res = ensure(rewriter->alloc, &rewriter->tmp_name, &rewriter->tmp_name_cap, tmp_name_len + 1);
+        if (res != ANVIL_OK) return res;
+        goto try_tmp_name_again;
+    }
+
+    return ANVIL_OK;
+}
+
+static anvil_result rewriteat(
+    struct anvil_rewriter *rewriter,
+    const int64_t region_x,
+    const int64_t region_z,
+    const char *region_extension,
+
+#ifdef POSIX
+    const int dir_fd,
+#else
+#error not implemented
+#endif
+
+    const bool recompress,
+    const anvil_compression compression,
+    const double compression_level
+) {
+    anvil_result res = format_names(rewriter, region_x, region_z, region_extension);
+    if (res != ANVIL_OK) return res;
+
+#ifdef POSIX
+
+    const int fd = openat(dir_fd, rewriter->name, O_RDONLY);
+    if (fd < 0) {
+        switch (errno) {
+        case ENOENT:
+        case ENOTDIR: errno = 0; return ANVIL_NOT_EXIST;
+        case ENOMEM: errno = 0; return ANVIL_ALLOC_FAILED;
+        default: return ANVIL_IO_ERROR;
+        }
+    }
+
+    struct stat st;
+    if (fstat(fd, &st)) {
+        const auto err = errno;
+        close(fd);
+        errno = err;
+        return ANVIL_IO_ERROR;
+    }
+
+    // empty region files are valid, and there's nothing to rewrite.
+    if (st.st_size == 0) {
+        if (close(fd)) return ANVIL_IO_ERROR;
+        return ANVIL_OK;
+    }
+
+    if (st.st_size < HEADER_SIZE) {
+        close(fd);
+        return ANVIL_MALFORMED;
+    }
+
+    char *file = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (file == MAP_FAILED) {
+        const auto err = errno;
+        close(fd);
+        errno = err;
+        return ANVIL_IO_ERROR;
+    }
+
+    // every live sector is read exactly once.
+    madvise(file, st.st_size, MADV_WILLNEED);
+
+    if (close(fd)) {
+        const auto err = errno;
+        munmap(file, st.st_size);
+        errno = err;
+        return ANVIL_IO_ERROR;
+    }
+
+    bool compact;
+    res = check_layout(rewriter, file, st.st_size, &compact);
+    if (res != ANVIL_OK || (compact && !recompress)) {
+        munmap(file, st.st_size);
+        return res;
+    }
+
+    const int tmp_fd = openat(dir_fd, rewriter->tmp_name, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (tmp_fd < 0) {
+        const auto err = errno;
+        munmap(file, st.st_size);
+        errno = err;
+
+        switch (errno) {
+        case ENOMEM: errno = 0; return ANVIL_ALLOC_FAILED;
+        case EDQUOT:
+        case ENOSPC: errno = 0; return ANVIL_DISK_FULL;
+        default: return ANVIL_IO_ERROR;
+        }
+    }
+
+    res = rewrite(rewriter, file, st.st_size, tmp_fd, recompress, compression, compression_level);
+
+    // the new file takes the old one's place, so it takes its permissions too.
+    if (res == ANVIL_OK && fchmod(tmp_fd, st.st_mode & 07777)) {
+        res = ANVIL_IO_ERROR;
+    }
+
+    if (res == ANVIL_OK && fsync(tmp_fd)) {
+        res = ANVIL_IO_ERROR;
+    }
+
+    if (res != ANVIL_OK) {
+        const auto err = errno;
+        close(tmp_fd);
+        unlinkat(dir_fd, rewriter->tmp_name, 0);
+        munmap(file, st.st_size);
+        errno = err;
+        return res;
+    }
+
+    munmap(file, st.st_size);
+
+    if (close(tmp_fd)) {
+        const auto err = errno;
+        unlinkat(dir_fd, rewriter->tmp_name, 0);
+        errno = err;
+        return ANVIL_IO_ERROR;
+    }
+
+    // the rename is the only point where the region file changes,
+    // so at any point the region is either entirely old or entirely new.
+    if (renameat(dir_fd, rewriter->tmp_name, dir_fd, rewriter->name)) {
+        const auto err = errno;
+        unlinkat(dir_fd, rewriter->tmp_name, 0);
+        errno = err;
+        return ANVIL_IO_ERROR;
+    }
+
+    if (fsync(dir_fd)) {
+        return ANVIL_IO_ERROR;
+    }
+
+    return ANVIL_OK;
+
+#else
+#error not implemented
+#endif
+}
+
+anvil_result anvil_region_recompressat(
+    struct anvil_rewriter *rewriter,
+    const int64_t region_x,
+    const int64_t region_z,
+    const char *region_extension,
+
+#ifdef POSIX
+    const int dir_fd,
+#else
+#error not implemented
+#endif
+
+    const anvil_compression compression,
+    const double compression_level
+) {
+    if (
+        rewriter == nullptr ||
+        region_extension == nullptr ||
+        compression_level < 0 ||
+        compression_level > 1
+    ) {
+        return ANVIL_INVALID_USAGE;
+    }
+
+    switch (compression) {
+    case ANVIL_COMPRESSION_NONE:
+    case ANVIL_COMPRESSION_GZIP:
+    case ANVIL_COMPRESSION_ZLIB:
+        break;
+    default:
+        return ANVIL_UNSUPPORTED_COMPRESSION;
+    }
+
+    return rewriteat(
+        rewriter,
+        region_x,
+        region_z,
+        region_extension,
+        dir_fd,
+        true,
+        compression,
+        compression_level
+    );
+}
+
+anvil_result anvil_region_compactat(
+    struct anvil_rewriter *rewriter,
+    const int64_t region_x,
+    const int64_t region_z,
+    const char *region_extension,
+
+#ifdef POSIX
+    const int dir_fd
+#else
+#error not implemented
+#endif
+
+) {
+    if (
+        rewriter == nullptr ||
+        region_extension == nullptr
+    ) {
+        return ANVIL_INVALID_USAGE;
+    }
+
+    return rewriteat(
+        rewriter,
+        region_x,
+        region_z,
+        region_extension,
+        dir_fd,
+        false,
+        ANVIL_COMPRESSION_NONE,
+        0
+    );
+}
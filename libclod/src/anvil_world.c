@@ -167,6 +167,63 @@ anvil_result anvil_world_open_region_dir(
     );
 }
 
+/// directories in a world that hold region files.
+static const char *region_subdirs[] = {
+    "region", "entities", "poi",
+    "DIM-1/region", "DIM-1/entities", "DIM-1/poi",
+    "DIM1/region", "DIM1/entities", "DIM1/poi",
+};
+
+anvil_result anvil_world_recompress(
+    struct anvil_rewriter *rewriter,
+    const struct anvil_world *world,
+    const anvil_compression compression,
+    const double compression_level,
+    const unsigned threads
+) {
+    if (
+        rewriter == nullptr ||
+        world == nullptr
+    ) {
+        return ANVIL_INVALID_USAGE;
+    }
+
+    for (size_t i = 0; i < sizeof(region_subdirs) / sizeof(region_subdirs[0]); i++) {
+        struct anvil_region_dir *region_dir;
+        anvil_result res = anvil_world_open_region_dir(&region_dir, world, region_subdirs[i], nullptr, nullptr);
+        if (res == ANVIL_NOT_EXIST) continue;
+        if (res != ANVIL_OK) return res;
+
+        res = anvil_region_dir_recompress(rewriter, region_dir, compression, compression_level, threads);
+        anvil_region_dir_close(region_dir);
+        if (res != ANVIL_OK) return res;
+    }
+
+    return ANVIL_OK;
+}
+
+anvil_result anvil_world_compact(
+    const struct anvil_world *world,
+    const unsigned threads
+) {
+    if (world == nullptr) {
+        return ANVIL_INVALID_USAGE;
+    }
+
+    for (size_t i = 0; i < sizeof(region_subdirs) / sizeof(region_subdirs[0]); i++) {
+        struct anvil_region_dir *region_dir;
+        anvil_result res = anvil_world_open_region_dir(&region_dir, world, region_subdirs[i], nullptr, nullptr);
+        if (res == ANVIL_NOT_EXIST) continue;
+        if (res != ANVIL_OK) return res;
+
+        res = anvil_region_dir_compact(region_dir, threads);
+        anvil_region_dir_close(region_dir);
+        if (res != ANVIL_OK) return res;
+    }
+
+    return ANVIL_OK;
+}
+
 void anvil_world_close(struct anvil_world *world) {
     if (world == nullptr) return;
 
@@ -105,11 +105,30 @@ lzma_ret compress_lzma(
 
         *strm = (lzma_stream)LZMA_STREAM_INIT;
         *ctx_ptr = strm;
+    }
 
-        result = lzma_easy_encoder(strm, (int)(level * 10), LZMA_CHECK_CRC32);
-        if (result != LZMA_OK) {
-            return result;
-        }
+    lzma_options_lzma options;
+    if (lzma_lzma_preset(&options, (uint32_t)(level * 9))) {
+        return LZMA_OPTIONS_ERROR;
+    }
+
+    // a dictionary bigger than the input is never used,
+    // but its match finder is still cleared every time the encoder is initialised.
+    // at high levels that costs milliseconds, far more than compressing a small mapping.
+    if (options.dict_size > in_len) {
+        options.dict_size = in_len < LZMA_DICT_SIZE_MIN ? LZMA_DICT_SIZE_MIN : (uint32_t)in_len;
+    }
+
+    const lzma_filter filters[] = {
+        { .id = LZMA_FILTER_LZMA2, .options = &options },
+        { .id = LZMA_VLI_UNKNOWN, .options = nullptr },
+    };
+
+    // a finished stream can't be fed more input,
+    // re-initialising an existing encoder reuses its allocations.
+    result = lzma_stream_encoder(strm, filters, LZMA_CHECK_CRC32);
+    if (result != LZMA_OK) {
+        return result;
     }
 
     strm->next_in = (uint8_t*)in;
@@ -136,7 +155,7 @@ lzma_ret compress_lzma(
         }
 
         result = lzma_code(strm, LZMA_FINISH);
-    } while (result == LZMA_OK && strm->avail_in > 0);
+    } while (result == LZMA_OK);
 
     *actual_out = strm->total_out;
     return result;
@@ -153,3 +172,136 @@ void compress_free_lzma(
         *ctx_ptr = nullptr;
     }
 }
+
+int decompress_lz4(
+    void **ctx_ptr,
+    const char *in,
+    const size_t in_len,
+    char **out,
+    size_t *out_cap,
+    size_t *actual_out,
+    void *(*realloc_f)(void*, size_t)
+) {
+    const auto ctx = (LZ4F_dctx**)ctx_ptr;
+
+    if (*ctx == nullptr) {
+        const LZ4F_errorCode_t err = LZ4F_createDecompressionContext(ctx, LZ4F_VERSION);
+        if (LZ4F_isError(err)) {
+            return -1;
+        }
+    } else {
+        LZ4F_resetDecompressionContext(*ctx);
+    }
+
+    size_t in_pos = 0, out_pos = 0;
+    size_t hint;
+
+    do {
+        if (*out_cap - out_pos == 0) {
+            const size_t new_cap = BUFFER_GROW(*out_cap);
+            char *new = realloc_f(*out, new_cap);
+            if (new == nullptr) {
+                return -1;
+            }
+
+            *out = new;
+            *out_cap = new_cap;
+        }
+
+        size_t src_size = in_len - in_pos;
+        size_t dst_size = *out_cap - out_pos;
+
+        hint = LZ4F_decompress(*ctx, *out + out_pos, &dst_size, in + in_pos, &src_size, nullptr);
+        if (LZ4F_isError(hint)) {
+            return -1;
+        }
+
+        in_pos += src_size;
+        out_pos += dst_size;
+
+        // the frame isn't finished, but we've run out of input.
+        if (hint != 0 && in_pos == in_len && dst_size == 0) {
+            return -1;
+        }
+    } while (hint != 0);
+
+    *actual_out = out_pos;
+    return 0;
+}
+
+void decompress_free_lz4(
+    void **ctx_ptr,
+    void *(*realloc_f)(void*, size_t)
+) {
+    const auto ctx = (LZ4F_dctx**)ctx_ptr;
+
+    if (*ctx != nullptr) {
+        LZ4F_freeDecompressionContext(*ctx);
+        *ctx = nullptr;
+    }
+}
+
+lzma_ret decompress_lzma(
+    void **ctx_ptr,
+    const char *in,
+    const size_t in_len,
+    char **out,
+    size_t *out_cap,
+    size_t *actual_out,
+    void *(*realloc_f)(void*, size_t)
+) {
+    lzma_stream *strm = *ctx_ptr;
+    lzma_ret result;
+
+    if (strm == nullptr) {
+        strm = realloc_f(nullptr, sizeof(lzma_stream));
+        if (strm == nullptr) {
+            return LZMA_MEM_ERROR;
+        }
+
+        *strm = (lzma_stream)LZMA_STREAM_INIT;
+        *ctx_ptr = strm;
+    }
+
+    // re-initialising an existing decoder reuses its allocations.
+    result = lzma_stream_decoder(strm, UINT64_MAX, 0);
+    if (result != LZMA_OK) {
+        return result;
+    }
+
+    strm->next_in = (uint8_t*)in;
+    strm->avail_in = in_len;
+    strm->total_in = 0;
+
+    strm->next_out = (uint8_t*)*out;
+    strm->avail_out = *out_cap;
+    strm->total_out = 0;
+
+    do {
+        if (strm->avail_out == 0) {
+            const size_t new_cap = BUFFER_GROW(*out_cap);
+            char *new = realloc_f(*out, new_cap);
+            if (new == nullptr) {
+                return LZMA_MEM_ERROR;
+            }
+
+            *out = new;
+            *out_cap = new_cap;
+
+            strm->next_out = (uint8_t*)new + strm->total_out;
+            strm->avail_out = new_cap - strm->total_out;
+        }
+
+        result = lzma_code(strm, LZMA_FINISH);
+    } while (result == LZMA_OK);
+
+    *actual_out = strm->total_out;
+    return result;
+}
+
+void decompress_free_lzma(
+    void **ctx_ptr,
+    void *(*realloc_f)(void*, size_t)
+) {
+    compress_free_lzma(ctx_ptr, realloc_f);
+}
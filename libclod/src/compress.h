@@ -2,6 +2,55 @@
 
 #include <stddef.h>
 #include <lzma.h>
+#include <anvil.h>
+
+/**
+ * the definition of the public anvil_codec.
+ *
+ * the lz4 and lzma fields are the contexts taken by the compress_* and decompress_* methods below,
+ * and can be given to them in place of a LOD's own contexts.
+ * the lzma streams always exist, so they are never allocated by those methods.
+ */
+struct anvil_codec {
+    const anvil_allocator *alloc;
+
+    int deflate_level;
+    struct libdeflate_compressor *deflate_compressor;
+    struct libdeflate_decompressor *deflate_decompressor;
+
+    void *lz4_ctx;
+    void *lz4_dctx;
+    void *lzma_ctx;
+    void *lzma_dctx;
+
+    char *in_buffer;        // uncompressed data.
+    size_t in_buffer_cap;
+
+    char *out_buffer;       // compressed data.
+    size_t out_buffer_cap;
+};
+
+struct libdeflate_decompressor *codec_deflate_decompressor(
+    struct anvil_codec *codec
+);
+
+/**
+ * changing the compression level between calls recreates the compressor.
+ */
+struct libdeflate_compressor *codec_deflate_compressor(
+    struct anvil_codec *codec,
+    int compression_level
+);
+
+/**
+ * grows one of the codec's buffers to at least n bytes.
+ */
+anvil_result codec_ensure(
+    const struct anvil_codec *codec,
+    char **buffer,
+    size_t *buffer_cap,
+    size_t n
+);
 
 int compress_lz4(
     void **ctx_ptr,
@@ -34,3 +83,33 @@ void compress_free_lzma(
     void **ctx_ptr,
     void *(*realloc_f)(void*, size_t)
 );
+
+int decompress_lz4(
+    void **ctx_ptr,
+    const char *in,
+    size_t in_len,
+    char **out,
+    size_t *out_cap,
+    size_t *actual_out,
+    void *(*realloc_f)(void*, size_t)
+);
+
+void decompress_free_lz4(
+    void **ctx_ptr,
+    void *(*realloc_f)(void*, size_t)
+);
+
+lzma_ret decompress_lzma(
+    void **ctx_ptr,
+    const char *in,
+    size_t in_len,
+    char **out,
+    size_t *out_cap,
+    size_t *actual_out,
+    void *(*realloc_f)(void*, size_t)
+);
+
+void decompress_free_lzma(
+    void **ctx_ptr,
+    void *(*realloc_f)(void*, size_t)
+);
@@ -0,0 +1,173 @@
+#include <stdlib.h>
+#include <string.h>
+#include <dh.h>
+
+/// allocations are aligned to this, enough for anything a LOD stores.
+#define ALIGN 16
+
+/**
+ * a block of memory allocations are bumped out of.
+ * blocks are only ever returned to the system when the arena is freed.
+ */
+struct block {
+    struct block *next;
+    size_t cap;
+    size_t used;
+    alignas(ALIGN) char data[];
+};
+
+/**
+ * sits in front of every allocation, so it can be copied when it has to move.
+ */
+struct header {
+    alignas(ALIGN) size_t size;
+};
+
+struct dh_arena {
+    struct block *first;
+    struct block *current;          // block allocations are being bumped out of.
+    void *top;                      // the last allocation, which can grow and shrink in place. (nullable)
+    size_t block_size;
+    size_t reserved;
+};
+
+/// the arena dh_arena_realloc allocates from on this thread.
+static thread_local struct dh_arena *bound = nullptr;
+
+static size_t align_up(const size_t size) {
+    return (size + ALIGN - 1) & ~(size_t)(ALIGN - 1);
+}
+
+struct dh_arena *dh_arena_new(
+    const size_t block_size
+) {
+    struct dh_arena *arena = malloc(sizeof(struct dh_arena));
+    if (arena == nullptr) return nullptr;
+
+    *arena = (struct dh_arena){
+        .first = nullptr,
+        .current = nullptr,
+        .top = nullptr,
+        .block_size = block_size > 0 ? align_up(block_size) : 4 * 1024 * 1024,
+        .reserved = 0,
+    };
+    return arena;
+}
+
+void dh_arena_bind(
+    struct dh_arena *arena
+) {
+    bound = arena;
+}
+
+void dh_arena_reset(
+    struct dh_arena *arena
+) {
+    if (arena == nullptr) return;
+
+    for (struct block *block = arena->first; block != nullptr; block = block->next)
+        block->used = 0;
+
+    arena->current = arena->first;
+    arena->top = nullptr;
+}
+
+size_t dh_arena_reserved(
+    const struct dh_arena *arena
+) {
+    return arena != nullptr ? arena->reserved : 0;
+}
+
+void dh_arena_free(
+    struct dh_arena *arena
+) {
+    if (arena == nullptr) return;
+    if (bound == arena) bound = nullptr;
+
+    struct block *block = arena->first;
+    while (block != nullptr) {
+        struct block *next = block->next;
+        free(block);
+        block = next;
+    }
+
+    free(arena);
+}
+
+/**
+ * takes size bytes from the current block, moving on to the next one if it's full.
+ * blocks kept from before the last reset are used again in the same order, so once a workload has
+ * been through the arena once, doing the same again fits in the blocks it already has.
+ */
+static void *bump(struct dh_arena *arena, const size_t size) {
+    const size_t need = sizeof(struct header) + align_up(size);
+    if (need < size) return nullptr;
+
+    struct block *block = arena->current;
+    if (block == nullptr || block->cap - block->used < need) {
+        struct block **link = block != nullptr ? &block->next : &arena->first;
+
+        block = *link;
+        if (block == nullptr || block->cap < need) {
+            const size_t cap = need > arena->block_size ? need : arena->block_size;
+
+            struct block *new = malloc(sizeof(struct block) + cap);
+            if (new == nullptr) return nullptr;
+
+            // a block too small for this stays where it is, for the allocations after it.
+            *new = (struct block){ .next = *link, .cap = cap, .used = 0 };
+            *link = new;
+            block = new;
+            arena->reserved += cap;
+        }
+
+        arena->current = block;
+    }
+
+    struct header *header = (struct header*)(block->data + block->used);
+    header->size = size;
+    block->used += need;
+
+    arena->top = header + 1;
+    return arena->top;
+}
+
+void *dh_arena_realloc(
+    void *ptr,
+    const size_t size
+) {
+    struct dh_arena *arena = bound;
+    if (arena == nullptr) return nullptr;
+
+    if (ptr == nullptr) return size > 0 ? bump(arena, size) : nullptr;
+
+    struct header *header = (struct header*)ptr - 1;
+    struct block *block = arena->current;
+
+    // only the last allocation can give its memory back before a reset, or grow where it is.
+    if (ptr == arena->top) {
+        const size_t start = (char*)header - block->data;
+
+        if (size == 0) {
+            block->used = start;
+            arena->top = nullptr;
+            return nullptr;
+        }
+
+        const size_t need = sizeof(struct header) + align_up(size);
+        if (need >= size && block->cap - start >= need) {
+            block->used = start + need;
+            header->size = size;
+            return ptr;
+        }
+    }
+
+    if (size == 0) return nullptr;
+    if (size <= header->size) return ptr;
+
+    void *new = bump(arena, size);
+    if (new == nullptr) return nullptr;
+
+    memcpy(new, ptr, header->size);
+    return new;
+}
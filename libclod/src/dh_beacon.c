@@ -0,0 +1,277 @@
+#include <stdint.h>
+#include <string.h>
+#include <dh.h>
+#include <nbt.h>
+#include "dh_lod.h"
+
+/**
+ * beam colours of stained glass, as minecraft blends them.
+ */
+static const struct { const char *colour; uint32_t rgb; } glass_colours[] = {
+    { "white",      0xF9FFFE },
+    { "orange",     0xF9801D },
+    { "magenta",    0xC74EBD },
+    { "light_blue", 0x3AB3DA },
+    { "yellow",     0xFED83D },
+    { "lime",       0x80C71F },
+    { "pink",       0xF38BAA },
+    { "gray",       0x474F52 },
+    { "light_gray", 0x9D9D97 },
+    { "cyan",       0x169C9C },
+    { "purple",     0x8932B8 },
+    { "blue",       0x3C44AA },
+    { "brown",      0x835432 },
+    { "green",      0x5E7C16 },
+    { "red",        0xB02E26 },
+    { "black",      0x1D1D21 },
+};
+
+/**
+ * finds the colour of a block the beam passes through, if it's stained glass or a stained glass pane.
+ */
+static bool glass_colour(const char *name, const size_t name_size, uint32_t *rgb) {
+    const char *prefix = "minecraft:";
+    if (name_size < strlen(prefix) || strncmp(name, prefix, strlen(prefix)) != 0) return false;
+    name += strlen(prefix);
+    const size_t size = name_size - strlen(prefix);
+
+    for (size_t i = 0; i < sizeof(glass_colours) / sizeof(*glass_colours); i++) {
+        const size_t colour_size = strlen(glass_colours[i].colour);
+        if (size <= colour_size || strncmp(name, glass_colours[i].colour, colour_size) != 0) continue;
+
+        const char *rest = name + colour_size;
+        const size_t rest_size = size - colour_size;
+        if (
+            (rest_size == strlen("_stained_glass") && strncmp(rest, "_stained_glass", rest_size) == 0) ||
+            (rest_size == strlen("_stained_glass_pane") && strncmp(rest, "_stained_glass_pane", rest_size) == 0)
+        ) {
+            *rgb = glass_colours[i].rgb;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+// section Y values a chunk can have, covering minecraft's tallest possible world.
+#define SECTIONS_MIN_Y (-128)
+#define SECTIONS 256
+
+/**
+ * the block states of one section, as they are in the chunk.
+ */
+struct section_states {
+    char *palette;  // (nullable) palette list, null if the chunk has no section at this Y.
+    char *data;     // (nullable) packed indices into the palette, null if the palette has one entry.
+};
+
+/**
+ * finds the block states of every section in the chunk, by their Y.
+ */
+static dh_result find_sections(char *section_list, const char *end, struct section_states *sections) {
+    memset(sections, 0, SECTIONS * sizeof(*sections));
+    if (section_list == nullptr || nbt_list_size(section_list) <= 0) return DH_OK;
+    if (nbt_list_etype(section_list) != NBT_COMPOUND) return DH_ERR_MALFORMED;
+
+    char *section = nbt_list_payload(section_list);
+    for (int32_t i = 0; i < nbt_list_size(section_list); i++) {
+        char *block_states = nullptr;
+        int64_t y = INT64_MIN;
+
+        section = nbt_named(section, end,
+            "block_states", strlen("block_states"), NBT_COMPOUND, &block_states,
+            "Y", strlen("Y"), NBT_ANY_INTEGER, &y,
+            nullptr
+        );
+        if (section == nullptr) return DH_ERR_MALFORMED;
+        if (block_states == nullptr || y < SECTIONS_MIN_Y || y >= SECTIONS_MIN_Y + SECTIONS) continue;
+
+        struct section_states *states = &sections[y - SECTIONS_MIN_Y];
+        if (nbt_named(block_states, end,
+            "palette", strlen("palette"), NBT_LIST, &states->palette,
+            "data", strlen("data"), NBT_LONG_ARRAY, &states->data,
+            nullptr
+        ) == nullptr) return DH_ERR_MALFORMED;
+
+        if (states->palette != nullptr && nbt_list_size(states->palette) <= 0) states->palette = nullptr;
+    }
+
+    return DH_OK;
+}
+
+/**
+ * finds the colour of the block at a position in a section, if it's stained glass.
+ * indices are packed into longs from the lowest bits up, at least 4 bits each, and never span two longs.
+ */
+static bool block_glass_colour(
+    const struct section_states *states,
+    const char *end,
+    const int64_t x,
+    const int64_t y,
+    const int64_t z,
+    uint32_t *rgb
+) {
+    const int32_t palette_size = nbt_list_size(states->palette);
+    int32_t index = 0;
+
+    if (palette_size > 1) {
+        if (states->data == nullptr) return false;
+
+        unsigned bits = 4;
+        while ((1 << bits) < palette_size) bits++;
+        const unsigned per_long = 64 / bits;
+
+        const unsigned block = (unsigned)(y * 16 * 16 + z * 16 + x);
+        if (block / per_long >= (unsigned)nbt_long_array_size(states->data)) return false;
+
+        const uint64_t packed = (uint64_t)nbt_long(nbt_long_array_payload(states->data) + block / per_long * 8);
+        index = (int32_t)(packed >> block % per_long * bits & ((1ULL << bits) - 1));
+        if (index >= palette_size) return false;
+    }
+
+    char *entry = nbt_list_payload(states->palette);
+    for (int32_t i = 0; i < index && entry != nullptr; i++)
+        entry = nbt_payload_step(entry, NBT_COMPOUND, end);
+    if (entry == nullptr) return false;
+
+    char *name = nullptr;
+    nbt_named(entry, end, "Name", strlen("Name"), NBT_STRING, &name, nullptr);
+    if (name == nullptr) return false;
+
+    return glass_colour(nbt_string(name), nbt_string_size(name), rgb);
+}
+
+/**
+ * walks up the column above a beacon, through the sections of its chunk, blending the colour of the glass its beam passes through.
+ * the first glass sets the colour, and each one after is averaged with it.
+ */
+static void beam_colour(const struct section_states *sections, const char *end, struct dh_beacon *beacon) {
+    float r = 1, g = 1, b = 1;
+    bool coloured = false;
+
+    const int64_t x = beacon->x & 15, z = beacon->z & 15;
+    int64_t section_y = (beacon->y + 1) >> 4;
+    if (section_y < SECTIONS_MIN_Y) section_y = SECTIONS_MIN_Y;
+
+    for (; section_y < SECTIONS_MIN_Y + SECTIONS; section_y++) {
+        const struct section_states *states = &sections[section_y - SECTIONS_MIN_Y];
+        if (states->palette == nullptr) continue;
+
+        for (int64_t y = 0; y < 16; y++) {
+            if (section_y * 16 + y <= beacon->y) continue;
+
+            uint32_t rgb;
+            if (!block_glass_colour(states, end, x, y, z, &rgb)) continue;
+
+            const float glass_r = (float)(rgb >> 16 & 0xFF) / 255.0f;
+            const float glass_g = (float)(rgb >> 8 & 0xFF) / 255.0f;
+            const float glass_b = (float)(rgb & 0xFF) / 255.0f;
+
+            if (coloured) {
+                r = (r + glass_r) / 2;
+                g = (g + glass_g) / 2;
+                b = (b + glass_b) / 2;
+            } else {
+                r = glass_r;
+                g = glass_g;
+                b = glass_b;
+                coloured = true;
+            }
+        }
+    }
+
+    beacon->r = (uint8_t)(r * 255.0f + 0.5f);
+    beacon->g = (uint8_t)(g * 255.0f + 0.5f);
+    beacon->b = (uint8_t)(b * 255.0f + 0.5f);
+}
+
+dh_result dh_lod_chunk_beacons(
+    struct dh_lod *lod,
+    struct dh_lod_ext *ext,
+    char *section_list,
+    char *block_entities,
+    const char *end
+) {
+    if (block_entities == nullptr || nbt_list_size(block_entities) <= 0) return DH_OK;
+    if (nbt_list_etype(block_entities) != NBT_COMPOUND) return DH_ERR_MALFORMED;
+
+    // sections are only found once the chunk is known to have a beacon, most chunks don't.
+    struct section_states sections[SECTIONS];
+    bool sections_found = false;
+
+    char *block_entity = nbt_list_payload(block_entities);
+    for (int32_t i = 0; i < nbt_list_size(block_entities); i++) {
+        char *id = nullptr;
+        int64_t x = INT64_MIN, y = INT64_MIN, z = INT64_MIN;
+
+        char *next = nbt_named(block_entity, end,
+            "id", strlen("id"), NBT_STRING, &id,
+            "x", strlen("x"), NBT_ANY_INTEGER, &x,
+            "y", strlen("y"), NBT_ANY_INTEGER, &y,
+            "z", strlen("z"), NBT_ANY_INTEGER, &z,
+            nullptr
+        );
+        if (next == nullptr) return DH_ERR_MALFORMED;
+        block_entity = next;
+
+        if (
+            id == nullptr || x == INT64_MIN || y == INT64_MIN || z == INT64_MIN ||
+            nbt_string_size(id) != strlen("minecraft:beacon") ||
+            strncmp(nbt_string(id), "minecraft:beacon", strlen("minecraft:beacon")) != 0
+        ) continue;
+
+        if (!sections_found) {
+            const dh_result res = find_sections(section_list, end, sections);
+            if (res != DH_OK) return res;
+            sections_found = true;
+        }
+
+        if (ext->beacons_len == ext->beacons_cap) {
+            const size_t new_cap = ext->beacons_cap ? ext->beacons_cap * 2 : 4;
+            struct dh_beacon *new = lod->realloc(ext->beacons, new_cap * sizeof(struct dh_beacon));
+            if (new == nullptr) return DH_ERR_ALLOC;
+            ext->beacons = new;
+            ext->beacons_cap = new_cap;
+        }
+
+        struct dh_beacon *beacon = &ext->beacons[ext->beacons_len++];
+        beacon->x = x;
+        beacon->y = y;
+        beacon->z = z;
+        beam_colour(sections, end, beacon);
+    }
+
+    return DH_OK;
+}
+
+dh_result dh_lod_add_beacons(
+    struct dh_lod *lod,
+    char *chunk,
+    const size_t chunk_size
+) {
+    if (lod == nullptr || (chunk == nullptr && chunk_size > 0)) return DH_ERR_INVALID_ARGUMENT;
+
+    struct dh_lod_ext *ext;
+    const dh_result res = dh_lod_ext_get(lod, &ext);
+    if (res != DH_OK) return res;
+
+    // the first chunk since the LOD's data was replaced starts its beacons again.
+    if (!ext->beacons_valid) {
+        ext->beacons_len = 0;
+        ext->beacons_valid = true;
+    }
+
+    if (chunk_size == 0) return DH_OK;
+    const char *end = chunk + chunk_size;
+
+    // without the section parser the chunk's root compound is walked here, once.
+    char *section_list = nullptr;
+    char *block_entities = nullptr;
+    if (nbt_named(nbt_payload(chunk, NBT_COMPOUND, end), end,
+        "sections", strlen("sections"), NBT_LIST, &section_list,
+        "block_entities", strlen("block_entities"), NBT_LIST, &block_entities,
+        nullptr
+    ) == nullptr) return DH_ERR_MALFORMED;
+
+    return dh_lod_chunk_beacons(lod, ext, section_list, block_entities, end);
+}
@@ -0,0 +1,57 @@
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdatomic.h>
+#include <dh.h>
+
+/**
+ * sits in front of every allocation, so what's given back can be counted.
+ * it keeps allocations as aligned as malloc's.
+ */
+struct header {
+    alignas(max_align_t) size_t size;
+};
+
+static atomic_size_t budget = 0;
+static atomic_size_t used = 0;
+
+void dh_budget_set(
+    const size_t bytes
+) {
+    atomic_store(&budget, bytes);
+}
+
+size_t dh_budget_used(void) {
+    return atomic_load(&used);
+}
+
+bool dh_budget_near(void) {
+    const size_t limit = atomic_load(&budget);
+    if (limit == 0) return false;
+
+    return atomic_load(&used) >= limit - limit / 8;
+}
+
+void *dh_budget_realloc(
+    void *ptr,
+    const size_t size
+) {
+    struct header *old = ptr != nullptr ? (struct header*)ptr - 1 : nullptr;
+    const size_t old_size = old != nullptr ? old->size : 0;
+
+    if (size == 0) {
+        free(old);
+        atomic_fetch_sub(&used, old_size);
+        return nullptr;
+    }
+
+    if (size > SIZE_MAX - sizeof(struct header)) return nullptr;
+
+    struct header *new = realloc(old, sizeof(struct header) + size);
+    if (new == nullptr) return nullptr;
+
+    new->size = size;
+    if (size > old_size) atomic_fetch_add(&used, size - old_size);
+    else atomic_fetch_sub(&used, old_size - size);
+
+    return new + 1;
+}
@@ -3,8 +3,10 @@
 #include <string.h>
 
 #include <sqlite3.h>
+#include <libdeflate.h>
 
 #include "dh.h"
+#include "dh_lod.h"
 #include "generated/index.h"
 
 int run_migration(sqlite3 *db, char *name, const char *sql, size_t sql_size) {
@@ -57,16 +59,144 @@ int run_migration(sqlite3 *db, char *name, const char *sql, size_t sql_size) {
     return 0;
 }
 
+/**
+ * a LOD waiting to be written, with its data and mapping copied into the pending buffer.
+ */
+struct pending_lod {
+    int64_t mip_level;
+    uint64_t key;               // Morton code of the position.
+    size_t seq;                 // order it was stored in, so the last store to a position wins.
+
+    int64_t x;
+    int64_t z;
+    int64_t min_y;
+    int64_t compression_mode;
+    int32_t checksum;
+    bool apply_to_parent;
+    bool apply_to_children;
+
+    size_t data;                // offsets into the buffer.
+    size_t data_len;
+    size_t mapping;
+    size_t mapping_len;
+};
+
+/**
+ * LODs stored with DH_DB_SORTED_WRITES.
+ * the buffer is written once it passes PENDING_BYTES, so it is also the batch size.
+ */
+struct pending {
+    struct pending_lod *lods;
+    size_t lods_len;
+    size_t lods_cap;
+
+    char *buffer;
+    size_t buffer_len;
+    size_t buffer_cap;
+};
+
+#define PENDING_BYTES (64 * 1024 * 1024)
+
 struct dh_db {
     sqlite3 *db;
+    unsigned flags;
+    struct pending *pending;    // (nullable) only with DH_DB_SORTED_WRITES.
 
     sqlite3_stmt *store;
+    sqlite3_stmt *load;
+    sqlite3_stmt *applied;
+    sqlite3_stmt *delete;
+    sqlite3_stmt *chunk_get;
+    sqlite3_stmt *chunk_put;
+    sqlite3_stmt *chunk_delete;
+    sqlite3_stmt *beacon_delete;
+    sqlite3_stmt *beacon_put;
+
+    char *chunk_buffer;         // decompressed chunk data being hashed.
+    size_t chunk_buffer_cap;
 };
 
+/**
+ * runs statements that don't return anything of interest.
+ */
+static int exec_sql(sqlite3 *db, const char *sql) {
+    char *msg = nullptr;
+    const int err = sqlite3_exec(db, sql, nullptr, nullptr, &msg);
+    if (err != SQLITE_OK) {
+        fprintf(stderr, "executing %s: (%d) %s\n", sql, err, msg != nullptr ? msg : sqlite3_errmsg(db));
+        sqlite3_free(msg);
+        return -1;
+    }
+
+    return 0;
+}
+
+static void finalize_statements(struct dh_db *db) {
+    sqlite3_finalize(db->store);
+    sqlite3_finalize(db->load);
+    sqlite3_finalize(db->applied);
+    sqlite3_finalize(db->delete);
+    sqlite3_finalize(db->chunk_get);
+    sqlite3_finalize(db->chunk_put);
+    sqlite3_finalize(db->chunk_delete);
+    sqlite3_finalize(db->beacon_delete);
+    sqlite3_finalize(db->beacon_put);
+
+    db->store = nullptr;
+    db->load = nullptr;
+    db->applied = nullptr;
+    db->delete = nullptr;
+    db->chunk_get = nullptr;
+    db->chunk_put = nullptr;
+    db->chunk_delete = nullptr;
+    db->beacon_delete = nullptr;
+    db->beacon_put = nullptr;
+}
+
+/// the ApplyToParent index from migration 0050, which bulk loads drop until they're closed.
+#define CREATE_UPDATED_INDEX "create index if not exists FullDataUpdatedIndex on FullData (ApplyToParent) where ApplyToParent = 1"
+
+/// columns read into a LOD, in the order load_row expects.
+#define LOAD_COLUMNS "DetailLevel, PosX, PosZ, MinY, DataChecksum, CompressionMode, Data, Mapping"
+
+/**
+ * reads the current row of a statement selecting LOAD_COLUMNS into the LOD.
+ * sqlite's blobs only live until the statement is stepped again,
+ * so the data is copied once, into the LOD's existing buffer.
+ */
+static int load_row(sqlite3_stmt *stmt, struct dh_lod *lod) {
+    lod->mip_level = sqlite3_column_int64(stmt, 0);
+    lod->x = sqlite3_column_int64(stmt, 1);
+    lod->z = sqlite3_column_int64(stmt, 2);
+    lod->min_y = sqlite3_column_int64(stmt, 3);
+    lod->checksum = sqlite3_column_int(stmt, 4);
+    lod->compression_mode = sqlite3_column_int64(stmt, 5);
+    lod->height = 0;
+    lod->has_data = true;
+
+    const dh_result res = dh_lod_load_stored(
+        lod,
+        sqlite3_column_blob(stmt, 6), sqlite3_column_bytes(stmt, 6),
+        sqlite3_column_blob(stmt, 7), sqlite3_column_bytes(stmt, 7)
+    );
+    if (res != DH_OK) {
+        fprintf(stderr, "loading LOD (%ld, %ld): %d\n", lod->x, lod->z, res);
+        return -1;
+    }
+
+    return 0;
+}
+
 struct dh_db *dh_db_open(const char *path) {
+    return dh_db_open_ex(path, 0);
+}
+
+struct dh_db *dh_db_open_ex(const char *path, const unsigned flags) {
     struct dh_db* db = calloc(1, sizeof(struct dh_db));
     if (db == nullptr) return nullptr;
 
+    db->flags = flags;
+
     int err = sqlite3_open_v2(path, &db->db, SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE, nullptr);
     if (err != SQLITE_OK) {
         fprintf(stderr, "sqlite3_open: %s\n", sqlite3_errmsg(db->db));
@@ -75,6 +205,20 @@ struct dh_db *dh_db_open(const char *path) {
         return nullptr;
     }
 
+    // page size has to be set before the first table is created, so before migrations.
+    // LOD rows are usually tens of kilobytes, and with the default 4KB pages
+    // nearly every row is a long chain of overflow pages.
+    if (flags & DH_DB_BULK_LOAD && exec_sql(db->db,
+        "pragma page_size = 32768; "
+        "pragma locking_mode = EXCLUSIVE; "
+        "pragma cache_size = -262144; "
+        "pragma mmap_size = 1073741824; "
+    )) {
+        sqlite3_close(db->db);
+        free(db);
+        return nullptr;
+    }
+
     sqlite3_stmt *stmt;
     err = sqlite3_prepare_v2(db->db, "SELECT name FROM sqlite_master WHERE name='Schema'", -1, &stmt, nullptr);
     if (err != SQLITE_OK) {
@@ -170,6 +314,16 @@ struct dh_db *dh_db_open(const char *path) {
     );
 
 
+    // the ApplyToParent index is rebuilt once when the database is closed,
+    // instead of being updated for every row.
+    // any other open puts it back, in case a bulk load never got to close.
+    const char *index_sql = flags & DH_DB_BULK_LOAD ? "drop index if exists FullDataUpdatedIndex" : CREATE_UPDATED_INDEX;
+    if (exec_sql(db->db, index_sql)) {
+        sqlite3_close(db->db);
+        free(db);
+        return nullptr;
+    }
+
     const char *store_sql =
         "insert into FullData ("
         "DetailLevel, "
@@ -187,127 +341,220 @@ struct dh_db *dh_db_open(const char *path) {
         "ApplyToChildren, "
         "LastModifiedUnixDateTime, "
         "CreatedUnixDateTime"
-        ") values (?,?,?,?,?,?,?,?,?,?,?,0,0,?,?)";
+        ") values (?,?,?,?,?,?,?,?,?,?,?,?,?,?,?) "
+        "on conflict (DetailLevel, PosX, PosZ) do update set "
+        "MinY = excluded.MinY, "
+        "DataChecksum = excluded.DataChecksum, "
+        "Data = excluded.Data, "
+        "ColumnGenerationStep = excluded.ColumnGenerationStep, "
+        "ColumnWorldCompressionMode = excluded.ColumnWorldCompressionMode, "
+        "Mapping = excluded.Mapping, "
+        "DataFormatVersion = excluded.DataFormatVersion, "
+        "CompressionMode = excluded.CompressionMode, "
+        "ApplyToParent = excluded.ApplyToParent, "
+        "ApplyToChildren = excluded.ApplyToChildren, "
+        "LastModifiedUnixDateTime = excluded.LastModifiedUnixDateTime "
+        // rewriting a row with the same data is a waste of IO.
+        "where DataChecksum != excluded.DataChecksum";
 
-    err = sqlite3_prepare_v2(db->db, store_sql, (int)strlen(store_sql)+1, &db->store, nullptr);
-    if (err != SQLITE_OK) {
-        fprintf(stderr, "sqlite3_prepate_v2: %s\n", sqlite3_errmsg(db->db));
-        sqlite3_close(db->db);
-        free(db);
-        return nullptr;
+    const char *load_sql =
+        "select " LOAD_COLUMNS " from FullData where DetailLevel = ? and PosX = ? and PosZ = ?";
+
+    const char *applied_sql =
+        "update FullData set ApplyToParent = 0 "
+        "where DetailLevel = ? and PosX between ? and ? and PosZ between ? and ? and ApplyToParent = 1";
+
+    const char *delete_sql =
+        "delete from FullData where DetailLevel = ? and PosX between ? and ? and PosZ between ? and ?";
+
+    const char *chunk_get_sql =
+        "select ChunkHash, LastModifiedUnixDateTime from ChunkHash where ChunkPosX = ? and ChunkPosZ = ?";
+
+    const char *chunk_put_sql =
+        "insert into ChunkHash ("
+        "ChunkPosX, "
+        "ChunkPosZ, "
+        "ChunkHash, "
+        "LastModifiedUnixDateTime, "
+        "CreatedUnixDateTime"
+        ") values (?,?,?,?,?) "
+        "on conflict (ChunkPosX, ChunkPosZ) do update set "
+        "ChunkHash = excluded.ChunkHash, "
+        "LastModifiedUnixDateTime = excluded.LastModifiedUnixDateTime";
+
+    const char *chunk_delete_sql =
+        "delete from ChunkHash where ChunkPosX = ? and ChunkPosZ = ?";
+
+    const char *beacon_delete_sql =
+        "delete from BeaconBeam where BlockPosX between ? and ? and BlockPosZ between ? and ?";
+
+    const char *beacon_put_sql =
+        "insert into BeaconBeam ("
+        "BlockPosX, "
+        "BlockPosY, "
+        "BlockPosZ, "
+        "ColorR, "
+        "ColorG, "
+        "ColorB, "
+        "LastModifiedUnixDateTime, "
+        "CreatedUnixDateTime"
+        ") values (?,?,?,?,?,?,?,?) "
+        "on conflict (BlockPosX, BlockPosY, BlockPosZ) do update set "
+        "ColorR = excluded.ColorR, "
+        "ColorG = excluded.ColorG, "
+        "ColorB = excluded.ColorB, "
+        "LastModifiedUnixDateTime = excluded.LastModifiedUnixDateTime";
+
+    struct { const char *sql; sqlite3_stmt **stmt; } statements[] = {
+        { store_sql, &db->store },
+        { load_sql, &db->load },
+        { applied_sql, &db->applied },
+        { delete_sql, &db->delete },
+        { chunk_get_sql, &db->chunk_get },
+        { chunk_put_sql, &db->chunk_put },
+        { chunk_delete_sql, &db->chunk_delete },
+        { beacon_delete_sql, &db->beacon_delete },
+        { beacon_put_sql, &db->beacon_put },
+    };
+
+    for (size_t i = 0; i < sizeof(statements) / sizeof(*statements); i++) {
+        err = sqlite3_prepare_v2(db->db, statements[i].sql, -1, statements[i].stmt, nullptr);
+        if (err != SQLITE_OK) {
+            fprintf(stderr, "sqlite3_prepate_v2: %s\n", sqlite3_errmsg(db->db));
+            finalize_statements(db);
+            sqlite3_close(db->db);
+            free(db);
+            return nullptr;
+        }
     }
 
-    err = sqlite3_prepare_v2(db->db, "pragma journal_mode = OFF; PRAGMA synchronous = OFF; ", -1, &stmt, nullptr);
-    if (err != SQLITE_OK) {
-        fprintf(stderr, "sqlite3_prepate_v2: %s\n", sqlite3_errmsg(db->db));
+    if (exec_sql(db->db, "pragma journal_mode = OFF; pragma synchronous = OFF; ")) {
+        finalize_statements(db);
         sqlite3_close(db->db);
         free(db);
         return nullptr;
     }
 
-    do {
-        err = sqlite3_step(stmt);
-    } while (err == SQLITE_ROW);
-    if (err != SQLITE_DONE) {
-        fprintf(stderr, "sqlite3_step: %s\n", sqlite3_errmsg(db->db));
+    if (flags & DH_DB_BULK_LOAD && exec_sql(db->db, "begin")) {
+        finalize_statements(db);
         sqlite3_close(db->db);
         free(db);
         return nullptr;
     }
 
-    sqlite3_finalize(stmt);
+    if (flags & DH_DB_SORTED_WRITES) {
+        db->pending = calloc(1, sizeof(struct pending));
+        if (db->pending == nullptr) {
+            finalize_statements(db);
+            sqlite3_close(db->db);
+            free(db);
+            return nullptr;
+        }
+    }
 
     return db;
 }
 
 void dh_db_close(struct dh_db *db) {
-    sqlite3_stmt *stmt;
+    dh_db_close_ex(db);
+}
 
-    if (db == nullptr) return;
+int dh_db_close_ex(struct dh_db *db) {
+    if (db == nullptr) return 0;
 
+    int res = 0;
     if (db->db != nullptr){
-        int err = sqlite3_prepare_v2(db->db, "pragma journal_mode = WAL; pragma synchronous = NORMAL; ", -1, &stmt, nullptr);
-        if (err != SQLITE_OK) {
-            fprintf(stderr, "sqlite3_prepare_v2: %s\n", sqlite3_errmsg(db->db));
-        }
+        if (dh_db_flush(db)) res = -1;
 
-        do {
-            err = sqlite3_step(stmt);
-        } while (err == SQLITE_ROW);
-        if (err != SQLITE_DONE) {
-            fprintf(stderr, "sqlite3_step: %s\n", sqlite3_errmsg(db->db));
-        }
-        
-        err = sqlite3_finalize(stmt);
-        if (err != SQLITE_OK) {
-            fprintf(stderr, "sqlite3_finalize: %s\n", sqlite3_errmsg(db->db));
-        }
+        // the bulk load is committed before the index is built,
+        // so a failure building it doesn't lose the LODs.
+        if (db->flags & DH_DB_BULK_LOAD) {
+            if (exec_sql(db->db, "commit")) {
+                res = -1;
+            } else if (exec_sql(db->db, CREATE_UPDATED_INDEX)) {
+                res = -1;
+            }
 
-        err = sqlite3_finalize(db->store);
-        if (err != SQLITE_OK) {
-            fprintf(stderr, "sqlite3_finalize: %s\n", sqlite3_errmsg(db->db));
+            if (exec_sql(db->db, "pragma locking_mode = NORMAL")) res = -1;
         }
-        db->store = nullptr;
 
-        err = sqlite3_close(db->db);
+        if (exec_sql(db->db, "pragma journal_mode = WAL; pragma synchronous = NORMAL; ")) res = -1;
+
+        finalize_statements(db);
+
+        const int err = sqlite3_close(db->db);
         if (err != SQLITE_OK) {
             fprintf(stderr, "sqlite3_close: %s\n", sqlite3_errmsg(db->db));
+            res = -1;
         }
         db->db = nullptr;
     }
 
-    free(db);
+    if (db->pending != nullptr) {
+        free(db->pending->lods);
+        free(db->pending->buffer);
+        free(db->pending);
+    }
 
+    free(db->chunk_buffer);
+    free(db);
+    return res;
 }
 
 int dh_db_store(const struct dh_db *db, struct dh_lod *lod) {
-    if (db == nullptr || lod == nullptr) return -1;
-
-    size_t mapping_len;
-    char *mapping;
-    const dh_result result = dh_lod_serialise_mapping(lod, &mapping, &mapping_len);
-    if (result != DH_OK) {
-        return -1;
-    }
+    return dh_db_store_ex(db, lod, false);
+}
 
+/**
+ * writes a row to FullData, replacing the row at the same position and mip level.
+ */
+static int store_row(
+    const struct dh_db *db,
+    const int64_t mip_level,
+    const int64_t x,
+    const int64_t z,
+    const int64_t min_y,
+    const int32_t checksum,
+    const int64_t compression_mode,
+    const char *data,
+    const size_t data_len,
+    const char *mapping,
+    const size_t mapping_len,
+    const bool apply_to_parent,
+    const bool apply_to_children
+) {
     #define check_error(stmt) ({ if ((stmt) != SQLITE_OK) \
         fprintf(stderr, #stmt ": %s\n", sqlite3_errmsg(db->db)); })
 
-    switch (lod->compression_mode) {
-    case DH_DATA_COMPRESSION_UNCOMPRESSED:
-        check_error(sqlite3_bind_blob(db->store, 7, dh_constants__gen_step, sizeof(dh_constants__gen_step), SQLITE_STATIC));
-        check_error(sqlite3_bind_blob(db->store, 8, dh_constants__compression_mode, sizeof(dh_constants__compression_mode), SQLITE_STATIC));
-        break;
-    case DH_DATA_COMPRESSION_LZ4:
-        check_error(sqlite3_bind_blob(db->store, 7, dh_constants__gen_step__lz4, sizeof(dh_constants__gen_step__lz4), SQLITE_STATIC));
-        check_error(sqlite3_bind_blob(db->store, 8, dh_constants__compression_mode__lz4, sizeof(dh_constants__compression_mode__lz4), SQLITE_STATIC));
-        break;
-    case DH_DATA_COMPRESSION_LZMA2:
-        check_error(sqlite3_bind_blob(db->store, 7, dh_constants__gen_step__lzma, sizeof(dh_constants__gen_step__lzma), SQLITE_STATIC));
-        check_error(sqlite3_bind_blob(db->store, 8, dh_constants__compression_mode__lzma, sizeof(dh_constants__compression_mode__lzma), SQLITE_STATIC));
-        break;
-    default:
+    const void *gen_step, *world_compression;
+    size_t gen_step_len, world_compression_len;
+    if (dh_lod_row_constants(compression_mode, &gen_step, &gen_step_len, &world_compression, &world_compression_len) != DH_OK) {
         fprintf(stderr, "unknown LOD compression mode\n");
         return -1;
     }
+    check_error(sqlite3_bind_blob(db->store, 7, gen_step, gen_step_len, SQLITE_STATIC));
+    check_error(sqlite3_bind_blob(db->store, 8, world_compression, world_compression_len, SQLITE_STATIC));
 
-    check_error(sqlite3_bind_int(db->store, 1, lod->mip_level));
-    check_error(sqlite3_bind_int(db->store, 2, lod->x));
-    check_error(sqlite3_bind_int(db->store, 3, lod->z));
-    check_error(sqlite3_bind_int(db->store, 4, lod->min_y));
-    check_error(sqlite3_bind_int(db->store, 5, 0));
-    check_error(sqlite3_bind_blob(db->store, 6, lod->lod_arr, lod->lod_len, SQLITE_STATIC));
+    check_error(sqlite3_bind_int(db->store, 1, mip_level));
+    check_error(sqlite3_bind_int(db->store, 2, x));
+    check_error(sqlite3_bind_int(db->store, 3, z));
+    check_error(sqlite3_bind_int(db->store, 4, min_y));
+    check_error(sqlite3_bind_int(db->store, 5, checksum));
+    check_error(sqlite3_bind_blob(db->store, 6, data, data_len, SQLITE_STATIC));
     check_error(sqlite3_bind_blob(db->store, 9, mapping, mapping_len, SQLITE_STATIC));
     check_error(sqlite3_bind_int(db->store, 10, 1));
-    check_error(sqlite3_bind_int(db->store, 11, lod->compression_mode)); // TODO; add compression
-    check_error(sqlite3_bind_int64(db->store, 12, 0));
-    check_error(sqlite3_bind_int64(db->store, 13, 0));
+    check_error(sqlite3_bind_int(db->store, 11, compression_mode)); // TODO; add compression
+    check_error(sqlite3_bind_int(db->store, 12, apply_to_parent));
+    check_error(sqlite3_bind_int(db->store, 13, apply_to_children));
+    check_error(sqlite3_bind_int64(db->store, 14, 0));
+    check_error(sqlite3_bind_int64(db->store, 15, 0));
 
     #undef check_error
 
     int error = sqlite3_step(db->store);
     if (error != SQLITE_DONE) {
         fprintf(stderr, "sqlite3_step FullData: (%d) %s\n", error, sqlite3_errmsg(db->db));
+        sqlite3_reset(db->store);
         return -1;
     }
 
@@ -319,3 +566,597 @@ int dh_db_store(const struct dh_db *db, struct dh_lod *lod) {
 
     return 0;
 }
+
+/**
+ * copies a LOD into the pending buffer.
+ */
+static int store_pending(
+    struct pending *pending,
+    const struct dh_lod *lod,
+    const char *mapping,
+    const size_t mapping_len,
+    const bool apply_to_parent,
+    const bool apply_to_children
+) {
+    if (pending->lods_len == pending->lods_cap) {
+        const size_t new_cap = pending->lods_cap ? pending->lods_cap * 2 : 256;
+        struct pending_lod *new = realloc(pending->lods, new_cap * sizeof(struct pending_lod));
+        if (new == nullptr) return -1;
+        pending->lods = new;
+        pending->lods_cap = new_cap;
+    }
+
+    const size_t len = lod->lod_len + mapping_len;
+    if (pending->buffer_cap - pending->buffer_len < len) {
+        size_t new_cap = pending->buffer_cap ? pending->buffer_cap * 2 : 1024 * 1024;
+        while (new_cap - pending->buffer_len < len) new_cap *= 2;
+        char *new = realloc(pending->buffer, new_cap);
+        if (new == nullptr) return -1;
+        pending->buffer = new;
+        pending->buffer_cap = new_cap;
+    }
+
+    struct pending_lod *p = &pending->lods[pending->lods_len];
+    p->mip_level = lod->mip_level;
+    p->key = dh_morton(lod->x, lod->z);
+    p->seq = pending->lods_len;
+    p->x = lod->x;
+    p->z = lod->z;
+    p->min_y = lod->min_y;
+    p->compression_mode = lod->compression_mode;
+    p->checksum = lod->checksum;
+    p->apply_to_parent = apply_to_parent;
+    p->apply_to_children = apply_to_children;
+
+    p->data = pending->buffer_len;
+    p->data_len = lod->lod_len;
+    if (lod->lod_len > 0) memcpy(pending->buffer + p->data, lod->lod_arr, lod->lod_len);
+    pending->buffer_len += lod->lod_len;
+
+    p->mapping = pending->buffer_len;
+    p->mapping_len = mapping_len;
+    if (mapping_len > 0) memcpy(pending->buffer + p->mapping, mapping, mapping_len);
+    pending->buffer_len += mapping_len;
+
+    pending->lods_len++;
+    return 0;
+}
+
+static int compare_pending(const void *a_ptr, const void *b_ptr) {
+    const struct pending_lod *a = a_ptr, *b = b_ptr;
+    if (a->mip_level != b->mip_level) return a->mip_level < b->mip_level ? -1 : 1;
+    if (a->key != b->key) return a->key < b->key ? -1 : 1;
+    return a->seq < b->seq ? -1 : a->seq > b->seq;
+}
+
+int dh_db_flush(const struct dh_db *db) {
+    if (db == nullptr) return -1;
+
+    struct pending *pending = db->pending;
+    if (pending == nullptr || pending->lods_len == 0) return 0;
+
+    qsort(pending->lods, pending->lods_len, sizeof(struct pending_lod), compare_pending);
+
+    // with the journal off a transaction can't be rolled back,
+    // so a batch written on its own gets an in-memory journal while it's written.
+    // a bulk load is already one transaction, whose journal can't be changed,
+    // so a failure there leaves the rows before it written.
+    const bool atomic = !(db->flags & DH_DB_BULK_LOAD);
+    if (atomic && exec_sql(db->db, "pragma journal_mode = MEMORY; begin")) {
+        exec_sql(db->db, "pragma journal_mode = OFF");
+        return -1;
+    }
+
+    int err = 0;
+    for (size_t i = 0; i < pending->lods_len && err == 0; i++) {
+        const struct pending_lod *p = &pending->lods[i];
+        err = store_row(
+            db, p->mip_level, p->x, p->z, p->min_y, p->checksum, p->compression_mode,
+            pending->buffer + p->data, p->data_len,
+            pending->buffer + p->mapping, p->mapping_len,
+            p->apply_to_parent, p->apply_to_children
+        );
+    }
+
+    if (atomic) {
+        if (err == 0 && exec_sql(db->db, "commit")) err = -1;
+        if (err) exec_sql(db->db, "rollback");
+        if (exec_sql(db->db, "pragma journal_mode = OFF")) err = -1;
+    }
+
+    // LODs that weren't written are kept for the next flush.
+    // rewriting the ones that were is harmless, as stores replace the row.
+    if (err) return -1;
+
+    pending->lods_len = 0;
+    pending->buffer_len = 0;
+    return 0;
+}
+
+/**
+ * replaces the beacons within a mip level 0 LOD's area with the ones found while generating it.
+ * LODs that weren't generated from chunks leave the beacons as they are.
+ */
+static int store_beacons(const struct dh_db *db, struct dh_lod *lod) {
+    const struct dh_beacon *beacons;
+    size_t num_beacons;
+    if (lod->mip_level != 0 || dh_lod_beacons(lod, &beacons, &num_beacons) != DH_OK) return 0;
+
+    sqlite3_bind_int64(db->beacon_delete, 1, lod->x * 64);
+    sqlite3_bind_int64(db->beacon_delete, 2, lod->x * 64 + 63);
+    sqlite3_bind_int64(db->beacon_delete, 3, lod->z * 64);
+    sqlite3_bind_int64(db->beacon_delete, 4, lod->z * 64 + 63);
+
+    int err = sqlite3_step(db->beacon_delete);
+    sqlite3_reset(db->beacon_delete);
+    if (err != SQLITE_DONE) {
+        fprintf(stderr, "sqlite3_step delete BeaconBeam: (%d) %s\n", err, sqlite3_errmsg(db->db));
+        return -1;
+    }
+
+    for (size_t i = 0; i < num_beacons; i++) {
+        sqlite3_bind_int64(db->beacon_put, 1, beacons[i].x);
+        sqlite3_bind_int64(db->beacon_put, 2, beacons[i].y);
+        sqlite3_bind_int64(db->beacon_put, 3, beacons[i].z);
+        sqlite3_bind_int(db->beacon_put, 4, beacons[i].r);
+        sqlite3_bind_int(db->beacon_put, 5, beacons[i].g);
+        sqlite3_bind_int(db->beacon_put, 6, beacons[i].b);
+        sqlite3_bind_int64(db->beacon_put, 7, 0);
+        sqlite3_bind_int64(db->beacon_put, 8, 0);
+
+        err = sqlite3_step(db->beacon_put);
+        sqlite3_reset(db->beacon_put);
+        if (err != SQLITE_DONE) {
+            fprintf(stderr, "sqlite3_step BeaconBeam: (%d) %s\n", err, sqlite3_errmsg(db->db));
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+/**
+ * stores a LOD with the given flags, through the pending buffer with sorted writes.
+ */
+static int store_lod(
+    const struct dh_db *db,
+    struct dh_lod *lod,
+    const bool apply_to_parent,
+    const bool apply_to_children
+) {
+    if (db == nullptr || lod == nullptr) return -1;
+
+    if (dh_lod_serialise(lod) != DH_OK) {
+        fprintf(stderr, "dh_lod_serialise (%ld, %ld, %ld): failed\n", lod->mip_level, lod->x, lod->z);
+        return -1;
+    }
+
+    // beacons don't depend on the order FullData is written in, so they aren't held back with sorted writes.
+    if (store_beacons(db, lod)) return -1;
+
+    size_t mapping_len;
+    char *mapping;
+    const dh_result result = dh_lod_serialise_mapping(lod, &mapping, &mapping_len);
+    if (result != DH_OK) {
+        return -1;
+    }
+
+    if (db->pending != nullptr) {
+        if (store_pending(db->pending, lod, mapping, mapping_len, apply_to_parent, apply_to_children)) {
+            fprintf(stderr, "pending LODs: out of memory\n");
+            return -1;
+        }
+
+        return db->pending->buffer_len >= PENDING_BYTES ? dh_db_flush(db) : 0;
+    }
+
+    return store_row(
+        db, lod->mip_level, lod->x, lod->z, lod->min_y, lod->checksum, lod->compression_mode,
+        lod->lod_arr, lod->lod_len, mapping, mapping_len, apply_to_parent, apply_to_children
+    );
+}
+
+int dh_db_store_ex(const struct dh_db *db, struct dh_lod *lod, const bool apply_to_parent) {
+    return store_lod(db, lod, apply_to_parent, false);
+}
+
+int dh_db_store_mip(const struct dh_db *db, struct dh_lod *lod, const bool apply_to_parent) {
+    return store_lod(db, lod, apply_to_parent, true);
+}
+
+int dh_db_delete(
+    const struct dh_db *db,
+    const int64_t mip_level,
+    const int64_t min_x,
+    const int64_t min_z,
+    const int64_t max_x,
+    const int64_t max_z
+) {
+    if (db == nullptr) return -1;
+
+    // a pending LOD in the range would otherwise be written after it was deleted.
+    if (dh_db_flush(db)) return -1;
+
+    sqlite3_bind_int64(db->delete, 1, mip_level);
+    sqlite3_bind_int64(db->delete, 2, min_x);
+    sqlite3_bind_int64(db->delete, 3, max_x);
+    sqlite3_bind_int64(db->delete, 4, min_z);
+    sqlite3_bind_int64(db->delete, 5, max_z);
+
+    const int err = sqlite3_step(db->delete);
+    sqlite3_reset(db->delete);
+    if (err != SQLITE_DONE) {
+        fprintf(stderr, "sqlite3_step delete FullData: (%d) %s\n", err, sqlite3_errmsg(db->db));
+        return -1;
+    }
+
+    return 0;
+}
+
+int dh_db_applied(
+    const struct dh_db *db,
+    const int64_t mip_level,
+    const int64_t min_x,
+    const int64_t min_z,
+    const int64_t max_x,
+    const int64_t max_z
+) {
+    if (db == nullptr) return -1;
+
+    if (dh_db_flush(db)) return -1;
+
+    sqlite3_bind_int64(db->applied, 1, mip_level);
+    sqlite3_bind_int64(db->applied, 2, min_x);
+    sqlite3_bind_int64(db->applied, 3, max_x);
+    sqlite3_bind_int64(db->applied, 4, min_z);
+    sqlite3_bind_int64(db->applied, 5, max_z);
+
+    const int err = sqlite3_step(db->applied);
+    sqlite3_reset(db->applied);
+    if (err != SQLITE_DONE) {
+        fprintf(stderr, "sqlite3_step update FullData: (%d) %s\n", err, sqlite3_errmsg(db->db));
+        return -1;
+    }
+
+    return 0;
+}
+
+/**
+ * reads the recorded hash and mtime of a chunk.
+ * returns 1 if the chunk has a record, 0 if it doesn't and -1 on error.
+ */
+static int chunk_get(
+    const struct dh_db *db,
+    const int64_t chunk_x,
+    const int64_t chunk_z,
+    int32_t *hash,
+    int64_t *mtime
+) {
+    sqlite3_bind_int64(db->chunk_get, 1, chunk_x);
+    sqlite3_bind_int64(db->chunk_get, 2, chunk_z);
+
+    const int err = sqlite3_step(db->chunk_get);
+    if (err == SQLITE_ROW) {
+        *hash = sqlite3_column_int(db->chunk_get, 0);
+        *mtime = sqlite3_column_int64(db->chunk_get, 1);
+    }
+
+    sqlite3_reset(db->chunk_get);
+
+    if (err == SQLITE_ROW) return 1;
+    if (err == SQLITE_DONE) return 0;
+
+    fprintf(stderr, "sqlite3_step ChunkHash: (%d) %s\n", err, sqlite3_errmsg(db->db));
+    return -1;
+}
+
+/**
+ * decompresses a chunk and hashes its data.
+ */
+static int chunk_hash(
+    struct dh_db *db,
+    struct anvil_region_file *region_file,
+    struct anvil_codec *codec,
+    const int64_t chunk_x,
+    const int64_t chunk_z,
+    int32_t *hash
+) {
+    size_t len;
+    anvil_result res;
+
+    while ((res = anvil_chunk_read_ex(
+        db->chunk_buffer, db->chunk_buffer_cap, &len,
+        chunk_x, chunk_z, region_file, codec
+    )) == ANVIL_INSUFFICIENT_SPACE) {
+        size_t new_cap = db->chunk_buffer_cap * 2;
+        if (new_cap < len) new_cap = len;
+        if (new_cap < 64 * 1024) new_cap = 64 * 1024;
+
+        char *new = realloc(db->chunk_buffer, new_cap);
+        if (new == nullptr) {
+            fprintf(stderr, "chunk buffer: out of memory\n");
+            return -1;
+        }
+
+        db->chunk_buffer = new;
+        db->chunk_buffer_cap = new_cap;
+    }
+
+    if (res != ANVIL_OK) {
+        fprintf(stderr, "anvil_chunk_read (%ld, %ld): %d\n", chunk_x, chunk_z, res);
+        return -1;
+    }
+
+    *hash = (int32_t)libdeflate_crc32(0, db->chunk_buffer, len);
+    return 0;
+}
+
+int dh_db_chunks_changed(
+    struct dh_db *db,
+    struct anvil_region_file *region_file,
+    struct anvil_codec *codec,
+    const int64_t lod_x,
+    const int64_t lod_z,
+    struct dh_chunk_state *state
+) {
+    if (db == nullptr || region_file == nullptr || state == nullptr) return -1;
+
+    state->lod_x = lod_x;
+    state->lod_z = lod_z;
+    state->changed = false;
+
+    for (int64_t i = 0; i < 16; i++) {
+        const int64_t chunk_x = lod_x * 4 + i / 4;
+        const int64_t chunk_z = lod_z * 4 + i % 4;
+
+        const uint32_t mtime = anvil_chunk_mtime(region_file, chunk_x, chunk_z);
+
+        int32_t recorded_hash = 0;
+        int64_t recorded_mtime = 0;
+        const int found = chunk_get(db, chunk_x, chunk_z, &recorded_hash, &recorded_mtime);
+        if (found < 0) return -1;
+
+        state->mtime[i] = mtime;
+        state->hash[i] = recorded_hash;
+        state->stale[i] = false;
+
+        // the region header says nothing has been written since the chunk was recorded,
+        // so there's no need to look at the chunk's data.
+        if (found ? (int64_t)mtime * 1000 == recorded_mtime : mtime == 0)
+            continue;
+
+        state->stale[i] = true;
+
+        // the chunk has been removed.
+        if (mtime == 0) {
+            state->changed = true;
+            continue;
+        }
+
+        if (chunk_hash(db, region_file, codec, chunk_x, chunk_z, &state->hash[i]))
+            return -1;
+
+        // chunks are often saved without their contents changing,
+        // in which case only the mtime needs recording.
+        if (!found || state->hash[i] != recorded_hash)
+            state->changed = true;
+    }
+
+    return state->changed;
+}
+
+int dh_db_chunks_record(
+    const struct dh_db *db,
+    const struct dh_chunk_state *state
+) {
+    if (db == nullptr || state == nullptr) return -1;
+
+    // the regenerated LOD may still be waiting to be written, and the chunks mustn't be recorded unless it is.
+    if (dh_db_flush(db)) return -1;
+
+    for (int64_t i = 0; i < 16; i++) {
+        if (!state->stale[i]) continue;
+
+        const int64_t chunk_x = state->lod_x * 4 + i / 4;
+        const int64_t chunk_z = state->lod_z * 4 + i % 4;
+
+        sqlite3_stmt *stmt;
+        if (state->mtime[i] == 0) {
+            stmt = db->chunk_delete;
+            sqlite3_bind_int64(stmt, 1, chunk_x);
+            sqlite3_bind_int64(stmt, 2, chunk_z);
+        } else {
+            stmt = db->chunk_put;
+            sqlite3_bind_int64(stmt, 1, chunk_x);
+            sqlite3_bind_int64(stmt, 2, chunk_z);
+            sqlite3_bind_int(stmt, 3, state->hash[i]);
+            // DH's timestamps are in milliseconds.
+            sqlite3_bind_int64(stmt, 4, (int64_t)state->mtime[i] * 1000);
+            sqlite3_bind_int64(stmt, 5, (int64_t)state->mtime[i] * 1000);
+        }
+
+        const int err = sqlite3_step(stmt);
+        sqlite3_reset(stmt);
+        if (err != SQLITE_DONE) {
+            fprintf(stderr, "sqlite3_step ChunkHash: (%d) %s\n", err, sqlite3_errmsg(db->db));
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+int dh_db_load(
+    const struct dh_db *db,
+    const int64_t mip_level,
+    const int64_t x,
+    const int64_t z,
+    struct dh_lod *lod
+) {
+    if (db == nullptr || lod == nullptr) return -1;
+
+    // pending LODs have to be written first to be seen.
+    if (dh_db_flush(db)) return -1;
+
+    sqlite3_bind_int64(db->load, 1, mip_level);
+    sqlite3_bind_int64(db->load, 2, x);
+    sqlite3_bind_int64(db->load, 3, z);
+
+    const int err = sqlite3_step(db->load);
+
+    int res;
+    if (err == SQLITE_ROW) {
+        res = load_row(db->load, lod) ? -1 : 0;
+    } else if (err == SQLITE_DONE) {
+        res = 1;
+    } else {
+        fprintf(stderr, "sqlite3_step load FullData: (%d) %s\n", err, sqlite3_errmsg(db->db));
+        res = -1;
+    }
+
+    sqlite3_reset(db->load);
+    return res;
+}
+
+struct dh_db_cursor {
+    const struct dh_db *db;
+    sqlite3_stmt *stmt;
+};
+
+int dh_db_cursor_open(
+    struct dh_db_cursor **cursor_out,
+    const struct dh_db *db,
+    const int64_t mip_level,
+    const int64_t min_x,
+    const int64_t min_z,
+    const int64_t max_x,
+    const int64_t max_z
+) {
+    if (cursor_out == nullptr || db == nullptr) return -1;
+    if (dh_db_flush(db)) return -1;
+
+    struct dh_db_cursor *cursor = malloc(sizeof(struct dh_db_cursor));
+    if (cursor == nullptr) return -1;
+
+    cursor->db = db;
+
+    // each cursor has its own statement so several can be open at once, and alongside loads.
+    const int err = sqlite3_prepare_v2(db->db,
+        "select " LOAD_COLUMNS " from FullData "
+        "where DetailLevel = ? and PosX between ? and ? and PosZ between ? and ? "
+        "order by PosX, PosZ",
+        -1, &cursor->stmt, nullptr
+    );
+    if (err != SQLITE_OK) {
+        fprintf(stderr, "sqlite3_prepare_v2: %s\n", sqlite3_errmsg(db->db));
+        free(cursor);
+        return -1;
+    }
+
+    sqlite3_bind_int64(cursor->stmt, 1, mip_level);
+    sqlite3_bind_int64(cursor->stmt, 2, min_x);
+    sqlite3_bind_int64(cursor->stmt, 3, max_x);
+    sqlite3_bind_int64(cursor->stmt, 4, min_z);
+    sqlite3_bind_int64(cursor->stmt, 5, max_z);
+
+    *cursor_out = cursor;
+    return 0;
+}
+
+int dh_db_cursor_next(
+    struct dh_db_cursor *cursor,
+    struct dh_lod *lod
+) {
+    if (cursor == nullptr || lod == nullptr) return -1;
+
+    const int err = sqlite3_step(cursor->stmt);
+    if (err == SQLITE_DONE) return 0;
+    if (err != SQLITE_ROW) {
+        fprintf(stderr, "sqlite3_step load FullData: (%d) %s\n", err, sqlite3_errmsg(cursor->db->db));
+        return -1;
+    }
+
+    return load_row(cursor->stmt, lod) ? -1 : 1;
+}
+
+void dh_db_cursor_close(
+    struct dh_db_cursor *cursor
+) {
+    if (cursor == nullptr) return;
+
+    sqlite3_finalize(cursor->stmt);
+    free(cursor);
+}
+
+/**
+ * sql function for dh_morton, so rows can be ordered by it.
+ * sqlite only has signed integers, so the top bit is flipped to keep the order the same.
+ */
+static void sql_morton(sqlite3_context *context, int argc, sqlite3_value **argv) {
+    const uint64_t key = dh_morton(
+        sqlite3_value_int64(argv[0]),
+        sqlite3_value_int64(argv[1])
+    );
+    sqlite3_result_int64(context, (sqlite3_int64)(key ^ 1ULL << 63));
+}
+
+int dh_db_recluster(const char *path, const char *out_path) {
+    sqlite3 *db;
+
+    // VACUUM INTO takes a consistent copy of the whole database, even while DH has it open.
+    int err = sqlite3_open_v2(path, &db, SQLITE_OPEN_READONLY, nullptr);
+    if (err != SQLITE_OK) {
+        fprintf(stderr, "sqlite3_open: %s\n", sqlite3_errmsg(db));
+        sqlite3_close(db);
+        return -1;
+    }
+
+    sqlite3_stmt *stmt;
+    err = sqlite3_prepare_v2(db, "vacuum into ?", -1, &stmt, nullptr);
+    if (err == SQLITE_OK) {
+        sqlite3_bind_text(stmt, 1, out_path, -1, SQLITE_STATIC);
+        err = sqlite3_step(stmt);
+        sqlite3_finalize(stmt);
+    }
+    if (err != SQLITE_DONE) {
+        fprintf(stderr, "vacuum into %s: (%d) %s\n", out_path, err, sqlite3_errmsg(db));
+        sqlite3_close(db);
+        return -1;
+    }
+    sqlite3_close(db);
+
+    err = sqlite3_open_v2(out_path, &db, SQLITE_OPEN_READWRITE, nullptr);
+    if (err != SQLITE_OK) {
+        fprintf(stderr, "sqlite3_open: %s\n", sqlite3_errmsg(db));
+        sqlite3_close(db);
+        return -1;
+    }
+
+    err = sqlite3_create_function(
+        db, "dh_morton", 2, SQLITE_UTF8 | SQLITE_DETERMINISTIC, nullptr, sql_morton, nullptr, nullptr
+    );
+    if (err != SQLITE_OK) {
+        fprintf(stderr, "sqlite3_create_function: %s\n", sqlite3_errmsg(db));
+        sqlite3_close(db);
+        return -1;
+    }
+
+    // rows are kept in rowid order, so they are reinserted in (DetailLevel, Morton) order
+    // and the final vacuum lays their pages out in that order too.
+    if (exec_sql(db,
+        "begin; "
+        "create temp table Clustered as select * from FullData order by DetailLevel, dh_morton(PosX, PosZ); "
+        "delete from FullData; "
+        "insert into FullData select * from temp.Clustered order by rowid; "
+        "drop table temp.Clustered; "
+        "commit; "
+        "vacuum; "
+    )) {
+        exec_sql(db, "rollback");
+        sqlite3_close(db);
+        return -1;
+    }
+
+    sqlite3_close(db);
+    return 0;
+}
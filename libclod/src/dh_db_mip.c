@@ -0,0 +1,816 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <threads.h>
+
+#include <dh.h>
+#include "dh_lod.h"
+#include "os.h"
+
+#ifdef POSIX
+#include <sys/mman.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#elifdef WINDOWS
+#error "windows methods not implemented yet"
+#endif
+
+/**
+ * a child's LOD written to the spill file, as it was when it was stored.
+ */
+struct spilled {
+    uint64_t offset;
+    uint32_t data_len;
+    uint32_t mapping_len;
+    int64_t mip_level;
+    int64_t x;
+    int64_t z;
+    int64_t height;
+    int64_t min_y;
+    int64_t compression_mode;
+    int32_t checksum;
+    bool has_data;
+};
+
+/**
+ * a LOD is built from its 2x2 children, each of which is built from theirs in turn,
+ * so the LODs being built make a tree of tiles, each depending on its 4 children.
+ *
+ * a tile is ready once its children are, and ready tiles are taken from the top of a stack,
+ * so workers finish the tiles they started before moving on, as the depth first build did.
+ * top level tiles are only added once the stack runs dry, and a tile hands its LOD to its parent
+ * and is freed when it's done, so memory is bounded by the number of workers and levels, not world size.
+ * freed tiles are kept for the next, so their LODs' buffers are reused rather than allocated for every tile.
+ *
+ * while the memory budget is nearly used, top level tiles wait for the ones being built,
+ * and LODs handed to parents that are still waiting on siblings are spilled to a temporary file.
+ */
+struct tile {
+    int64_t level;
+    int64_t x;
+    int64_t z;
+
+    struct tile *parent;            // (nullable) tile this one is built into, null for top level tiles.
+    int slot;                       // position in the parent's children, in x then z order.
+
+    bool expanded;                  // children have been added.
+    int remaining;                  // children not done yet.
+    bool found[4];                  // child has data.
+    bool spilled[4];                // child's LOD is in the spill file rather than children.
+    struct dh_lod children[4];      // children's LODs, in x then z order.
+    struct spilled records[4];      // where spilled children are.
+
+    struct tile *prev, *next;       // every tile alive, so they can be freed on error.
+};
+
+struct pyramid {
+    const struct dh_db *db;
+    int64_t top_level;
+    int64_t compression_mode;
+    double compression_level;
+
+    mtx_t lock;                     // guards everything beneath.
+    cnd_t changed;                  // a tile is ready, or there is nothing left to do.
+    mtx_t db_lock;                  // the database isn't safe to use from more than one thread at once.
+
+    struct tile **ready;            // tiles that can be built or expanded, the last is taken first.
+    size_t ready_len;
+    size_t ready_cap;
+
+    struct tile *live;              // list of every tile alive.
+    struct tile *spare;             // freed tiles, linked by next, whose LODs keep their buffers.
+    unsigned busy;                  // workers building a tile.
+    bool failed;
+
+    // next top level tile to add.
+    int64_t next_x, next_z;
+    int64_t min_z, max_x, max_z;
+
+    mtx_t spill_lock;               // guards the spill file.
+    FILE *spill;                    // (nullable) made when the first LOD is spilled, and deleted when closed.
+    uint64_t spill_end;
+    const char *spill_map;          // (nullable) the file as far as it had been written when it was last mapped.
+    size_t spill_map_len;
+};
+
+/**
+ * per worker state, kept between tiles so buffers and codec contexts are reused.
+ */
+struct worker {
+    struct pyramid *p;
+    struct anvil_codec *codec;      // (nullable)
+    bool owns_codec;
+
+    struct dh_lod src[4];           // children being combined, in x then z order.
+    struct dh_lod out;              // LOD being built, before it's handed to its parent.
+    struct dh_lod empty;            // stands in for children with no data beneath them.
+    struct spilled spilled;         // where out was written, if it was spilled instead of handed over.
+};
+
+/**
+ * fills the empty LOD with 64x64 columns that have no datapoints.
+ */
+static int make_empty(struct dh_lod *empty) {
+    const size_t len = 64 * 64 * 2;
+    if (empty->lod_cap < len) {
+        char *new = empty->realloc(empty->lod_arr, len);
+        if (new == nullptr) return -1;
+        empty->lod_arr = new;
+        empty->lod_cap = len;
+    }
+
+    memset(empty->lod_arr, 0, len);
+    empty->lod_len = len;
+    empty->mapping_len = 0;
+    empty->compression_mode = DH_DATA_COMPRESSION_UNCOMPRESSED;
+    empty->has_data = false;
+    return 0;
+}
+
+/**
+ * swaps the data of two LODs, leaving each with its own internal state.
+ * both have to be serialised, as their host forms and column offsets stay behind with the rest of it.
+ */
+static void swap_lod(struct dh_lod *a, struct dh_lod *b) {
+    dh_lod_data_replaced(a);
+    dh_lod_data_replaced(b);
+
+    const struct dh_lod tmp = *a;
+
+    *a = *b;
+    a->realloc = tmp.realloc;
+    a->__internal = tmp.__internal;
+
+    void *(*b_realloc)(void*, size_t) = b->realloc;
+    void *b_internal = b->__internal;
+    *b = tmp;
+    b->realloc = b_realloc;
+    b->__internal = b_internal;
+}
+
+static struct tile *new_tile(
+    struct pyramid *p,
+    const int64_t level,
+    const int64_t x,
+    const int64_t z,
+    struct tile *parent,
+    const int slot
+) {
+    struct tile *tile = p->spare;
+    struct dh_lod children[4];
+
+    if (tile != nullptr) {
+        p->spare = tile->next;
+        for (int i = 0; i < 4; i++) {
+            const int dx = i >> 1, dz = i & 1;
+            dh_lod_recycle(&tile->children[i], level - 1, x * 2 + dx, z * 2 + dz);
+        }
+        memcpy(children, tile->children, sizeof(children));
+    } else {
+        tile = malloc(sizeof(*tile));
+        if (tile == nullptr) return nullptr;
+
+        for (int i = 0; i < 4; i++) {
+            children[i] = DH_LOD_CLEAR;
+            children[i].realloc = dh_budget_realloc;
+        }
+    }
+
+    *tile = (struct tile){
+        .level = level,
+        .x = x,
+        .z = z,
+        .parent = parent,
+        .slot = slot,
+        .prev = nullptr,
+        .next = p->live,
+    };
+    memcpy(tile->children, children, sizeof(children));
+
+    if (p->live != nullptr) p->live->prev = tile;
+    p->live = tile;
+    return tile;
+}
+
+static void free_tile(struct pyramid *p, struct tile *tile) {
+    if (tile->prev != nullptr) tile->prev->next = tile->next;
+    else p->live = tile->next;
+    if (tile->next != nullptr) tile->next->prev = tile->prev;
+
+    // while memory is short, nothing is kept that isn't needed.
+    if (dh_budget_near()) {
+        for (int i = 0; i < 4; i++) dh_lod_free(&tile->children[i]);
+        free(tile);
+        return;
+    }
+
+    tile->next = p->spare;
+    p->spare = tile;
+}
+
+static int push_ready(struct pyramid *p, struct tile *tile) {
+    if (p->ready_len == p->ready_cap) {
+        const size_t cap = p->ready_cap ? p->ready_cap * 2 : 64;
+        struct tile **new = realloc(p->ready, sizeof(*new) * cap);
+        if (new == nullptr) return -1;
+        p->ready = new;
+        p->ready_cap = cap;
+    }
+
+    p->ready[p->ready_len++] = tile;
+    return 0;
+}
+
+/**
+ * takes the next tile to work on, adding the next top level tile if none are ready.
+ * returns null if there are none left to add, or if memory is short and tiles are still being built.
+ */
+static struct tile *take_ready(struct pyramid *p) {
+    if (p->ready_len > 0) return p->ready[--p->ready_len];
+    if (p->next_x > p->max_x) return nullptr;
+
+    // every live tile is being built or waiting on one that is, so one finishing wakes us up.
+    if (p->live != nullptr && dh_budget_near()) return nullptr;
+
+    struct tile *tile = new_tile(p, p->top_level, p->next_x, p->next_z, nullptr, 0);
+    if (tile == nullptr) {
+        p->failed = true;
+        return nullptr;
+    }
+
+    if (p->next_z++ == p->max_z) {
+        p->next_z = p->min_z;
+        p->next_x++;
+    }
+
+    return tile;
+}
+
+/**
+ * adds a tile's children, so they're taken in Morton order.
+ */
+static int expand(struct pyramid *p, struct tile *tile) {
+    tile->expanded = true;
+    tile->remaining = 4;
+
+    for (int i = 3; i >= 0; i--) {
+        const int dx = i & 1, dz = i >> 1;
+
+        struct tile *child = new_tile(p, tile->level - 1, tile->x * 2 + dx, tile->z * 2 + dz, tile, dx * 2 + dz);
+        if (child == nullptr || push_ready(p, child)) return -1;
+    }
+
+    return 0;
+}
+
+/**
+ * appends the worker's out LOD to the spill file, recording where it went in the worker.
+ * the LOD has to have been stored, so its data and mapping are serialised and compressed.
+ */
+static int spill(struct worker *w) {
+    struct pyramid *p = w->p;
+    const struct dh_lod *lod = &w->out;
+
+    size_t mapping_len;
+    char *mapping;
+    if (dh_lod_serialise_mapping(&w->out, &mapping, &mapping_len) != DH_OK) return -1;
+
+    mtx_lock(&p->spill_lock);
+    if (p->spill == nullptr && (p->spill = tmpfile()) == nullptr) {
+        fprintf(stderr, "creating spill file: %s\n", strerror(errno));
+        mtx_unlock(&p->spill_lock);
+        return -1;
+    }
+
+    const struct iovec iov[2] = {
+        { lod->lod_arr, lod->lod_len },
+        { mapping, mapping_len },
+    };
+    const ssize_t len = lod->lod_len + mapping_len;
+    if (pwritev(fileno(p->spill), iov, 2, (off_t)p->spill_end) != len) {
+        fprintf(stderr, "write spill file: %s\n", strerror(errno));
+        mtx_unlock(&p->spill_lock);
+        return -1;
+    }
+
+    w->spilled = (struct spilled){
+        .offset = p->spill_end,
+        .data_len = (uint32_t)lod->lod_len,
+        .mapping_len = (uint32_t)mapping_len,
+        .mip_level = lod->mip_level,
+        .x = lod->x,
+        .z = lod->z,
+        .height = lod->height,
+        .min_y = lod->min_y,
+        .compression_mode = lod->compression_mode,
+        .checksum = lod->checksum,
+        .has_data = lod->has_data,
+    };
+    p->spill_end += len;
+
+    mtx_unlock(&p->spill_lock);
+    return 0;
+}
+
+/**
+ * reads a spilled LOD back into lod, mapping the spill file again if it's grown past it.
+ */
+static int unspill(struct pyramid *p, const struct spilled *record, struct dh_lod *lod) {
+    mtx_lock(&p->spill_lock);
+
+    const uint64_t end = record->offset + record->data_len + record->mapping_len;
+    if (end > p->spill_map_len) {
+        if (p->spill_map != nullptr) munmap((void*)p->spill_map, p->spill_map_len);
+        p->spill_map = nullptr;
+        p->spill_map_len = 0;
+
+        void *map = mmap(nullptr, p->spill_end, PROT_READ, MAP_SHARED, fileno(p->spill), 0);
+        if (map == MAP_FAILED) {
+            fprintf(stderr, "mmap spill file: %s\n", strerror(errno));
+            mtx_unlock(&p->spill_lock);
+            return -1;
+        }
+
+        p->spill_map = map;
+        p->spill_map_len = p->spill_end;
+    }
+
+    const char *data = p->spill_map + record->offset;
+
+    lod->mip_level = record->mip_level;
+    lod->x = record->x;
+    lod->z = record->z;
+    lod->height = record->height;
+    lod->min_y = record->min_y;
+    lod->compression_mode = record->compression_mode;
+    lod->checksum = record->checksum;
+    lod->has_data = record->has_data;
+
+    const dh_result res = dh_lod_load_stored(lod, data, record->data_len, data + record->data_len, record->mapping_len);
+    mtx_unlock(&p->spill_lock);
+
+    if (res != DH_OK) {
+        fprintf(stderr, "loading spilled LOD: %d\n", res);
+        return -1;
+    }
+
+    return 0;
+}
+
+/**
+ * builds a tile's LOD into the worker's out LOD from its children, and stores it.
+ * level 1 tiles load their children from the database instead.
+ * it returns 1 if the LOD was built, 2 if it was built and spilled, 0 if there's no data beneath it and -1 on error.
+ */
+static int build(struct worker *w, struct tile *tile) {
+    const struct pyramid *p = w->p;
+    struct dh_lod *src[4] = {nullptr, nullptr, nullptr, nullptr};
+    struct dh_lod *found = nullptr;
+
+    if (tile->level == 1) {
+        mtx_lock(&w->p->db_lock);
+        for (int i = 0; i < 4; i++) {
+            const int dx = i >> 1, dz = i & 1;
+
+            const int res = dh_db_load(p->db, 0, tile->x * 2 + dx, tile->z * 2 + dz, &w->src[i]);
+            if (res < 0) {
+                mtx_unlock(&w->p->db_lock);
+                return -1;
+            }
+            if (res == 0) src[i] = found = &w->src[i];
+        }
+        mtx_unlock(&w->p->db_lock);
+    } else {
+        for (int i = 0; i < 4; i++) {
+            if (!tile->found[i]) continue;
+
+            // the worker's LODs keep their buffers for decompressing into.
+            if (tile->spilled[i]) {
+                if (unspill(w->p, &tile->records[i], &w->src[i])) return -1;
+            } else {
+                swap_lod(&w->src[i], &tile->children[i]);
+            }
+            src[i] = found = &w->src[i];
+        }
+    }
+
+    if (found == nullptr) return 0;
+
+    w->empty.mip_level = tile->level - 1;
+    w->empty.min_y = found->min_y;
+    for (int i = 0; i < 4; i++) if (src[i] == nullptr) src[i] = &w->empty;
+
+    struct dh_lod *out = &w->out;
+    dh_result result = dh_lod_mip_ex(out, tile->level, src, 4, w->codec);
+    if (result != DH_OK) {
+        fprintf(stderr, "dh_lod_mip (%ld, %ld, %ld): %d\n", tile->level, tile->x, tile->z, result);
+        return -1;
+    }
+
+    out->x = tile->x;
+    out->z = tile->z;
+    out->mip_level = tile->level;
+
+    result = dh_compress_ex(out, p->compression_mode, p->compression_level, w->codec);
+    if (result != DH_OK) {
+        fprintf(stderr, "dh_compress (%ld, %ld, %ld): %d\n", tile->level, tile->x, tile->z, result);
+        return -1;
+    }
+
+    // only the top level needs DH to carry it further up, everything beneath it is up to date.
+    mtx_lock(&w->p->db_lock);
+    int err = dh_db_store_mip(p->db, out, tile->level == p->top_level);
+    if (err == 0) err = dh_db_applied(p->db, tile->level - 1, tile->x * 2, tile->z * 2, tile->x * 2 + 1, tile->z * 2 + 1);
+    mtx_unlock(&w->p->db_lock);
+    if (err) return -1;
+
+    // the LOD stays with the worker, whose buffers are reused for the next.
+    if (tile->parent != nullptr && dh_budget_near()) return spill(w) ? -1 : 2;
+    return 1;
+}
+
+/**
+ * hands a built tile's LOD to its parent, and readies the parent if it was the last child.
+ */
+static int finish(struct worker *w, struct tile *tile, const int built) {
+    struct pyramid *p = w->p;
+    struct tile *parent = tile->parent;
+    const int slot = tile->slot;
+    free_tile(p, tile);
+
+    if (parent == nullptr) return 0;
+
+    if (built == 2) {
+        parent->records[slot] = w->spilled;
+        parent->spilled[slot] = true;
+    } else if (built) {
+        swap_lod(&parent->children[slot], &w->out);
+    }
+    parent->found[slot] = built > 0;
+
+    if (--parent->remaining > 0) return 0;
+    return push_ready(p, parent);
+}
+
+static int work(void *arg) {
+    struct worker *w = arg;
+    struct pyramid *p = w->p;
+
+    mtx_lock(&p->lock);
+    while (!p->failed) {
+        struct tile *tile = take_ready(p);
+        if (tile == nullptr) {
+            if (p->failed || p->busy == 0) break;
+
+            // tiles still being built may ready their parents.
+            cnd_wait(&p->changed, &p->lock);
+            continue;
+        }
+
+        if (tile->level > 1 && !tile->expanded) {
+            if (expand(p, tile)) p->failed = true;
+            cnd_broadcast(&p->changed);
+            continue;
+        }
+
+        p->busy++;
+        mtx_unlock(&p->lock);
+
+        const int res = build(w, tile);
+
+        mtx_lock(&p->lock);
+        p->busy--;
+
+        if (res < 0 || finish(w, tile, res)) p->failed = true;
+        cnd_broadcast(&p->changed);
+    }
+
+    cnd_broadcast(&p->changed);
+    mtx_unlock(&p->lock);
+    return 0;
+}
+
+static int open_worker(struct worker *w, struct pyramid *p, struct anvil_codec *codec, const bool own_codec) {
+    *w = (struct worker){ .p = p, .codec = codec, .owns_codec = false };
+    for (int i = 0; i < 4; i++) {
+        w->src[i] = DH_LOD_CLEAR;
+        w->src[i].realloc = dh_budget_realloc;
+    }
+    w->out = DH_LOD_CLEAR;
+    w->out.realloc = dh_budget_realloc;
+    w->empty = DH_LOD_CLEAR;
+    w->empty.realloc = dh_budget_realloc;
+
+    // codecs aren't thread safe, every worker other than the calling thread's has its own.
+    // without one, each LOD makes its own contexts.
+    if (own_codec) w->owns_codec = anvil_codec_open(&w->codec, nullptr) == ANVIL_OK;
+    if (own_codec && !w->owns_codec) w->codec = nullptr;
+
+    return make_empty(&w->empty);
+}
+
+static void close_worker(struct worker *w) {
+    for (int i = 0; i < 4; i++) dh_lod_free(&w->src[i]);
+    dh_lod_free(&w->out);
+    dh_lod_free(&w->empty);
+    if (w->owns_codec) anvil_codec_close(w->codec);
+}
+
+int dh_db_build_mips(
+    const struct dh_db *db,
+    const int64_t top_level,
+    const int64_t min_x,
+    const int64_t min_z,
+    const int64_t max_x,
+    const int64_t max_z,
+    const int64_t compression_mode,
+    const double compression_level,
+    struct anvil_codec *codec
+) {
+    return dh_db_build_mips_ex(
+        db, top_level, min_x, min_z, max_x, max_z,
+        compression_mode, compression_level, codec, 1
+    );
+}
+
+int dh_db_build_mips_ex(
+    const struct dh_db *db,
+    const int64_t top_level,
+    const int64_t min_x,
+    const int64_t min_z,
+    const int64_t max_x,
+    const int64_t max_z,
+    const int64_t compression_mode,
+    const double compression_level,
+    struct anvil_codec *codec,
+    unsigned threads
+) {
+    if (db == nullptr || top_level < 1 || top_level > 32 || min_x > max_x || min_z > max_z) {
+        fprintf(stderr, "dh_db_build_mips: invalid argument\n");
+        return -1;
+    }
+
+    if (threads == 0) threads = 1;
+
+    struct pyramid p = {
+        .db = db,
+        .top_level = top_level,
+        .compression_mode = compression_mode,
+        .compression_level = compression_level,
+        .ready = nullptr,
+        .ready_len = 0,
+        .ready_cap = 0,
+        .live = nullptr,
+        .spare = nullptr,
+        .busy = 0,
+        .failed = false,
+        .next_x = dh_floor_shift(min_x, top_level),
+        .next_z = dh_floor_shift(min_z, top_level),
+        .min_z = dh_floor_shift(min_z, top_level),
+        .max_x = dh_floor_shift(max_x, top_level),
+        .max_z = dh_floor_shift(max_z, top_level),
+        .spill = nullptr,
+        .spill_end = 0,
+        .spill_map = nullptr,
+        .spill_map_len = 0,
+    };
+
+    if (mtx_init(&p.lock, mtx_plain) != thrd_success) return -1;
+    if (mtx_init(&p.db_lock, mtx_plain) != thrd_success) {
+        mtx_destroy(&p.lock);
+        return -1;
+    }
+    if (mtx_init(&p.spill_lock, mtx_plain) != thrd_success) {
+        mtx_destroy(&p.db_lock);
+        mtx_destroy(&p.lock);
+        return -1;
+    }
+    if (cnd_init(&p.changed) != thrd_success) {
+        mtx_destroy(&p.spill_lock);
+        mtx_destroy(&p.db_lock);
+        mtx_destroy(&p.lock);
+        return -1;
+    }
+
+    struct worker *workers = malloc(sizeof(struct worker) * threads);
+    thrd_t *handles = malloc(sizeof(thrd_t) * threads);
+    int err = workers == nullptr || handles == nullptr ? -1 : 0;
+
+    unsigned opened = 0;
+    while (err == 0 && opened < threads) {
+        if (open_worker(&workers[opened], &p, codec, opened > 0)) err = -1;
+        opened++;
+    }
+
+    // the calling thread is one of the workers.
+    // if threads can't be made we just get on with it with fewer.
+    unsigned started = 1;
+    if (err == 0) {
+        while (started < threads && thrd_create(&handles[started], work, &workers[started]) == thrd_success)
+            started++;
+
+        work(&workers[0]);
+
+        for (unsigned i = 1; i < started; i++) {
+            thrd_join(handles[i], nullptr);
+        }
+
+        if (p.failed) err = -1;
+    }
+
+    while (p.live != nullptr) free_tile(&p, p.live);
+    while (p.spare != nullptr) {
+        struct tile *tile = p.spare;
+        p.spare = tile->next;
+        for (int i = 0; i < 4; i++) dh_lod_free(&tile->children[i]);
+        free(tile);
+    }
+    for (unsigned i = 0; i < opened; i++) close_worker(&workers[i]);
+    free(workers);
+    free(handles);
+    free(p.ready);
+
+    if (p.spill_map != nullptr) munmap((void*)p.spill_map, p.spill_map_len);
+    if (p.spill != nullptr) fclose(p.spill);
+
+    cnd_destroy(&p.changed);
+    mtx_destroy(&p.spill_lock);
+    mtx_destroy(&p.db_lock);
+    mtx_destroy(&p.lock);
+
+    return err;
+}
+
+struct mip_any_sources {
+    struct dh_db_cursor *cursor;
+    size_t count;
+};
+
+static int next_source(struct dh_lod *src, void *user) {
+    struct mip_any_sources *sources = user;
+
+    const int res = dh_db_cursor_next(sources->cursor, src);
+    if (res > 0) sources->count++;
+    return res;
+}
+
+int dh_db_mip_any(
+    const struct dh_db *db,
+    const int64_t mip_level,
+    const int64_t x,
+    const int64_t z,
+    const int64_t source_level,
+    struct dh_lod *lod,
+    struct anvil_codec *codec
+) {
+    if (db == nullptr || lod == nullptr || source_level < 0 || source_level >= mip_level || mip_level > 32) {
+        fprintf(stderr, "dh_db_mip_any: invalid argument\n");
+        return -1;
+    }
+
+    const int64_t shift = mip_level - source_level;
+    const int64_t min_x = x * (1LL << shift), min_z = z * (1LL << shift);
+    const int64_t max_x = min_x + (1LL << shift) - 1, max_z = min_z + (1LL << shift) - 1;
+
+    struct mip_any_sources sources = { .cursor = nullptr, .count = 0 };
+    if (dh_db_cursor_open(&sources.cursor, db, source_level, min_x, min_z, max_x, max_z)) return -1;
+
+    const dh_result result = dh_lod_mip_stream(lod, mip_level, x, z, next_source, &sources, codec);
+    dh_db_cursor_close(sources.cursor);
+
+    if (result != DH_OK) {
+        fprintf(stderr, "dh_lod_mip_stream (%ld, %ld, %ld): %d\n", mip_level, x, z, result);
+        return -1;
+    }
+
+    return sources.count == 0;
+}
+
+int dh_db_update_region(
+    struct dh_db *db,
+    struct anvil_region_file *region_file,
+    const int64_t region_x,
+    const int64_t region_z,
+    const int64_t top_level,
+    const int64_t compression_mode,
+    const double compression_level,
+    struct anvil_codec *codec,
+    dh_result (*generate)(int64_t lod_x, int64_t lod_z, struct dh_lod *lod, void *user),
+    void *user
+) {
+    return dh_db_update_region_ex(
+        db, region_file, region_x, region_z, top_level,
+        compression_mode, compression_level, codec, generate, user, nullptr
+    );
+}
+
+int dh_db_update_region_ex(
+    struct dh_db *db,
+    struct anvil_region_file *region_file,
+    const int64_t region_x,
+    const int64_t region_z,
+    const int64_t top_level,
+    const int64_t compression_mode,
+    const double compression_level,
+    struct anvil_codec *codec,
+    dh_result (*generate)(int64_t lod_x, int64_t lod_z, struct dh_lod *lod, void *user),
+    void *user,
+    struct dh_lod_pool *pool
+) {
+    if (db == nullptr || region_file == nullptr || generate == nullptr || top_level < 0 || top_level > 32) {
+        fprintf(stderr, "dh_db_update_region: invalid argument\n");
+        return -1;
+    }
+
+    // a region is 32x32 chunks, making 8x8 LODs.
+    struct dh_chunk_state states[64];
+    int64_t xs[64], zs[64];
+    size_t changed = 0;
+
+    struct dh_lod local = DH_LOD_CLEAR;
+    struct dh_lod *lod = &local;
+    if (pool != nullptr) {
+        lod = dh_lod_pool_take(pool, 0, region_x * 8, region_z * 8);
+        if (lod == nullptr) {
+            fprintf(stderr, "dh_db_update_region: allocating LOD\n");
+            return -1;
+        }
+    }
+    int ret = -1;
+
+    for (int64_t i = 0; i < 64; i++) {
+        const int64_t lod_x = region_x * 8 + i / 8;
+        const int64_t lod_z = region_z * 8 + i % 8;
+
+        const int res = dh_db_chunks_changed(db, region_file, codec, lod_x, lod_z, &states[i]);
+        if (res < 0) goto cleanup;
+        if (res == 0) continue;
+
+        dh_lod_recycle(lod, 0, lod_x, lod_z);
+        dh_result result = generate(lod_x, lod_z, lod, user);
+        if (result != DH_OK) {
+            fprintf(stderr, "generating LOD (%ld, %ld): %d\n", lod_x, lod_z, result);
+            goto cleanup;
+        }
+
+        result = dh_compress_ex(lod, compression_mode, compression_level, codec);
+        if (result != DH_OK) {
+            fprintf(stderr, "dh_compress (0, %ld, %ld): %d\n", lod_x, lod_z, result);
+            goto cleanup;
+        }
+
+        if (dh_db_store_ex(db, lod, true)) goto cleanup;
+
+        xs[changed] = lod_x;
+        zs[changed] = lod_z;
+        changed++;
+    }
+
+    // recording flushes the LODs first, so chunks are only recorded once what was made from them is written.
+    // unchanged LODs may still have chunks with new mtimes to record.
+    for (size_t i = 0; i < 64; i++) {
+        if (dh_db_chunks_record(db, &states[i])) goto cleanup;
+    }
+
+    // only the ancestors of changed LODs are rebuilt, a level at a time, each from the one beneath it.
+    // if this fails, the LODs beneath still have ApplyToParent set, so DH rebuilds them instead.
+    size_t num_positions = changed;
+    for (int64_t level = 1; level <= top_level && num_positions > 0; level++) {
+        size_t num_parents = 0;
+        for (size_t i = 0; i < num_positions; i++) {
+            const int64_t x = dh_floor_shift(xs[i], 1), z = dh_floor_shift(zs[i], 1);
+
+            size_t j = 0;
+            while (j < num_parents && (xs[j] != x || zs[j] != z)) j++;
+            if (j < num_parents) continue;
+
+            xs[num_parents] = x;
+            zs[num_parents] = z;
+            num_parents++;
+        }
+        num_positions = num_parents;
+
+        for (size_t i = 0; i < num_positions; i++) {
+            const int res = dh_db_mip_any(db, level, xs[i], zs[i], level - 1, lod, codec);
+            if (res < 0) goto cleanup;
+            if (res == 1) continue;
+
+            const dh_result result = dh_compress_ex(lod, compression_mode, compression_level, codec);
+            if (result != DH_OK) {
+                fprintf(stderr, "dh_compress (%ld, %ld, %ld): %d\n", level, xs[i], zs[i], result);
+                goto cleanup;
+            }
+
+            if (dh_db_store_mip(db, lod, level == top_level)) goto cleanup;
+            if (dh_db_applied(db, level - 1, xs[i] * 2, zs[i] * 2, xs[i] * 2 + 1, zs[i] * 2 + 1)) goto cleanup;
+        }
+    }
+
+    ret = (int)changed;
+
+cleanup:
+    if (pool != nullptr) dh_lod_pool_give(pool, lod);
+    else dh_lod_free(lod);
+    return ret;
+}
@@ -1,4 +1,5 @@
 #include <stdlib.h>
+#include <libdeflate.h>
 
 #include <anvil.h>
 #include <nbt.h>
@@ -6,6 +7,7 @@
 
 #include "compress.h"
 #include "dh_lod.h"
+#include "generated/index.h"
 
 int dh_compare_strings(const void *str1_ptr, const void *str2_ptr) {
     const char *str1 = *(char**)str1_ptr; const char *str2 = *(char**)str2_ptr;
@@ -110,15 +112,34 @@ void dh_lod_ext_free(struct dh_lod *lod) {
 
     for (int64_t i = 0; i < 4; i++) {
         if (ext->id_lookup[i].sections != nullptr) {
-            for (int64_t j = 0; j < ext->id_lookup->sections_cap; j++) {
+            for (size_t j = 0; j < ext->id_lookup[i].sections_cap; j++) {
                 lod->realloc(ext->id_lookup[i].sections[j].ids, 0);
             }
             lod->realloc(ext->id_lookup[i].sections, 0);
         }
     }
 
+    if (ext->planar_buffer != nullptr) lod->realloc(ext->planar_buffer, 0);
+    if (ext->beacons != nullptr) lod->realloc(ext->beacons, 0);
+
+    if (ext->mip.column_start != nullptr) lod->realloc(ext->mip.column_start, 0);
+    if (ext->mip.top != nullptr) lod->realloc(ext->mip.top, 0);
+    if (ext->mip.bottom != nullptr) lod->realloc(ext->mip.bottom, 0);
+    if (ext->mip.id != nullptr) lod->realloc(ext->mip.id, 0);
+    if (ext->mip.light != nullptr) lod->realloc(ext->mip.light, 0);
+    if (ext->mip.events != nullptr) lod->realloc(ext->mip.events, 0);
+    if (ext->mip.buckets != nullptr) lod->realloc(ext->mip.buckets, 0);
+    if (ext->mip.id_count != nullptr) lod->realloc(ext->mip.id_count, 0);
+    if (ext->mip.active_ids != nullptr) lod->realloc(ext->mip.active_ids, 0);
+    if (ext->mip.active_index != nullptr) lod->realloc(ext->mip.active_index, 0);
+    if (ext->mip.id_air != nullptr) lod->realloc(ext->mip.id_air, 0);
+    dh_lod_host_free(&ext->host, lod->realloc);
+    if (ext->column_offsets != nullptr) lod->realloc(ext->column_offsets, 0);
+
     if (ext->lzma_ctx != nullptr) compress_free_lzma(&ext->lzma_ctx, lod->realloc);
     if (ext->lz4_ctx != nullptr) compress_free_lz4(&ext->lz4_ctx, lod->realloc);
+    if (ext->lzma_dctx != nullptr) decompress_free_lzma(&ext->lzma_dctx, lod->realloc);
+    if (ext->lz4_dctx != nullptr) decompress_free_lz4(&ext->lz4_dctx, lod->realloc);
 
     lod->realloc(ext, 0);
     lod->__internal = nullptr;
@@ -155,7 +176,8 @@ dh_result dh_lod_merge_mappings(
         res = dh_lod_add_mapping(
             dst,
             src->mapping_arr[i],
-            strlen(src->mapping_arr[i]),
+            // mappings are stored with their terminator.
+            strlen(src->mapping_arr[i]) + 1,
             &id_mapping[i]
         );
 
@@ -218,6 +240,114 @@ dh_result dh_lod_ensure(
     return DH_OK;
 }
 
+dh_result dh_lod_load_stored(
+    struct dh_lod *lod,
+    const char *data,
+    const size_t data_len,
+    const char *mapping,
+    const size_t mapping_len
+) {
+    if (lod->realloc == nullptr) lod->realloc = realloc;
+
+    lod->lod_len = 0;
+    const dh_result res = dh_lod_ensure(lod, data_len);
+    if (res != DH_OK) return res;
+
+    if (data_len > 0) memcpy(lod->lod_arr, data, data_len);
+    lod->lod_len = data_len;
+
+    return dh_lod_deserialise_mapping(lod, mapping, mapping_len);
+}
+
+dh_result dh_lod_row_constants(
+    const int64_t compression_mode,
+    const void **gen_step,
+    size_t *gen_step_len,
+    const void **world_compression,
+    size_t *world_compression_len
+) {
+    switch (compression_mode) {
+    case DH_DATA_COMPRESSION_UNCOMPRESSED:
+        *gen_step = dh_constants__gen_step;
+        *gen_step_len = sizeof(dh_constants__gen_step);
+        *world_compression = dh_constants__compression_mode;
+        *world_compression_len = sizeof(dh_constants__compression_mode);
+        return DH_OK;
+    case DH_DATA_COMPRESSION_LZ4:
+        *gen_step = dh_constants__gen_step__lz4;
+        *gen_step_len = sizeof(dh_constants__gen_step__lz4);
+        *world_compression = dh_constants__compression_mode__lz4;
+        *world_compression_len = sizeof(dh_constants__compression_mode__lz4);
+        return DH_OK;
+    case DH_DATA_COMPRESSION_LZMA2:
+        *gen_step = dh_constants__gen_step__lzma;
+        *gen_step_len = sizeof(dh_constants__gen_step__lzma);
+        *world_compression = dh_constants__compression_mode__lzma;
+        *world_compression_len = sizeof(dh_constants__compression_mode__lzma);
+        return DH_OK;
+    default:
+        return DH_ERR_UNSUPPORTED;
+    }
+}
+
+int32_t dh_lod_checksum(
+    const char *data,
+    const size_t len
+) {
+    return (int32_t)libdeflate_crc32(0, data, len);
+}
+
+dh_result dh_lod_verify(
+    struct dh_lod *lod,
+    struct anvil_codec *codec
+) {
+    if (lod == nullptr) return DH_ERR_INVALID_ARGUMENT;
+
+    struct dh_column_iter *iter;
+    dh_result res = dh_column_iter_open(&iter, lod, codec);
+    if (res != DH_OK) return res;
+
+    uint32_t crc = 0;
+    size_t columns = 0;
+    const char *datapoints;
+    size_t num_datapoints;
+    while ((res = dh_column_iter_next(iter, &datapoints, &num_datapoints)) == DH_OK) {
+        // a datapoint whose id isn't in the mapping can't be drawn, whatever the checksum says.
+        for (size_t i = 0; i < num_datapoints && res == DH_OK; i++) {
+            if (DP_ID(dp_read(datapoints + i * 8)) >= lod->mapping_len) res = DH_ERR_MALFORMED;
+        }
+        if (res != DH_OK) break;
+
+        // columns are contiguous with their 2 byte length.
+        crc = libdeflate_crc32(crc, datapoints - 2, 2 + num_datapoints * 8);
+        columns++;
+    }
+
+    dh_column_iter_close(iter);
+
+    if (res != DH_DONE) return res;
+
+    // data cut off between two columns still reads as whole columns.
+    if (columns != 0 && columns != 64 * 64) return DH_ERR_MALFORMED;
+    if ((int32_t)crc != lod->checksum) return DH_ERR_MALFORMED;
+    return DH_OK;
+}
+
+dh_result dh_lod_beacons(
+    struct dh_lod *lod,
+    const struct dh_beacon **beacons,
+    size_t *num_beacons
+) {
+    if (lod == nullptr || beacons == nullptr || num_beacons == nullptr) return DH_ERR_INVALID_ARGUMENT;
+
+    const struct dh_lod_ext *ext = lod->__internal;
+    if (ext == nullptr || !ext->beacons_valid) return DH_ERR_UNSUPPORTED;
+
+    *beacons = ext->beacons;
+    *num_beacons = ext->beacons_len;
+    return DH_OK;
+}
+
 dh_result dh_lod_serialise_mapping(
     struct dh_lod *lod,
     char **out,
@@ -241,8 +371,8 @@ dh_result dh_lod_serialise_mapping(
         }\
 
     ensure_buffer(4);
-    ext->temp_buffer[(*n_bytes)++] = (char)((lod->mapping_len >> (2 * 8)) & 0xFF);
     ext->temp_buffer[(*n_bytes)++] = (char)((lod->mapping_len >> (3 * 8)) & 0xFF);
+    ext->temp_buffer[(*n_bytes)++] = (char)((lod->mapping_len >> (2 * 8)) & 0xFF);
     ext->temp_buffer[(*n_bytes)++] = (char)((lod->mapping_len >> (1 * 8)) & 0xFF);
     ext->temp_buffer[(*n_bytes)++] = (char)((lod->mapping_len >> (0 * 8)) & 0xFF);
     
@@ -261,7 +391,7 @@ dh_result dh_lod_serialise_mapping(
 
     #undef ensure_buffer
 
-    switch (lod->compression_mode) {
+    switch (lod->compression_mode & DH_DATA_COMPRESSION_MODE_MASK) {
     case DH_DATA_COMPRESSION_UNCOMPRESSED: {
         *out = ext->temp_buffer;
         return DH_OK;
@@ -323,40 +453,227 @@ dh_result dh_lod_serialise_mapping(
     }
 }
 
+/**
+ * parses an uncompressed mapping, reusing the LOD's mapping strings where it can.
+ */
+static dh_result dh_lod_deserialise_mapping_raw(
+    struct dh_lod *lod,
+    const char *in,
+    const size_t in_len
+) {
+    if (in_len < 4) return DH_ERR_MALFORMED;
+
+    const size_t mapping_len =
+        (size_t)(uint8_t)in[0] << 24 |
+        (size_t)(uint8_t)in[1] << 16 |
+        (size_t)(uint8_t)in[2] << 8  |
+        (size_t)(uint8_t)in[3] ;
+
+    // every entry takes at least 2 bytes, which bounds the allocation below.
+    if (mapping_len > (in_len - 4) / 2) return DH_ERR_MALFORMED;
+
+    if (lod->mapping_cap < mapping_len) {
+        char **new = lod->realloc(lod->mapping_arr, mapping_len * sizeof(char*));
+        if (new == nullptr) return DH_ERR_ALLOC;
+
+        for (size_t i = lod->mapping_cap; i < mapping_len; i++) new[i] = nullptr;
+        lod->mapping_arr = new;
+        lod->mapping_cap = mapping_len;
+    }
+
+    lod->mapping_len = 0;
+
+    size_t offset = 4;
+    for (size_t i = 0; i < mapping_len; i++) {
+        if (offset + 2 > in_len) return DH_ERR_MALFORMED;
+
+        const size_t size = (size_t)(uint8_t)in[offset] << 8 | (size_t)(uint8_t)in[offset + 1];
+        offset += 2;
+
+        if (offset + size > in_len) return DH_ERR_MALFORMED;
+
+        char *new = lod->realloc(lod->mapping_arr[i], size + 1);
+        if (new == nullptr) return DH_ERR_ALLOC;
+
+        memcpy(new, in + offset, size);
+        new[size] = '\0';
+        lod->mapping_arr[i] = new;
+        lod->mapping_len++;
+
+        offset += size;
+    }
+
+    return DH_OK;
+}
+
+dh_result dh_lod_deserialise_mapping(
+    struct dh_lod *lod,
+    const char *in,
+    const size_t in_len
+) {
+    if (lod == nullptr || (in == nullptr && in_len > 0)) return DH_ERR_INVALID_ARGUMENT;
+
+    struct dh_lod_ext *ext;
+    dh_result res = dh_lod_ext_get(lod, &ext);
+    if (res != DH_OK) return res;
+
+    // every loaded LOD replaces its mapping, so the beacons, host form and column offsets of whatever the LOD held before are gone too.
+    ext->beacons_valid = false;
+    dh_lod_data_replaced(lod);
+
+    // the mapping is compressed the same way as the LOD data.
+    switch (lod->compression_mode & DH_DATA_COMPRESSION_MODE_MASK) {
+    case DH_DATA_COMPRESSION_UNCOMPRESSED: {
+        break;
+    }
+    case DH_DATA_COMPRESSION_LZ4: {
+        size_t decompressed_len;
+        const int result = decompress_lz4(
+            &ext->lz4_dctx,
+            in,
+            in_len,
+            &ext->temp_buffer,
+            &ext->temp_buffer_cap,
+            &decompressed_len,
+            lod->realloc
+        );
+
+        if (result != 0) return DH_ERR_COMPRESS;
+        return dh_lod_deserialise_mapping_raw(lod, ext->temp_buffer, decompressed_len);
+    }
+    case DH_DATA_COMPRESSION_LZMA2: {
+        size_t decompressed_len;
+        const lzma_ret result = decompress_lzma(
+            &ext->lzma_dctx,
+            in,
+            in_len,
+            &ext->temp_buffer,
+            &ext->temp_buffer_cap,
+            &decompressed_len,
+            lod->realloc
+        );
+
+        if (result != LZMA_OK && result != LZMA_STREAM_END) return DH_ERR_COMPRESS;
+        return dh_lod_deserialise_mapping_raw(lod, ext->temp_buffer, decompressed_len);
+    }
+    case DH_DATA_COMPRESSION_ZSTD: {
+        return DH_ERR_UNSUPPORTED;
+    }
+    default: {
+        return DH_ERR_INVALID_ARGUMENT;
+    }
+    }
+
+    return dh_lod_deserialise_mapping_raw(lod, in, in_len);
+}
+
+static void swap_buffers(
+    char **a, size_t *a_cap,
+    char **b, size_t *b_cap
+) {
+    char *tmp = *a;
+    *a = *b;
+    *b = tmp;
+
+    const size_t tmp_cap = *a_cap;
+    *a_cap = *b_cap;
+    *b_cap = tmp_cap;
+}
+
 dh_result dh_compress(
     struct dh_lod *lod,
     const int64_t compression_mode,
     const double level
+) {
+    return dh_compress_ex(lod, compression_mode, level, nullptr);
+}
+
+dh_result dh_compress_ex(
+    struct dh_lod *lod,
+    const int64_t compression_mode,
+    const double level,
+    struct anvil_codec *codec
 ) {
     struct dh_lod_ext *ext;
-    const dh_result res = dh_lod_ext_get(lod, &ext);
+    dh_result res = dh_lod_ext_get(lod, &ext);
     if (res != DH_OK) return res;
 
+    res = dh_lod_serialise(lod);
+    if (res != DH_OK) return res;
+
+    // contexts are taken from the codec if given, otherwise the LOD keeps its own.
+    void **lz4_ctx   = codec != nullptr ? &codec->lz4_ctx   : &ext->lz4_ctx;
+    void **lz4_dctx  = codec != nullptr ? &codec->lz4_dctx  : &ext->lz4_dctx;
+    void **lzma_ctx  = codec != nullptr ? &codec->lzma_ctx  : &ext->lzma_ctx;
+    void **lzma_dctx = codec != nullptr ? &codec->lzma_dctx : &ext->lzma_dctx;
+
     if (compression_mode == lod->compression_mode)
         return DH_OK;
-    
-    char  *decompressed_lod_arr;
-    size_t decompressed_lod_len;
-    size_t decompressed_lod_cap;
+
+    if (compression_mode & ~(DH_DATA_COMPRESSION_MODE_MASK | DH_DATA_COMPRESSION_PLANAR))
+        return DH_ERR_INVALID_ARGUMENT;
+
+    switch (compression_mode & DH_DATA_COMPRESSION_MODE_MASK) {
+    case DH_DATA_COMPRESSION_UNCOMPRESSED:
+    case DH_DATA_COMPRESSION_LZ4:
+    case DH_DATA_COMPRESSION_LZMA2:
+        break;
+    case DH_DATA_COMPRESSION_ZSTD:
+        return DH_ERR_UNSUPPORTED;
+    default:
+        return DH_ERR_INVALID_ARGUMENT;
+    }
 
     // existing format -> decompressed
-    // this step consumes the data in the LOD,
-    // writing the uncompressed data into the decompressed buffer.
-    // after this step, the LOD's data and mapping is assumed to be invalid.
-    // 
+    // the decompressed data is written into big_buffer, which is then swapped with the LOD's data,
+    // leaving the compressed data in big_buffer to be reused.
+    // if a step fails the LOD is left in whichever valid state it was last in.
 
-    switch (lod->compression_mode) {
+    switch (lod->compression_mode & DH_DATA_COMPRESSION_MODE_MASK) {
     case DH_DATA_COMPRESSION_UNCOMPRESSED: {
-        decompressed_lod_arr = lod->lod_arr;
-        decompressed_lod_len = lod->lod_len;
-        decompressed_lod_cap = lod->lod_cap;
         break;
     }
     case DH_DATA_COMPRESSION_LZ4: {
-        return DH_ERR_UNSUPPORTED;
+        size_t decompressed_lod_len;
+
+        const int result = decompress_lz4(
+            lz4_dctx,
+            lod->lod_arr,
+            lod->lod_len,
+            &ext->big_buffer,
+            &ext->big_buffer_cap,
+            &decompressed_lod_len,
+            lod->realloc
+        );
+
+        if (result != 0) {
+            return DH_ERR_COMPRESS;
+        }
+
+        swap_buffers(&lod->lod_arr, &lod->lod_cap, &ext->big_buffer, &ext->big_buffer_cap);
+        lod->lod_len = decompressed_lod_len;
+        break;
     }
     case DH_DATA_COMPRESSION_LZMA2: {
-        return DH_ERR_UNSUPPORTED;
+        size_t decompressed_lod_len;
+
+        const lzma_ret result = decompress_lzma(
+            lzma_dctx,
+            lod->lod_arr,
+            lod->lod_len,
+            &ext->big_buffer,
+            &ext->big_buffer_cap,
+            &decompressed_lod_len,
+            lod->realloc
+        );
+
+        if (result != LZMA_OK && result != LZMA_STREAM_END) {
+            return DH_ERR_COMPRESS;
+        }
+
+        swap_buffers(&lod->lod_arr, &lod->lod_cap, &ext->big_buffer, &ext->big_buffer_cap);
+        lod->lod_len = decompressed_lod_len;
+        break;
     }
     case DH_DATA_COMPRESSION_ZSTD: {
         return DH_ERR_UNSUPPORTED;
@@ -366,24 +683,53 @@ dh_result dh_compress(
     }
     }
 
+    lod->compression_mode &= ~DH_DATA_COMPRESSION_MODE_MASK;
+
+    // planar <-> serialised.
+
+    if (
+        (lod->compression_mode & DH_DATA_COMPRESSION_PLANAR) !=
+        (compression_mode & DH_DATA_COMPRESSION_PLANAR)
+    ) {
+        size_t planar_lod_len;
+
+        if (lod->compression_mode & DH_DATA_COMPRESSION_PLANAR) {
+            res = dh_lod_planar_join(
+                lod->lod_arr,
+                lod->lod_len,
+                &ext->planar_buffer,
+                &ext->planar_buffer_cap,
+                &planar_lod_len,
+                lod->realloc
+            );
+        } else {
+            res = dh_lod_planar_split(
+                lod->lod_arr,
+                lod->lod_len,
+                &ext->planar_buffer,
+                &ext->planar_buffer_cap,
+                &planar_lod_len,
+                lod->realloc
+            );
+        }
 
-    switch (compression_mode) {
-    case DH_DATA_COMPRESSION_UNCOMPRESSED: {
-        lod->lod_arr = decompressed_lod_arr;
-        lod->lod_len = decompressed_lod_len;
-        lod->lod_cap = decompressed_lod_cap;
-
-        lod->compression_mode = DH_DATA_COMPRESSION_UNCOMPRESSED;
+        if (res != DH_OK) return res;
 
-        return DH_OK;
+        swap_buffers(&lod->lod_arr, &lod->lod_cap, &ext->planar_buffer, &ext->planar_buffer_cap);
+        lod->lod_len = planar_lod_len;
+        lod->compression_mode ^= DH_DATA_COMPRESSION_PLANAR;
     }
+
+    // decompressed -> requested format
+
+    switch (compression_mode & DH_DATA_COMPRESSION_MODE_MASK) {
     case DH_DATA_COMPRESSION_LZ4: {
         size_t compressed_lod_len;
 
         const int result = compress_lz4(
-            &ext->lz4_ctx,
-            decompressed_lod_arr,
-            decompressed_lod_len,
+            lz4_ctx,
+            lod->lod_arr,
+            lod->lod_len,
             &ext->big_buffer,
             &ext->big_buffer_cap,
             &compressed_lod_len,
@@ -392,33 +738,20 @@ dh_result dh_compress(
         );
 
         if (result != 0) {
-            lod->lod_arr = decompressed_lod_arr;
-            lod->lod_len = decompressed_lod_len;
-            lod->lod_cap = decompressed_lod_cap;
-    
-            lod->compression_mode = DH_DATA_COMPRESSION_UNCOMPRESSED;
-    
             return DH_ERR_COMPRESS;
         }
 
-        lod->lod_arr = ext->big_buffer;
+        swap_buffers(&lod->lod_arr, &lod->lod_cap, &ext->big_buffer, &ext->big_buffer_cap);
         lod->lod_len = compressed_lod_len;
-        lod->lod_cap = ext->big_buffer_cap;
-
-        ext->big_buffer = decompressed_lod_arr;
-        ext->big_buffer_cap = decompressed_lod_cap;
-
-        lod->compression_mode = DH_DATA_COMPRESSION_LZ4;
-
-        return DH_OK;
+        break;
     }
     case DH_DATA_COMPRESSION_LZMA2: {
         size_t compressed_lod_len;
 
         const lzma_ret result = compress_lzma(
-            &ext->lzma_ctx,
-            decompressed_lod_arr,
-            decompressed_lod_len,
+            lzma_ctx,
+            lod->lod_arr,
+            lod->lod_len,
             &ext->big_buffer,
             &ext->big_buffer_cap,
             &compressed_lod_len,
@@ -427,33 +760,20 @@ dh_result dh_compress(
         );
 
         if (result != LZMA_OK && result != LZMA_STREAM_END) {
-            lod->lod_arr = decompressed_lod_arr;
-            lod->lod_len = decompressed_lod_len;
-            lod->lod_cap = decompressed_lod_cap;
-    
-            lod->compression_mode = DH_DATA_COMPRESSION_UNCOMPRESSED;
-    
             return DH_ERR_COMPRESS;
         }
 
-        lod->lod_arr = ext->big_buffer;
+        swap_buffers(&lod->lod_arr, &lod->lod_cap, &ext->big_buffer, &ext->big_buffer_cap);
         lod->lod_len = compressed_lod_len;
-        lod->lod_cap = ext->big_buffer_cap;
-
-        ext->big_buffer = decompressed_lod_arr;
-        ext->big_buffer_cap = decompressed_lod_cap;
-
-        lod->compression_mode = DH_DATA_COMPRESSION_LZMA2;
-
-        return DH_OK;
-    }
-    case DH_DATA_COMPRESSION_ZSTD: {
-        return DH_ERR_UNSUPPORTED;
+        break;
     }
     default: {
-        return DH_ERR_INVALID_ARGUMENT;
+        break;
     }
     }
+
+    lod->compression_mode = compression_mode;
+    return DH_OK;
 }
 
 void dh_lod_trim(
@@ -462,6 +782,9 @@ void dh_lod_trim(
     if (lod == nullptr) return;
     if (lod->realloc == nullptr) return;
 
+    // the host form goes with the rest of the internal state, so it has to be written out first.
+    if (dh_lod_serialise(lod) != DH_OK) return;
+
     for (size_t i = lod->mapping_len; i < lod->mapping_cap; i++) if (lod->mapping_arr[i] != nullptr) {
         lod->realloc(lod->mapping_arr[i], 0);
         lod->mapping_arr[i] = nullptr;
@@ -486,6 +809,34 @@ void dh_lod_trim(
     dh_lod_ext_free(lod);
 }
 
+void dh_lod_recycle(
+    struct dh_lod *lod,
+    const int64_t mip_level,
+    const int64_t x,
+    const int64_t z
+) {
+    if (lod == nullptr) return;
+
+    lod->x = x;
+    lod->z = z;
+    lod->height = 0;
+    lod->min_y = 0;
+    lod->mip_level = mip_level;
+    lod->compression_mode = DH_DATA_COMPRESSION_UNCOMPRESSED;
+    lod->mapping_len = 0;
+    lod->lod_len = 0;
+    lod->has_data = false;
+    lod->checksum = 0;
+
+    // mapping strings past mapping_len, buffers and compression contexts are kept for the next LOD.
+    struct dh_lod_ext *ext = lod->__internal;
+    if (ext == nullptr) return;
+
+    dh_lod_data_replaced(lod);
+    ext->beacons_len = 0;
+    ext->beacons_valid = false;
+}
+
 void dh_lod_free(
     struct dh_lod *lod
 ) {
@@ -508,3 +859,90 @@ void dh_lod_free(
 
     *lod = DH_LOD_CLEAR;
 }
+
+struct dh_lod_pool {
+    struct dh_lod **spare;          // LODs given back, each allocated with realloc.
+    size_t spare_len;
+    size_t max_lods;
+    void *(*realloc)(void*, size_t);
+};
+
+struct dh_lod_pool *dh_lod_pool_new(
+    const size_t max_lods,
+    void *(*realloc_f)(void*, size_t)
+) {
+    if (realloc_f == nullptr) realloc_f = realloc;
+
+    struct dh_lod_pool *pool = realloc_f(nullptr, sizeof(struct dh_lod_pool));
+    if (pool == nullptr) return nullptr;
+
+    struct dh_lod **spare = nullptr;
+    if (max_lods > 0) {
+        spare = realloc_f(nullptr, max_lods * sizeof(struct dh_lod*));
+        if (spare == nullptr) {
+            realloc_f(pool, 0);
+            return nullptr;
+        }
+    }
+
+    *pool = (struct dh_lod_pool){
+        .spare = spare,
+        .spare_len = 0,
+        .max_lods = max_lods,
+        .realloc = realloc_f,
+    };
+    return pool;
+}
+
+struct dh_lod *dh_lod_pool_take(
+    struct dh_lod_pool *pool,
+    const int64_t mip_level,
+    const int64_t x,
+    const int64_t z
+) {
+    if (pool == nullptr) return nullptr;
+
+    if (pool->spare_len > 0) {
+        struct dh_lod *lod = pool->spare[--pool->spare_len];
+        dh_lod_recycle(lod, mip_level, x, z);
+        return lod;
+    }
+
+    struct dh_lod *lod = pool->realloc(nullptr, sizeof(struct dh_lod));
+    if (lod == nullptr) return nullptr;
+
+    *lod = DH_LOD_CLEAR;
+    lod->realloc = pool->realloc;
+    dh_lod_recycle(lod, mip_level, x, z);
+    return lod;
+}
+
+void dh_lod_pool_give(
+    struct dh_lod_pool *pool,
+    struct dh_lod *lod
+) {
+    if (pool == nullptr || lod == nullptr) return;
+
+    if (pool->spare_len < pool->max_lods) {
+        pool->spare[pool->spare_len++] = lod;
+        return;
+    }
+
+    dh_lod_free(lod);
+    pool->realloc(lod, 0);
+}
+
+void dh_lod_pool_free(
+    struct dh_lod_pool *pool
+) {
+    if (pool == nullptr) return;
+
+    void *(*realloc_f)(void*, size_t) = pool->realloc;
+    for (size_t i = 0; i < pool->spare_len; i++) {
+        dh_lod_free(pool->spare[i]);
+        realloc_f(pool->spare[i], 0);
+    }
+
+    if (pool->spare != nullptr) realloc_f(pool->spare, 0);
+    realloc_f(pool, 0);
+}
@@ -46,6 +46,27 @@ static void dp_write(char *data, const uint64_t dp) {
     data[7] = (char)(uint8_t)(dp >> (0 * 8) & 0xFF);
 }
 
+/**
+ * interleaves the bits of x and z, so positions close together in both axes sort close together.
+ * the sign bits are flipped so negative positions sort before positive ones.
+ */
+static uint64_t dh_morton(const int64_t x, const int64_t z) {
+    uint64_t key = 0;
+    const uint32_t ux = (uint32_t)x ^ 0x80000000u;
+    const uint32_t uz = (uint32_t)z ^ 0x80000000u;
+    for (int i = 31; i >= 0; i--) {
+        key = key << 2 | (uint64_t)(ux >> i & 1) << 1 | (uz >> i & 1);
+    }
+    return key;
+}
+
+/**
+ * shifts a position right, rounding down, where division would round towards zero.
+ */
+static inline int64_t dh_floor_shift(const int64_t value, const int64_t shift) {
+    return value >= 0 ? value >> shift : -((-value - 1) >> shift) - 1;
+}
+
 int dh_compare_lod_pos(const void *, const void *);
 int dh_compare_strings(const void *, const void *);
 
@@ -77,6 +98,62 @@ dh_result dh_lod_ensure(
     size_t n
 );
 
+/**
+ * copies a stored LOD's data and serialised mapping into the LOD, reusing its buffers.
+ * the fields describing the LOD are set by the caller, as each store keeps them differently.
+ */
+dh_result dh_lod_load_stored(
+    struct dh_lod *lod,
+    const char *data,
+    size_t data_len,
+    const char *mapping,
+    size_t mapping_len
+);
+
+/**
+ * the ColumnGenerationStep and ColumnWorldCompressionMode blobs DH expects next to a LOD compressed with the given mode.
+ * it returns DH_ERR_UNSUPPORTED for modes DH can't read, including planar ones.
+ */
+dh_result dh_lod_row_constants(
+    int64_t compression_mode,
+    const void **gen_step,
+    size_t *gen_step_len,
+    const void **world_compression,
+    size_t *world_compression_len
+);
+
+/**
+ * checksum of uncompressed LOD data.
+ * libdeflate's CRC32 uses carry-less multiplication where the CPU supports it,
+ * so it costs next to nothing compared to generating the data.
+ */
+int32_t dh_lod_checksum(
+    const char *data,
+    size_t len
+);
+
+/**
+ * rearranges serialised LOD data into planar form, and back.
+ * out is grown using realloc_f as needed.
+ */
+dh_result dh_lod_planar_split(
+    const char *in,
+    size_t in_len,
+    char **out,
+    size_t *out_cap,
+    size_t *out_len,
+    void *(*realloc_f)(void*, size_t)
+);
+
+dh_result dh_lod_planar_join(
+    const char *in,
+    size_t in_len,
+    char **out,
+    size_t *out_cap,
+    size_t *out_len,
+    void *(*realloc_f)(void*, size_t)
+);
+
 // TODO this is too complex
 struct id_lookup {
     struct id_table {
@@ -89,15 +166,191 @@ struct id_lookup {
 
 #define ID_LOOKUP_CLEAR (struct id_lookup){nullptr, 0}
 
+/**
+ * the LOD's data as host-endian datapoints, with where each column starts.
+ * generation, mipping and compaction write this instead of lod_arr, and lod_arr is only written from it
+ * by dh_lod_serialise when something needs the DH format, so datapoints are byte swapped once on the way out
+ * instead of by every stage, and any column can be found without walking the ones before it.
+ */
+struct dh_lod_host {
+    uint32_t *column_start;     // first datapoint of each of the 64x64 columns, and one past the last written.
+    size_t columns;             // columns written.
+
+    uint64_t *datapoints;       // every column's datapoints, top down.
+    size_t datapoints_len;
+    size_t datapoints_cap;
+
+    bool valid;                 // holds the LOD's data.
+    bool pending;               // lod_arr hasn't been written since it changed.
+};
+
+#define DH_LOD_HOST_CLEAR (struct dh_lod_host){ nullptr, 0, nullptr, 0, 0, false, false }
+
+/**
+ * empties the host form, so columns can be written into it from the first.
+ */
+dh_result dh_lod_host_reset(
+    struct dh_lod_host *host,
+    void *(*realloc_f)(void*, size_t)
+);
+
+/**
+ * makes room for n more datapoints.
+ */
+dh_result dh_lod_host_reserve(
+    struct dh_lod_host *host,
+    void *(*realloc_f)(void*, size_t),
+    size_t n
+);
+
+/**
+ * ends the column being written, which holds every datapoint added since the last one ended.
+ */
+static inline void dh_lod_host_end_column(struct dh_lod_host *host) {
+    host->column_start[++host->columns] = (uint32_t)host->datapoints_len;
+}
+
+/**
+ * makes the LOD's host form hold its data, decompressing and decoding lod_arr if it doesn't already.
+ */
+dh_result dh_lod_host_decode(
+    struct dh_lod *lod,
+    struct anvil_codec *codec
+);
+
+/**
+ * the LOD's host form if it holds its data, otherwise null.
+ */
+struct dh_lod_host *dh_lod_host_get(
+    const struct dh_lod *lod
+);
+
+/**
+ * forgets everything worked out from the LOD's data, the host form and column offsets,
+ * for when lod_arr is replaced by something that doesn't know about them.
+ */
+void dh_lod_data_replaced(
+    struct dh_lod *lod
+);
+
+void dh_lod_host_free(
+    struct dh_lod_host *host,
+    void *(*realloc_f)(void*, size_t)
+);
+
+/**
+ * scratch space for mipping, kept with the LOD so mipping into it again doesn't allocate.
+ * source columns are decoded into host-endian arrays a strip at a time,
+ * and each destination column's datapoint boundaries are bucketed by y.
+ */
+struct dh_mip_scratch {
+    uint32_t *column_start;     // first datapoint of each decoded column, and one past the last.
+    size_t column_start_cap;
+
+    uint16_t *top;              // y above each datapoint.
+    uint16_t *bottom;           // y of the bottom of each datapoint.
+    uint32_t *id;               // destination LOD id.
+    uint8_t *light;             // block light << 4 | sky light.
+    size_t datapoints_cap;
+
+    uint32_t *events;           // datapoint << 1 | 1 for its top, datapoint << 1 for its bottom.
+    size_t events_cap;
+
+    uint32_t *buckets;          // events per y, then where each y's events end.
+    size_t buckets_cap;
+
+    uint32_t *id_count;         // votes for each id at the current y, all zero between columns.
+    uint32_t *active_ids;       // ids with a non-zero count.
+    uint32_t *active_index;     // position of each id in active_ids.
+    uint8_t *id_air;            // whether each id is an air block.
+    size_t ids_cap;
+    size_t ids_classified;      // ids with id_air set. reset whenever the destination mapping is.
+};
+
+#define DH_MIP_SCRATCH_CLEAR (struct dh_mip_scratch){\
+    nullptr, 0,\
+    nullptr, nullptr, nullptr, nullptr, 0,\
+    nullptr, 0,\
+    nullptr, 0,\
+    nullptr, nullptr, nullptr, nullptr, 0, 0\
+}
+
+/**
+ * decodes rows of 64 columns from a source LOD into the scratch arrays, starting at the given column,
+ * mapping ids to the destination LOD's on the way. the source is found with its column offsets,
+ * see dh_lod_column_offsets, so strips are found without reading the columns before them.
+ * every datapoint is read and byte swapped exactly once here, the merge only touches the arrays.
+ */
+dh_result dh_lod_mip_decode_strip(
+    struct dh_mip_scratch *mip,
+    void *(*realloc_f)(void*, size_t),
+    const char *data,
+    const uint32_t *offsets,
+    size_t first_column,
+    size_t rows,
+    const uint32_t *id_mapping,
+    size_t mapping_len
+);
+
+/**
+ * dh_lod_mip_decode_strip for a source LOD with a host form, which is only mapped and unpacked.
+ */
+dh_result dh_lod_mip_decode_host_strip(
+    struct dh_mip_scratch *mip,
+    void *(*realloc_f)(void*, size_t),
+    const struct dh_lod_host *host,
+    size_t first_column,
+    size_t rows,
+    const uint32_t *id_mapping,
+    size_t mapping_len
+);
+
+/**
+ * makes sure the id counting table covers every id of the destination LOD, and notes which are air.
+ * new counts start at zero, and counts are back at zero after every merged column.
+ */
+dh_result dh_lod_mip_reserve_ids(
+    struct dh_mip_scratch *mip,
+    const struct dh_lod *lod
+);
+
+/**
+ * merges size x size decoded columns, starting at the given column of each row in the strip,
+ * into a single column appended to the host form.
+ *
+ * the tops and bottoms of every datapoint are bucketed by y, then swept from the top down
+ * while counting the votes for each id. every span between two boundaries takes the id
+ * the policy picks, and the light averaged over all size x size columns.
+ * spans are merged into the span above them when they have the same id.
+ *
+ * DH_MIP_FAST copies the first column of the strip's first row instead, the rest needn't be decoded.
+ */
+dh_result dh_lod_mip_merge_column(
+    struct dh_lod_host *out,
+    struct dh_mip_scratch *mip,
+    void *(*realloc_f)(void*, size_t),
+    size_t size,
+    size_t first_column,
+    int64_t policy
+);
+
 #define DH_LOD_EXT_CLEAR (struct dh_lod_ext){\
     nullptr, 0,\
     nullptr, 0,\
     nullptr, 0,\
     nullptr, 0,\
+    nullptr, 0,\
+    nullptr,\
+    nullptr,\
     nullptr,\
     nullptr,\
     {ANVIL_SECTIONS_CLEAR, ANVIL_SECTIONS_CLEAR, ANVIL_SECTIONS_CLEAR, ANVIL_SECTIONS_CLEAR },\
-    {ID_LOOKUP_CLEAR, ID_LOOKUP_CLEAR, ID_LOOKUP_CLEAR, ID_LOOKUP_CLEAR}\
+    {ID_LOOKUP_CLEAR, ID_LOOKUP_CLEAR, ID_LOOKUP_CLEAR, ID_LOOKUP_CLEAR},\
+    nullptr, 0, 0,\
+    false,\
+    DH_MIP_SCRATCH_CLEAR,\
+    DH_LOD_HOST_CLEAR,\
+    nullptr, false\
 }
 
 struct dh_lod_ext {
@@ -113,15 +366,44 @@ struct dh_lod_ext {
     char *big_buffer;
     size_t big_buffer_cap;
 
+    char *planar_buffer;
+    size_t planar_buffer_cap;
+
     void *lzma_ctx;
     void *lz4_ctx;
+    void *lzma_dctx;
+    void *lz4_dctx;
 
     struct anvil_sections sections[4];
     struct id_lookup id_lookup[4];
+
+    struct dh_beacon *beacons;
+    size_t beacons_len;
+    size_t beacons_cap;
+    bool beacons_valid;         // if the beacons are from the chunks the LOD was generated from.
+
+    struct dh_mip_scratch mip;
+    struct dh_lod_host host;
+
+    uint32_t *column_offsets;   // see dh_lod_column_offsets.
+    bool column_offsets_valid;  // if the offsets are for the LOD's current data.
 };
 
 dh_result dh_lod_ext_get(struct dh_lod *lod, struct dh_lod_ext **ext_ptr);
 
+/**
+ * adds the beacons in a chunk to the LOD's, with the colours of their beams.
+ * section_list and block_entities are the chunk's (nullable) list tags, as the section parser finds them,
+ * end is the end of the chunk's uncompressed NBT.
+ */
+dh_result dh_lod_chunk_beacons(
+    struct dh_lod *lod,
+    struct dh_lod_ext *ext,
+    char *section_list,
+    char *block_entities,
+    const char *end
+);
+
 #define DH_LODS_NO_LODS INT64_MIN + 1
 #define DH_LODS_NOT_SAME INT64_MIN + 2
 int64_t dh_lods_same_mip_level(struct dh_lod **lods, size_t num_lods);
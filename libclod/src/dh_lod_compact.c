@@ -0,0 +1,140 @@
+#include <stdint.h>
+#include <string.h>
+#include <dh.h>
+#include "dh_lod.h"
+
+static uint64_t dp_top(const uint64_t dp) {
+    return DP_MIN_Y(dp) + DP_HEIGHT(dp);
+}
+
+/**
+ * appends a datapoint to the column, joining it onto the one above if it touches it and is otherwise the same.
+ * it returns the number of datapoints written.
+ */
+static size_t emit(uint64_t *out, size_t count, const uint64_t dp) {
+    if (count > 0) {
+        const uint64_t above = out[count - 1];
+        const uint64_t mask = DP_BLOCK_LIGHT_MASK | DP_SKY_LIGHT_MASK | DP_ID_MASK;
+
+        if ((above & mask) == (dp & mask) && DP_MIN_Y(above) == dp_top(dp)) {
+            uint64_t joined = above;
+            joined = DP_SET_HEIGHT(joined, DP_HEIGHT(above) + DP_HEIGHT(dp));
+            joined = DP_SET_MIN_Y(joined, DP_MIN_Y(dp));
+            out[count - 1] = joined;
+            return count;
+        }
+    }
+
+    out[count] = dp;
+    return count + 1;
+}
+
+/**
+ * compacts a column of n datapoints into out, which may overlap them as long as it doesn't start after them.
+ * every datapoint is read before anything is written over it.
+ *
+ * datapoints from depth blocks beneath the first one without sky light are split into groups of similar height,
+ * as many as the budget leaves room for, and each group becomes a single datapoint taking the id and light of
+ * its tallest datapoint. if there aren't enough datapoints beneath that to meet the budget, it starts higher.
+ *
+ * it returns the number of datapoints written.
+ */
+static size_t compact_column(
+    uint64_t *out,
+    const uint64_t *dps,
+    const size_t n,
+    const int64_t depth,
+    const size_t max_datapoints
+) {
+    size_t first = n;
+    for (size_t i = 0; i < n; i++) {
+        const uint64_t dp = dps[i];
+        if (DP_SKY_LIGHT(dp) != 0) continue;
+
+        const int64_t limit = (int64_t)dp_top(dp) - depth;
+        first = i;
+        while (first < n && (int64_t)dp_top(dps[first]) > limit) first++;
+        break;
+    }
+
+    // one group of n - max_datapoints + 1 datapoints is as few as will meet the budget.
+    const size_t removed = n - max_datapoints;
+    if (n - first < removed + 1) first = n - removed - 1;
+
+    const size_t groups = n - first - removed;
+    const uint64_t group_top = dp_top(dps[first]);
+    const uint64_t total = group_top - DP_MIN_Y(dps[n - 1]);
+
+    size_t count = 0;
+    for (size_t i = 0; i < first; i++) {
+        count = emit(out, count, dps[i]);
+    }
+
+    size_t group = 0;
+    uint64_t top = group_top, tallest = 0;
+    for (size_t i = first; i < n; i++) {
+        const uint64_t dp = dps[i];
+        if (DP_HEIGHT(dp) > DP_HEIGHT(tallest)) tallest = dp;
+
+        // groups end once they reach their share of the height, while leaving a datapoint for each group after them.
+        const size_t left = n - 1 - i;
+        const size_t groups_left = groups - 1 - group;
+        const uint64_t covered = group_top - DP_MIN_Y(dp);
+        if (i + 1 < n) {
+            if (groups_left == 0) continue;
+            if (left > groups_left && covered * groups < total * (group + 1)) continue;
+        }
+
+        uint64_t merged = tallest;
+        merged = DP_SET_MIN_Y(merged, DP_MIN_Y(dp));
+        merged = DP_SET_HEIGHT(merged, top - DP_MIN_Y(dp));
+        count = emit(out, count, merged);
+
+        top = DP_MIN_Y(dp);
+        tallest = 0;
+        group++;
+    }
+
+    return count;
+}
+
+dh_result dh_lod_compact(
+    struct dh_lod *lod,
+    const int64_t depth,
+    const size_t max_datapoints,
+    struct anvil_codec *codec
+) {
+    if (lod == nullptr || depth < 0 || max_datapoints == 0) return DH_ERR_INVALID_ARGUMENT;
+
+    const dh_result res = dh_lod_host_decode(lod, codec);
+    if (res != DH_OK) return res;
+
+    struct dh_lod_host *host = dh_lod_host_get(lod);
+
+    // datapoints are checked up front, so a malformed LOD is left as it was.
+    for (size_t i = 0; i < host->datapoints_len; i++) {
+        if (DP_HEIGHT(host->datapoints[i]) == 0) return DH_ERR_MALFORMED;
+    }
+
+    // columns only ever shrink, so they're rewritten in place.
+    uint32_t write = 0;
+    for (size_t column = 0; column < 64 * 64; column++) {
+        const uint32_t first = host->column_start[column];
+        const size_t len = host->column_start[column + 1] - first;
+
+        size_t count = len;
+        if (len > max_datapoints) {
+            count = compact_column(host->datapoints + write, host->datapoints + first, len, depth, max_datapoints);
+        } else {
+            memmove(host->datapoints + write, host->datapoints + first, len * sizeof(*host->datapoints));
+        }
+
+        host->column_start[column] = write;
+        write += count;
+    }
+
+    host->column_start[64 * 64] = write;
+    host->datapoints_len = write;
+    host->pending = true;
+    return DH_OK;
+}
@@ -208,16 +208,16 @@ dh_result dh_from_chunks(
     lod->mapping_len = 0;
     lod->lod_len = 0;
     lod->has_data = false;
+    lod->checksum = 0;
 
-    if (ext->big_buffer_cap > lod->lod_cap) {
-        char *tmp = lod->lod_arr;
-        lod->lod_arr = ext->big_buffer;
-        ext->big_buffer = tmp;
+    ext->beacons_len = 0;
+    ext->beacons_valid = false;
+    ext->column_offsets_valid = false;
 
-        const auto tmp_cap = lod->lod_cap;
-        lod->lod_cap = ext->big_buffer_cap;
-        ext->big_buffer_cap = tmp_cap;
-    }
+    // columns are written to the host form, lod_arr is written from it when it's needed.
+    struct dh_lod_host *host = &ext->host;
+    res = dh_lod_host_reset(host, lod->realloc);
+    if (res != DH_OK) return res;
 
     for (int64_t chunk_x = 0; chunk_x < 4; chunk_x++) {
 
@@ -232,7 +232,7 @@ dh_result dh_from_chunks(
                 return DH_ERR_MALFORMED;
             }
 
-            const dh_result result = add_mappings(
+            dh_result result = add_mappings(
                 lod,
                 ext,
                 &ext->sections[chunk_z],
@@ -242,6 +242,18 @@ dh_result dh_from_chunks(
             if (result != DH_OK) {
                 return result;
             }
+
+            // beacons come from the tags the section parser already found, the chunk isn't walked again.
+            result = dh_lod_chunk_beacons(
+                lod,
+                ext,
+                ext->sections[chunk_z].section_list,
+                ext->sections[chunk_z].block_entities,
+                chunks[chunk_x * 4 + chunk_z].data + chunks[chunk_x * 4 + chunk_z].data_size
+            );
+            if (result != DH_OK) {
+                return result;
+            }
         }
 
         lod->height = ext->sections->len * 16;
@@ -255,16 +267,19 @@ dh_result dh_from_chunks(
 
             for (int64_t block_z = 0; block_z < 16; block_z++) {
 
-                res = dh_lod_ensure(lod, 2 + 8 * sections->len * 16);
+                res = dh_lod_host_reserve(host, lod->realloc, sections->len * 16);
                 if (res != DH_OK) return res;
 
-                char *cursor     = lod->lod_arr + lod->lod_len + 2;
+                uint64_t *const column = host->datapoints + host->datapoints_len;
+                uint64_t *cursor = column;
 
                 if (
                     sections->status != nullptr && (
                     strlen("minecraft:full") != nbt_string_size(sections->status) ||
                     0 != strncmp("minecraft:full", nbt_string(sections->status), strlen("minecraft:full"))
                 )) {
+                    // chunks that aren't fully generated leave their columns empty.
+                    dh_lod_host_end_column(host);
                     continue;
                 }
 
@@ -330,8 +345,7 @@ dh_result dh_from_chunks(
                         }
 
                         if (DP_HEIGHT(last_datapoint) > 0) {
-                            dp_write(cursor, last_datapoint);
-                            cursor += 8;
+                            *cursor++ = last_datapoint;
                         }
 
                         last_datapoint =
@@ -342,20 +356,20 @@ dh_result dh_from_chunks(
                 }
 
                 if (DP_HEIGHT(last_datapoint) > 0) {
-                    dp_write(cursor, last_datapoint);
-                    cursor += 8;
+                    *cursor++ = last_datapoint;
                 }
 
-                const auto count = (cursor - 2 - lod->lod_arr - lod->lod_len) / 8;
-                if (count > 0) lod->has_data = true;
-                (lod->lod_arr + lod->lod_len)[0] = (char)(count >> (1 * 8) & 0xFF);
-                (lod->lod_arr + lod->lod_len)[1] = (char)(count >> (0 * 8) & 0xFF);
-                lod->lod_len = cursor - lod->lod_arr;
+                if (cursor > column) lod->has_data = true;
+                host->datapoints_len += cursor - column;
+                dh_lod_host_end_column(host);
             }
         }
     }
 
     #undef ensure_buffer
 
+    host->valid = true;
+    host->pending = true;
+    ext->beacons_valid = true;
     return DH_OK;
 }
\ No newline at end of file
@@ -0,0 +1,144 @@
+#include <stdint.h>
+#include <dh.h>
+#include "dh_lod.h"
+
+dh_result dh_lod_host_reset(
+    struct dh_lod_host *host,
+    void *(*realloc_f)(void*, size_t)
+) {
+    if (host->column_start == nullptr) {
+        host->column_start = realloc_f(nullptr, (64 * 64 + 1) * sizeof(*host->column_start));
+        if (host->column_start == nullptr) return DH_ERR_ALLOC;
+    }
+
+    host->column_start[0] = 0;
+    host->columns = 0;
+    host->datapoints_len = 0;
+    host->valid = false;
+    host->pending = false;
+    return DH_OK;
+}
+
+dh_result dh_lod_host_reserve(
+    struct dh_lod_host *host,
+    void *(*realloc_f)(void*, size_t),
+    const size_t n
+) {
+    if (host->datapoints_cap - host->datapoints_len >= n) return DH_OK;
+
+    size_t new_cap = (host->datapoints_cap << 1) - (host->datapoints_cap >> 1);
+    if (new_cap < host->datapoints_len + n) new_cap = host->datapoints_len + n;
+
+    uint64_t *new = realloc_f(host->datapoints, new_cap * sizeof(*new));
+    if (new == nullptr) return DH_ERR_ALLOC;
+
+    host->datapoints = new;
+    host->datapoints_cap = new_cap;
+    return DH_OK;
+}
+
+dh_result dh_lod_host_decode(
+    struct dh_lod *lod,
+    struct anvil_codec *codec
+) {
+    struct dh_lod_ext *ext;
+    dh_result res = dh_lod_ext_get(lod, &ext);
+    if (res != DH_OK) return res;
+
+    struct dh_lod_host *host = &ext->host;
+    if (host->valid) return DH_OK;
+
+    res = dh_compress_ex(lod, DH_DATA_COMPRESSION_UNCOMPRESSED, 0, codec);
+    if (res != DH_OK) return res;
+
+    res = dh_lod_host_reset(host, lod->realloc);
+    if (res != DH_OK) return res;
+
+    // every column after a malformed one would be wrong, so nothing is kept.
+    const char *cursor = lod->lod_arr;
+    const char *end = lod->lod_arr + lod->lod_len;
+    for (size_t column = 0; column < 64 * 64; column++) {
+        if (end - cursor < 2) return DH_ERR_MALFORMED;
+        const size_t len = (uint8_t)cursor[0] << 8 | (uint8_t)cursor[1];
+        if ((size_t)(end - cursor - 2) < len * 8) return DH_ERR_MALFORMED;
+        cursor += 2;
+
+        res = dh_lod_host_reserve(host, lod->realloc, len);
+        if (res != DH_OK) return res;
+
+        for (size_t i = 0; i < len; i++, cursor += 8) {
+            host->datapoints[host->datapoints_len++] = dp_read(cursor);
+        }
+        dh_lod_host_end_column(host);
+    }
+
+    host->valid = true;
+    return DH_OK;
+}
+
+struct dh_lod_host *dh_lod_host_get(
+    const struct dh_lod *lod
+) {
+    struct dh_lod_ext *ext = lod->__internal;
+    if (ext == nullptr || !ext->host.valid) return nullptr;
+    return &ext->host;
+}
+
+void dh_lod_data_replaced(
+    struct dh_lod *lod
+) {
+    struct dh_lod_ext *ext = lod->__internal;
+    if (ext == nullptr) return;
+
+    ext->host.valid = false;
+    ext->host.pending = false;
+    ext->column_offsets_valid = false;
+}
+
+void dh_lod_host_free(
+    struct dh_lod_host *host,
+    void *(*realloc_f)(void*, size_t)
+) {
+    if (host->column_start != nullptr) realloc_f(host->column_start, 0);
+    if (host->datapoints != nullptr) realloc_f(host->datapoints, 0);
+    *host = DH_LOD_HOST_CLEAR;
+}
+
+dh_result dh_lod_serialise(
+    struct dh_lod *lod
+) {
+    if (lod == nullptr) return DH_ERR_INVALID_ARGUMENT;
+
+    struct dh_lod_ext *ext = lod->__internal;
+    if (ext == nullptr || !ext->host.pending) return DH_OK;
+
+    const struct dh_lod_host *host = &ext->host;
+    if (host->columns != 64 * 64) return DH_ERR_MALFORMED;
+
+    lod->lod_len = 0;
+    lod->compression_mode = DH_DATA_COMPRESSION_UNCOMPRESSED;
+
+    const dh_result res = dh_lod_ensure(lod, 64 * 64 * 2 + host->datapoints_len * 8);
+    if (res != DH_OK) return res;
+
+    char *cursor = lod->lod_arr;
+    for (size_t column = 0; column < 64 * 64; column++) {
+        const uint32_t first = host->column_start[column];
+        const uint32_t last = host->column_start[column + 1];
+
+        cursor[0] = (char)((last - first) >> (1 * 8) & 0xFF);
+        cursor[1] = (char)((last - first) >> (0 * 8) & 0xFF);
+        cursor += 2;
+
+        for (uint32_t d = first; d < last; d++, cursor += 8) {
+            dp_write(cursor, host->datapoints[d]);
+        }
+    }
+
+    lod->lod_len = cursor - lod->lod_arr;
+    lod->has_data = host->datapoints_len > 0;
+    lod->checksum = dh_lod_checksum(lod->lod_arr, lod->lod_len);
+    ext->host.pending = false;
+    ext->column_offsets_valid = false;
+    return DH_OK;
+}
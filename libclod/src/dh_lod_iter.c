@@ -0,0 +1,277 @@
+#include <stdlib.h>
+#include <string.h>
+#include <lz4frame.h>
+
+#include <dh.h>
+
+#include "compress.h"
+#include "dh_lod.h"
+
+// LODs are compressed in 64KB blocks, so the window is filled a block at a time.
+#define WINDOW_STEP (64 * 1024)
+
+/**
+ * the window holds decompressed data that hasn't been read yet between start and end.
+ * before it is refilled the unread bytes are carried back to the start of the buffer,
+ * so a column that spans two blocks is always contiguous when it is returned.
+ */
+struct dh_column_iter {
+    void *(*realloc)(void*, size_t);
+
+    const char *in;         // compressed LOD data.
+    size_t in_len;
+    size_t in_pos;
+
+    void *lz4_dctx;         // LZ4F_dctx.
+    bool owns_dctx;         // if lz4_dctx was made for this iteration.
+    bool finished;          // if there's no more data to decompress.
+
+    const char *data;       // the window. points into LOD data if it is uncompressed.
+    char *buffer;           // allocated window.
+    size_t buffer_cap;
+    size_t start;
+    size_t end;
+};
+
+dh_result dh_column_iter_open(
+    struct dh_column_iter **iter_out,
+    struct dh_lod *lod,
+    struct anvil_codec *codec
+) {
+    if (iter_out == nullptr || lod == nullptr)
+        return DH_ERR_INVALID_ARGUMENT;
+
+    const dh_result res = dh_lod_serialise(lod);
+    if (res != DH_OK) return res;
+
+    switch (lod->compression_mode) {
+    case DH_DATA_COMPRESSION_UNCOMPRESSED:
+    case DH_DATA_COMPRESSION_LZ4:
+        break;
+    default:
+        return DH_ERR_UNSUPPORTED;
+    }
+
+    void *(*realloc_f)(void*, size_t) = lod->realloc != nullptr ? lod->realloc : realloc;
+
+    struct dh_column_iter *iter = realloc_f(nullptr, sizeof(struct dh_column_iter));
+    if (iter == nullptr) {
+        return DH_ERR_ALLOC;
+    }
+
+    iter->realloc = realloc_f;
+    iter->in = lod->lod_arr;
+    iter->in_len = lod->lod_len;
+    iter->in_pos = 0;
+    iter->lz4_dctx = nullptr;
+    iter->owns_dctx = false;
+    iter->finished = true;
+    iter->data = lod->lod_arr;
+    iter->buffer = nullptr;
+    iter->buffer_cap = 0;
+    iter->start = 0;
+    iter->end = lod->lod_len;
+
+    if (lod->compression_mode == DH_DATA_COMPRESSION_LZ4) {
+        iter->finished = false;
+        iter->data = nullptr;
+        iter->end = 0;
+
+        if (codec != nullptr && codec->lz4_dctx != nullptr) {
+            iter->lz4_dctx = codec->lz4_dctx;
+            LZ4F_resetDecompressionContext(iter->lz4_dctx);
+        } else {
+            LZ4F_dctx *dctx;
+            if (LZ4F_isError(LZ4F_createDecompressionContext(&dctx, LZ4F_VERSION))) {
+                realloc_f(iter, 0);
+                return DH_ERR_ALLOC;
+            }
+
+            // the codec keeps the context for next time.
+            if (codec != nullptr) {
+                codec->lz4_dctx = dctx;
+            } else {
+                iter->owns_dctx = true;
+            }
+            iter->lz4_dctx = dctx;
+        }
+    }
+
+    *iter_out = iter;
+    return DH_OK;
+}
+
+/**
+ * makes at least n unread bytes available in the window, if there are that many left.
+ */
+static dh_result fill(
+    struct dh_column_iter *iter,
+    const size_t n
+) {
+    while (iter->end - iter->start < n && !iter->finished) {
+        if (iter->start > 0) {
+            memmove(iter->buffer, iter->buffer + iter->start, iter->end - iter->start);
+            iter->end -= iter->start;
+            iter->start = 0;
+        }
+
+        if (iter->buffer_cap - iter->end < WINDOW_STEP) {
+            size_t new_cap = iter->buffer_cap + WINDOW_STEP;
+            if (new_cap < n) new_cap = n + WINDOW_STEP;
+
+            char *new = iter->realloc(iter->buffer, new_cap);
+            if (new == nullptr) return DH_ERR_ALLOC;
+
+            iter->buffer = new;
+            iter->buffer_cap = new_cap;
+            iter->data = new;
+        }
+
+        size_t src_size = iter->in_len - iter->in_pos;
+        size_t dst_size = iter->buffer_cap - iter->end;
+
+        const size_t hint = LZ4F_decompress(
+            iter->lz4_dctx,
+            iter->buffer + iter->end,
+            &dst_size,
+            iter->in + iter->in_pos,
+            &src_size,
+            nullptr
+        );
+        if (LZ4F_isError(hint)) {
+            return DH_ERR_COMPRESS;
+        }
+
+        iter->in_pos += src_size;
+        iter->end += dst_size;
+
+        if (hint == 0) {
+            iter->finished = true;
+        } else if (iter->in_pos == iter->in_len && dst_size == 0) {
+            // the frame isn't finished, but we've run out of input.
+            return DH_ERR_MALFORMED;
+        }
+    }
+
+    return DH_OK;
+}
+
+dh_result dh_column_iter_next(
+    struct dh_column_iter *iter,
+    const char **datapoints,
+    size_t *num_datapoints
+) {
+    if (iter == nullptr) return DH_ERR_INVALID_ARGUMENT;
+
+    dh_result res = fill(iter, 2);
+    if (res != DH_OK) return res;
+
+    if (iter->end == iter->start) return DH_DONE;
+    if (iter->end - iter->start < 2) return DH_ERR_MALFORMED;
+
+    const size_t count =
+        (size_t)(uint8_t)iter->data[iter->start + 0] << 8 |
+        (size_t)(uint8_t)iter->data[iter->start + 1] ;
+
+    res = fill(iter, 2 + count * 8);
+    if (res != DH_OK) return res;
+
+    if (iter->end - iter->start < 2 + count * 8) return DH_ERR_MALFORMED;
+
+    if (datapoints != nullptr) *datapoints = iter->data + iter->start + 2;
+    if (num_datapoints != nullptr) *num_datapoints = count;
+
+    iter->start += 2 + count * 8;
+    return DH_OK;
+}
+
+dh_result dh_column_iter_skip(
+    struct dh_column_iter *iter,
+    size_t n
+) {
+    while (n-- > 0) {
+        const dh_result res = dh_column_iter_next(iter, nullptr, nullptr);
+        if (res != DH_OK) return res;
+    }
+    return DH_OK;
+}
+
+void dh_column_iter_close(
+    struct dh_column_iter *iter
+) {
+    if (iter == nullptr) return;
+
+    if (iter->owns_dctx)
+        LZ4F_freeDecompressionContext(iter->lz4_dctx);
+    if (iter->buffer != nullptr)
+        iter->realloc(iter->buffer, 0);
+
+    iter->realloc(iter, 0);
+}
+
+dh_result dh_lod_column_offsets(
+    struct dh_lod *lod,
+    const uint32_t **offsets,
+    struct anvil_codec *codec
+) {
+    if (lod == nullptr || offsets == nullptr) return DH_ERR_INVALID_ARGUMENT;
+
+    dh_result res = dh_compress_ex(lod, DH_DATA_COMPRESSION_UNCOMPRESSED, 0, codec);
+    if (res != DH_OK) return res;
+
+    struct dh_lod_ext *ext;
+    res = dh_lod_ext_get(lod, &ext);
+    if (res != DH_OK) return res;
+
+    if (!ext->column_offsets_valid) {
+        if (ext->column_offsets == nullptr) {
+            ext->column_offsets = lod->realloc(nullptr, (64 * 64 + 1) * sizeof(*ext->column_offsets));
+            if (ext->column_offsets == nullptr) return DH_ERR_ALLOC;
+        }
+
+        const struct dh_lod_host *host = dh_lod_host_get(lod);
+        if (host != nullptr) {
+            // lod_arr was written from the host form, so every column is where it puts it, after a count for each.
+            for (size_t column = 0; column <= 64 * 64; column++) {
+                ext->column_offsets[column] = column * 2 + host->column_start[column] * 8;
+            }
+        } else {
+            const char *cursor = lod->lod_arr;
+            const char *end = lod->lod_arr + lod->lod_len;
+            for (size_t column = 0; column < 64 * 64; column++) {
+                if (end - cursor < 2) return DH_ERR_MALFORMED;
+                const size_t len = (uint8_t)cursor[0] << 8 | (uint8_t)cursor[1];
+                if ((size_t)(end - cursor - 2) < len * 8) return DH_ERR_MALFORMED;
+
+                ext->column_offsets[column] = cursor - lod->lod_arr;
+                cursor += 2 + len * 8;
+            }
+            ext->column_offsets[64 * 64] = cursor - lod->lod_arr;
+        }
+
+        ext->column_offsets_valid = true;
+    }
+
+    *offsets = ext->column_offsets;
+    return DH_OK;
+}
+
+dh_result dh_lod_column(
+    struct dh_lod *lod,
+    const int64_t x,
+    const int64_t z,
+    const char **datapoints,
+    size_t *num_datapoints,
+    struct anvil_codec *codec
+) {
+    if (x < 0 || x >= 64 || z < 0 || z >= 64) return DH_ERR_INVALID_ARGUMENT;
+
+    const uint32_t *offsets;
+    const dh_result res = dh_lod_column_offsets(lod, &offsets, codec);
+    if (res != DH_OK) return res;
+
+    const char *column = lod->lod_arr + offsets[x * 64 + z];
+    if (datapoints != nullptr) *datapoints = column + 2;
+    if (num_datapoints != nullptr) *num_datapoints = (uint8_t)column[0] << 8 | (uint8_t)column[1];
+    return DH_OK;
+}
@@ -66,11 +66,34 @@ dh_result dh_lod_mip(
     const int64_t mip_level,
     struct dh_lod **lods,
     const size_t num_lods
+) {
+    return dh_lod_mip_ex(lod, mip_level, lods, num_lods, nullptr);
+}
+
+dh_result dh_lod_mip_ex(
+    struct dh_lod *lod,
+    const int64_t mip_level,
+    struct dh_lod **lods,
+    const size_t num_lods,
+    struct anvil_codec *codec
+) {
+    return dh_lod_mip_policy(lod, mip_level, lods, num_lods, codec, DH_MIP_MODE);
+}
+
+dh_result dh_lod_mip_policy(
+    struct dh_lod *lod,
+    const int64_t mip_level,
+    struct dh_lod **lods,
+    const size_t num_lods,
+    struct anvil_codec *codec,
+    const int64_t policy
 ) {
     if (
         lod == nullptr  ||
         lods == nullptr ||
-        mip_level < 0
+        mip_level < 0   ||
+        policy < DH_MIP_MODE ||
+        policy > DH_MIP_FAST
     ) return DH_ERR_INVALID_ARGUMENT;
 
     if (
@@ -78,7 +101,7 @@ dh_result dh_lod_mip(
         all_have_mip_level(mip_level - 1, num_lods, lods) &&
         all_have_min_y(lods[0]->min_y, num_lods, lods)
     ) {
-        return dh_lod_mip_2x2(lod, lods);
+        return dh_lod_mip_2x2(lod, lods, codec, policy);
     }
 
     if (
@@ -86,7 +109,7 @@ dh_result dh_lod_mip(
         all_have_mip_level(mip_level - 2, num_lods, lods) &&
         all_have_min_y(lods[0]->min_y, num_lods, lods)
     ) {
-        return dh_lod_mip_4x4(lod, lods);
+        return dh_lod_mip_4x4(lod, lods, codec, policy);
     }
 
     if (
@@ -94,7 +117,7 @@ dh_result dh_lod_mip(
         all_have_mip_level(mip_level - 3, num_lods, lods) &&
         all_have_min_y(lods[0]->min_y, num_lods, lods)
     ) {
-        return dh_lod_mip_8x8(lod, lods);
+        return dh_lod_mip_8x8(lod, lods, codec, policy);
     }
 
     if (
@@ -102,7 +125,7 @@ dh_result dh_lod_mip(
         all_have_mip_level(mip_level - 4, num_lods, lods) &&
         all_have_min_y(lods[0]->min_y, num_lods, lods)
     ) {
-        return dh_lod_mip_16x16(lod, lods);
+        return dh_lod_mip_16x16(lod, lods, codec, policy);
     }
 
     if (
@@ -110,7 +133,7 @@ dh_result dh_lod_mip(
         all_have_mip_level(mip_level - 5, num_lods, lods) &&
         all_have_min_y(lods[0]->min_y, num_lods, lods)
     ) {
-        return dh_lod_mip_32x32(lod, lods);
+        return dh_lod_mip_32x32(lod, lods, codec, policy);
     }
 
     /**
@@ -122,7 +145,7 @@ dh_result dh_lod_mip(
         all_have_mip_level(mip_level - 6, num_lods, lods) &&
         all_have_min_y(lods[0]->min_y, num_lods, lods)
     ) {
-        return dh_lod_mip_64x64(lod, lods);
+        return dh_lod_mip_64x64(lod, lods, codec, policy);
     }
 
     return DH_ERR_UNSUPPORTED;
@@ -0,0 +1,465 @@
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <stdlib.h>
+#include <dh.h>
+#include "dh_lod.h"
+
+/// candidate ids kept per span. ids past this many are tracked approximately.
+#define CANDIDATES 4
+
+/**
+ * a run of y in a destination column with the same sources covering it.
+ * the candidates are a space-saving summary of the weight each id covers:
+ * when they're full a new id replaces the lightest, inheriting its weight,
+ * so any id covering more than 1/CANDIDATES of the span's weight is never lost.
+ */
+struct span {
+    uint16_t top;                   // y above the span.
+    uint16_t bottom;                // y of the bottom of the span.
+    uint32_t id[CANDIDATES];        // destination LOD ids.
+    float weight[CANDIDATES];       // area each id covers, zero for unused candidates.
+    float block_light;              // sum of block light * area.
+    float sky_light;                // sum of sky light * area.
+    float total;                    // area covered by any source.
+};
+
+struct column {
+    struct span *spans;             // ordered from the top down, without overlaps.
+    uint32_t len;
+    uint32_t cap;
+};
+
+struct any {
+    struct dh_lod *lod;
+    struct anvil_codec *codec;
+    int64_t mip_level;
+    int64_t x;
+    int64_t z;
+    bool has_min_y;
+
+    struct column *columns;         // 64x64 destination columns, x major.
+
+    struct span *temp;              // spans of a column being rebuilt.
+    size_t temp_cap;
+
+    struct dh_lod_host partial;     // a source's columns merged down to destination columns, one at a time.
+};
+
+static void add_candidate(struct span *span, const uint32_t id, const float weight) {
+    int lightest = 0;
+    for (int i = 0; i < CANDIDATES; i++) {
+        if (span->weight[i] > 0 && span->id[i] == id) {
+            span->weight[i] += weight;
+            return;
+        }
+        if (span->weight[i] < span->weight[lightest]) lightest = i;
+    }
+
+    span->id[lightest] = id;
+    span->weight[lightest] += weight;
+}
+
+/**
+ * adds a merged column of datapoints, each covering the given area, to a destination column.
+ * both are ordered from the top down, so they're merged in one pass,
+ * splitting spans wherever either one has a boundary.
+ */
+static dh_result accumulate(
+    struct any *any,
+    struct column *column,
+    const uint64_t *datapoints,
+    const size_t len,
+    const int64_t y_offset,
+    const float weight
+) {
+    // a column can't end up with more spans than both have boundaries.
+    const size_t needed = column->len + len * 2 + 1;
+    if (any->temp_cap < needed) {
+        struct span *new = any->lod->realloc(any->temp, needed * sizeof(struct span));
+        if (new == nullptr) return DH_ERR_ALLOC;
+        any->temp = new;
+        any->temp_cap = needed;
+    }
+
+    const struct span *old = column->spans;
+    struct span *out = any->temp;
+    size_t out_len = 0;
+
+    size_t i = 0, j = 0;
+    int64_t run_top = 0, run_bottom = 0;
+    uint64_t run = 0;
+
+    // loads the next datapoint that covers anything after shifting it to the destination's min y.
+    #define next_run() ({\
+        run_top = run_bottom = -1;\
+        while (j < len) {\
+            run = datapoints[j];\
+            run_bottom = (int64_t)DP_MIN_Y(run) + y_offset;\
+            run_top = run_bottom + (int64_t)DP_HEIGHT(run);\
+            if (run_bottom < 0) run_bottom = 0;\
+            if (run_top > 4095) run_top = 4095;\
+            if (run_top > run_bottom) break;\
+            j++;\
+        }\
+        if (j == len) run_top = run_bottom = -1;\
+    })
+
+    next_run();
+    int64_t y = INT64_MAX;
+
+    while (true) {
+        while (i < column->len && old[i].bottom >= y) i++;
+        while (j < len && run_bottom >= y) {
+            j++;
+            next_run();
+        }
+        if (i == column->len && j == len) break;
+
+        // the segment starts at y, or at the next top if nothing covers y.
+        const int64_t old_top = i < column->len ? (old[i].top < y ? old[i].top : y) : -1;
+        const int64_t new_top = j < len ? (run_top < y ? run_top : y) : -1;
+        const int64_t top = old_top > new_top ? old_top : new_top;
+
+        const bool in_old = i < column->len && old[i].top >= top;
+        const bool in_new = j < len && run_top >= top;
+
+        // and ends at the nearest boundary below it.
+        int64_t bottom = 0;
+        if (i < column->len) {
+            const int64_t b = in_old ? old[i].bottom : old[i].top;
+            if (b > bottom) bottom = b;
+        }
+        if (j < len) {
+            const int64_t b = in_new ? run_bottom : run_top;
+            if (b > bottom) bottom = b;
+        }
+
+        struct span span;
+        if (in_old) {
+            span = old[i];
+        } else {
+            memset(&span, 0, sizeof(span));
+        }
+        span.top = top;
+        span.bottom = bottom;
+
+        if (in_new) {
+            add_candidate(&span, DP_ID(run), weight);
+            span.block_light += (float)DP_BLOCK_LIGHT(run) * weight;
+            span.sky_light += (float)DP_SKY_LIGHT(run) * weight;
+            span.total += weight;
+        }
+
+        // neighbours left identical, by sources with boundaries elsewhere, are joined back up.
+        struct span *above = out_len > 0 ? &out[out_len - 1] : nullptr;
+        if (
+            above != nullptr && above->bottom == span.top &&
+            memcmp(above->id, span.id, sizeof(span) - offsetof(struct span, id)) == 0
+        ) {
+            above->bottom = span.bottom;
+        } else {
+            out[out_len++] = span;
+        }
+
+        y = bottom;
+    }
+
+    #undef next_run
+
+    if (column->cap < out_len) {
+        const uint32_t new_cap = out_len + out_len / 2;
+        struct span *new = any->lod->realloc(column->spans, new_cap * sizeof(struct span));
+        if (new == nullptr) return DH_ERR_ALLOC;
+        column->spans = new;
+        column->cap = new_cap;
+    }
+
+    if (out_len > 0) memcpy(column->spans, out, out_len * sizeof(struct span));
+    column->len = out_len;
+    return DH_OK;
+}
+
+/**
+ * merges a source LOD's columns down to the destination's resolution,
+ * and adds them to the destination columns they fall in.
+ */
+static dh_result add_source(struct any *any, struct dh_lod *src) {
+    if (src == nullptr) return DH_OK;
+    if (src->mip_level < 0 || src->mip_level >= any->mip_level) return DH_ERR_INVALID_ARGUMENT;
+
+    // destination columns are 1 << shift source columns wide.
+    const int64_t shift = any->mip_level - src->mip_level;
+
+    // columns merged into each partial column. sources above 6 levels down make a single partial.
+    const int64_t group_shift = shift < 6 ? shift : 6;
+    const size_t group = 1 << group_shift;
+    const int64_t partials = 64 >> group_shift;
+
+    // first destination column, relative to the destination LOD.
+    const int64_t first_x = dh_floor_shift(src->x * 64, shift) - any->x * 64;
+    const int64_t first_z = dh_floor_shift(src->z * 64, shift) - any->z * 64;
+    if (first_x + partials <= 0 || first_x >= 64 || first_z + partials <= 0 || first_z >= 64) return DH_OK;
+
+    // sources with a host form are read from it, the rest from their serialised data.
+    const struct dh_lod_host *src_host = dh_lod_host_get(src);
+    const uint32_t *offsets = nullptr;
+    dh_result res = DH_OK;
+    if (src_host == nullptr) res = dh_lod_column_offsets(src, &offsets, any->codec);
+    if (res != DH_OK) return res;
+
+    struct dh_lod *lod = any->lod;
+
+    if (!any->has_min_y) {
+        lod->min_y = src->min_y;
+        any->has_min_y = true;
+    }
+
+    uint32_t *id_mapping;
+    res = dh_lod_merge_mappings(lod, src, &id_mapping);
+    if (res != DH_OK) return res;
+
+    struct dh_lod_ext *ext;
+    res = dh_lod_ext_get(lod, &ext);
+    if (res != DH_OK) return res;
+
+    res = dh_lod_mip_reserve_ids(&ext->mip, lod);
+    if (res != DH_OK) return res;
+
+    // area each partial column covers, in blocks.
+    const float weight = (float)(group * group) * (float)(1ULL << (2 * src->mip_level));
+
+    // only the strips of partial columns that fall in the destination are read.
+    const int64_t first_partial = first_x < 0 ? -first_x : 0;
+    const int64_t last_partial = 64 - first_x < partials ? 64 - first_x : partials;
+
+    for (int64_t partial_x = first_partial; partial_x < last_partial; partial_x++) {
+        if (src_host != nullptr) {
+            res = dh_lod_mip_decode_host_strip(
+                &ext->mip,
+                lod->realloc,
+                src_host,
+                partial_x * group * 64,
+                group,
+                id_mapping,
+                src->mapping_len
+            );
+        } else {
+            res = dh_lod_mip_decode_strip(
+                &ext->mip,
+                lod->realloc,
+                src->lod_arr,
+                offsets,
+                partial_x * group * 64,
+                group,
+                id_mapping,
+                src->mapping_len
+            );
+        }
+        if (res != DH_OK) return res;
+
+        const int64_t column_x = first_x + partial_x;
+
+        for (int64_t partial_z = 0; partial_z < partials; partial_z++) {
+            const int64_t column_z = first_z + partial_z;
+            if (column_z < 0 || column_z >= 64) continue;
+
+            res = dh_lod_host_reset(&any->partial, lod->realloc);
+            if (res != DH_OK) return res;
+
+            res = dh_lod_mip_merge_column(&any->partial, &ext->mip, lod->realloc, group, partial_z * group, DH_MIP_MODE);
+            if (res != DH_OK) return res;
+
+            res = accumulate(
+                any,
+                &any->columns[column_x * 64 + column_z],
+                any->partial.datapoints,
+                any->partial.datapoints_len,
+                src->min_y - lod->min_y,
+                weight
+            );
+            if (res != DH_OK) return res;
+        }
+    }
+
+    return DH_OK;
+}
+
+/**
+ * writes every destination column, taking the heaviest id of each span and its area weighted light.
+ */
+static dh_result finish(struct any *any) {
+    struct dh_lod *lod = any->lod;
+
+    struct dh_lod_ext *ext;
+    dh_result res = dh_lod_ext_get(lod, &ext);
+    if (res != DH_OK) return res;
+
+    struct dh_lod_host *host = &ext->host;
+    res = dh_lod_host_reset(host, lod->realloc);
+    if (res != DH_OK) return res;
+
+    for (size_t c = 0; c < 64 * 64; c++) {
+        const struct column *column = &any->columns[c];
+
+        res = dh_lod_host_reserve(host, lod->realloc, column->len);
+        if (res != DH_OK) return res;
+
+        uint64_t *const start = host->datapoints + host->datapoints_len;
+        uint64_t *cursor = start;
+
+        uint64_t run = 0;
+        bool has_run = false;
+
+        for (uint32_t i = 0; i < column->len; i++) {
+            const struct span *span = &column->spans[i];
+
+            int heaviest = 0;
+            for (int k = 1; k < CANDIDATES; k++)
+                if (span->weight[k] > span->weight[heaviest]) heaviest = k;
+
+            const uint32_t id = span->id[heaviest];
+            if (has_run && DP_ID(run) == id && DP_MIN_Y(run) == span->top) {
+                run = DP_SET_HEIGHT(run, DP_HEIGHT(run) + span->top - span->bottom);
+                run = DP_SET_MIN_Y(run, span->bottom);
+                continue;
+            }
+
+            if (has_run) *cursor++ = run;
+
+            run = 0;
+            run = DP_SET_BLOCK_LIGHT(run, (uint64_t)(span->block_light / span->total + 0.5f));
+            run = DP_SET_SKY_LIGHT(run, (uint64_t)(span->sky_light / span->total + 0.5f));
+            run = DP_SET_MIN_Y(run, span->bottom);
+            run = DP_SET_HEIGHT(run, span->top - span->bottom);
+            run = DP_SET_ID(run, id);
+            has_run = true;
+        }
+
+        if (has_run) *cursor++ = run;
+
+        if (cursor > start) lod->has_data = true;
+        host->datapoints_len += cursor - start;
+        dh_lod_host_end_column(host);
+    }
+
+    host->valid = true;
+    host->pending = true;
+    return DH_OK;
+}
+
+static dh_result begin(
+    struct any *any,
+    struct dh_lod *lod,
+    const int64_t mip_level,
+    const int64_t x,
+    const int64_t z,
+    struct anvil_codec *codec
+) {
+    if (lod->realloc == nullptr) lod->realloc = realloc;
+
+    *any = (struct any){
+        .lod = lod,
+        .codec = codec,
+        .mip_level = mip_level,
+        .x = x,
+        .z = z,
+        .has_min_y = false,
+        .columns = lod->realloc(nullptr, 64 * 64 * sizeof(struct column)),
+        .temp = nullptr,
+        .temp_cap = 0,
+        .partial = DH_LOD_HOST_CLEAR,
+    };
+    if (any->columns == nullptr) return DH_ERR_ALLOC;
+
+    memset(any->columns, 0, 64 * 64 * sizeof(struct column));
+
+    struct dh_lod_ext *ext;
+    const dh_result res = dh_lod_ext_get(lod, &ext);
+    if (res != DH_OK) return res;
+
+    ext->beacons_valid = false;
+    ext->mip.ids_classified = 0;
+    dh_lod_data_replaced(lod);
+
+    lod->x = x;
+    lod->z = z;
+    lod->height = 0;
+    lod->min_y = 0;
+    lod->mip_level = mip_level;
+    lod->compression_mode = DH_DATA_COMPRESSION_UNCOMPRESSED;
+    lod->mapping_len = 0;
+    lod->lod_len = 0;
+    lod->has_data = false;
+    lod->checksum = 0;
+
+    return DH_OK;
+}
+
+static void end(struct any *any) {
+    if (any->columns != nullptr) {
+        for (size_t c = 0; c < 64 * 64; c++)
+            if (any->columns[c].spans != nullptr) any->lod->realloc(any->columns[c].spans, 0);
+        any->lod->realloc(any->columns, 0);
+    }
+
+    if (any->temp != nullptr) any->lod->realloc(any->temp, 0);
+    dh_lod_host_free(&any->partial, any->lod->realloc);
+}
+
+dh_result dh_lod_mip_any(
+    struct dh_lod *lod,
+    const int64_t mip_level,
+    const int64_t x,
+    const int64_t z,
+    struct dh_lod **lods,
+    const size_t num_lods,
+    struct anvil_codec *codec
+) {
+    if (lod == nullptr || (lods == nullptr && num_lods > 0) || mip_level < 1 || mip_level > 32)
+        return DH_ERR_INVALID_ARGUMENT;
+
+    struct any any;
+    dh_result res = begin(&any, lod, mip_level, x, z, codec);
+
+    for (size_t i = 0; i < num_lods && res == DH_OK; i++)
+        res = add_source(&any, lods[i]);
+
+    if (res == DH_OK) res = finish(&any);
+    end(&any);
+    return res;
+}
+
+dh_result dh_lod_mip_stream(
+    struct dh_lod *lod,
+    const int64_t mip_level,
+    const int64_t x,
+    const int64_t z,
+    int (*next)(struct dh_lod *src, void *user),
+    void *user,
+    struct anvil_codec *codec
+) {
+    if (lod == nullptr || next == nullptr || mip_level < 1 || mip_level > 32)
+        return DH_ERR_INVALID_ARGUMENT;
+
+    struct any any;
+    dh_result res = begin(&any, lod, mip_level, x, z, codec);
+
+    struct dh_lod src = DH_LOD_CLEAR;
+    src.realloc = lod->realloc;
+
+    while (res == DH_OK) {
+        const int more = next(&src, user);
+        if (more < 0) res = DH_ERR_INVALID_ARGUMENT;
+        if (more <= 0) break;
+
+        // next is free to fill src however it likes, so nothing worked out from the last source still holds.
+        dh_lod_data_replaced(&src);
+        res = add_source(&any, &src);
+    }
+
+    if (res == DH_OK) res = finish(&any);
+    dh_lod_free(&src);
+    end(&any);
+    return res;
+}
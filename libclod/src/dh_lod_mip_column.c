@@ -0,0 +1,268 @@
+#include <stdint.h>
+#include <string.h>
+#include <dh.h>
+#include "dh_lod.h"
+
+#define __DH_CONCAT(prefix, suffix) prefix##suffix
+#define DH_CONCAT(prefix, suffix) __DH_CONCAT(prefix, suffix)
+
+/**
+ * grows a scratch array to hold at least n elements, evaluating to false if it couldn't.
+ * the capacity is left for the caller to update, as some arrays share one.
+ */
+#define mip_reserve(realloc_f, arr, n) ({\
+    void *new = (realloc_f)((arr), (n) * sizeof(*(arr)));\
+    if (new != nullptr) (arr) = new;\
+    new != nullptr;\
+})
+
+static size_t mip_grow(const size_t cap, const size_t n) {
+    const size_t new_cap = (cap << 1) - (cap >> 1);
+    return new_cap < n ? n : new_cap;
+}
+
+/**
+ * makes room in the scratch arrays for a strip of the given columns and datapoints.
+ */
+static dh_result reserve_strip(
+    struct dh_mip_scratch *mip,
+    void *(*realloc_f)(void*, size_t),
+    const size_t columns,
+    const size_t datapoints
+) {
+    if (mip->column_start_cap < columns + 1) {
+        const size_t new_cap = mip_grow(mip->column_start_cap, columns + 1);
+        if (!mip_reserve(realloc_f, mip->column_start, new_cap)) return DH_ERR_ALLOC;
+        mip->column_start_cap = new_cap;
+    }
+
+    if (mip->datapoints_cap < datapoints) {
+        const size_t new_cap = mip_grow(mip->datapoints_cap, datapoints);
+        if (
+            !mip_reserve(realloc_f, mip->top, new_cap) ||
+            !mip_reserve(realloc_f, mip->bottom, new_cap) ||
+            !mip_reserve(realloc_f, mip->id, new_cap) ||
+            !mip_reserve(realloc_f, mip->light, new_cap)
+        ) return DH_ERR_ALLOC;
+        mip->datapoints_cap = new_cap;
+    }
+
+    return DH_OK;
+}
+
+/**
+ * adds a datapoint to the decoded strip after the d already in it, evaluating to false if its id isn't mapped.
+ */
+static inline bool decode_datapoint(
+    struct dh_mip_scratch *mip,
+    uint32_t *d,
+    const uint64_t dp,
+    const uint32_t *id_mapping,
+    const size_t mapping_len
+) {
+    // a datapoint without height would start and end at the same y, covering nothing.
+    if (DP_HEIGHT(dp) == 0) return true;
+    if (DP_ID(dp) >= mapping_len) return false;
+
+    mip->bottom[*d] = DP_MIN_Y(dp);
+    mip->top[*d] = DP_MIN_Y(dp) + DP_HEIGHT(dp);
+    mip->id[*d] = id_mapping[DP_ID(dp)];
+    mip->light[*d] = DP_BLOCK_LIGHT(dp) << 4 | DP_SKY_LIGHT(dp);
+    (*d)++;
+    return true;
+}
+
+dh_result dh_lod_mip_decode_strip(
+    struct dh_mip_scratch *mip,
+    void *(*realloc_f)(void*, size_t),
+    const char *data,
+    const uint32_t *offsets,
+    const size_t first_column,
+    const size_t rows,
+    const uint32_t *id_mapping,
+    const size_t mapping_len
+) {
+    const size_t columns = rows * 64;
+    if (64 * 64 - first_column < columns) return DH_ERR_INVALID_ARGUMENT;
+
+    // the offsets were checked against the data when they were found, so they're enough to count the datapoints.
+    const size_t bytes = offsets[first_column + columns] - offsets[first_column];
+    const dh_result res = reserve_strip(mip, realloc_f, columns, (bytes - columns * 2) / 8);
+    if (res != DH_OK) return res;
+
+    uint32_t d = 0;
+    for (size_t column = 0; column < columns; column++) {
+        const char *cursor = data + offsets[first_column + column];
+        const size_t len = (uint8_t)cursor[0] << 8 | (uint8_t)cursor[1];
+        cursor += 2;
+
+        mip->column_start[column] = d;
+        for (size_t i = 0; i < len; i++, cursor += 8) {
+            if (!decode_datapoint(mip, &d, dp_read(cursor), id_mapping, mapping_len)) return DH_ERR_MALFORMED;
+        }
+    }
+    mip->column_start[columns] = d;
+
+    return DH_OK;
+}
+
+dh_result dh_lod_mip_decode_host_strip(
+    struct dh_mip_scratch *mip,
+    void *(*realloc_f)(void*, size_t),
+    const struct dh_lod_host *host,
+    const size_t first_column,
+    const size_t rows,
+    const uint32_t *id_mapping,
+    const size_t mapping_len
+) {
+    const size_t columns = rows * 64;
+    if (host->columns - first_column < columns) return DH_ERR_INVALID_ARGUMENT;
+
+    const uint32_t first = host->column_start[first_column];
+    const uint32_t last = host->column_start[first_column + columns];
+
+    const dh_result res = reserve_strip(mip, realloc_f, columns, last - first);
+    if (res != DH_OK) return res;
+
+    uint32_t d = 0;
+    for (size_t column = 0; column < columns; column++) {
+        const uint32_t column_last = host->column_start[first_column + column + 1];
+
+        mip->column_start[column] = d;
+        for (uint32_t i = host->column_start[first_column + column]; i < column_last; i++) {
+            if (!decode_datapoint(mip, &d, host->datapoints[i], id_mapping, mapping_len)) return DH_ERR_MALFORMED;
+        }
+    }
+    mip->column_start[columns] = d;
+
+    return DH_OK;
+}
+
+/**
+ * whether a mapping is for one of the air blocks.
+ * mappings are the biome, "_DH-BSW_", the block name, then "_STATE_" and its properties.
+ */
+static bool is_air(const char *mapping) {
+    const char *names[] = { "minecraft:air", "minecraft:cave_air", "minecraft:void_air" };
+
+    const char *block = strstr(mapping, "_DH-BSW_");
+    if (block == nullptr) return false;
+    block += strlen("_DH-BSW_");
+
+    for (size_t i = 0; i < sizeof(names) / sizeof(*names); i++) {
+        const size_t len = strlen(names[i]);
+        if (strncmp(block, names[i], len) == 0 && (block[len] == '\0' || block[len] == '_')) return true;
+    }
+    return false;
+}
+
+dh_result dh_lod_mip_reserve_ids(
+    struct dh_mip_scratch *mip,
+    const struct dh_lod *lod
+) {
+    const size_t ids = lod->mapping_len;
+
+    if (mip->ids_cap < ids) {
+        const size_t new_cap = mip_grow(mip->ids_cap, ids);
+        if (
+            !mip_reserve(lod->realloc, mip->id_count, new_cap) ||
+            !mip_reserve(lod->realloc, mip->active_ids, new_cap) ||
+            !mip_reserve(lod->realloc, mip->active_index, new_cap) ||
+            !mip_reserve(lod->realloc, mip->id_air, new_cap)
+        ) return DH_ERR_ALLOC;
+
+        memset(mip->id_count + mip->ids_cap, 0, (new_cap - mip->ids_cap) * sizeof(*mip->id_count));
+        mip->ids_cap = new_cap;
+    }
+
+    for (; mip->ids_classified < ids; mip->ids_classified++) {
+        mip->id_air[mip->ids_classified] = is_air(lod->mapping_arr[mip->ids_classified]);
+    }
+
+    return DH_OK;
+}
+
+#define DH_MIP_POLICY DH_MIP_MODE
+#define DH_MIP_POLICY_NAME _mode
+#include "dh_lod_mip_merge.c"
+#undef DH_MIP_POLICY
+#undef DH_MIP_POLICY_NAME
+
+#define DH_MIP_POLICY DH_MIP_SURFACE
+#define DH_MIP_POLICY_NAME _surface
+#include "dh_lod_mip_merge.c"
+#undef DH_MIP_POLICY
+#undef DH_MIP_POLICY_NAME
+
+#define DH_MIP_POLICY DH_MIP_HEIGHT_WEIGHTED
+#define DH_MIP_POLICY_NAME _height_weighted
+#include "dh_lod_mip_merge.c"
+#undef DH_MIP_POLICY
+#undef DH_MIP_POLICY_NAME
+
+/**
+ * copies a single decoded column, joining datapoints that have the same id and light and touch.
+ */
+static dh_result copy_column(
+    struct dh_lod_host *out,
+    const struct dh_mip_scratch *mip,
+    void *(*realloc_f)(void*, size_t),
+    const size_t column_index
+) {
+    const uint32_t first = mip->column_start[column_index];
+    const uint32_t last = mip->column_start[column_index + 1];
+
+    const dh_result res = dh_lod_host_reserve(out, realloc_f, last - first);
+    if (res != DH_OK) return res;
+
+    uint64_t *const column = out->datapoints + out->datapoints_len;
+    uint64_t *cursor = column;
+
+    uint64_t run = 0;
+    bool has_run = false;
+
+    for (uint32_t d = first; d < last; d++) {
+        if (
+            has_run &&
+            DP_ID(run) == mip->id[d] &&
+            DP_MIN_Y(run) == mip->top[d] &&
+            (DP_BLOCK_LIGHT(run) << 4 | DP_SKY_LIGHT(run)) == mip->light[d]
+        ) {
+            run = DP_SET_HEIGHT(run, DP_HEIGHT(run) + mip->top[d] - mip->bottom[d]);
+            run = DP_SET_MIN_Y(run, mip->bottom[d]);
+            continue;
+        }
+
+        if (has_run) *cursor++ = run;
+
+        run = 0;
+        run = DP_SET_BLOCK_LIGHT(run, mip->light[d] >> 4);
+        run = DP_SET_SKY_LIGHT(run, mip->light[d] & 0xF);
+        run = DP_SET_MIN_Y(run, mip->bottom[d]);
+        run = DP_SET_HEIGHT(run, mip->top[d] - mip->bottom[d]);
+        run = DP_SET_ID(run, mip->id[d]);
+        has_run = true;
+    }
+
+    if (has_run) *cursor++ = run;
+
+    out->datapoints_len += cursor - column;
+    dh_lod_host_end_column(out);
+    return DH_OK;
+}
+
+dh_result dh_lod_mip_merge_column(
+    struct dh_lod_host *out,
+    struct dh_mip_scratch *mip,
+    void *(*realloc_f)(void*, size_t),
+    const size_t size,
+    const size_t first_column,
+    const int64_t policy
+) {
+    switch (policy) {
+        case DH_MIP_SURFACE: return merge_column_surface(out, mip, realloc_f, size, first_column);
+        case DH_MIP_HEIGHT_WEIGHTED: return merge_column_height_weighted(out, mip, realloc_f, size, first_column);
+        case DH_MIP_FAST: return copy_column(out, mip, realloc_f, first_column);
+        default: return merge_column_mode(out, mip, realloc_f, size, first_column);
+    }
+}
@@ -0,0 +1,184 @@
+#ifdef DH_MIP_POLICY
+
+/**
+ * the sweep that merges size x size decoded columns, specialised for each id policy.
+ * DH_MIP_POLICY is one of DH_MIP_MODE, DH_MIP_SURFACE and DH_MIP_HEIGHT_WEIGHTED,
+ * and everything depending on it is resolved at compile time.
+ */
+
+#if DH_MIP_POLICY == DH_MIP_HEIGHT_WEIGHTED
+#define WEIGHT(mip, d) ((uint32_t)((mip)->top[d] - (mip)->bottom[d]))
+#else
+#define WEIGHT(mip, d) 1u
+#endif
+
+/**
+ * whether an id takes part in picking the id of a span.
+ * with the surface policy air only counts when nothing else covers the span.
+ */
+static inline bool DH_CONCAT(votes, DH_MIP_POLICY_NAME)(
+    const struct dh_mip_scratch *mip,
+    const uint32_t id,
+    const uint32_t solid
+) {
+    return DH_MIP_POLICY != DH_MIP_SURFACE || solid == 0 || !mip->id_air[id];
+}
+
+#define votes DH_CONCAT(votes, DH_MIP_POLICY_NAME)
+
+static dh_result DH_CONCAT(merge_column, DH_MIP_POLICY_NAME)(
+    struct dh_lod_host *out,
+    struct dh_mip_scratch *mip,
+    void *(*realloc_f)(void*, size_t),
+    const size_t size,
+    const size_t first_column
+) {
+    uint32_t lo = UINT32_MAX, hi = 0;
+    size_t events = 0;
+    for (size_t row = 0; row < size; row++) {
+        const uint32_t first = mip->column_start[row * 64 + first_column];
+        const uint32_t last = mip->column_start[row * 64 + first_column + size];
+
+        for (uint32_t d = first; d < last; d++) {
+            if (mip->bottom[d] < lo) lo = mip->bottom[d];
+            if (mip->top[d] > hi) hi = mip->top[d];
+        }
+        events += (last - first) * 2;
+    }
+
+    // there can't be more spans than boundaries.
+    const dh_result res = dh_lod_host_reserve(out, realloc_f, events);
+    if (res != DH_OK) return res;
+
+    uint64_t *const column = out->datapoints + out->datapoints_len;
+    uint64_t *cursor = column;
+
+    if (events > 0) {
+        const size_t buckets = hi - lo + 1;
+
+        if (mip->events_cap < events) {
+            const size_t new_cap = mip_grow(mip->events_cap, events);
+            if (!mip_reserve(realloc_f, mip->events, new_cap)) return DH_ERR_ALLOC;
+            mip->events_cap = new_cap;
+        }
+
+        if (mip->buckets_cap < buckets) {
+            const size_t new_cap = mip_grow(mip->buckets_cap, buckets);
+            if (!mip_reserve(realloc_f, mip->buckets, new_cap)) return DH_ERR_ALLOC;
+            mip->buckets_cap = new_cap;
+        }
+
+        // counting sort, from the highest y to the lowest.
+        memset(mip->buckets, 0, buckets * sizeof(*mip->buckets));
+        for (size_t row = 0; row < size; row++) {
+            const uint32_t first = mip->column_start[row * 64 + first_column];
+            const uint32_t last = mip->column_start[row * 64 + first_column + size];
+
+            for (uint32_t d = first; d < last; d++) {
+                mip->buckets[mip->top[d] - lo]++;
+                mip->buckets[mip->bottom[d] - lo]++;
+            }
+        }
+
+        uint32_t start = 0;
+        for (size_t bucket = buckets; bucket-- > 0;) {
+            const uint32_t count = mip->buckets[bucket];
+            mip->buckets[bucket] = start;
+            start += count;
+        }
+
+        for (size_t row = 0; row < size; row++) {
+            const uint32_t first = mip->column_start[row * 64 + first_column];
+            const uint32_t last = mip->column_start[row * 64 + first_column + size];
+
+            for (uint32_t d = first; d < last; d++) {
+                mip->events[mip->buckets[mip->top[d] - lo]++] = d << 1 | 1;
+                mip->events[mip->buckets[mip->bottom[d] - lo]++] = d << 1;
+            }
+        }
+
+        uint32_t active_ids = 0, covered = 0, solid = 0;
+        uint32_t block_light = 0, sky_light = 0;
+        uint32_t span_top = hi;
+
+        uint64_t run = 0;
+        bool has_run = false;
+
+        for (size_t i = 0; i < events; i++) {
+            const uint32_t event = mip->events[i];
+            const uint32_t d = event >> 1;
+            const uint32_t y = event & 1 ? mip->top[d] : mip->bottom[d];
+
+            if (y != span_top && covered > 0) {
+                // ties go to the span above, so runs aren't broken up for nothing.
+                uint32_t mode = 0, mode_count = 0;
+                if (has_run && votes(mip, DP_ID(run), solid)) {
+                    mode = DP_ID(run);
+                    mode_count = mip->id_count[mode];
+                }
+                for (uint32_t j = 0; j < active_ids; j++) {
+                    const uint32_t id = mip->active_ids[j];
+                    if (!votes(mip, id, solid)) continue;
+                    if (mip->id_count[id] > mode_count) {
+                        mode = id;
+                        mode_count = mip->id_count[id];
+                    }
+                }
+
+                if (has_run && DP_ID(run) == mode && DP_MIN_Y(run) == span_top) {
+                    run = DP_SET_HEIGHT(run, DP_HEIGHT(run) + span_top - y);
+                    run = DP_SET_MIN_Y(run, y);
+                } else {
+                    if (has_run) *cursor++ = run;
+
+                    run = 0;
+                    run = DP_SET_BLOCK_LIGHT(run, block_light / (size * size));
+                    run = DP_SET_SKY_LIGHT(run, sky_light / (size * size));
+                    run = DP_SET_MIN_Y(run, y);
+                    run = DP_SET_HEIGHT(run, span_top - y);
+                    run = DP_SET_ID(run, mode);
+                    has_run = true;
+                }
+            }
+            span_top = y;
+
+            const uint32_t id = mip->id[d];
+            if (event & 1) {
+                // the top of a datapoint, it covers everything down to its bottom.
+                if (mip->id_count[id] == 0) {
+                    mip->active_index[id] = active_ids;
+                    mip->active_ids[active_ids++] = id;
+                }
+                mip->id_count[id] += WEIGHT(mip, d);
+
+                covered++;
+                if (DH_MIP_POLICY == DH_MIP_SURFACE && !mip->id_air[id]) solid++;
+                block_light += mip->light[d] >> 4;
+                sky_light += mip->light[d] & 0xF;
+            } else {
+                mip->id_count[id] -= WEIGHT(mip, d);
+                if (mip->id_count[id] == 0) {
+                    const uint32_t moved = mip->active_ids[--active_ids];
+                    mip->active_ids[mip->active_index[id]] = moved;
+                    mip->active_index[moved] = mip->active_index[id];
+                }
+
+                covered--;
+                if (DH_MIP_POLICY == DH_MIP_SURFACE && !mip->id_air[id]) solid--;
+                block_light -= mip->light[d] >> 4;
+                sky_light -= mip->light[d] & 0xF;
+            }
+        }
+
+        if (has_run) *cursor++ = run;
+    }
+
+    out->datapoints_len += cursor - column;
+    dh_lod_host_end_column(out);
+    return DH_OK;
+}
+
+#undef votes
+#undef WEIGHT
+
+#endif
@@ -12,13 +12,6 @@
 #define __DH_CONCAT(prefix, suffix) prefix##suffix
 #define DH_CONCAT(prefix, suffix) __DH_CONCAT(prefix, suffix)
 
-#define read_check_column_len(data, end) ({\
-    if (data + 2 <= end) return DH_ERR_MALFORMED;\
-    int64_t value = (uint8_t)data[0] << 8 | (uint8_t)data[1];\
-    if (data + 2 + value * 8 <= end) return DH_ERR_MALFORMED;\
-    value;\
-})
-
 /**
  * I believe there are times when it's beneficial to have the code be more straightforward -
  * reflect the complexity of the task that it's performing without hiding it behind abstractions.
@@ -31,10 +24,20 @@
  * I don't care if you spend the time understanding how this particular method works, or completely rewrite it from scratch.
  * Just make sure you understand the bigger picture.
  * Don't cut corners. Mipping is a complex task - give it the respect it deserves.
+ *
+ * Source LODs are walked in strips of SIZE rows of columns, the rows one row of destination columns is made from.
+ * A strip is decoded into the LOD's mip scratch arrays once, and each of its destination columns is merged from there,
+ * so the working set stays around a strip's worth of datapoints rather than the whole source LOD.
+ * Sources that were themselves generated or mipped are read from their host form, so they're never serialised
+ * or decompressed on the way, and the result is left in the LOD's host form until something serialises it.
+ * Other sources are read through their column offsets, so strips are found directly, even when rows are skipped.
+ * Nothing is allocated once the scratch arrays have grown to fit.
  */
 dh_result DH_CONCAT(dh_lod_mip, DH_MIP_NAME)(
     struct dh_lod *lod,
-    struct dh_lod **src
+    struct dh_lod **src,
+    struct anvil_codec *codec,
+    const int64_t policy
 ) {
     if (
         lod == NULL ||
@@ -47,15 +50,12 @@ dh_result DH_CONCAT(dh_lod_mip, DH_MIP_NAME)(
     dh_result res = dh_lod_ext_get(lod, &ext);
     if (res != DH_OK) return res;
 
-    if (ext->big_buffer_cap > lod->lod_cap) {
-        char *tmp = lod->lod_arr;
-        lod->lod_arr = ext->big_buffer;
-        ext->big_buffer = tmp;
+    ext->beacons_valid = false;
+    ext->column_offsets_valid = false;
 
-        const auto tmp_cap = lod->lod_cap;
-        lod->lod_cap = ext->big_buffer_cap;
-        ext->big_buffer_cap = tmp_cap;
-    }
+    struct dh_lod_host *host = &ext->host;
+    res = dh_lod_host_reset(host, lod->realloc);
+    if (res != DH_OK) return res;
 
     lod->x = 0;
     lod->z = 0;
@@ -66,195 +66,80 @@ dh_result DH_CONCAT(dh_lod_mip, DH_MIP_NAME)(
     lod->mapping_len = 0;
     lod->lod_len = 0;
     lod->has_data = false;
+    lod->checksum = 0;
 
-    // allocate everything on the stack. 83456 bytes in total for DH_MIP_LEVELS = 6.
-    // I'm worried that this might be a bit too much for the stack.
+    struct dh_mip_scratch *mip = &ext->mip;
+    mip->ids_classified = 0;
 
-    char *end[SIZE];
-    char *z_cursor[SIZE];
-    char *cursors[SIZE * SIZE];
-    uint32_t *id_mapping[SIZE];      // source LOD -> destination LOD id lookup.
-    uint16_t remaining[SIZE * SIZE]; // number of remaining datapoints + 1.
-    uint16_t next_y[SIZE * SIZE];    // next datapoint transition.
-    char *datapoints[SIZE * SIZE];   // current datapoint cursor.
+    // the fast policy only looks at the first row of each strip.
+    const size_t rows = policy == DH_MIP_FAST ? 1 : SIZE;
 
-    // loop over our LODs in x,
-    // initialise the cursors for these LODs.
-    for (int lod_x = 0; lod_x < SIZE; ++lod_x) {
+    // one of each for the row of source LODs being mipped.
+    // sources are read from their host form if they have one, and their serialised data otherwise.
+    const struct dh_lod_host *src_host[SIZE];
+    const char *data[SIZE];
+    const uint32_t *offsets[SIZE];
+    uint32_t *id_mapping[SIZE];     // source LOD -> destination LOD id lookup.
+    size_t mapping_len[SIZE];
+
+    for (int lod_x = 0; lod_x < SIZE; lod_x++) {
 
-        for (int lod_z = 0; lod_z < SIZE; ++lod_z) {
+        for (int lod_z = 0; lod_z < SIZE; lod_z++) {
             struct dh_lod *src_lod = src[lod_x * SIZE + lod_z];
 
-            end[lod_z] = src_lod->lod_arr + src_lod->lod_len;
-            cursors[lod_z] = src_lod->lod_arr;
+            src_host[lod_z] = dh_lod_host_get(src_lod);
+            if (src_host[lod_z] == nullptr) {
+                res = dh_lod_column_offsets(src_lod, &offsets[lod_z], codec);
+                if (res != DH_OK) return res;
+            }
 
-            res = dh_compress(src_lod, DH_DATA_COMPRESSION_UNCOMPRESSED, 0);
-            if (res != DH_OK) return res;
+            data[lod_z] = src_lod->lod_arr;
+            mapping_len[lod_z] = src_lod->mapping_len;
 
-            res = dh_lod_merge_mappings(
-                lod, src_lod, &id_mapping[lod_z]
-            );
+            res = dh_lod_merge_mappings(lod, src_lod, &id_mapping[lod_z]);
             if (res != DH_OK) return res;
         }
 
-    // no we have our LODs setup, iterate block-by-block on x.
-    for (int sample_x = 0; sample_x < 64 / SIZE; sample_x++)
-    for (
-        int lod_z = 0
-    ;
-        lod_z < SIZE
-    ;
-        // store our position for when we come back to this lod.
-        z_cursor[lod_z] =         cursors[SIZE * SIZE - 1] + 2 + 8 *
-            read_check_column_len(cursors[SIZE * SIZE - 1], end[lod_z]),
-        lod_z++
-    ) {
-
-        // load our previous position and derive our view from it.
-        cursors[0] = z_cursor[lod_z];
-        for (int cz = 1; cz < SIZE; cz++)
-            cursors[cz] =             cursors[cz - 1] + 2 + 8 *
-                read_check_column_len(cursors[cz - 1], end[lod_z]);
-
-        for (int cx = 1; cx < SIZE; cx++) {
-            cursors[cx * SIZE] = cursors[cx * SIZE - 1];
-            for (int cz = SIZE - 1; cz < 64; cz++)
-                cursors[cx * SIZE] =      cursors[cx * SIZE] + 2 + 8 *
-                    read_check_column_len(cursors[cx * SIZE], end[lod_z]);
-
-            for (int cz = 1; cz < SIZE; cz++) {
-                cursors[cx * SIZE + cz] = cursors[cx * SIZE + cz - 1] + 2 + 8 *
-                    read_check_column_len(cursors[cx * SIZE + cz - 1], end[lod_z]);
-            }
-        }
-
-    for (
-        int sample_z = 0
-    ;
-        sample_z < 64 / SIZE
-    ;
-        ({
-        // move the cursors to the next z position
-        for (int cx = 0; cx < SIZE; cx++) {
-            cursors[cx * SIZE] =      cursors[cx * SIZE + SIZE - 1] + 2 + 8 *
-                read_check_column_len(cursors[cx * SIZE + SIZE - 1], end[lod_z]);
-
-            for (int cz = 1; cz < SIZE; cz++)
-                cursors[cz * SIZE + cz] = cursors[cz * SIZE + cz - 1] + 2 + 8 *
-                    read_check_column_len(cursors[cz * SIZE + cz - 1], end[lod_z]);
-        }
-        sample_z++;
-        })
-    ) {
-
-        // get setup to iterate down the columns
-        for (int i = 0; i < SIZE * SIZE; i++) {
-            remaining[i] = read_check_column_len(cursors[i], end[lod_z]);
-            if (remaining[i]) {
-                const uint64_t datapoint = dp_read(cursors[i] + 1);
-                next_y[i] = DP_MIN_Y(datapoint) + DP_HEIGHT(datapoint) + 1;
+        res = dh_lod_mip_reserve_ids(mip, lod);
+        if (res != DH_OK) return res;
+
+        for (int sample_x = 0; sample_x < 64 / SIZE; sample_x++)
+        for (int lod_z = 0; lod_z < SIZE; lod_z++) {
+
+            if (src_host[lod_z] != nullptr) {
+                res = dh_lod_mip_decode_host_strip(
+                    mip,
+                    lod->realloc,
+                    src_host[lod_z],
+                    sample_x * SIZE * 64,
+                    rows,
+                    id_mapping[lod_z],
+                    mapping_len[lod_z]
+                );
             } else {
-                next_y[i] = 0;
-            }
-            datapoints[i] = nullptr;
-        }
-
-        char *cursor = lod->lod_arr + lod->lod_len + 2;
-        uint_fast16_t min_y = 0, height;
-        uint64_t last_datapoint = 0;
-
-        last_datapoint = DP_SET_SKY_LIGHT(last_datapoint, 0xF);
-
-        for (int i = 0; i < SIZE; i++) if (next_y[i] > min_y) min_y = next_y[i];
-
-    while (({
-        uint_fast16_t remaining_total = 0;
-        for (int i = 0; i < SIZE; i++) if (next_y[i] == min_y && remaining[i] > 0) {
-            if (remaining[i] == 1) {
-                // transitioning out of the last datapoint
-                datapoints[i] = nullptr;
-                next_y[i] = 0;
-                remaining[i]--;
-                continue;
+                res = dh_lod_mip_decode_strip(
+                    mip,
+                    lod->realloc,
+                    data[lod_z],
+                    offsets[lod_z],
+                    sample_x * SIZE * 64,
+                    rows,
+                    id_mapping[lod_z],
+                    mapping_len[lod_z]
+                );
             }
+            if (res != DH_OK) return res;
 
-            if (datapoints[i] == nullptr) {
-                // transitioning into first datapoint
-                datapoints[i] = cursors[i] + 2;
-            } else {
-                // transitioning from one datapoint to the next
-                datapoints[i] += 8;
-                remaining[i]--;
-            }
-
-            remaining_total += remaining[i];
-            next_y[i] = DP_MIN_Y(dp_read(datapoints[i]));
-        }
-
-        uint_fast16_t next_min_y = 0;
-        for (int i = 0; i < SIZE; i++) if (next_y[i] > next_min_y) next_min_y = next_y[i];
-
-        height = min_y - next_min_y;
-        min_y = next_min_y;
-        remaining_total > 0;
-    })) {
-        uint32_t id_mode = 0;
-        uint32_t total_block_light = 0, total_sky_light = 0;
-        int id_count = 0;
-        for (int i = 0; i < SIZE * SIZE; i++) if (datapoints[i] != nullptr) {
-            int c = 0;
-            const register uint64_t dp = dp_read(datapoints[i]);
-
-            for (int j = 0; j < SIZE * SIZE; j++) if (datapoints[j] != nullptr)
-                if (DP_ID(dp) == DP_ID(dp_read(datapoints[j])))
-                    c++;
-
-            total_block_light += DP_BLOCK_LIGHT(dp);
-            total_sky_light += DP_SKY_LIGHT(dp);
-
-            if (c > id_count) {
-                id_count = c;
-                id_mode = DP_ID(dp);
+            for (int sample_z = 0; sample_z < 64 / SIZE; sample_z++) {
+                res = dh_lod_mip_merge_column(host, mip, lod->realloc, SIZE, sample_z * SIZE, policy);
+                if (res != DH_OK) return res;
             }
         }
-
-        if (DP_ID(last_datapoint) == id_mode) {
-            last_datapoint = DP_SET_HEIGHT(last_datapoint, DP_HEIGHT(last_datapoint) + height);
-            last_datapoint = DP_SET_MIN_Y(last_datapoint, min_y);
-
-            continue;
-        }
-
-        if (DP_HEIGHT(last_datapoint) > 0) {
-            last_datapoint = DP_SET_ID(last_datapoint, id_mapping[lod_z][DP_ID(last_datapoint)]);
-            dp_write(cursor, last_datapoint);
-            cursor += 8;
-        }
-
-        last_datapoint = 0;
-        last_datapoint = DP_SET_SKY_LIGHT(last_datapoint, total_sky_light / (SIZE * SIZE));
-        last_datapoint = DP_SET_BLOCK_LIGHT(last_datapoint, total_block_light / (SIZE * SIZE));
-        last_datapoint = DP_SET_MIN_Y(last_datapoint, min_y);
-        last_datapoint = DP_SET_HEIGHT(last_datapoint, height);
-        last_datapoint = DP_SET_ID(last_datapoint, id_mode);
-    }
-
-        if (DP_HEIGHT(last_datapoint) > 0) {
-            last_datapoint = DP_SET_ID(last_datapoint, id_mapping[lod_z][DP_ID(last_datapoint)]);
-            dp_write(cursor, last_datapoint);
-            cursor += 8;
-        }
-
-        const auto c = (cursor - 2 - lod->lod_arr - lod->lod_len) / 8;
-        if (c > 0) lod->has_data = true;
-        (lod->lod_arr + lod->lod_len)[0] = (char)(c >> (1 * 8) & 0xFF);
-        (lod->lod_arr + lod->lod_len)[1] = (char)(c >> (0 * 8) & 0xFF);
-        lod->lod_len = cursor - lod->lod_arr;
-
-    }
-    }
     }
 
+    lod->has_data = host->datapoints_len > 0;
+    host->valid = true;
+    host->pending = true;
     return DH_OK;
 }
 
@@ -419,4 +304,4 @@ dh_result dh_from_one_below(
 }
 */
 
-#undef read_check_column_len
+#undef SIZE
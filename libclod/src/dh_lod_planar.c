@@ -0,0 +1,225 @@
+#include <stdint.h>
+#include <string.h>
+
+#include <dh.h>
+
+#include "dh_lod.h"
+
+/**
+ * the planar form is a reversible rearrangement of serialised LOD data.
+ * it exists because general purpose compressors are byte oriented,
+ * and the interleaved 64 bit datapoints hide the structure that the data has.
+ *
+ * neighbouring columns are usually near identical, and within a column,
+ * each datapoint sits directly below the last. fields are split into their own planes,
+ * and multibyte fields are split further into one plane per byte, most significant first,
+ * so that the mostly-zero high bytes end up next to each other.
+ *
+ *   u32          column count (C)
+ *   u32          datapoint count (D)
+ *   C bytes x 2  datapoint count of each column
+ *   D bytes      block light << 4 | sky light
+ *   D bytes x 2  zig-zagged min_y residual
+ *   D bytes x 2  height
+ *   D bytes x 4  zig-zagged id delta
+ *
+ * the min_y residual is the difference from where the datapoint would sit if it
+ * directly followed the datapoint above it, or for the first datapoint in a column,
+ * if its top was level with the top of the previous column. for LODs made by
+ * dh_from_chunks, it is almost always zero.
+ *
+ * the id delta is taken from the previous datapoint, carried across columns.
+ */
+
+#define PLANAR_HEADER_SIZE 8
+#define PLANAR_DATAPOINT_SIZE (1 + 2 + 2 + 4)
+
+static uint32_t zig_zag(const int32_t v) {
+    return (uint32_t)v << 1 ^ (uint32_t)(v >> 31);
+}
+
+static int32_t un_zig_zag(const uint32_t v) {
+    return (int32_t)(v >> 1 ^ -(v & 1));
+}
+
+static dh_result ensure_out(
+    char **out,
+    size_t *out_cap,
+    const size_t n,
+    void *(*realloc_f)(void*, size_t)
+) {
+    if (*out_cap < n) {
+        char *new = realloc_f(*out, n);
+        if (new == nullptr) return DH_ERR_ALLOC;
+
+        *out = new;
+        *out_cap = n;
+    }
+
+    return DH_OK;
+}
+
+dh_result dh_lod_planar_split(
+    const char *in,
+    const size_t in_len,
+    char **out,
+    size_t *out_cap,
+    size_t *out_len,
+    void *(*realloc_f)(void*, size_t)
+) {
+    const char *cursor = in;
+    const char *end = in + in_len;
+    size_t columns = 0, datapoints = 0;
+
+    while (cursor < end) {
+        if (cursor + 2 > end) return DH_ERR_MALFORMED;
+        const size_t count = (uint8_t)cursor[0] << 8 | (uint8_t)cursor[1];
+        if (cursor + 2 + count * 8 > end) return DH_ERR_MALFORMED;
+
+        cursor += 2 + count * 8;
+        datapoints += count;
+        columns++;
+    }
+
+    if (columns > UINT32_MAX || datapoints > UINT32_MAX) return DH_ERR_UNSUPPORTED;
+
+    const size_t size = PLANAR_HEADER_SIZE + columns * 2 + datapoints * PLANAR_DATAPOINT_SIZE;
+    const dh_result res = ensure_out(out, out_cap, size, realloc_f);
+    if (res != DH_OK) return res;
+
+    char *o = *out;
+    o[0] = (char)(columns >> 24); o[1] = (char)(columns >> 16); o[2] = (char)(columns >> 8); o[3] = (char)columns;
+    o[4] = (char)(datapoints >> 24); o[5] = (char)(datapoints >> 16); o[6] = (char)(datapoints >> 8); o[7] = (char)datapoints;
+
+    char *count_hi  = o + PLANAR_HEADER_SIZE;
+    char *count_lo  = count_hi  + columns;
+    char *light     = count_lo  + columns;
+    char *min_y_hi  = light     + datapoints;
+    char *min_y_lo  = min_y_hi  + datapoints;
+    char *height_hi = min_y_lo  + datapoints;
+    char *height_lo = height_hi + datapoints;
+    char *id_3      = height_lo + datapoints;
+    char *id_2      = id_3      + datapoints;
+    char *id_1      = id_2      + datapoints;
+    char *id_0      = id_1      + datapoints;
+
+    int32_t column_top = 0;
+    uint32_t last_id = 0;
+    size_t d = 0;
+
+    cursor = in;
+    for (size_t c = 0; c < columns; c++) {
+        count_hi[c] = cursor[0];
+        count_lo[c] = cursor[1];
+        const size_t count = (uint8_t)cursor[0] << 8 | (uint8_t)cursor[1];
+        cursor += 2;
+
+        int32_t bottom = column_top;
+        for (size_t i = 0; i < count; i++, d++, cursor += 8) {
+            const uint64_t dp = dp_read(cursor);
+            const auto min_y  = (int32_t)DP_MIN_Y(dp);
+            const auto height = (int32_t)DP_HEIGHT(dp);
+            const auto id     = (uint32_t)DP_ID(dp);
+
+            const uint32_t residual = zig_zag(bottom - height - min_y);
+            const uint32_t id_delta = zig_zag((int32_t)(id - last_id));
+
+            if (i == 0) column_top = min_y + height;
+            bottom = min_y;
+            last_id = id;
+
+            light[d]     = (char)(DP_BLOCK_LIGHT(dp) << 4 | DP_SKY_LIGHT(dp));
+            min_y_hi[d]  = (char)(residual >> 8);
+            min_y_lo[d]  = (char)residual;
+            height_hi[d] = (char)(height >> 8);
+            height_lo[d] = (char)height;
+            id_3[d]      = (char)(id_delta >> 24);
+            id_2[d]      = (char)(id_delta >> 16);
+            id_1[d]      = (char)(id_delta >> 8);
+            id_0[d]      = (char)id_delta;
+        }
+    }
+
+    *out_len = size;
+    return DH_OK;
+}
+
+dh_result dh_lod_planar_join(
+    const char *in,
+    const size_t in_len,
+    char **out,
+    size_t *out_cap,
+    size_t *out_len,
+    void *(*realloc_f)(void*, size_t)
+) {
+    if (in_len < PLANAR_HEADER_SIZE) return DH_ERR_MALFORMED;
+
+    const size_t columns =
+        (size_t)(uint8_t)in[0] << 24 | (size_t)(uint8_t)in[1] << 16 |
+        (size_t)(uint8_t)in[2] << 8  | (size_t)(uint8_t)in[3];
+    const size_t datapoints =
+        (size_t)(uint8_t)in[4] << 24 | (size_t)(uint8_t)in[5] << 16 |
+        (size_t)(uint8_t)in[6] << 8  | (size_t)(uint8_t)in[7];
+
+    if (in_len != PLANAR_HEADER_SIZE + columns * 2 + datapoints * PLANAR_DATAPOINT_SIZE)
+        return DH_ERR_MALFORMED;
+
+    const size_t size = columns * 2 + datapoints * 8;
+    const dh_result res = ensure_out(out, out_cap, size, realloc_f);
+    if (res != DH_OK) return res;
+
+    const char *count_hi  = in + PLANAR_HEADER_SIZE;
+    const char *count_lo  = count_hi  + columns;
+    const char *light     = count_lo  + columns;
+    const char *min_y_hi  = light     + datapoints;
+    const char *min_y_lo  = min_y_hi  + datapoints;
+    const char *height_hi = min_y_lo  + datapoints;
+    const char *height_lo = height_hi + datapoints;
+    const char *id_3      = height_lo + datapoints;
+    const char *id_2      = id_3      + datapoints;
+    const char *id_1      = id_2      + datapoints;
+    const char *id_0      = id_1      + datapoints;
+
+    int32_t column_top = 0;
+    uint32_t last_id = 0;
+    size_t d = 0;
+
+    char *cursor = *out;
+    for (size_t c = 0; c < columns; c++) {
+        const size_t count = (uint8_t)count_hi[c] << 8 | (uint8_t)count_lo[c];
+        if (d + count > datapoints) return DH_ERR_MALFORMED;
+
+        cursor[0] = count_hi[c];
+        cursor[1] = count_lo[c];
+        cursor += 2;
+
+        int32_t bottom = column_top;
+        for (size_t i = 0; i < count; i++, d++, cursor += 8) {
+            const int32_t height = (uint8_t)height_hi[d] << 8 | (uint8_t)height_lo[d];
+            const int32_t residual = un_zig_zag((uint8_t)min_y_hi[d] << 8 | (uint8_t)min_y_lo[d]);
+            const uint32_t id_delta =
+                (uint32_t)(uint8_t)id_3[d] << 24 | (uint32_t)(uint8_t)id_2[d] << 16 |
+                (uint32_t)(uint8_t)id_1[d] << 8  | (uint32_t)(uint8_t)id_0[d];
+
+            const int32_t min_y = bottom - height - residual;
+            const uint32_t id = last_id + (uint32_t)un_zig_zag(id_delta);
+
+            if (i == 0) column_top = min_y + height;
+            bottom = min_y;
+            last_id = id;
+
+            uint64_t dp = 0;
+            dp = DP_SET_BLOCK_LIGHT(dp, (uint8_t)light[d] >> 4);
+            dp = DP_SET_SKY_LIGHT(dp, light[d] & 0xF);
+            dp = DP_SET_MIN_Y(dp, min_y);
+            dp = DP_SET_HEIGHT(dp, height);
+            dp = DP_SET_ID(dp, id);
+            dp_write(cursor, dp);
+        }
+    }
+
+    if (d != datapoints) return DH_ERR_MALFORMED;
+
+    *out_len = size;
+    return DH_OK;
+}
@@ -0,0 +1,141 @@
+#include <stdlib.h>
+
+#include <dh.h>
+
+struct dh_store {
+    const struct dh_store_backend *backend;
+    void *handle;
+};
+
+struct dh_store *dh_store_open(const struct dh_store_backend *backend, const char *path, const unsigned flags) {
+    if (backend == nullptr || path == nullptr) return nullptr;
+
+    struct dh_store *store = malloc(sizeof(struct dh_store));
+    if (store == nullptr) return nullptr;
+
+    store->backend = backend;
+    store->handle = backend->open(path, flags);
+    if (store->handle == nullptr) {
+        free(store);
+        return nullptr;
+    }
+
+    return store;
+}
+
+int dh_store_put(struct dh_store *store, struct dh_lod *lod, const bool apply_to_parent) {
+    if (store == nullptr || lod == nullptr) return -1;
+    if (dh_lod_serialise(lod) != DH_OK) return -1;
+    return store->backend->put(store->handle, lod, apply_to_parent);
+}
+
+int dh_store_get(
+    struct dh_store *store,
+    const int64_t mip_level,
+    const int64_t x,
+    const int64_t z,
+    struct dh_lod *lod
+) {
+    if (store == nullptr || lod == nullptr) return -1;
+    return store->backend->get(store->handle, mip_level, x, z, lod);
+}
+
+int dh_store_range(
+    struct dh_store *store,
+    const int64_t mip_level,
+    const int64_t min_x,
+    const int64_t min_z,
+    const int64_t max_x,
+    const int64_t max_z,
+    struct dh_lod *lod,
+    int (*each)(struct dh_lod *lod, void *user),
+    void *user
+) {
+    if (store == nullptr || lod == nullptr || each == nullptr) return -1;
+    return store->backend->range(store->handle, mip_level, min_x, min_z, max_x, max_z, lod, each, user);
+}
+
+int dh_store_delete(
+    struct dh_store *store,
+    const int64_t mip_level,
+    const int64_t min_x,
+    const int64_t min_z,
+    const int64_t max_x,
+    const int64_t max_z
+) {
+    if (store == nullptr) return -1;
+    return store->backend->delete(store->handle, mip_level, min_x, min_z, max_x, max_z);
+}
+
+int dh_store_close(struct dh_store *store) {
+    if (store == nullptr) return 0;
+
+    const int err = store->backend->close(store->handle);
+    free(store);
+    return err;
+}
+
+//========//
+// SQLite //
+//========//
+
+static void *sqlite_open(const char *path, const unsigned flags) {
+    return dh_db_open_ex(path, flags);
+}
+
+static int sqlite_put(void *store, struct dh_lod *lod, const bool apply_to_parent) {
+    return dh_db_store_ex(store, lod, apply_to_parent);
+}
+
+static int sqlite_get(void *store, const int64_t mip_level, const int64_t x, const int64_t z, struct dh_lod *lod) {
+    return dh_db_load(store, mip_level, x, z, lod);
+}
+
+static int sqlite_range(
+    void *store,
+    const int64_t mip_level,
+    const int64_t min_x,
+    const int64_t min_z,
+    const int64_t max_x,
+    const int64_t max_z,
+    struct dh_lod *lod,
+    int (*each)(struct dh_lod *lod, void *user),
+    void *user
+) {
+    struct dh_db_cursor *cursor;
+    if (dh_db_cursor_open(&cursor, store, mip_level, min_x, min_z, max_x, max_z)) return -1;
+
+    int res;
+    while ((res = dh_db_cursor_next(cursor, lod)) == 1) {
+        res = each(lod, user);
+        if (res != 0) break;
+    }
+
+    dh_db_cursor_close(cursor);
+    return res;
+}
+
+static int sqlite_delete(
+    void *store,
+    const int64_t mip_level,
+    const int64_t min_x,
+    const int64_t min_z,
+    const int64_t max_x,
+    const int64_t max_z
+) {
+    return dh_db_delete(store, mip_level, min_x, min_z, max_x, max_z);
+}
+
+static int sqlite_close(void *store) {
+    return dh_db_close_ex(store);
+}
+
+const struct dh_store_backend dh_store_sqlite = {
+    .name = "sqlite",
+    .open = sqlite_open,
+    .put = sqlite_put,
+    .get = sqlite_get,
+    .range = sqlite_range,
+    .delete = sqlite_delete,
+    .close = sqlite_close,
+};
@@ -0,0 +1,482 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+#include <dh.h>
+
+#include "dh_lod.h"
+#include "os.h"
+
+#ifdef POSIX
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#include <fcntl.h>
+#elifdef WINDOWS
+#error "windows methods not implemented yet"
+#endif
+
+#define FLAT_MAGIC "CLODFLAT"
+// 2 widened compression_mode to keep DH_DATA_COMPRESSION_PLANAR.
+#define FLAT_VERSION 2
+#define FLAT_BYTE_ORDER 0x01020304u
+
+/**
+ * the file is a header, then a record for every LOD stored, then the index.
+ * everything is in host byte order, and byte_order is there to tell when it isn't.
+ */
+struct flat_header {
+    char magic[8];
+    uint32_t version;
+    uint32_t byte_order;
+    uint64_t index_offset;      // 0 if no index has been written yet.
+    uint64_t index_len;         // number of index entries.
+};
+
+/**
+ * precedes the LOD's data and serialised mapping.
+ */
+struct flat_record {
+    int32_t mip_level;
+    int32_t x;
+    int32_t z;
+    int32_t min_y;
+    int32_t checksum;
+    uint16_t compression_mode;
+    uint8_t apply_to_parent;
+    uint8_t reserved;
+    uint32_t data_len;
+    uint32_t mapping_len;
+};
+
+/**
+ * the index in the file, sorted by mip level then Morton position.
+ */
+struct flat_index_entry {
+    int32_t mip_level;
+    int32_t x;
+    int32_t z;
+    uint32_t reserved;
+    uint64_t offset;            // offset of the record.
+};
+
+struct flat_entry {
+    int64_t mip_level;
+    uint64_t key;               // Morton code of the position.
+    size_t seq;                 // order it was stored in, so the last store to a position wins.
+    int64_t x;
+    int64_t z;
+    uint64_t offset;
+};
+
+struct flat_store {
+    int fd;
+    bool writable;
+    bool modified;              // the index needs writing on close.
+    bool unsorted;              // entries have been appended since the index was last sorted.
+
+    const char *map;            // (nullable) the file, up to map_len.
+    size_t map_len;
+    uint64_t end;               // where the next record is appended.
+
+    struct flat_entry *entries;
+    size_t entries_len;
+    size_t entries_cap;
+};
+
+static int compare_entries(const void *a_ptr, const void *b_ptr) {
+    const struct flat_entry *a = a_ptr, *b = b_ptr;
+    if (a->mip_level != b->mip_level) return a->mip_level < b->mip_level ? -1 : 1;
+    if (a->key != b->key) return a->key < b->key ? -1 : 1;
+    return a->seq < b->seq ? -1 : a->seq > b->seq;
+}
+
+/**
+ * sorts the index, keeping only the last entry stored for each position.
+ */
+static void sort_entries(struct flat_store *store) {
+    if (!store->unsorted) return;
+
+    qsort(store->entries, store->entries_len, sizeof(struct flat_entry), compare_entries);
+
+    size_t j = 0;
+    for (size_t i = 0; i < store->entries_len; i++) {
+        const struct flat_entry *next = i + 1 < store->entries_len ? &store->entries[i + 1] : nullptr;
+        if (next != nullptr && next->mip_level == store->entries[i].mip_level && next->key == store->entries[i].key)
+            continue;
+        store->entries[j++] = store->entries[i];
+    }
+
+    store->entries_len = j;
+    store->unsorted = false;
+}
+
+/**
+ * index of the first entry at or after the mip level and Morton code.
+ */
+static size_t lower_bound(const struct flat_store *store, const int64_t mip_level, const uint64_t key) {
+    size_t lo = 0, hi = store->entries_len;
+    while (lo < hi) {
+        const size_t mid = lo + (hi - lo) / 2;
+        const struct flat_entry *e = &store->entries[mid];
+        if (e->mip_level < mip_level || (e->mip_level == mip_level && e->key < key)) lo = mid + 1;
+        else hi = mid;
+    }
+    return lo;
+}
+
+static int append_entry(struct flat_store *store, const struct flat_entry *entry) {
+    if (store->entries_len == store->entries_cap) {
+        const size_t new_cap = store->entries_cap ? store->entries_cap * 2 : 1024;
+        struct flat_entry *new = realloc(store->entries, new_cap * sizeof(struct flat_entry));
+        if (new == nullptr) return -1;
+        store->entries = new;
+        store->entries_cap = new_cap;
+    }
+
+    store->entries[store->entries_len] = *entry;
+    store->entries[store->entries_len].seq = store->entries_len;
+    store->entries_len++;
+    return 0;
+}
+
+/**
+ * maps the whole file, so records appended since it was last mapped can be read.
+ */
+static int remap(struct flat_store *store) {
+    if (store->map != nullptr) munmap((void*)store->map, store->map_len);
+    store->map = nullptr;
+    store->map_len = 0;
+
+    if (store->end == 0) return 0;
+
+    void *map = mmap(nullptr, store->end, PROT_READ, MAP_SHARED, store->fd, 0);
+    if (map == MAP_FAILED) {
+        fprintf(stderr, "mmap flat store: %s\n", strerror(errno));
+        return -1;
+    }
+
+    store->map = map;
+    store->map_len = store->end;
+    return 0;
+}
+
+static void flat_free(struct flat_store *store) {
+    if (store->map != nullptr) munmap((void*)store->map, store->map_len);
+    if (store->fd >= 0) close(store->fd);
+    free(store->entries);
+    free(store);
+}
+
+static void *flat_open(const char *path, const unsigned flags) {
+    struct flat_store *store = calloc(1, sizeof(struct flat_store));
+    if (store == nullptr) return nullptr;
+
+    // clients may only be given read access to the file.
+    store->writable = true;
+    store->fd = open(path, O_RDWR | O_CREAT, 0644);
+    if (store->fd < 0 && (errno == EACCES || errno == EROFS)) {
+        store->writable = false;
+        store->fd = open(path, O_RDONLY);
+    }
+    if (store->fd < 0) {
+        fprintf(stderr, "open %s: %s\n", path, strerror(errno));
+        free(store);
+        return nullptr;
+    }
+
+    struct stat st;
+    if (fstat(store->fd, &st)) {
+        fprintf(stderr, "stat %s: %s\n", path, strerror(errno));
+        flat_free(store);
+        return nullptr;
+    }
+
+    struct flat_header header;
+    if (st.st_size == 0 && store->writable) {
+        memset(&header, 0, sizeof(header));
+        memcpy(header.magic, FLAT_MAGIC, sizeof(header.magic));
+        header.version = FLAT_VERSION;
+        header.byte_order = FLAT_BYTE_ORDER;
+
+        if (pwrite(store->fd, &header, sizeof(header), 0) != sizeof(header)) {
+            fprintf(stderr, "write %s: %s\n", path, strerror(errno));
+            flat_free(store);
+            return nullptr;
+        }
+
+        store->end = sizeof(header);
+    } else {
+        store->end = st.st_size;
+    }
+
+    if (remap(store)) {
+        flat_free(store);
+        return nullptr;
+    }
+
+    if (store->map_len >= sizeof(header)) memcpy(&header, store->map, sizeof(header));
+    if (
+        store->map_len < sizeof(header) ||
+        memcmp(header.magic, FLAT_MAGIC, sizeof(header.magic)) != 0 ||
+        header.version != FLAT_VERSION ||
+        header.byte_order != FLAT_BYTE_ORDER ||
+        header.index_offset + header.index_len * sizeof(struct flat_index_entry) > store->map_len
+    ) {
+        fprintf(stderr, "%s is not a flat LOD store, or was written on a machine with a different byte order\n", path);
+        flat_free(store);
+        return nullptr;
+    }
+
+    for (uint64_t i = 0; i < header.index_len; i++) {
+        struct flat_index_entry on_disk;
+        memcpy(&on_disk, store->map + header.index_offset + i * sizeof(on_disk), sizeof(on_disk));
+
+        const struct flat_entry entry = {
+            .mip_level = on_disk.mip_level,
+            .key = dh_morton(on_disk.x, on_disk.z),
+            .x = on_disk.x,
+            .z = on_disk.z,
+            .offset = on_disk.offset,
+        };
+        if (append_entry(store, &entry)) {
+            flat_free(store);
+            return nullptr;
+        }
+    }
+
+    return store;
+}
+
+static int flat_put(void *handle, struct dh_lod *lod, const bool apply_to_parent) {
+    struct flat_store *store = handle;
+    if (!store->writable) {
+        fprintf(stderr, "flat store is read only\n");
+        return -1;
+    }
+
+    size_t mapping_len;
+    char *mapping;
+    if (dh_lod_serialise_mapping(lod, &mapping, &mapping_len) != DH_OK) return -1;
+
+    const struct flat_record record = {
+        .mip_level = (int32_t)lod->mip_level,
+        .x = (int32_t)lod->x,
+        .z = (int32_t)lod->z,
+        .min_y = (int32_t)lod->min_y,
+        .checksum = lod->checksum,
+        .compression_mode = (uint16_t)lod->compression_mode,
+        .apply_to_parent = apply_to_parent,
+        .data_len = (uint32_t)lod->lod_len,
+        .mapping_len = (uint32_t)mapping_len,
+    };
+
+    const struct iovec iov[3] = {
+        { (void*)&record, sizeof(record) },
+        { lod->lod_arr, lod->lod_len },
+        { mapping, mapping_len },
+    };
+    const ssize_t len = sizeof(record) + lod->lod_len + mapping_len;
+    if (pwritev(store->fd, iov, 3, (off_t)store->end) != len) {
+        fprintf(stderr, "write flat store: %s\n", strerror(errno));
+        return -1;
+    }
+
+    const struct flat_entry entry = {
+        .mip_level = lod->mip_level,
+        .key = dh_morton(lod->x, lod->z),
+        .x = lod->x,
+        .z = lod->z,
+        .offset = store->end,
+    };
+    if (append_entry(store, &entry)) {
+        fprintf(stderr, "flat store index: out of memory\n");
+        return -1;
+    }
+
+    store->end += len;
+    store->modified = true;
+    store->unsorted = true;
+    return 0;
+}
+
+/**
+ * reads the record an entry points to into the LOD.
+ */
+static int read_entry(struct flat_store *store, const struct flat_entry *entry, struct dh_lod *lod) {
+    if (entry->offset + sizeof(struct flat_record) > store->map_len && remap(store)) return -1;
+
+    struct flat_record record;
+    if (entry->offset + sizeof(record) > store->map_len) {
+        fprintf(stderr, "flat store: record (%ld, %ld) is out of bounds\n", entry->x, entry->z);
+        return -1;
+    }
+    memcpy(&record, store->map + entry->offset, sizeof(record));
+
+    const char *data = store->map + entry->offset + sizeof(record);
+    if (entry->offset + sizeof(record) + record.data_len + record.mapping_len > store->map_len) {
+        fprintf(stderr, "flat store: record (%ld, %ld) is out of bounds\n", entry->x, entry->z);
+        return -1;
+    }
+
+    lod->mip_level = record.mip_level;
+    lod->x = record.x;
+    lod->z = record.z;
+    lod->min_y = record.min_y;
+    lod->checksum = record.checksum;
+    lod->compression_mode = record.compression_mode;
+    lod->height = 0;
+    lod->has_data = true;
+
+    const dh_result res = dh_lod_load_stored(lod, data, record.data_len, data + record.data_len, record.mapping_len);
+    if (res != DH_OK) {
+        fprintf(stderr, "loading LOD (%ld, %ld): %d\n", lod->x, lod->z, res);
+        return -1;
+    }
+
+    return 0;
+}
+
+static int flat_get(void *handle, const int64_t mip_level, const int64_t x, const int64_t z, struct dh_lod *lod) {
+    struct flat_store *store = handle;
+    sort_entries(store);
+
+    const uint64_t key = dh_morton(x, z);
+    const size_t i = lower_bound(store, mip_level, key);
+    if (
+        i == store->entries_len ||
+        store->entries[i].mip_level != mip_level ||
+        store->entries[i].key != key
+    ) return 1;
+
+    return read_entry(store, &store->entries[i], lod) ? -1 : 0;
+}
+
+static int flat_range(
+    void *handle,
+    const int64_t mip_level,
+    const int64_t min_x,
+    const int64_t min_z,
+    const int64_t max_x,
+    const int64_t max_z,
+    struct dh_lod *lod,
+    int (*each)(struct dh_lod *lod, void *user),
+    void *user
+) {
+    struct flat_store *store = handle;
+    sort_entries(store);
+
+    // every position in the range has a Morton code between the range's corners,
+    // but not every code between them is in the range.
+    const uint64_t max_key = dh_morton(max_x, max_z);
+    for (
+        size_t i = lower_bound(store, mip_level, dh_morton(min_x, min_z));
+        i < store->entries_len && store->entries[i].mip_level == mip_level && store->entries[i].key <= max_key;
+        i++
+    ) {
+        const struct flat_entry entry = store->entries[i];
+        if (entry.x < min_x || entry.x > max_x || entry.z < min_z || entry.z > max_z) continue;
+
+        if (read_entry(store, &entry, lod)) return -1;
+
+        const int res = each(lod, user);
+        if (res != 0) return res;
+    }
+
+    return 0;
+}
+
+static int flat_delete(
+    void *handle,
+    const int64_t mip_level,
+    const int64_t min_x,
+    const int64_t min_z,
+    const int64_t max_x,
+    const int64_t max_z
+) {
+    struct flat_store *store = handle;
+    if (!store->writable) {
+        fprintf(stderr, "flat store is read only\n");
+        return -1;
+    }
+
+    sort_entries(store);
+
+    size_t j = 0;
+    for (size_t i = 0; i < store->entries_len; i++) {
+        const struct flat_entry *e = &store->entries[i];
+        if (
+            e->mip_level == mip_level &&
+            e->x >= min_x && e->x <= max_x &&
+            e->z >= min_z && e->z <= max_z
+        ) continue;
+        store->entries[j++] = *e;
+    }
+
+    if (j != store->entries_len) store->modified = true;
+    store->entries_len = j;
+    return 0;
+}
+
+/**
+ * appends the index and points the header at it.
+ */
+static int write_index(struct flat_store *store) {
+    sort_entries(store);
+
+    const size_t len = store->entries_len * sizeof(struct flat_index_entry);
+    struct flat_index_entry *index = malloc(len > 0 ? len : 1);
+    if (index == nullptr) return -1;
+
+    for (size_t i = 0; i < store->entries_len; i++) {
+        index[i] = (struct flat_index_entry) {
+            .mip_level = (int32_t)store->entries[i].mip_level,
+            .x = (int32_t)store->entries[i].x,
+            .z = (int32_t)store->entries[i].z,
+            .offset = store->entries[i].offset,
+        };
+    }
+
+    struct flat_header header = {
+        .version = FLAT_VERSION,
+        .byte_order = FLAT_BYTE_ORDER,
+        .index_offset = store->end,
+        .index_len = store->entries_len,
+    };
+    memcpy(header.magic, FLAT_MAGIC, sizeof(header.magic));
+
+    // the index has to be on disk before the header points at it.
+    int err = 0;
+    if (
+        pwrite(store->fd, index, len, (off_t)store->end) != (ssize_t)len ||
+        fdatasync(store->fd) ||
+        pwrite(store->fd, &header, sizeof(header), 0) != sizeof(header) ||
+        fdatasync(store->fd)
+    ) {
+        fprintf(stderr, "write flat store index: %s\n", strerror(errno));
+        err = -1;
+    }
+
+    free(index);
+    return err;
+}
+
+static int flat_close(void *handle) {
+    struct flat_store *store = handle;
+
+    const int err = store->writable && store->modified ? write_index(store) : 0;
+    flat_free(store);
+    return err;
+}
+
+const struct dh_store_backend dh_store_flat = {
+    .name = "flat",
+    .open = flat_open,
+    .put = flat_put,
+    .get = flat_get,
+    .range = flat_range,
+    .delete = flat_delete,
+    .close = flat_close,
+};
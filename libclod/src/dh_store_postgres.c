@@ -0,0 +1,424 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <libpq-fe.h>
+
+#include <dh.h>
+
+#include "dh_lod.h"
+
+/// FullData's columns, in the order they are copied.
+#define COPY_COLUMNS \
+    "DetailLevel, PosX, PosZ, MinY, DataChecksum, Data, " \
+    "ColumnGenerationStep, ColumnWorldCompressionMode, Mapping, " \
+    "DataFormatVersion, CompressionMode, ApplyToParent, ApplyToChildren, " \
+    "LastModifiedUnixDateTime, CreatedUnixDateTime"
+
+/// columns read into a LOD, in the order read_row expects.
+#define LOAD_COLUMNS "DetailLevel, PosX, PosZ, MinY, DataChecksum, CompressionMode, Data, Mapping"
+
+/// stored LODs are copied to the server once this much COPY data is buffered.
+#define COPY_BATCH_BYTES (32 * 1024 * 1024)
+
+/**
+ * the same layout as DH's FullData, so rows can be moved between the two as they are.
+ * integer widths follow what sqlite is given, and BIT columns are smallints holding 0 or 1.
+ */
+static const char *create_sql =
+    "create table if not exists FullData ("
+    "DetailLevel smallint not null, "
+    "PosX integer not null, "
+    "PosZ integer not null, "
+    "MinY integer not null, "
+    "DataChecksum integer not null, "
+    "Data bytea, "
+    "ColumnGenerationStep bytea, "
+    "ColumnWorldCompressionMode bytea, "
+    "Mapping bytea, "
+    "DataFormatVersion smallint, "
+    "CompressionMode smallint, "
+    "ApplyToParent smallint, "
+    "ApplyToChildren smallint not null default 0, "
+    "LastModifiedUnixDateTime bigint not null, "
+    "CreatedUnixDateTime bigint not null, "
+    "primary key (DetailLevel, PosX, PosZ)"
+    ")";
+
+/**
+ * COPY can't update existing rows, so batches are copied into a staging table and merged from there.
+ * Seq keeps the order rows were stored in, so the last store to a position wins.
+ */
+static const char *staging_sql =
+    "create temp table if not exists FullDataStaging (like FullData, Seq bigserial) on commit delete rows";
+
+static const char *copy_sql =
+    "copy FullDataStaging (" COPY_COLUMNS ") from stdin (format binary)";
+
+static const char *upsert_sql =
+    "insert into FullData (" COPY_COLUMNS ") "
+    "select distinct on (DetailLevel, PosX, PosZ) " COPY_COLUMNS " from FullDataStaging "
+    "order by DetailLevel, PosX, PosZ, Seq desc "
+    "on conflict (DetailLevel, PosX, PosZ) do update set "
+    "MinY = excluded.MinY, "
+    "DataChecksum = excluded.DataChecksum, "
+    "Data = excluded.Data, "
+    "ColumnGenerationStep = excluded.ColumnGenerationStep, "
+    "ColumnWorldCompressionMode = excluded.ColumnWorldCompressionMode, "
+    "Mapping = excluded.Mapping, "
+    "DataFormatVersion = excluded.DataFormatVersion, "
+    "CompressionMode = excluded.CompressionMode, "
+    "ApplyToParent = excluded.ApplyToParent, "
+    "ApplyToChildren = excluded.ApplyToChildren, "
+    "LastModifiedUnixDateTime = excluded.LastModifiedUnixDateTime "
+    "where FullData.DataChecksum != excluded.DataChecksum";
+
+static const char copy_signature[] = "PGCOPY\n\377\r\n";
+
+struct pg_store {
+    PGconn *conn;
+
+    char *copy;             // COPY data for LODs that haven't been sent yet, without the header.
+    size_t copy_len;
+    size_t copy_cap;
+};
+
+static int copy_reserve(struct pg_store *store, const size_t n) {
+    if (store->copy_cap - store->copy_len >= n) return 0;
+
+    size_t new_cap = store->copy_cap ? store->copy_cap * 2 : 1024 * 1024;
+    while (new_cap - store->copy_len < n) new_cap *= 2;
+
+    char *new = realloc(store->copy, new_cap);
+    if (new == nullptr) return -1;
+
+    store->copy = new;
+    store->copy_cap = new_cap;
+    return 0;
+}
+
+// COPY binary integers are big endian.
+static void copy_be(struct pg_store *store, const uint64_t value, const int bytes) {
+    for (int i = bytes - 1; i >= 0; i--)
+        store->copy[store->copy_len++] = (char)(value >> (i * 8) & 0xFF);
+}
+
+// each field is its length followed by its value.
+static void copy_int(struct pg_store *store, const int64_t value, const int bytes) {
+    copy_be(store, bytes, 4);
+    copy_be(store, (uint64_t)value, bytes);
+}
+
+static void copy_bytes(struct pg_store *store, const void *data, const size_t len) {
+    copy_be(store, len, 4);
+    if (len > 0) memcpy(store->copy + store->copy_len, data, len);
+    store->copy_len += len;
+}
+
+static int64_t result_int(const PGresult *res, const int row, const int col) {
+    const char *value = PQgetvalue(res, row, col);
+    const int len = PQgetlength(res, row, col);
+
+    uint64_t v = (uint8_t)value[0] & 0x80 ? UINT64_MAX : 0;
+    for (int i = 0; i < len; i++) v = v << 8 | (uint8_t)value[i];
+    return (int64_t)v;
+}
+
+static int exec(struct pg_store *store, const char *sql, const ExecStatusType expected) {
+    PGresult *res = PQexec(store->conn, sql);
+    const ExecStatusType status = PQresultStatus(res);
+    PQclear(res);
+
+    if (status != expected) {
+        fprintf(stderr, "postgres %s: %s", sql, PQerrorMessage(store->conn));
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * sends the buffered LODs in a single COPY, and merges them into FullData.
+ * if that fails, the LODs stay buffered for the next flush.
+ */
+static int flush(struct pg_store *store) {
+    if (store->copy_len == 0) return 0;
+
+    if (exec(store, "begin", PGRES_COMMAND_OK)) return -1;
+
+    if (exec(store, staging_sql, PGRES_COMMAND_OK)) {
+        exec(store, "rollback", PGRES_COMMAND_OK);
+        return -1;
+    }
+
+    PGresult *res = PQexec(store->conn, copy_sql);
+    const ExecStatusType status = PQresultStatus(res);
+    PQclear(res);
+    if (status != PGRES_COPY_IN) {
+        fprintf(stderr, "postgres copy FullDataStaging: %s", PQerrorMessage(store->conn));
+        exec(store, "rollback", PGRES_COMMAND_OK);
+        return -1;
+    }
+
+    char header[19];
+    memcpy(header, copy_signature, 11);
+    memset(header + 11, 0, 8);  // flags and header extension length.
+    const char trailer[2] = { (char)0xFF, (char)0xFF };
+
+    int err = 0;
+    if (
+        PQputCopyData(store->conn, header, sizeof(header)) != 1 ||
+        PQputCopyData(store->conn, store->copy, (int)store->copy_len) != 1 ||
+        PQputCopyData(store->conn, trailer, sizeof(trailer)) != 1 ||
+        PQputCopyEnd(store->conn, nullptr) != 1
+    ) err = -1;
+
+    while ((res = PQgetResult(store->conn)) != nullptr) {
+        if (PQresultStatus(res) != PGRES_COMMAND_OK) err = -1;
+        PQclear(res);
+    }
+
+    if (err || exec(store, upsert_sql, PGRES_COMMAND_OK)) {
+        fprintf(stderr, "postgres copy FullData: %s", PQerrorMessage(store->conn));
+        exec(store, "rollback", PGRES_COMMAND_OK);
+        return -1;
+    }
+
+    if (exec(store, "commit", PGRES_COMMAND_OK)) return -1;
+
+    store->copy_len = 0;
+    return 0;
+}
+
+static void *pg_open(const char *conninfo, const unsigned flags) {
+    struct pg_store *store = calloc(1, sizeof(struct pg_store));
+    if (store == nullptr) return nullptr;
+
+    store->conn = PQconnectdb(conninfo);
+    if (PQstatus(store->conn) != CONNECTION_OK) {
+        fprintf(stderr, "postgres connect: %s", PQerrorMessage(store->conn));
+        PQfinish(store->conn);
+        free(store);
+        return nullptr;
+    }
+
+    if (exec(store, create_sql, PGRES_COMMAND_OK)) {
+        PQfinish(store->conn);
+        free(store);
+        return nullptr;
+    }
+
+    return store;
+}
+
+static int pg_put(void *handle, struct dh_lod *lod, const bool apply_to_parent) {
+    struct pg_store *store = handle;
+
+    size_t mapping_len;
+    char *mapping;
+    if (dh_lod_serialise_mapping(lod, &mapping, &mapping_len) != DH_OK) return -1;
+
+    const void *gen_step, *world_compression;
+    size_t gen_step_len, world_compression_len;
+    if (dh_lod_row_constants(lod->compression_mode, &gen_step, &gen_step_len, &world_compression, &world_compression_len) != DH_OK) {
+        fprintf(stderr, "unknown LOD compression mode\n");
+        return -1;
+    }
+
+    // 15 fields, each with a 4 byte length.
+    const size_t len = 2 + 15 * 4 + 2 + 4 * 4 + lod->lod_len + gen_step_len + world_compression_len +
+        mapping_len + 2 + 2 + 2 + 2 + 8 + 8;
+    if (copy_reserve(store, len)) {
+        fprintf(stderr, "postgres copy buffer: out of memory\n");
+        return -1;
+    }
+
+    copy_be(store, 15, 2);
+    copy_int(store, lod->mip_level, 2);
+    copy_int(store, lod->x, 4);
+    copy_int(store, lod->z, 4);
+    copy_int(store, lod->min_y, 4);
+    copy_int(store, lod->checksum, 4);
+    copy_bytes(store, lod->lod_arr, lod->lod_len);
+    copy_bytes(store, gen_step, gen_step_len);
+    copy_bytes(store, world_compression, world_compression_len);
+    copy_bytes(store, mapping, mapping_len);
+    copy_int(store, 1, 2);
+    copy_int(store, lod->compression_mode, 2);
+    copy_int(store, apply_to_parent, 2);
+    copy_int(store, 0, 2);
+    copy_int(store, 0, 8);
+    copy_int(store, 0, 8);
+
+    return store->copy_len >= COPY_BATCH_BYTES ? flush(store) : 0;
+}
+
+/**
+ * reads a row of LOAD_COLUMNS, fetched in binary, into the LOD.
+ */
+static int read_row(const PGresult *res, const int row, struct dh_lod *lod) {
+    lod->mip_level = result_int(res, row, 0);
+    lod->x = result_int(res, row, 1);
+    lod->z = result_int(res, row, 2);
+    lod->min_y = result_int(res, row, 3);
+    lod->checksum = (int32_t)result_int(res, row, 4);
+    lod->compression_mode = result_int(res, row, 5);
+    lod->height = 0;
+    lod->has_data = true;
+
+    const dh_result result = dh_lod_load_stored(
+        lod,
+        PQgetvalue(res, row, 6), PQgetlength(res, row, 6),
+        PQgetvalue(res, row, 7), PQgetlength(res, row, 7)
+    );
+    if (result != DH_OK) {
+        fprintf(stderr, "loading LOD (%ld, %ld): %d\n", lod->x, lod->z, result);
+        return -1;
+    }
+
+    return 0;
+}
+
+/**
+ * formats integer parameters as text, which postgres converts to the column's type.
+ */
+struct params {
+    char text[6][24];
+    const char *values[6];
+};
+
+static void params_set(struct params *params, const int i, const int64_t value) {
+    snprintf(params->text[i], sizeof(params->text[i]), "%ld", value);
+    params->values[i] = params->text[i];
+}
+
+static int pg_get(void *handle, const int64_t mip_level, const int64_t x, const int64_t z, struct dh_lod *lod) {
+    struct pg_store *store = handle;
+    if (flush(store)) return -1;
+
+    struct params params;
+    params_set(&params, 0, mip_level);
+    params_set(&params, 1, x);
+    params_set(&params, 2, z);
+
+    PGresult *res = PQexecParams(store->conn,
+        "select " LOAD_COLUMNS " from FullData where DetailLevel = $1 and PosX = $2 and PosZ = $3",
+        3, nullptr, params.values, nullptr, nullptr, 1
+    );
+    if (PQresultStatus(res) != PGRES_TUPLES_OK) {
+        fprintf(stderr, "postgres load FullData: %s", PQerrorMessage(store->conn));
+        PQclear(res);
+        return -1;
+    }
+
+    int err = 1;
+    if (PQntuples(res) > 0) err = read_row(res, 0, lod) ? -1 : 0;
+
+    PQclear(res);
+    return err;
+}
+
+static int pg_range(
+    void *handle,
+    const int64_t mip_level,
+    const int64_t min_x,
+    const int64_t min_z,
+    const int64_t max_x,
+    const int64_t max_z,
+    struct dh_lod *lod,
+    int (*each)(struct dh_lod *lod, void *user),
+    void *user
+) {
+    struct pg_store *store = handle;
+    if (flush(store)) return -1;
+
+    struct params params;
+    params_set(&params, 0, mip_level);
+    params_set(&params, 1, min_x);
+    params_set(&params, 2, max_x);
+    params_set(&params, 3, min_z);
+    params_set(&params, 4, max_z);
+
+    if (!PQsendQueryParams(store->conn,
+        "select " LOAD_COLUMNS " from FullData "
+        "where DetailLevel = $1 and PosX between $2 and $3 and PosZ between $4 and $5 "
+        "order by PosX, PosZ",
+        5, nullptr, params.values, nullptr, nullptr, 1
+    )) {
+        fprintf(stderr, "postgres load FullData: %s", PQerrorMessage(store->conn));
+        return -1;
+    }
+
+    // rows are streamed one at a time instead of the whole range being held in memory.
+    PQsetSingleRowMode(store->conn);
+
+    // results have to be read to the end before the connection can be used again, even after stopping.
+    int ret = 0;
+    PGresult *res;
+    while ((res = PQgetResult(store->conn)) != nullptr) {
+        const ExecStatusType status = PQresultStatus(res);
+
+        if (status == PGRES_SINGLE_TUPLE && ret == 0) {
+            ret = read_row(res, 0, lod) ? -1 : each(lod, user);
+        } else if (status != PGRES_SINGLE_TUPLE && status != PGRES_TUPLES_OK) {
+            fprintf(stderr, "postgres load FullData: %s", PQerrorMessage(store->conn));
+            ret = -1;
+        }
+
+        PQclear(res);
+    }
+
+    return ret;
+}
+
+static int pg_delete(
+    void *handle,
+    const int64_t mip_level,
+    const int64_t min_x,
+    const int64_t min_z,
+    const int64_t max_x,
+    const int64_t max_z
+) {
+    struct pg_store *store = handle;
+    if (flush(store)) return -1;
+
+    struct params params;
+    params_set(&params, 0, mip_level);
+    params_set(&params, 1, min_x);
+    params_set(&params, 2, max_x);
+    params_set(&params, 3, min_z);
+    params_set(&params, 4, max_z);
+
+    PGresult *res = PQexecParams(store->conn,
+        "delete from FullData where DetailLevel = $1 and PosX between $2 and $3 and PosZ between $4 and $5",
+        5, nullptr, params.values, nullptr, nullptr, 0
+    );
+    const ExecStatusType status = PQresultStatus(res);
+    PQclear(res);
+
+    if (status != PGRES_COMMAND_OK) {
+        fprintf(stderr, "postgres delete FullData: %s", PQerrorMessage(store->conn));
+        return -1;
+    }
+
+    return 0;
+}
+
+static int pg_close(void *handle) {
+    struct pg_store *store = handle;
+
+    const int err = flush(store);
+    PQfinish(store->conn);
+    free(store->copy);
+    free(store);
+    return err;
+}
+
+const struct dh_store_backend dh_store_postgres = {
+    .name = "postgres",
+    .open = pg_open,
+    .put = pg_put,
+    .get = pg_get,
+    .range = pg_range,
+    .delete = pg_delete,
+    .close = pg_close,
+};
@@ -0,0 +1,17 @@
+#include <stdio.h>
+
+#include <dh.h>
+
+/**
+ * stands in for the postgres store when the library is built without libpq.
+ * nothing can be opened, so the other methods are never called.
+ */
+static void *none_open(const char *conninfo, const unsigned flags) {
+    fprintf(stderr, "postgres store: libclod was built without libpq\n");
+    return nullptr;
+}
+
+const struct dh_store_backend dh_store_postgres = {
+    .name = "postgres",
+    .open = none_open,
+};
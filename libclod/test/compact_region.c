@@ -0,0 +1,151 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <sys/stat.h>
+
+#include <anvil.h>
+#include <dh.h>
+
+#include "test.h"
+
+/**
+ * checks a region file holds the chunks it was written with, in header order with no gaps.
+ */
+static void check_compact(const char *name, const uint64_t seed) {
+    char *file = malloc(TEST_REGION_CAP);
+    assert(file != nullptr);
+    const size_t size = test_region_read(name, file);
+    char data[TEST_CHUNK_MAX];
+
+    size_t next_sector = 2;
+    for (size_t i = 0; i < 1024; i++) {
+        const size_t len = test_chunk_data(seed, i, data);
+        const uint32_t location = test_read_u32(file + i * 4);
+        const uint32_t mtime = test_read_u32(file + TEST_SECTOR_SIZE + i * 4);
+
+        if (len == 0) {
+            assert(location == 0 && mtime == 0);
+            continue;
+        }
+
+        const size_t sector = location >> 8, count = location & 0xFF;
+        assert(sector == next_sector);
+        assert(count == (5 + len + TEST_SECTOR_SIZE - 1) / TEST_SECTOR_SIZE);
+        assert(mtime == 1000 + i);
+
+        const char *frame = file + sector * TEST_SECTOR_SIZE;
+        assert(test_read_u32(frame) == len + 1);
+        assert(frame[4] == ANVIL_COMPRESSION_NONE);
+        assert(memcmp(frame + 5, data, len) == 0);
+
+        next_sector += count;
+    }
+
+    // every sector is whole, and there's nothing after the last chunk.
+    assert(size == next_sector * TEST_SECTOR_SIZE);
+    free(file);
+}
+
+static ino_t inode(const char *name) {
+    char *path = test_path(name);
+    struct stat st;
+    assert(stat(path, &st) == 0);
+    free(path);
+    return st.st_ino;
+}
+
+static mode_t mode(const char *name) {
+    char *path = test_path(name);
+    struct stat st;
+    assert(stat(path, &st) == 0);
+    free(path);
+    return st.st_mode & 07777;
+}
+
+int main(void) {
+    char *region_path = test_path("region");
+    assert(mkdir(region_path, 0755) == 0);
+
+    test_region_write("region/r.0.0.mca", 1);
+    test_region_write("region/r.-1.2.mca", 2);
+    test_region_write("region/r.3.-4.mca", 3);
+
+    // a rewritten region file keeps the permissions of the one it replaces.
+    char *restricted = test_path("region/r.-1.2.mca");
+    assert(chmod(restricted, 0600) == 0);
+    free(restricted);
+
+    struct anvil_region_dir *region_dir;
+    anvil_result res = anvil_region_dir_open(&region_dir, test_dir(), "region", nullptr, nullptr, nullptr);
+    assert(res == ANVIL_OK);
+
+    struct anvil_rewriter *rewriter;
+    res = anvil_rewriter_open(&rewriter, nullptr, nullptr);
+    assert(res == ANVIL_OK);
+
+    // one region file.
+    res = anvil_region_compact(rewriter, region_dir, 0, 0);
+    assert(res == ANVIL_OK);
+    check_compact("region/r.0.0.mca", 1);
+
+    // a compact region file is left as it is.
+    const ino_t compacted = inode("region/r.0.0.mca");
+    res = anvil_region_compact(rewriter, region_dir, 0, 0);
+    assert(res == ANVIL_OK);
+    assert(inode("region/r.0.0.mca") == compacted);
+
+    assert(anvil_region_compact(rewriter, region_dir, 5, 5) == ANVIL_NOT_EXIST);
+
+    // the whole directory, on more threads than there are region files,
+    // while an iteration over the directory is part way through.
+    struct anvil_region_iter *iter;
+    res = anvil_region_iter_open(&iter, region_dir);
+    assert(res == ANVIL_OK);
+    struct anvil_region_entry entry;
+    assert(anvil_region_iter_next(&entry, iter) == ANVIL_NEXT);
+
+    res = anvil_region_dir_compact(region_dir, 4);
+    assert(res == ANVIL_OK);
+    check_compact("region/r.0.0.mca", 1);
+    check_compact("region/r.-1.2.mca", 2);
+    check_compact("region/r.3.-4.mca", 3);
+    assert(mode("region/r.-1.2.mca") == 0600);
+
+    // compacting doesn't move the iteration.
+    size_t regions = 1;
+    while ((res = anvil_region_iter_next(&entry, iter)) == ANVIL_NEXT) regions++;
+    assert(res == ANVIL_DONE);
+    assert(regions == 3);
+    anvil_region_iter_close(iter);
+
+    // two chunks sharing a sector are refused, and the file isn't touched.
+    char *file = malloc(TEST_REGION_CAP);
+    assert(file != nullptr);
+    const size_t size = test_region_read("region/r.-1.2.mca", file);
+    size_t a = 0, b;
+    while (test_read_u32(file + a * 4) == 0) a++;
+    b = a + 1;
+    while (test_read_u32(file + b * 4) == 0) b++;
+    test_write_u32(file + b * 4, test_read_u32(file + a * 4));
+
+    char *path = test_path("region/r.-1.2.mca");
+    FILE *f = fopen(path, "wb");
+    assert(f != nullptr);
+    assert(fwrite(file, size, 1, f) == 1);
+    assert(fclose(f) == 0);
+
+    const ino_t overlapping = inode("region/r.-1.2.mca");
+    assert(anvil_region_compact(rewriter, region_dir, -1, 2) == ANVIL_MALFORMED);
+    assert(inode("region/r.-1.2.mca") == overlapping);
+
+    printf("ok\n");
+
+    free(path);
+    free(file);
+    anvil_rewriter_close(rewriter);
+    anvil_region_dir_close(region_dir);
+    free(region_path);
+    test_dir_remove();
+    return 0;
+}
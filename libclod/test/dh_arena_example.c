@@ -0,0 +1,57 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <assert.h>
+
+#include <dh.h>
+
+#include "test.h"
+
+#define CYCLES 8
+
+int main(void) {
+    struct dh_lod sources[4];
+    struct dh_lod *src[4];
+    for (int i = 0; i < 4; i++) {
+        sources[i] = DH_LOD_CLEAR;
+        test_lod_random(&sources[i], 0, i >> 1, i & 1, 128, 16);
+        src[i] = &sources[i];
+    }
+
+    // the codec keeps compression contexts across LODs, outside of the arena.
+    struct anvil_codec *codec;
+    assert(anvil_codec_open(&codec, nullptr) == ANVIL_OK);
+
+    struct dh_arena *arena = dh_arena_new(0);
+    assert(arena != nullptr);
+    dh_arena_bind(arena);
+
+    size_t reserved = 0;
+    for (int cycle = 0; cycle < CYCLES; cycle++) {
+        struct dh_lod lod = DH_LOD_CLEAR;
+        lod.realloc = dh_arena_realloc;
+
+        assert(dh_lod_mip_ex(&lod, 1, src, 4, codec) == DH_OK);
+        assert(dh_compress_ex(&lod, DH_DATA_COMPRESSION_LZ4, 0.0, codec) == DH_OK);
+
+        char *mapping;
+        size_t mapping_len;
+        assert(dh_lod_serialise_mapping(&lod, &mapping, &mapping_len) == DH_OK);
+        assert(dh_lod_verify(&lod, codec) == DH_OK);
+
+        dh_lod_free(&lod);
+        dh_arena_reset(arena);
+
+        // every cycle after the first fits in the memory the first took.
+        printf("cycle %d: %zuKiB reserved\n", cycle, dh_arena_reserved(arena) >> 10);
+        if (cycle > 0) assert(dh_arena_reserved(arena) == reserved);
+        reserved = dh_arena_reserved(arena);
+    }
+
+    dh_arena_free(arena);
+    anvil_codec_close(codec);
+    for (int i = 0; i < 4; i++) dh_lod_free(&sources[i]);
+
+    return 0;
+}
@@ -0,0 +1,79 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+
+#include <dh.h>
+
+#include "test.h"
+
+// columns skipped between reads in the second pass.
+#define SKIP 37
+
+int main(void) {
+    struct anvil_codec *codec;
+    assert(anvil_codec_open(&codec, nullptr) == ANVIL_OK);
+
+    // tall columns of short runs, so the LOD is many times the iterator's decompression window.
+    struct dh_lod lod = DH_LOD_CLEAR, expected = DH_LOD_CLEAR;
+    test_lod_random(&lod, 0, 5, -7, 384, 6);
+    test_random_seed(0);
+    test_lod_random(&expected, 0, 5, -7, 384, 6);
+    printf("%zuKiB uncompressed", expected.lod_len >> 10);
+    assert(expected.lod_len > 64 * 1024);
+
+    assert(dh_compress_ex(&lod, DH_DATA_COMPRESSION_LZ4, 0.5, codec) == DH_OK);
+    printf(", %zuKiB LZ4\n", lod.lod_len >> 10);
+    assert(lod.lod_len > 64 * 1024);
+
+    // every column, in x major order, the same as reading it directly.
+    struct dh_column_iter *iter;
+    assert(dh_column_iter_open(&iter, &lod, codec) == DH_OK);
+
+    const char *datapoints, *expected_datapoints;
+    size_t num_datapoints, expected_num_datapoints;
+    for (int64_t x = 0; x < 64; x++) for (int64_t z = 0; z < 64; z++) {
+        assert(dh_column_iter_next(iter, &datapoints, &num_datapoints) == DH_OK);
+        assert(dh_lod_column(&expected, x, z, &expected_datapoints, &expected_num_datapoints, nullptr) == DH_OK);
+        assert(num_datapoints == expected_num_datapoints);
+        assert(memcmp(datapoints, expected_datapoints, num_datapoints * 8) == 0);
+    }
+    assert(dh_column_iter_next(iter, &datapoints, &num_datapoints) == DH_DONE);
+    dh_column_iter_close(iter);
+
+    // skipping lands on the same columns.
+    assert(dh_column_iter_open(&iter, &lod, codec) == DH_OK);
+
+    size_t column = 0;
+    for (;;) {
+        const dh_result res = dh_column_iter_skip(iter, SKIP);
+        column += SKIP;
+        if (column > 64 * 64) {
+            assert(res == DH_DONE);
+            break;
+        }
+        assert(res == DH_OK);
+
+        const dh_result next = dh_column_iter_next(iter, &datapoints, &num_datapoints);
+        if (column == 64 * 64) {
+            assert(next == DH_DONE);
+            break;
+        }
+        assert(next == DH_OK);
+
+        assert(dh_lod_column(&expected, column / 64, column % 64, &expected_datapoints, &expected_num_datapoints, nullptr) == DH_OK);
+        assert(num_datapoints == expected_num_datapoints);
+        assert(memcmp(datapoints, expected_datapoints, num_datapoints * 8) == 0);
+        column++;
+    }
+    dh_column_iter_close(iter);
+
+    // the LOD is left compressed, and still matches its checksum.
+    assert(lod.compression_mode == DH_DATA_COMPRESSION_LZ4);
+    assert(dh_lod_verify(&lod, codec) == DH_OK);
+
+    dh_lod_free(&lod);
+    dh_lod_free(&expected);
+    anvil_codec_close(codec);
+    return 0;
+}
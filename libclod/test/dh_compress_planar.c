@@ -0,0 +1,45 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+
+#include <dh.h>
+
+#include "test.h"
+
+int main(int argc, char **argv) {
+    struct dh_lod plain = DH_LOD_CLEAR, planar = DH_LOD_CLEAR;
+    test_lod_terrain(&plain, 0, 0, 0);
+    test_lod_terrain(&planar, 0, 0, 0);
+
+    char *original = malloc(plain.lod_len);
+    const size_t original_len = plain.lod_len;
+    memcpy(original, plain.lod_arr, original_len);
+
+    const int64_t modes[] = { DH_DATA_COMPRESSION_LZ4, DH_DATA_COMPRESSION_LZMA2 };
+    for (int i = 0; i < 2; i++) {
+        dh_result res = dh_compress(&plain, modes[i], 0.5);
+        assert(res == DH_OK);
+        res = dh_compress(&planar, modes[i] | DH_DATA_COMPRESSION_PLANAR, 0.5);
+        assert(res == DH_OK);
+
+        printf(
+            "mode %ld: %zu bytes uncompressed, %zu bytes compressed, %zu bytes planar compressed\n",
+            modes[i], original_len, plain.lod_len, planar.lod_len
+        );
+
+        res = dh_compress(&plain, DH_DATA_COMPRESSION_UNCOMPRESSED, 0);
+        assert(res == DH_OK);
+        res = dh_compress(&planar, DH_DATA_COMPRESSION_UNCOMPRESSED, 0);
+        assert(res == DH_OK);
+
+        assert(plain.lod_len == original_len && memcmp(plain.lod_arr, original, original_len) == 0);
+        assert(planar.lod_len == original_len && memcmp(planar.lod_arr, original, original_len) == 0);
+    }
+
+    free(original);
+    dh_lod_free(&plain);
+    dh_lod_free(&planar);
+
+    return 0;
+}
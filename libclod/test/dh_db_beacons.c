@@ -0,0 +1,339 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+
+#include <sqlite3.h>
+#include <nbt.h>
+#include <dh.h>
+
+#include "test.h"
+
+//===============//
+// Chunk Writing //
+//===============//
+
+#define CHUNK_CAP (64 * 1024)
+
+struct chunk {
+    char data[CHUNK_CAP];
+    size_t len;
+};
+
+static void put(struct chunk *chunk, const uint64_t value, const int bytes) {
+    assert(chunk->len + bytes <= CHUNK_CAP);
+    for (int i = bytes - 1; i >= 0; i--) chunk->data[chunk->len++] = (char)(value >> i * 8);
+}
+
+static void put_string(struct chunk *chunk, const char *str) {
+    const size_t len = strlen(str);
+    put(chunk, len, 2);
+    assert(chunk->len + len <= CHUNK_CAP);
+    memcpy(chunk->data + chunk->len, str, len);
+    chunk->len += len;
+}
+
+static void put_tag(struct chunk *chunk, const int type, const char *name) {
+    put(chunk, type, 1);
+    put_string(chunk, name);
+}
+
+/**
+ * a section's palette, and the blocks in it that aren't the first entry.
+ */
+struct section {
+    int y;
+    const char *palette[17];
+    size_t palette_len;
+    struct { int x, y, z; uint32_t index; } blocks[4];
+    size_t blocks_len;
+};
+
+struct block_entity {
+    const char *id;
+    int x, y, z;
+};
+
+/**
+ * writes a chunk's NBT, with its sections' block states packed the way minecraft packs them.
+ */
+static void make_chunk(
+    struct chunk *chunk,
+    const struct section *sections,
+    const size_t num_sections,
+    const struct block_entity *entities,
+    const size_t num_entities
+) {
+    chunk->len = 0;
+    put_tag(chunk, NBT_COMPOUND, "");
+    put_tag(chunk, NBT_INT, "DataVersion");
+    put(chunk, 3953, 4);
+
+    put_tag(chunk, NBT_LIST, "sections");
+    put(chunk, NBT_COMPOUND, 1);
+    put(chunk, num_sections, 4);
+    for (size_t s = 0; s < num_sections; s++) {
+        const struct section *section = &sections[s];
+        put_tag(chunk, NBT_BYTE, "Y");
+        put(chunk, (uint8_t)section->y, 1);
+
+        put_tag(chunk, NBT_COMPOUND, "block_states");
+        put_tag(chunk, NBT_LIST, "palette");
+        put(chunk, NBT_COMPOUND, 1);
+        put(chunk, section->palette_len, 4);
+        for (size_t i = 0; i < section->palette_len; i++) {
+            put_tag(chunk, NBT_STRING, "Name");
+            put_string(chunk, section->palette[i]);
+            put(chunk, NBT_END, 1);
+        }
+
+        if (section->palette_len > 1) {
+            int bits = 4;
+            while ((1u << bits) < section->palette_len) bits++;
+            const int per_long = 64 / bits;
+            const int longs = (4096 + per_long - 1) / per_long;
+
+            uint32_t indices[4096] = { 0 };
+            for (size_t i = 0; i < section->blocks_len; i++) {
+                indices[(section->blocks[i].y & 15) * 256 + section->blocks[i].z * 16 + section->blocks[i].x] = section->blocks[i].index;
+            }
+
+            put_tag(chunk, NBT_LONG_ARRAY, "data");
+            put(chunk, longs, 4);
+            for (int l = 0; l < longs; l++) {
+                uint64_t packed = 0;
+                for (int i = 0; i < per_long && l * per_long + i < 4096; i++) {
+                    packed |= (uint64_t)indices[l * per_long + i] << i * bits;
+                }
+                put(chunk, packed, 8);
+            }
+        }
+        put(chunk, NBT_END, 1);
+        put(chunk, NBT_END, 1);
+    }
+
+    put_tag(chunk, NBT_LIST, "block_entities");
+    put(chunk, NBT_COMPOUND, 1);
+    put(chunk, num_entities, 4);
+    for (size_t i = 0; i < num_entities; i++) {
+        put_tag(chunk, NBT_STRING, "id");
+        put_string(chunk, entities[i].id);
+        put_tag(chunk, NBT_INT, "x");
+        put(chunk, (uint32_t)entities[i].x, 4);
+        put_tag(chunk, NBT_INT, "y");
+        put(chunk, (uint32_t)entities[i].y, 4);
+        put_tag(chunk, NBT_INT, "z");
+        put(chunk, (uint32_t)entities[i].z, 4);
+        put(chunk, NBT_END, 1);
+    }
+
+    put(chunk, NBT_END, 1);
+}
+
+//=========//
+// Beacons //
+//=========//
+
+static void check_beacon(const struct dh_beacon *beacon, const int64_t x, const int64_t y, const int64_t z, const uint32_t rgb) {
+    assert(beacon->x == x && beacon->y == y && beacon->z == z);
+    assert(beacon->r == (rgb >> 16 & 0xFF) && beacon->g == (rgb >> 8 & 0xFF) && beacon->b == (rgb & 0xFF));
+}
+
+/**
+ * the number of beacons stored, and the colour of the one at a position or 0 if there isn't one.
+ */
+static int64_t beacons(const char *path, const int64_t x, const int64_t y, const int64_t z, uint32_t *rgb) {
+    sqlite3 *db;
+    int err = sqlite3_open_v2(path, &db, SQLITE_OPEN_READONLY, nullptr);
+    assert(err == SQLITE_OK);
+
+    sqlite3_stmt *stmt;
+    err = sqlite3_prepare_v2(db, "select count(*) from BeaconBeam", -1, &stmt, nullptr);
+    assert(err == SQLITE_OK);
+    assert(sqlite3_step(stmt) == SQLITE_ROW);
+    const int64_t count = sqlite3_column_int64(stmt, 0);
+    sqlite3_finalize(stmt);
+
+    err = sqlite3_prepare_v2(db,
+        "select ColorR, ColorG, ColorB from BeaconBeam where BlockPosX = ? and BlockPosY = ? and BlockPosZ = ?",
+        -1, &stmt, nullptr
+    );
+    assert(err == SQLITE_OK);
+    sqlite3_bind_int64(stmt, 1, x);
+    sqlite3_bind_int64(stmt, 2, y);
+    sqlite3_bind_int64(stmt, 3, z);
+
+    *rgb = 0;
+    if (sqlite3_step(stmt) == SQLITE_ROW) {
+        *rgb = (uint32_t)sqlite3_column_int(stmt, 0) << 16 | (uint32_t)sqlite3_column_int(stmt, 1) << 8 | (uint32_t)sqlite3_column_int(stmt, 2);
+    }
+
+    sqlite3_finalize(stmt);
+    sqlite3_close(db);
+    return count;
+}
+
+#define WHITE 0xFFFFFF
+#define LIME 0x80C71F
+#define BLACK 0x1D1D21
+
+// red, then blue averaged in, then a light blue pane averaged in.
+#define RED_BLUE_LIGHT_BLUE 0x5876A1
+
+int main(void) {
+    char *path = test_path("DistantHorizons.sqlite");
+
+    // the chunk at 0, 0. a beacon under red glass in a section whose palette takes 5 bits an index,
+    // with glass beneath it and beside it that doesn't count. a section is missing above it,
+    // then plain glass, blue glass and a light blue pane. another beacon has nothing above it.
+    struct chunk *first = malloc(sizeof(struct chunk));
+    assert(first != nullptr);
+    {
+        const struct section sections[] = {
+            {
+                .y = -1,
+                .palette = {
+                    "minecraft:stone", "minecraft:dirt", "minecraft:andesite", "minecraft:diorite",
+                    "minecraft:granite", "minecraft:gravel", "minecraft:sand", "minecraft:clay",
+                    "minecraft:tuff", "minecraft:calcite", "minecraft:coal_ore", "minecraft:iron_ore",
+                    "minecraft:gold_ore", "minecraft:copper_ore", "minecraft:light_blue_stained_glass", "minecraft:beacon",
+                    "minecraft:red_stained_glass",
+                },
+                .palette_len = 17,
+                .blocks = { { 3, -10, 4, 16 }, { 3, -14, 4, 14 }, { 5, -10, 4, 16 }, { 3, -12, 4, 15 } },
+                .blocks_len = 4,
+            },
+            {
+                .y = 1,
+                .palette = {
+                    "minecraft:air", "minecraft:blue_stained_glass", "minecraft:glass",
+                    "minecraft:light_blue_stained_glass_pane",
+                },
+                .palette_len = 4,
+                .blocks = { { 3, 18, 4, 2 }, { 3, 20, 4, 1 }, { 3, 30, 4, 3 } },
+                .blocks_len = 3,
+            },
+        };
+        const struct block_entity entities[] = {
+            { "minecraft:chest", 3, -11, 4 },
+            { "minecraft:beacon", 3, -12, 4 },
+            { "minecraft:beacon", 9, 40, 9 },
+        };
+        make_chunk(first, sections, 2, entities, 3);
+    }
+
+    // the chunk at 1, 2, a beacon beneath a section of nothing but lime glass.
+    struct chunk *second = malloc(sizeof(struct chunk));
+    assert(second != nullptr);
+    {
+        const struct section sections[] = {
+            { .y = 4, .palette = { "minecraft:lime_stained_glass" }, .palette_len = 1 },
+        };
+        const struct block_entity entities[] = {
+            { "minecraft:beacon", 20, 63, 40 },
+        };
+        make_chunk(second, sections, 1, entities, 1);
+    }
+
+    // the chunk at -1, 0, a beacon at a negative x under black glass.
+    struct chunk *negative = malloc(sizeof(struct chunk));
+    assert(negative != nullptr);
+    {
+        const struct section sections[] = {
+            {
+                .y = 0,
+                .palette = { "minecraft:air", "minecraft:black_stained_glass" },
+                .palette_len = 2,
+                .blocks = { { 11, 10, 7, 1 } },
+                .blocks_len = 1,
+            },
+        };
+        const struct block_entity entities[] = {
+            { "minecraft:beacon", -5, 2, 7 },
+        };
+        make_chunk(negative, sections, 1, entities, 1);
+    }
+
+    // beacons are found in each chunk, coloured by the glass above them.
+    struct dh_lod lod = DH_LOD_CLEAR, other = DH_LOD_CLEAR;
+    const struct dh_beacon *found;
+    size_t num_found;
+
+    test_lod_terrain(&lod, 0, 0, 0);
+    assert(dh_lod_beacons(&lod, &found, &num_found) == DH_ERR_UNSUPPORTED);
+    assert(dh_lod_add_beacons(&lod, first->data, first->len) == DH_OK);
+    assert(dh_lod_add_beacons(&lod, second->data, second->len) == DH_OK);
+    assert(dh_lod_beacons(&lod, &found, &num_found) == DH_OK);
+    assert(num_found == 3);
+    check_beacon(&found[0], 3, -12, 4, RED_BLUE_LIGHT_BLUE);
+    check_beacon(&found[1], 9, 40, 9, WHITE);
+    check_beacon(&found[2], 20, 63, 40, LIME);
+
+    test_lod_terrain(&other, 0, -1, 0);
+    assert(dh_lod_add_beacons(&other, negative->data, negative->len) == DH_OK);
+    assert(dh_lod_beacons(&other, &found, &num_found) == DH_OK);
+    assert(num_found == 1);
+    check_beacon(&found[0], -5, 2, 7, BLACK);
+
+    // a chunk cut short is malformed.
+    assert(dh_lod_add_beacons(&other, first->data, first->len / 2) == DH_ERR_MALFORMED);
+
+    // storing a generated LOD stores its beacons.
+    struct dh_db *db = dh_db_open(path);
+    assert(db != nullptr);
+    assert(dh_db_store(db, &other) == 0);
+    assert(dh_db_store(db, &lod) == 0);
+    assert(dh_db_close_ex(db) == 0);
+
+    uint32_t rgb;
+    assert(beacons(path, 3, -12, 4, &rgb) == 4 && rgb == RED_BLUE_LIGHT_BLUE);
+    assert(beacons(path, 9, 40, 9, &rgb) == 4 && rgb == WHITE);
+    assert(beacons(path, 20, 63, 40, &rgb) == 4 && rgb == LIME);
+    assert(beacons(path, -5, 2, 7, &rgb) == 4 && rgb == BLACK);
+
+    // generating the LOD again from fewer beacons replaces those in its area, and leaves the others.
+    test_lod_terrain(&lod, 0, 0, 0);
+    assert(dh_lod_add_beacons(&lod, second->data, second->len) == DH_OK);
+
+    db = dh_db_open(path);
+    assert(db != nullptr);
+    assert(dh_db_store(db, &lod) == 0);
+    assert(dh_db_close_ex(db) == 0);
+
+    assert(beacons(path, 3, -12, 4, &rgb) == 2 && rgb == 0);
+    assert(beacons(path, 9, 40, 9, &rgb) == 2 && rgb == 0);
+    assert(beacons(path, 20, 63, 40, &rgb) == 2 && rgb == LIME);
+    assert(beacons(path, -5, 2, 7, &rgb) == 2 && rgb == BLACK);
+
+    // a loaded LOD has no beacons of its own, and storing it leaves the stored ones.
+    db = dh_db_open(path);
+    assert(db != nullptr);
+    assert(dh_db_load(db, 0, 0, 0, &lod) == 0);
+    assert(dh_lod_beacons(&lod, &found, &num_found) == DH_ERR_UNSUPPORTED);
+    assert(dh_db_store(db, &lod) == 0);
+    assert(dh_db_close_ex(db) == 0);
+    assert(beacons(path, 20, 63, 40, &rgb) == 2 && rgb == LIME);
+
+    // a LOD generated from chunks without beacons clears its area.
+    test_lod_terrain(&lod, 0, 0, 0);
+    assert(dh_lod_add_beacons(&lod, nullptr, 0) == DH_OK);
+    assert(dh_lod_beacons(&lod, &found, &num_found) == DH_OK && num_found == 0);
+
+    db = dh_db_open(path);
+    assert(db != nullptr);
+    assert(dh_db_store(db, &lod) == 0);
+    assert(dh_db_close_ex(db) == 0);
+    assert(beacons(path, 20, 63, 40, &rgb) == 1 && rgb == 0);
+    assert(beacons(path, -5, 2, 7, &rgb) == 1 && rgb == BLACK);
+
+    printf("ok\n");
+
+    dh_lod_free(&lod);
+    dh_lod_free(&other);
+    free(first);
+    free(second);
+    free(negative);
+    free(path);
+    test_dir_remove();
+    return 0;
+}
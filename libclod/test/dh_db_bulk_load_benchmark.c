@@ -0,0 +1,104 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <assert.h>
+
+#include <sqlite3.h>
+#include <dh.h>
+
+#include "test.h"
+
+#define LODS 128
+
+static long store_all(const char *path, const unsigned flags, struct dh_lod *lod) {
+    remove(path);
+
+    struct timespec start, end;
+    timespec_get(&start, TIME_UTC);
+
+    struct dh_db *db = dh_db_open_ex(path, flags);
+    assert(db != nullptr);
+
+    // only storing is timed, so the same LOD data is stored at every position.
+    for (int64_t x = 0; x < LODS; x++) for (int64_t z = 0; z < LODS; z++) {
+        lod->x = x;
+        lod->z = z;
+        lod->checksum = (int32_t)(x * LODS + z);
+
+        const int error = dh_db_store(db, lod);
+        assert(error == 0);
+    }
+
+    const int error = dh_db_close_ex(db);
+    assert(error == 0);
+
+    timespec_get(&end, TIME_UTC);
+
+    return
+        (end.tv_sec * 1000000000L + end.tv_nsec) -
+        (start.tv_sec * 1000000000L + start.tv_nsec);
+}
+
+static int64_t updated_indexes(const char *path) {
+    sqlite3 *db;
+    assert(sqlite3_open(path, &db) == SQLITE_OK);
+    sqlite3_stmt *stmt;
+    assert(sqlite3_prepare_v2(db,
+        "select count(*) from sqlite_master where type = 'index' and name = 'FullDataUpdatedIndex'", -1, &stmt, nullptr
+    ) == SQLITE_OK);
+    assert(sqlite3_step(stmt) == SQLITE_ROW);
+    const int64_t count = sqlite3_column_int64(stmt, 0);
+    sqlite3_finalize(stmt);
+    sqlite3_close(db);
+    return count;
+}
+
+int main(int argc, char **argv) {
+    char *path = test_path("bulk_load_benchmark.sqlite");
+
+    struct dh_lod lod = DH_LOD_CLEAR;
+    test_lod_terrain(&lod, 0, 0, 0);
+    const dh_result result = dh_compress(&lod, DH_DATA_COMPRESSION_LZMA2, 0.5);
+    assert(result == DH_OK);
+
+    const long normal_ns = store_all(path, 0, &lod);
+    const long bulk_ns = store_all(path, DH_DB_BULK_LOAD, &lod);
+
+    // the bulk load was committed on close.
+    struct dh_db *db = dh_db_open(path);
+    assert(db != nullptr);
+    struct dh_lod loaded = DH_LOD_CLEAR;
+    const int found = dh_db_load(db, 0, LODS - 1, LODS - 1, &loaded);
+    assert(found == 0);
+    assert(loaded.checksum == (int32_t)(LODS * LODS - 1));
+    dh_lod_free(&loaded);
+    dh_db_close(db);
+    assert(updated_indexes(path) == 1);
+
+    // a bulk load that never got to close leaves the index dropped, until the database is next opened.
+    sqlite3 *sql;
+    assert(sqlite3_open(path, &sql) == SQLITE_OK);
+    assert(sqlite3_exec(sql, "drop index FullDataUpdatedIndex", nullptr, nullptr, nullptr) == SQLITE_OK);
+    sqlite3_close(sql);
+    assert(updated_indexes(path) == 0);
+
+    db = dh_db_open(path);
+    assert(db != nullptr);
+    assert(updated_indexes(path) == 1);
+    dh_db_close(db);
+
+    dh_lod_free(&lod);
+    free(path);
+    test_dir_remove();
+
+    printf(
+        "stored %d LODs in %9.1fms normally, %9.1fms bulk loading (%.2fx)\n",
+        LODS * LODS,
+        (double)normal_ns / 1000000.0,
+        (double)bulk_ns / 1000000.0,
+        (double)normal_ns / (double)bulk_ns
+    );
+
+    return 0;
+}
@@ -0,0 +1,130 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <assert.h>
+
+#include <dh.h>
+
+#include "test.h"
+
+// mip level 0 LODs from -RANGE to RANGE - 1 in each axis, with a few missing.
+#define RANGE 6
+#define TOP_LEVEL 4
+#define THREADS 4
+
+/**
+ * stores the same mip level 0 LODs in a new database, and builds the levels above them
+ * within a memory budget, or without one if it's 0.
+ */
+static long build(const char *path, const unsigned threads, const size_t budget) {
+    remove(path);
+    struct dh_db *db = dh_db_open(path);
+    assert(db != nullptr);
+
+    struct dh_lod lod = DH_LOD_CLEAR;
+    for (int64_t x = -RANGE; x < RANGE; x++) for (int64_t z = -RANGE; z < RANGE; z++) {
+        if ((x * 7 + z * 3) % 5 == 0) continue;
+
+        test_lod_terrain(&lod, 0, x, z);
+        const int err = dh_db_store(db, &lod);
+        assert(err == 0);
+    }
+    dh_lod_free(&lod);
+
+    struct timespec start, end;
+    timespec_get(&start, TIME_UTC);
+
+    dh_budget_set(budget);
+    int err = dh_db_build_mips_ex(
+        db, TOP_LEVEL,
+        -RANGE, -RANGE, RANGE - 1, RANGE - 1,
+        DH_DATA_COMPRESSION_LZ4, 0.5, nullptr, threads
+    );
+    assert(err == 0);
+    dh_budget_set(0);
+
+    timespec_get(&end, TIME_UTC);
+
+    // every LOD the build allocated has been freed.
+    assert(dh_budget_used() == 0);
+
+    err = dh_db_close_ex(db);
+    assert(err == 0);
+
+    return (end.tv_sec - start.tv_sec) * 1000000000L + end.tv_nsec - start.tv_nsec;
+}
+
+/**
+ * checks every stored LOD in two databases is the same, byte for byte.
+ */
+static size_t compare(const char *a_path, const char *b_path) {
+    struct dh_db *a = dh_db_open(a_path), *b = dh_db_open(b_path);
+    assert(a != nullptr && b != nullptr);
+
+    struct dh_lod a_lod = DH_LOD_CLEAR, b_lod = DH_LOD_CLEAR;
+    size_t compared = 0;
+
+    for (int64_t level = 0; level <= TOP_LEVEL; level++) {
+        struct dh_db_cursor *a_cursor, *b_cursor;
+        int err = dh_db_cursor_open(&a_cursor, a, level, INT32_MIN, INT32_MIN, INT32_MAX, INT32_MAX);
+        assert(err == 0);
+        err = dh_db_cursor_open(&b_cursor, b, level, INT32_MIN, INT32_MIN, INT32_MAX, INT32_MAX);
+        assert(err == 0);
+
+        size_t level_lods = 0;
+        int a_res, b_res;
+        while ((a_res = dh_db_cursor_next(a_cursor, &a_lod)) == 1) {
+            b_res = dh_db_cursor_next(b_cursor, &b_lod);
+            assert(b_res == 1);
+            assert(test_lod_equal(&a_lod, &b_lod));
+            level_lods++;
+        }
+        assert(a_res == 0);
+        assert(dh_db_cursor_next(b_cursor, &b_lod) == 0);
+
+        // every level up to the top has something on it.
+        assert(level_lods > 0);
+        compared += level_lods;
+
+        dh_db_cursor_close(a_cursor);
+        dh_db_cursor_close(b_cursor);
+    }
+
+    dh_lod_free(&a_lod);
+    dh_lod_free(&b_lod);
+    dh_db_close(a);
+    dh_db_close(b);
+
+    return compared;
+}
+
+int main(int argc, char **argv) {
+    char *single_path = test_path("single.sqlite");
+    char *threaded_path = test_path("threaded.sqlite");
+    char *spilled_path = test_path("spilled.sqlite");
+
+    const long single_ns = build(single_path, 1, 0);
+    const long threaded_ns = build(threaded_path, THREADS, 0);
+
+    // a budget of a byte is always nearly used up, so every built LOD waiting on its siblings is spilled to disk.
+    const long spilled_ns = build(spilled_path, THREADS, 1);
+
+    printf(
+        "built mip levels 1 to %d in %.1fms on 1 thread, %.1fms on %d threads, %.1fms spilling\n",
+        TOP_LEVEL, (double)single_ns / 1000000.0, (double)threaded_ns / 1000000.0, THREADS, (double)spilled_ns / 1000000.0
+    );
+
+    // LODs are built the same whichever thread builds them and wherever they wait,
+    // only the order they're stored in differs.
+    size_t compared = compare(single_path, threaded_path);
+    printf("%zu LODs identical on %d threads\n", compared, THREADS);
+    compared = compare(single_path, spilled_path);
+    printf("%zu LODs identical spilling\n", compared);
+
+    free(single_path);
+    free(threaded_path);
+    free(spilled_path);
+    test_dir_remove();
+
+    return 0;
+}
@@ -0,0 +1,76 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <assert.h>
+
+#include <sqlite3.h>
+#include <dh.h>
+
+#include "test.h"
+
+// 4x4 mip level 0 LODs, making 2x2 at level 1 and one at level 2.
+#define SIZE 4
+#define TOP_LEVEL 2
+
+int main(void) {
+    char *path = test_path("DistantHorizons.sqlite");
+
+    struct dh_db *db = dh_db_open(path);
+    assert(db != nullptr);
+
+    // stored as if they'd just changed, so building the mips clears ApplyToParent on them.
+    struct dh_lod lod = DH_LOD_CLEAR;
+    for (int64_t x = 0; x < SIZE; x++) for (int64_t z = 0; z < SIZE; z++) {
+        test_lod_terrain(&lod, 0, x, z);
+        const int err = dh_db_store_ex(db, &lod, true);
+        assert(err == 0);
+    }
+    dh_lod_free(&lod);
+
+    int err = dh_db_build_mips(db, TOP_LEVEL, 0, 0, SIZE - 1, SIZE - 1, DH_DATA_COMPRESSION_LZ4, 0.5, nullptr);
+    assert(err == 0);
+    err = dh_db_close_ex(db);
+    assert(err == 0);
+
+    sqlite3 *sql;
+    err = sqlite3_open_v2(path, &sql, SQLITE_OPEN_READONLY, nullptr);
+    assert(err == SQLITE_OK);
+
+    sqlite3_stmt *stmt;
+    err = sqlite3_prepare_v2(sql,
+        "select DetailLevel, count(*), sum(ApplyToParent), sum(ApplyToChildren) from FullData "
+        "group by DetailLevel order by DetailLevel",
+        -1, &stmt, nullptr
+    );
+    assert(err == SQLITE_OK);
+
+    // rows, then how many have ApplyToParent and ApplyToChildren set, for each level.
+    const int expected[TOP_LEVEL + 1][3] = {
+        { SIZE * SIZE, 0, 0 },
+        { SIZE * SIZE / 4, 0, SIZE * SIZE / 4 },
+        { 1, 1, 1 },
+    };
+
+    int levels = 0;
+    while ((err = sqlite3_step(stmt)) == SQLITE_ROW) {
+        const int level = sqlite3_column_int(stmt, 0);
+        const int rows = sqlite3_column_int(stmt, 1);
+        const int apply_to_parent = sqlite3_column_int(stmt, 2);
+        const int apply_to_children = sqlite3_column_int(stmt, 3);
+        printf("level %d: %d rows, %d ApplyToParent, %d ApplyToChildren\n", level, rows, apply_to_parent, apply_to_children);
+
+        assert(level == levels && level <= TOP_LEVEL);
+        assert(rows == expected[level][0]);
+        assert(apply_to_parent == expected[level][1]);
+        assert(apply_to_children == expected[level][2]);
+        levels++;
+    }
+    assert(err == SQLITE_DONE);
+    assert(levels == TOP_LEVEL + 1);
+
+    sqlite3_finalize(stmt);
+    sqlite3_close(sql);
+
+    free(path);
+    test_dir_remove();
+    return 0;
+}
@@ -0,0 +1,106 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <assert.h>
+
+#include <dh.h>
+
+#include "test.h"
+
+// mip level 0 LODs from -RANGE to RANGE - 1 in each axis.
+#define RANGE 3
+
+// a LOD stored with a checksum that doesn't match its data.
+#define CORRUPT_X 1
+#define CORRUPT_Z (-2)
+
+static const int64_t modes[] = {
+    DH_DATA_COMPRESSION_UNCOMPRESSED,
+    DH_DATA_COMPRESSION_LZ4,
+    DH_DATA_COMPRESSION_LZMA2,
+};
+
+int main(int argc, char **argv) {
+    char *path = test_path("DistantHorizons.sqlite");
+
+    // LODs are stored with every compression mode, as DH may have written them with any of them.
+    struct dh_db *db = dh_db_open(path);
+    assert(db != nullptr);
+
+    struct dh_lod lod = DH_LOD_CLEAR;
+    for (int64_t x = -RANGE; x < RANGE; x++) for (int64_t z = -RANGE; z < RANGE; z++) {
+        test_lod_terrain(&lod, 0, x, z);
+        if (x == CORRUPT_X && z == CORRUPT_Z) lod.checksum ^= 1;
+
+        const dh_result result = dh_compress(&lod, modes[(x + z + 2 * RANGE) % 3], 0.5);
+        assert(result == DH_OK);
+
+        const int err = dh_db_store(db, &lod);
+        assert(err == 0);
+    }
+
+    assert(dh_db_load(db, 0, RANGE, 0, &lod) == 1);
+    assert(dh_db_load(db, 1, 0, 0, &lod) == 1);
+    dh_lod_free(&lod);
+
+    // the whole level is read, in x then z order.
+    struct dh_db_cursor *cursor;
+    int res = dh_db_cursor_open(&cursor, db, 0, INT32_MIN, INT32_MIN, INT32_MAX, INT32_MAX);
+    assert(res == 0);
+
+    struct dh_lod expected = DH_LOD_CLEAR;
+    lod = DH_LOD_CLEAR;
+    size_t num_lods = 0, num_corrupt = 0;
+
+    while ((res = dh_db_cursor_next(cursor, &lod)) == 1) {
+        assert(lod.x == -RANGE + (int64_t)num_lods / (2 * RANGE));
+        assert(lod.z == -RANGE + (int64_t)num_lods % (2 * RANGE));
+        assert(lod.compression_mode == modes[(lod.x + lod.z + 2 * RANGE) % 3]);
+        num_lods++;
+
+        // LZMA compressed LODs can't be verified without decompressing them first.
+        if ((lod.compression_mode & DH_DATA_COMPRESSION_MODE_MASK) == DH_DATA_COMPRESSION_LZMA2)
+            dh_compress(&lod, DH_DATA_COMPRESSION_UNCOMPRESSED, 0);
+
+        // only LODs stored by this library have checksums that can be verified.
+        if (dh_lod_verify(&lod, nullptr) == DH_ERR_MALFORMED) {
+            printf("LOD (%ld, %ld) doesn't match its checksum\n", lod.x, lod.z);
+            assert(lod.x == CORRUPT_X && lod.z == CORRUPT_Z);
+            num_corrupt++;
+            continue;
+        }
+
+        // the data and mapping are what was stored.
+        const dh_result result = dh_compress(&lod, DH_DATA_COMPRESSION_UNCOMPRESSED, 0);
+        assert(result == DH_OK);
+        test_lod_terrain(&expected, 0, lod.x, lod.z);
+        assert(test_lod_equal(&lod, &expected));
+    }
+    assert(res == 0);
+
+    printf("read %zu LODs, %zu corrupt\n", num_lods, num_corrupt);
+    assert(num_lods == 2 * RANGE * 2 * RANGE);
+    assert(num_corrupt == 1);
+
+    dh_db_cursor_close(cursor);
+
+    // a range only reads what's in it.
+    res = dh_db_cursor_open(&cursor, db, 0, -1, -2, 0, 1);
+    assert(res == 0);
+    num_lods = 0;
+    while ((res = dh_db_cursor_next(cursor, &lod)) == 1) {
+        assert(lod.x >= -1 && lod.x <= 0 && lod.z >= -2 && lod.z <= 1);
+        num_lods++;
+    }
+    assert(res == 0);
+    assert(num_lods == 2 * 4);
+
+    dh_db_cursor_close(cursor);
+    dh_lod_free(&lod);
+    dh_lod_free(&expected);
+    dh_db_close(db);
+
+    free(path);
+    test_dir_remove();
+    return 0;
+}
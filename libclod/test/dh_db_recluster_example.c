@@ -0,0 +1,140 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <assert.h>
+
+#include <sqlite3.h>
+#include <dh.h>
+
+#include "test.h"
+
+#define LEVELS 3
+#define RANGE 4
+
+struct row {
+    int64_t mip_level, x, z;
+    int32_t checksum;
+    bool seen;
+};
+
+// (2 * RANGE)^2 LODs at mip level 0, and a quarter as many on each level above.
+static struct row rows[(2 * RANGE) * (2 * RANGE) * 2];
+static size_t num_rows = 0;
+
+/**
+ * the Morton key the database is clustered by, written out again so the test doesn't trust the library's.
+ */
+static uint64_t morton(const int64_t x, const int64_t z) {
+    const uint32_t ux = (uint32_t)x ^ 0x80000000u, uz = (uint32_t)z ^ 0x80000000u;
+    uint64_t key = 0;
+    for (int bit = 0; bit < 32; bit++) {
+        key |= (uint64_t)(ux >> bit & 1) << (bit * 2 + 1);
+        key |= (uint64_t)(uz >> bit & 1) << (bit * 2);
+    }
+    return key;
+}
+
+static bool in_order(const int64_t level_a, const uint64_t key_a, const int64_t level_b, const uint64_t key_b) {
+    return level_a < level_b || (level_a == level_b && key_a <= key_b);
+}
+
+int main(void) {
+    char *path = test_path("DistantHorizons.sqlite");
+    char *out_path = test_path("DistantHorizons.clustered.sqlite");
+
+    for (int64_t level = 0; level < LEVELS; level++) {
+        const int64_t range = RANGE >> level;
+        for (int64_t x = -range; x < range; x++) for (int64_t z = -range; z < range; z++) {
+            rows[num_rows] = (struct row){ level, x, z, (int32_t)(1000 + num_rows), false };
+            num_rows++;
+        }
+    }
+
+    // stored in a shuffled order, as LODs generated in no particular order would be.
+    test_random_seed(7);
+    for (size_t i = num_rows - 1; i > 0; i--) {
+        const size_t j = test_random() % (i + 1);
+        const struct row tmp = rows[i];
+        rows[i] = rows[j];
+        rows[j] = tmp;
+    }
+
+    struct dh_db *db = dh_db_open(path);
+    assert(db != nullptr);
+
+    struct dh_lod lod = DH_LOD_CLEAR;
+    test_lod_terrain(&lod, 0, 0, 0);
+    assert(dh_compress(&lod, DH_DATA_COMPRESSION_LZ4, 0.5) == DH_OK);
+
+    bool shuffled = false;
+    for (size_t i = 0; i < num_rows; i++) {
+        lod.mip_level = rows[i].mip_level;
+        lod.x = rows[i].x;
+        lod.z = rows[i].z;
+        lod.checksum = rows[i].checksum;
+        assert(dh_db_store(db, &lod) == 0);
+
+        if (i > 0 && !in_order(
+            rows[i - 1].mip_level, morton(rows[i - 1].x, rows[i - 1].z),
+            rows[i].mip_level, morton(rows[i].x, rows[i].z)
+        )) shuffled = true;
+    }
+    assert(shuffled);
+    assert(dh_db_close_ex(db) == 0);
+
+    assert(dh_db_recluster(path, out_path) == 0);
+
+    // every row survived, with its data, and rowids follow (DetailLevel, Morton position).
+    sqlite3 *sql;
+    assert(sqlite3_open_v2(out_path, &sql, SQLITE_OPEN_READONLY, nullptr) == SQLITE_OK);
+    sqlite3_stmt *stmt;
+    assert(sqlite3_prepare_v2(sql,
+        "select DetailLevel, PosX, PosZ, DataChecksum from FullData order by rowid", -1, &stmt, nullptr
+    ) == SQLITE_OK);
+
+    size_t count = 0;
+    int64_t last_level = -1;
+    uint64_t last_key = 0;
+    int err;
+    while ((err = sqlite3_step(stmt)) == SQLITE_ROW) {
+        const int64_t level = sqlite3_column_int64(stmt, 0);
+        const int64_t x = sqlite3_column_int64(stmt, 1);
+        const int64_t z = sqlite3_column_int64(stmt, 2);
+        const int32_t checksum = (int32_t)sqlite3_column_int64(stmt, 3);
+
+        size_t i = 0;
+        while (i < num_rows && (rows[i].mip_level != level || rows[i].x != x || rows[i].z != z)) i++;
+        assert(i < num_rows);
+        assert(!rows[i].seen);
+        assert(rows[i].checksum == checksum);
+        rows[i].seen = true;
+
+        const uint64_t key = morton(x, z);
+        assert(in_order(last_level, last_key, level, key));
+        last_level = level;
+        last_key = key;
+        count++;
+    }
+    assert(err == SQLITE_DONE);
+    assert(count == num_rows);
+
+    sqlite3_finalize(stmt);
+    sqlite3_close(sql);
+
+    // the reclustered database is still a usable one.
+    db = dh_db_open(out_path);
+    assert(db != nullptr);
+    struct dh_lod loaded = DH_LOD_CLEAR;
+    assert(dh_db_load(db, rows[0].mip_level, rows[0].x, rows[0].z, &loaded) == 0);
+    assert(loaded.checksum == rows[0].checksum);
+    assert(loaded.lod_len == lod.lod_len);
+    dh_db_close(db);
+
+    printf("reclustered %zu LODs\n", count);
+
+    dh_lod_free(&loaded);
+    dh_lod_free(&lod);
+    free(out_path);
+    free(path);
+    test_dir_remove();
+    return 0;
+}
@@ -0,0 +1,189 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <assert.h>
+#include <sys/stat.h>
+
+#include <sqlite3.h>
+#include <anvil.h>
+#include <dh.h>
+
+#include "test.h"
+
+// a region with negative positions, whose LODs' ancestors round down.
+#define REGION_X (-1)
+#define REGION_Z 0
+#define TOP_LEVEL 4
+
+// LODs with chunks, from the region's corner.
+#define SIZE 4
+
+// a LOD one of whose chunks is changed, and one whose chunk is saved again unchanged.
+#define CHANGED_X 1
+#define CHANGED_Z 2
+#define RESAVED_X 3
+#define RESAVED_Z 0
+
+// how many times each LOD's chunks have changed, which generate makes its LOD from.
+static uint64_t versions[SIZE][SIZE];
+
+static dh_result generate(const int64_t lod_x, const int64_t lod_z, struct dh_lod *lod, void *user) {
+    const int64_t x = lod_x - REGION_X * 8, z = lod_z - REGION_Z * 8;
+    assert(x >= 0 && x < SIZE && z >= 0 && z < SIZE);
+
+    test_random_seed((uint64_t)(x * SIZE + z) * 1000 + versions[x][z]);
+    test_lod_random(lod, 0, lod_x, lod_z, 64, 8);
+    ++*(int*)user;
+    return DH_OK;
+}
+
+static void write_chunk(struct anvil_region_file *region_file, const int64_t chunk_x, const int64_t chunk_z) {
+    const int64_t x = chunk_x - REGION_X * 32, z = chunk_z - REGION_Z * 32;
+
+    char data[64];
+    const int len = snprintf(data, sizeof(data), "chunk %ld %ld version %lu", chunk_x, chunk_z, versions[x / 4][z / 4]);
+    const anvil_result res = anvil_chunk_write_ex(data, len, 0.5, ANVIL_COMPRESSION_ZLIB, chunk_x, chunk_z, region_file, nullptr);
+    assert(res == ANVIL_OK);
+}
+
+/**
+ * the single value a query returns.
+ */
+static int64_t query(const char *path, const char *sql) {
+    sqlite3 *db;
+    int err = sqlite3_open(path, &db);
+    assert(err == SQLITE_OK);
+
+    sqlite3_stmt *stmt;
+    err = sqlite3_prepare_v2(db, sql, -1, &stmt, nullptr);
+    assert(err == SQLITE_OK);
+    err = sqlite3_step(stmt);
+    assert(err == SQLITE_ROW);
+    const int64_t result = sqlite3_column_int64(stmt, 0);
+
+    sqlite3_finalize(stmt);
+    sqlite3_close(db);
+    return result;
+}
+
+static int update(const char *path, struct anvil_region_file *region_file, int *calls, struct dh_lod_pool *pool) {
+    struct dh_db *db = dh_db_open(path);
+    assert(db != nullptr);
+
+    const int changed = dh_db_update_region_ex(
+        db, region_file, REGION_X, REGION_Z, TOP_LEVEL,
+        DH_DATA_COMPRESSION_LZ4, 0.5, nullptr, generate, calls, pool
+    );
+    assert(changed >= 0);
+
+    assert(dh_db_close_ex(db) == 0);
+    return changed;
+}
+
+int main(void) {
+    char *path = test_path("DistantHorizons.sqlite");
+    char *region_path = test_path("region");
+    assert(mkdir(region_path, 0755) == 0);
+
+    struct anvil_world *world;
+    anvil_result res = anvil_world_open(&world, test_dir(), nullptr);
+    assert(res == ANVIL_OK);
+    struct anvil_region_dir *region_dir;
+    res = anvil_world_open_region_dir(&region_dir, world, "region", nullptr, nullptr);
+    assert(res == ANVIL_OK);
+    struct anvil_region_file *region_file;
+    res = anvil_region_open_file(&region_file, region_dir, REGION_X, REGION_Z);
+    assert(res == ANVIL_OK);
+
+    for (int64_t x = 0; x < SIZE * 4; x++) for (int64_t z = 0; z < SIZE * 4; z++)
+        write_chunk(region_file, REGION_X * 32 + x, REGION_Z * 32 + z);
+
+    // everything is new, so every LOD with chunks is made, along with one ancestor per level above them.
+    int calls = 0;
+    assert(update(path, region_file, &calls, nullptr) == SIZE * SIZE);
+    assert(calls == SIZE * SIZE);
+
+    assert(query(path, "select count(*) from FullData where DetailLevel = 0") == SIZE * SIZE);
+    assert(query(path, "select count(*) from FullData where DetailLevel = 1") == SIZE * SIZE / 4);
+    for (int64_t level = 2; level <= TOP_LEVEL; level++) {
+        char sql[128];
+        snprintf(sql, sizeof(sql), "select count(*) from FullData where DetailLevel = %ld", level);
+        assert(query(path, sql) == 1);
+    }
+
+    // only the top level is left for DH to carry further up.
+    assert(query(path, "select sum(ApplyToParent) from FullData") == 1);
+    assert(query(path, "select max(DetailLevel) from FullData where ApplyToParent = 1") == TOP_LEVEL);
+
+    // chunks are recorded with their mtime in milliseconds.
+    assert(query(path, "select count(*) from ChunkHash") == SIZE * 4 * SIZE * 4);
+    const int64_t mtime = anvil_chunk_mtime(region_file, REGION_X * 32, REGION_Z * 32);
+    assert(mtime != 0);
+    assert(query(path, "select min(LastModifiedUnixDateTime) from ChunkHash") == mtime * 1000);
+
+    // later updates share a LOD from a pool, as a pipeline updating many regions would.
+    struct dh_lod_pool *pool = dh_lod_pool_new(1, nullptr);
+    assert(pool != nullptr);
+
+    // nothing has changed since.
+    assert(update(path, region_file, &calls, pool) == 0);
+    assert(calls == SIZE * SIZE);
+
+    // mtimes are in seconds, so a chunk saved in the same second as before would look unchanged.
+    while (time(nullptr) <= mtime) {
+        const struct timespec wait = { .tv_nsec = 50000000 };
+        nanosleep(&wait, nullptr);
+    }
+
+    // marks every row, so it's clear which ones the next update rewrites.
+    sqlite3 *sql;
+    assert(sqlite3_open(path, &sql) == SQLITE_OK);
+    assert(sqlite3_exec(sql, "update FullData set LastModifiedUnixDateTime = 1", nullptr, nullptr, nullptr) == SQLITE_OK);
+    sqlite3_close(sql);
+
+    write_chunk(region_file, REGION_X * 32 + RESAVED_X * 4, REGION_Z * 32 + RESAVED_Z * 4 + 3);
+    versions[CHANGED_X][CHANGED_Z]++;
+    write_chunk(region_file, REGION_X * 32 + CHANGED_X * 4 + 2, REGION_Z * 32 + CHANGED_Z * 4 + 1);
+
+    // a chunk saved without changing doesn't make its LOD again, but its new mtime is recorded.
+    assert(update(path, region_file, &calls, pool) == 1);
+    assert(calls == SIZE * SIZE + 1);
+    assert(query(path, "select count(*) from ChunkHash where LastModifiedUnixDateTime > (select min(LastModifiedUnixDateTime) from ChunkHash)") == 2);
+
+    // only the changed LOD and one ancestor per level are rewritten.
+    assert(query(path, "select count(*) from FullData where LastModifiedUnixDateTime != 1") == TOP_LEVEL + 1);
+    for (int64_t level = 0; level <= TOP_LEVEL; level++) {
+        char sql_text[256];
+        snprintf(sql_text, sizeof(sql_text),
+            "select count(*) from FullData where DetailLevel = %ld and PosX = %ld and PosZ = %ld and LastModifiedUnixDateTime != 1",
+            level, (int64_t)(REGION_X * 8 + CHANGED_X) >> level, (int64_t)(REGION_Z * 8 + CHANGED_Z) >> level
+        );
+        assert(query(path, sql_text) == 1);
+    }
+    assert(query(path, "select sum(ApplyToParent) from FullData") == 1);
+
+    // the changed LOD is the one made from its new chunks.
+    struct dh_db *db = dh_db_open(path);
+    assert(db != nullptr);
+    struct dh_lod lod = DH_LOD_CLEAR, expected = DH_LOD_CLEAR;
+    assert(dh_db_load(db, 0, REGION_X * 8 + CHANGED_X, REGION_Z * 8 + CHANGED_Z, &lod) == 0);
+    assert(dh_compress(&lod, DH_DATA_COMPRESSION_UNCOMPRESSED, 0) == DH_OK);
+    generate(REGION_X * 8 + CHANGED_X, REGION_Z * 8 + CHANGED_Z, &expected, &calls);
+    assert(test_lod_equal(&lod, &expected));
+    dh_db_close(db);
+
+    printf("ok\n");
+
+    dh_lod_free(&lod);
+    dh_lod_free(&expected);
+    dh_lod_pool_free(pool);
+    anvil_region_file_close(region_file);
+    anvil_region_dir_close(region_dir);
+    anvil_world_close(world);
+
+    free(region_path);
+    free(path);
+    test_dir_remove();
+    return 0;
+}
@@ -0,0 +1,131 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <assert.h>
+
+#include <sqlite3.h>
+#include <dh.h>
+
+#include "test.h"
+
+// 4x4 mip level 0 LODs, and the level 1 LOD above some of them.
+#define SIZE 4
+
+// a LOD that's stored again with different data.
+#define CHANGED_X 3
+#define CHANGED_Z 0
+
+// an area that's deleted.
+#define DELETED_MIN_X 1
+#define DELETED_MIN_Z 1
+#define DELETED_MAX_X 2
+#define DELETED_MAX_Z 2
+
+static void exec(const char *path, const char *sql) {
+    sqlite3 *db;
+    int err = sqlite3_open(path, &db);
+    assert(err == SQLITE_OK);
+    err = sqlite3_exec(db, sql, nullptr, nullptr, nullptr);
+    assert(err == SQLITE_OK);
+    sqlite3_close(db);
+}
+
+int main(void) {
+    char *path = test_path("DistantHorizons.sqlite");
+
+    struct dh_db *db = dh_db_open(path);
+    assert(db != nullptr);
+
+    struct dh_lod lod = DH_LOD_CLEAR, expected = DH_LOD_CLEAR;
+    for (int64_t x = 0; x < SIZE; x++) for (int64_t z = 0; z < SIZE; z++) {
+        test_lod_terrain(&lod, 0, x, z);
+        const int err = dh_db_store(db, &lod);
+        assert(err == 0);
+    }
+    test_lod_terrain(&lod, 1, 0, 0);
+    assert(dh_db_store(db, &lod) == 0);
+    assert(dh_db_close_ex(db) == 0);
+
+    // marks every row, so it's clear which ones a later store rewrites.
+    exec(path, "update FullData set ApplyToParent = 0, LastModifiedUnixDateTime = 1, CreatedUnixDateTime = 1");
+
+    // the same LODs again, as if they'd changed, and one that really has.
+    db = dh_db_open(path);
+    assert(db != nullptr);
+
+    for (int64_t x = 0; x < SIZE; x++) for (int64_t z = 0; z < SIZE; z++) {
+        if (x == CHANGED_X && z == CHANGED_Z) {
+            test_random_seed(1);
+            test_lod_random(&lod, 0, x, z, 64, 8);
+        } else {
+            test_lod_terrain(&lod, 0, x, z);
+        }
+        const int err = dh_db_store_ex(db, &lod, true);
+        assert(err == 0);
+    }
+    assert(dh_db_close_ex(db) == 0);
+
+    sqlite3 *sql;
+    int err = sqlite3_open_v2(path, &sql, SQLITE_OPEN_READONLY, nullptr);
+    assert(err == SQLITE_OK);
+
+    sqlite3_stmt *stmt;
+    err = sqlite3_prepare_v2(sql,
+        "select PosX, PosZ, ApplyToParent, LastModifiedUnixDateTime, CreatedUnixDateTime "
+        "from FullData where DetailLevel = 0",
+        -1, &stmt, nullptr
+    );
+    assert(err == SQLITE_OK);
+
+    // only the changed row is rewritten, and it keeps when it was created.
+    size_t rows = 0;
+    while ((err = sqlite3_step(stmt)) == SQLITE_ROW) {
+        const int64_t x = sqlite3_column_int64(stmt, 0);
+        const int64_t z = sqlite3_column_int64(stmt, 1);
+        const bool changed = x == CHANGED_X && z == CHANGED_Z;
+        assert(sqlite3_column_int(stmt, 2) == changed);
+        assert((sqlite3_column_int64(stmt, 3) != 1) == changed);
+        assert(sqlite3_column_int64(stmt, 4) == 1);
+        rows++;
+    }
+    assert(err == SQLITE_DONE);
+    assert(rows == SIZE * SIZE);
+
+    sqlite3_finalize(stmt);
+    sqlite3_close(sql);
+
+    // deleting an area of level 0 leaves everything outside it, and the level above it.
+    db = dh_db_open(path);
+    assert(db != nullptr);
+    err = dh_db_delete(db, 0, DELETED_MIN_X, DELETED_MIN_Z, DELETED_MAX_X, DELETED_MAX_Z);
+    assert(err == 0);
+
+    for (int64_t x = 0; x < SIZE; x++) for (int64_t z = 0; z < SIZE; z++) {
+        const int res = dh_db_load(db, 0, x, z, &lod);
+        if (x >= DELETED_MIN_X && x <= DELETED_MAX_X && z >= DELETED_MIN_Z && z <= DELETED_MAX_Z) {
+            assert(res == 1);
+            continue;
+        }
+        assert(res == 0);
+
+        if (x == CHANGED_X && z == CHANGED_Z) {
+            test_random_seed(1);
+            test_lod_random(&expected, 0, x, z, 64, 8);
+        } else {
+            test_lod_terrain(&expected, 0, x, z);
+        }
+        assert(test_lod_equal(&lod, &expected));
+    }
+
+    assert(dh_db_load(db, 1, 0, 0, &lod) == 0);
+    test_lod_terrain(&expected, 1, 0, 0);
+    assert(test_lod_equal(&lod, &expected));
+    assert(dh_db_close_ex(db) == 0);
+
+    printf("ok\n");
+
+    dh_lod_free(&lod);
+    dh_lod_free(&expected);
+    free(path);
+    test_dir_remove();
+    return 0;
+}
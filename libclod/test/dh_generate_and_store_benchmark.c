@@ -75,6 +75,7 @@ int main(int argc, char **argv) {
             // generate LOD
             timespec_get(&lod_start, TIME_UTC);
                 result = dh_from_chunks(chunks, &lod);
+                if (result == DH_OK) result = dh_lod_serialise(&lod);
             timespec_get(&lod_end, TIME_UTC);
 
             assert(result == DH_OK);
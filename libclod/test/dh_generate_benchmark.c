@@ -52,6 +52,8 @@ int main(int argc, char **argv) {
 
                 dh_result result = dh_from_chunks(chunks, &lod);
                 assert(result == DH_OK);
+                result = dh_lod_serialise(&lod);
+                assert(result == DH_OK);
             
             timespec_get(&lod_end, TIME_UTC);
     
@@ -0,0 +1,89 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <assert.h>
+
+#include <dh.h>
+
+#include "test.h"
+
+#define SURFACE 200
+#define DEPTH 16
+#define MAX_DATAPOINTS 24
+
+/**
+ * fills a LOD with columns of sky, a grass surface, then caves riddled with ore down to y 0.
+ * odd columns are all sky lit, like a tall structure of thin layers, so only the budget makes them compact.
+ */
+static void make_lod(struct dh_lod *lod) {
+    test_lod_begin(lod, 0, 0, 0);
+
+    uint64_t dps[2 + SURFACE];
+    for (int column = 0; column < 64 * 64; column++) {
+        const uint64_t sky = column & 1 ? 15 : 0;
+        size_t count = 0;
+
+        dps[count++] = test_datapoint(0, 15, SURFACE + 1, 100, TEST_AIR);
+        dps[count++] = test_datapoint(0, 15, SURFACE, 1, TEST_GRASS);
+
+        for (uint64_t y = SURFACE; y > 0; count++) {
+            uint64_t height = 1 + test_random() % 3;
+            if (height > y) height = y;
+            y -= height;
+
+            const uint64_t id = count % 2 ? TEST_STONE : test_random() % 2 ? TEST_IRON_ORE : TEST_CAVE_AIR;
+            dps[count] = test_datapoint(0, sky, y, height, id);
+        }
+
+        test_lod_column(lod, dps, count);
+    }
+
+    test_lod_end(lod);
+}
+
+int main(void) {
+    struct dh_lod original = DH_LOD_CLEAR, lod = DH_LOD_CLEAR;
+    make_lod(&original);
+    test_random_seed(0);
+    make_lod(&lod);
+
+    assert(dh_lod_compact(&lod, DEPTH, MAX_DATAPOINTS, nullptr) == DH_OK);
+    assert(dh_lod_serialise(&lod) == DH_OK);
+    assert(dh_lod_verify(&lod, nullptr) == DH_OK);
+    printf("%zuKiB -> %zuKiB\n", original.lod_len >> 10, lod.lod_len >> 10);
+
+    const char *before = original.lod_arr, *after = lod.lod_arr;
+    for (int column = 0; column < 64 * 64; column++) {
+        const size_t before_len = (uint8_t)before[0] << 8 | (uint8_t)before[1];
+        const size_t after_len = (uint8_t)after[0] << 8 | (uint8_t)after[1];
+        assert(after_len <= MAX_DATAPOINTS);
+
+        // the surface and the first DEPTH blocks beneath it are kept wherever the sky can't reach,
+        // though they may be joined onto identical datapoints beneath them.
+        if (!(column & 1)) {
+            for (size_t i = 0; i < before_len; i++) {
+                const uint64_t dp = test_read_u64(before + 2 + i * 8);
+                const uint64_t min_y = dp >> 44 & 0xFFF, top = min_y + (dp >> 32 & 0xFFF);
+                if (top <= SURFACE - DEPTH) break;
+
+                assert(i < after_len);
+                const uint64_t kept = test_read_u64(after + 2 + i * 8);
+                assert((kept & 0xFF000000FFFFFFFFULL) == (dp & 0xFF000000FFFFFFFFULL));
+                assert((kept >> 44 & 0xFFF) <= min_y);
+                assert((kept >> 44 & 0xFFF) + (kept >> 32 & 0xFFF) == top);
+            }
+        }
+
+        // nothing is added or lost at the bottom.
+        assert((test_read_u64(before + 2 + (before_len - 1) * 8) >> 44 & 0xFFF) == (test_read_u64(after + 2 + (after_len - 1) * 8) >> 44 & 0xFFF));
+
+        before += 2 + before_len * 8;
+        after += 2 + after_len * 8;
+    }
+
+    dh_lod_free(&lod);
+    dh_lod_free(&original);
+
+    return 0;
+}
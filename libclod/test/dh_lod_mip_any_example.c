@@ -0,0 +1,56 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <assert.h>
+
+#include <dh.h>
+
+#include "test.h"
+
+int main(void) {
+    struct dh_lod sources[4 * 4];
+    struct dh_lod *src[4 * 4];
+    for (int x = 0; x < 4; x++) for (int z = 0; z < 4; z++) {
+        sources[x * 4 + z] = DH_LOD_CLEAR;
+        test_lod_random(&sources[x * 4 + z], 1, -4 + x, 8 + z, 128, 16);
+        src[x * 4 + z] = &sources[x * 4 + z];
+    }
+
+    // with every source there, it's the same as dh_lod_mip.
+    struct dh_lod expected = DH_LOD_CLEAR, lod = DH_LOD_CLEAR;
+    assert(dh_lod_mip(&expected, 3, src, 4 * 4) == DH_OK);
+    assert(dh_lod_mip_any(&lod, 3, -1, 2, src, 4 * 4, nullptr) == DH_OK);
+    assert(dh_lod_serialise(&expected) == DH_OK && dh_lod_serialise(&lod) == DH_OK);
+    assert(lod.lod_len == expected.lod_len);
+    assert(memcmp(lod.lod_arr, expected.lod_arr, lod.lod_len) == 0);
+
+    // missing sources leave their columns empty, and sources from other mip levels fill in.
+    struct dh_lod finer = DH_LOD_CLEAR;
+    test_lod_random(&finer, 0, -8, 16, 128, 16);
+
+    struct dh_lod *mixed[4 * 4 + 1];
+    memcpy(mixed, src, sizeof(src));
+    mixed[0] = nullptr;
+    mixed[4 * 4] = &finer;
+    assert(dh_lod_mip_any(&lod, 3, -1, 2, mixed, 4 * 4 + 1, nullptr) == DH_OK);
+    assert(dh_lod_verify(&lod, nullptr) == DH_OK);
+
+    size_t empty = 0;
+    for (int x = 0; x < 64; x++) for (int z = 0; z < 64; z++) {
+        size_t count;
+        assert(dh_lod_column(&lod, x, z, nullptr, &count, nullptr) == DH_OK);
+        if (count == 0) empty++;
+    }
+
+    // the level 1 source at (-4, 8) is missing, the level 0 source at (-8, 16) covers half of it in each axis.
+    printf("%zu empty columns\n", empty);
+    assert(empty == 16 * 16 - 8 * 8);
+
+    dh_lod_free(&lod);
+    dh_lod_free(&expected);
+    dh_lod_free(&finer);
+    for (int i = 0; i < 4 * 4; i++) dh_lod_free(&sources[i]);
+
+    return 0;
+}
@@ -0,0 +1,68 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <time.h>
+#include <assert.h>
+
+#include <dh.h>
+
+#include "test.h"
+
+#define HEIGHT 384
+
+int main(void) {
+    // 16 distinct source LODs are plenty, they're repeated to make up the larger mips.
+    struct dh_lod sources[16];
+    for (int i = 0; i < 16; i++) {
+        sources[i] = DH_LOD_CLEAR;
+        test_lod_random(&sources[i], 0, i / 4, i % 4, HEIGHT, 24);
+    }
+
+    struct dh_lod **src = malloc(sizeof(struct dh_lod*) * 64 * 64);
+    for (int i = 0; i < 64 * 64; i++) src[i] = &sources[i % 16];
+
+    struct dh_lod lod = DH_LOD_CLEAR;
+    struct timespec start, end;
+
+    const int64_t policies[] = { DH_MIP_MODE, DH_MIP_SURFACE, DH_MIP_HEIGHT_WEIGHTED, DH_MIP_FAST };
+    const char *policy_names[] = { "mode", "surface", "height weighted", "fast" };
+
+    for (int policy = 0; policy < 4; policy++)
+    for (int levels = 1; levels <= 6; levels++) {
+        const int size = 1 << levels;
+
+        // small mips are repeated, so their timings are more than noise.
+        const int runs = size * size < 256 ? 256 / (size * size) : 1;
+
+        long total_ns = 0;
+        for (int run = 0; run < runs; run++) {
+            timespec_get(&start, TIME_UTC);
+
+                const dh_result result = dh_lod_mip_policy(&lod, levels, src, size * size, nullptr, policies[policy]);
+                assert(result == DH_OK);
+
+            timespec_get(&end, TIME_UTC);
+
+            total_ns +=
+                (end.tv_sec * 1000000000L + end.tv_nsec) -
+                (start.tv_sec * 1000000000L + start.tv_nsec);
+        }
+
+        assert(lod.mip_level == levels);
+        assert(dh_lod_verify(&lod, nullptr) == DH_OK);
+
+        printf(
+            "%s mip %dx%d: %0.3fms/LOD, %0.3fms per source LOD, %ldKiB output\n",
+            policy_names[policy], size, size,
+            (double)total_ns / (1000000.0 * runs),
+            (double)total_ns / (1000000.0 * runs * size * size),
+            lod.lod_len >> 10
+        );
+    }
+
+    dh_lod_free(&lod);
+    for (int i = 0; i < 16; i++) dh_lod_free(&sources[i]);
+    free(src);
+
+    return 0;
+}
@@ -0,0 +1,160 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+
+#include <dh.h>
+
+#include "test.h"
+
+/**
+ * a column given from the top down.
+ */
+struct column {
+    const uint64_t *datapoints;
+    size_t count;
+};
+
+#define COLUMN(...) ((struct column) {\
+    (const uint64_t[]) { __VA_ARGS__ },\
+    sizeof((const uint64_t[]) { __VA_ARGS__ }) / sizeof(uint64_t)\
+})
+#define EMPTY ((struct column) { nullptr, 0 })
+
+#define POLICIES 4
+
+/**
+ * 2x2 source columns, a and b in the first row and c and d in the second,
+ * and the column each policy is expected to merge them into.
+ */
+struct group {
+    struct column a, b, c, d;
+    struct column expected[POLICIES];
+};
+
+// where each group goes in the destination, spread over every source LOD.
+static const struct { size_t group; int x; int z; } placements[] = {
+    { 0, 0, 0 },
+    { 1, 5, 40 },
+    { 2, 33, 7 },
+    { 0, 63, 63 },
+    { 2, 40, 32 },
+};
+#define PLACEMENTS (sizeof(placements) / sizeof(*placements))
+
+static struct column sources[2 * 2][64 * 64];
+static struct column expected[POLICIES][64 * 64];
+
+static void place(const struct group *group, const int x, const int z) {
+    struct column *src = sources[(x / 32) * 2 + z / 32];
+    const int sx = x % 32 * 2, sz = z % 32 * 2;
+
+    src[sx * 64 + sz] = group->a;
+    src[sx * 64 + sz + 1] = group->b;
+    src[(sx + 1) * 64 + sz] = group->c;
+    src[(sx + 1) * 64 + sz + 1] = group->d;
+
+    for (int policy = 0; policy < POLICIES; policy++) {
+        expected[policy][x * 64 + z] = group->expected[policy];
+    }
+}
+
+static void make_lod(struct dh_lod *lod, const int64_t mip_level, const int64_t x, const int64_t z, const struct column *columns) {
+    test_lod_begin(lod, mip_level, x, z);
+    for (int i = 0; i < 64 * 64; i++) test_lod_column(lod, columns[i].datapoints, columns[i].count);
+    test_lod_end(lod);
+}
+
+int main(void) {
+    const struct group groups[] = {
+        // air over most of the top, with water and dirt beside it.
+        // surface picks the water over the air, and the span below joins the span above with its light.
+        [0] = {
+            .a = COLUMN(test_datapoint(0, 15, 4, 12, TEST_AIR), test_datapoint(0, 0, 0, 4, TEST_STONE)),
+            .b = COLUMN(test_datapoint(0, 15, 4, 12, TEST_AIR), test_datapoint(0, 0, 0, 4, TEST_STONE)),
+            .c = COLUMN(
+                test_datapoint(0, 15, 12, 4, TEST_AIR),
+                test_datapoint(0, 8, 4, 8, TEST_DIRT),
+                test_datapoint(0, 0, 0, 4, TEST_STONE)
+            ),
+            .d = COLUMN(test_datapoint(0, 12, 4, 12, TEST_WATER), test_datapoint(0, 0, 0, 4, TEST_STONE)),
+            .expected = {
+                [DH_MIP_MODE] = COLUMN(test_datapoint(0, 14, 4, 12, TEST_AIR), test_datapoint(0, 0, 0, 4, TEST_STONE)),
+                [DH_MIP_SURFACE] = COLUMN(test_datapoint(0, 14, 4, 12, TEST_WATER), test_datapoint(0, 0, 0, 4, TEST_STONE)),
+                [DH_MIP_HEIGHT_WEIGHTED] = COLUMN(test_datapoint(0, 14, 4, 12, TEST_AIR), test_datapoint(0, 0, 0, 4, TEST_STONE)),
+                [DH_MIP_FAST] = COLUMN(test_datapoint(0, 15, 4, 12, TEST_AIR), test_datapoint(0, 0, 0, 4, TEST_STONE)),
+            },
+        },
+
+        // two short runs of dirt against one tall run of deepslate, beside an empty column.
+        // the tie at the bottom goes to the deepslate above it, unless height already picked it.
+        [1] = {
+            .a = COLUMN(test_datapoint(8, 4, 10, 2, TEST_DIRT), test_datapoint(12, 0, 0, 2, TEST_STONE)),
+            .b = COLUMN(test_datapoint(4, 4, 10, 2, TEST_DIRT)),
+            .c = COLUMN(test_datapoint(0, 0, 0, 12, TEST_DEEPSLATE)),
+            .d = EMPTY,
+            .expected = {
+                [DH_MIP_MODE] = COLUMN(test_datapoint(3, 2, 10, 2, TEST_DIRT), test_datapoint(0, 0, 0, 10, TEST_DEEPSLATE)),
+                [DH_MIP_SURFACE] = COLUMN(test_datapoint(3, 2, 10, 2, TEST_DIRT), test_datapoint(0, 0, 0, 10, TEST_DEEPSLATE)),
+                [DH_MIP_HEIGHT_WEIGHTED] = COLUMN(test_datapoint(3, 2, 0, 12, TEST_DEEPSLATE)),
+                [DH_MIP_FAST] = COLUMN(test_datapoint(8, 4, 10, 2, TEST_DIRT), test_datapoint(12, 0, 0, 2, TEST_STONE)),
+            },
+        },
+
+        // air split in two beside lit cave air, over a gap and a block of ore, with two empty columns.
+        // the gap stays empty, surface lets air win where nothing else is, and fast joins the split air.
+        [2] = {
+            .a = COLUMN(
+                test_datapoint(0, 15, 20, 10, TEST_AIR),
+                test_datapoint(0, 15, 16, 4, TEST_AIR),
+                test_datapoint(0, 0, 0, 4, TEST_IRON_ORE)
+            ),
+            .b = COLUMN(test_datapoint(7, 0, 16, 8, TEST_CAVE_AIR)),
+            .c = EMPTY,
+            .d = EMPTY,
+            .expected = {
+                [DH_MIP_MODE] = COLUMN(test_datapoint(0, 3, 16, 14, TEST_AIR), test_datapoint(0, 0, 0, 4, TEST_IRON_ORE)),
+                [DH_MIP_SURFACE] = COLUMN(test_datapoint(0, 3, 16, 14, TEST_AIR), test_datapoint(0, 0, 0, 4, TEST_IRON_ORE)),
+                [DH_MIP_HEIGHT_WEIGHTED] = COLUMN(
+                    test_datapoint(0, 3, 20, 10, TEST_AIR),
+                    test_datapoint(1, 3, 16, 4, TEST_CAVE_AIR),
+                    test_datapoint(0, 0, 0, 4, TEST_IRON_ORE)
+                ),
+                [DH_MIP_FAST] = COLUMN(test_datapoint(0, 15, 16, 14, TEST_AIR), test_datapoint(0, 0, 0, 4, TEST_IRON_ORE)),
+            },
+        },
+    };
+    for (size_t i = 0; i < PLACEMENTS; i++) place(&groups[placements[i].group], placements[i].x, placements[i].z);
+
+    struct dh_lod lods[2 * 2];
+    struct dh_lod *src[2 * 2];
+    for (int i = 0; i < 2 * 2; i++) {
+        lods[i] = DH_LOD_CLEAR;
+        make_lod(&lods[i], 0, i / 2, i % 2, sources[i]);
+        src[i] = &lods[i];
+    }
+
+    struct dh_lod lod = DH_LOD_CLEAR, want = DH_LOD_CLEAR;
+    const char *names[POLICIES] = { "mode", "surface", "height weighted", "fast" };
+
+    for (int64_t policy = 0; policy < POLICIES; policy++) {
+        assert(dh_lod_mip_policy(&lod, 1, src, 2 * 2, nullptr, policy) == DH_OK);
+        assert(dh_lod_serialise(&lod) == DH_OK);
+
+        make_lod(&want, 1, 0, 0, expected[policy]);
+        assert(test_lod_equal(&lod, &want));
+        printf("%s ok\n", names[policy]);
+    }
+
+    // merging from any sources picks the same ids as the mode policy.
+    assert(dh_lod_mip_any(&lod, 1, 0, 0, src, 2 * 2, nullptr) == DH_OK);
+    assert(dh_lod_serialise(&lod) == DH_OK);
+    make_lod(&want, 1, 0, 0, expected[DH_MIP_MODE]);
+    assert(test_lod_equal(&lod, &want));
+
+    dh_lod_free(&lod);
+    dh_lod_free(&want);
+    for (int i = 0; i < 2 * 2; i++) dh_lod_free(&lods[i]);
+
+    return 0;
+}
@@ -0,0 +1,120 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+
+#include <anvil.h>
+#include <dh.h>
+
+#include "test.h"
+// the id lookups are only made by dh_from_chunks, so they're filled in by hand.
+#include "../src/dh_lod.h"
+
+/**
+ * counts the allocations that haven't been freed, and every allocation made.
+ */
+static size_t live = 0;
+static size_t made = 0;
+
+static void *counting_realloc(void *ptr, const size_t size) {
+    if (size == 0) {
+        if (ptr != nullptr) live--;
+        free(ptr);
+        return nullptr;
+    }
+
+    void *new = realloc(ptr, size);
+    if (new != nullptr && ptr == nullptr) {
+        live++;
+        made++;
+    }
+    return new;
+}
+
+/**
+ * gives each of a LOD's four id lookups a different number of sections, some with ids.
+ */
+static void fill_id_lookups(struct dh_lod *lod) {
+    struct dh_lod_ext *ext;
+    assert(dh_lod_ext_get(lod, &ext) == DH_OK);
+
+    const size_t caps[4] = { 1, 5, 0, 3 };
+    for (size_t i = 0; i < 4; i++) {
+        struct id_lookup *lookup = &ext->id_lookup[i];
+        assert(lookup->sections == nullptr);
+        if (caps[i] == 0) continue;
+
+        lookup->sections = lod->realloc(nullptr, caps[i] * sizeof(*lookup->sections));
+        assert(lookup->sections != nullptr);
+        lookup->sections_cap = caps[i];
+
+        for (size_t j = 0; j < caps[i]; j++) {
+            lookup->sections[j] = (struct id_table){ nullptr, 0, 0 };
+            if (j % 2 == 1) continue;
+
+            lookup->sections[j].ids = lod->realloc(nullptr, 16 * sizeof(uint32_t));
+            assert(lookup->sections[j].ids != nullptr);
+            lookup->sections[j].ids_cap = 16;
+        }
+    }
+}
+
+int main(void) {
+    // every section of every id lookup is freed, not just as many as the first lookup has.
+    struct dh_lod lod = DH_LOD_CLEAR;
+    lod.realloc = counting_realloc;
+    fill_id_lookups(&lod);
+    assert(live > 0);
+    dh_lod_free(&lod);
+    assert(live == 0);
+
+    struct dh_lod_pool *pool = dh_lod_pool_new(1, counting_realloc);
+    assert(pool != nullptr);
+
+    // an empty pool makes a new LOD.
+    struct dh_lod *first = dh_lod_pool_take(pool, 0, 3, 4);
+    assert(first != nullptr);
+    assert(first->realloc == counting_realloc);
+    assert(first->mip_level == 0 && first->x == 3 && first->z == 4);
+
+    test_random_seed(1);
+    test_lod_random(first, 0, 3, 4, 64, 8);
+    assert(dh_compress(first, DH_DATA_COMPRESSION_LZMA2, 0.5) == DH_OK);
+    fill_id_lookups(first);
+    dh_lod_pool_give(pool, first);
+    const size_t made_first = made;
+
+    // the LOD given back is taken again, empty and at its new position, keeping what it had allocated.
+    struct dh_lod *again = dh_lod_pool_take(pool, 2, -5, 7);
+    assert(again == first);
+    assert(again->mip_level == 2 && again->x == -5 && again->z == 7);
+    assert(again->mapping_len == 0 && again->lod_len == 0 && !again->has_data);
+    const struct dh_beacon *beacons;
+    size_t num_beacons;
+    assert(dh_lod_beacons(again, &beacons, &num_beacons) == DH_ERR_UNSUPPORTED);
+
+    // compressing a LOD like the last one doesn't make another compression context.
+    test_random_seed(1);
+    test_lod_random(again, 2, -5, 7, 64, 8);
+    assert(dh_compress(again, DH_DATA_COMPRESSION_LZMA2, 0.5) == DH_OK);
+    assert(made == made_first);
+
+    // a second LOD is new, and is freed when it's given back to a full pool.
+    struct dh_lod *second = dh_lod_pool_take(pool, 0, 0, 0);
+    assert(second != nullptr && second != again);
+    fill_id_lookups(second);
+    dh_lod_pool_give(pool, again);
+    const size_t live_full = live;
+    dh_lod_pool_give(pool, second);
+    assert(live < live_full);
+
+    assert(dh_lod_pool_take(pool, 0, 0, 0) == again);
+    dh_lod_pool_give(pool, again);
+
+    // freeing the pool frees the LOD it kept.
+    dh_lod_pool_free(pool);
+    assert(live == 0);
+
+    printf("ok\n");
+    return 0;
+}
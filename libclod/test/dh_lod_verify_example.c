@@ -0,0 +1,75 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+
+#include <dh.h>
+
+#include "test.h"
+
+/**
+ * a copy of a LOD with its data cut down to len bytes.
+ */
+static void truncated(struct dh_lod *out, const struct dh_lod *lod, const size_t len) {
+    test_lod_begin(out, lod->mip_level, lod->x, lod->z);
+    out->compression_mode = lod->compression_mode;
+    out->checksum = lod->checksum;
+
+    out->lod_arr = out->realloc(out->lod_arr, len);
+    assert(out->lod_arr != nullptr);
+    out->lod_cap = len;
+    memcpy(out->lod_arr, lod->lod_arr, len);
+    out->lod_len = len;
+}
+
+int main(void) {
+    struct dh_lod lod = DH_LOD_CLEAR, copy = DH_LOD_CLEAR;
+    test_lod_terrain(&lod, 0, -1, 2);
+    assert(dh_lod_verify(&lod, nullptr) == DH_OK);
+
+    // the last column is 2 bytes of count and its datapoints, which are checked one at a time.
+    const char *last;
+    size_t last_len;
+    assert(dh_lod_column(&lod, 63, 63, &last, &last_len, nullptr) == DH_OK);
+    assert(last_len > 1);
+
+    // cut off part way through a datapoint, part way through a column, and between two columns.
+    const size_t cuts[] = { 3, 8, 2 + last_len * 8 };
+    for (size_t i = 0; i < sizeof(cuts) / sizeof(*cuts); i++) {
+        truncated(&copy, &lod, lod.lod_len - cuts[i]);
+        assert(dh_lod_verify(&copy, nullptr) == DH_ERR_MALFORMED);
+    }
+
+    // a wrong checksum.
+    truncated(&copy, &lod, lod.lod_len);
+    assert(dh_lod_verify(&copy, nullptr) == DH_OK);
+    copy.checksum ^= 1;
+    assert(dh_lod_verify(&copy, nullptr) == DH_ERR_MALFORMED);
+
+    // an id past the end of the mapping, with a checksum that matches it.
+    truncated(&copy, &lod, lod.lod_len);
+    char *datapoint = copy.lod_arr + copy.lod_len - 8;
+    test_write_u64(datapoint, (test_read_u64(datapoint) & ~0xFFFFFFFFULL) | TEST_BLOCKS);
+    copy.checksum = test_checksum(copy.lod_arr, copy.lod_len);
+    assert(dh_lod_verify(&copy, nullptr) == DH_ERR_MALFORMED);
+
+    // the last id in the mapping is fine.
+    test_write_u64(datapoint, (test_read_u64(datapoint) & ~0xFFFFFFFFULL) | (TEST_BLOCKS - 1));
+    copy.checksum = test_checksum(copy.lod_arr, copy.lod_len);
+    assert(dh_lod_verify(&copy, nullptr) == DH_OK);
+
+    // compressed LODs are checked as they're decompressed, and cutting them short never passes.
+    assert(dh_compress(&lod, DH_DATA_COMPRESSION_LZ4, 0.5) == DH_OK);
+    assert(dh_lod_verify(&lod, nullptr) == DH_OK);
+
+    truncated(&copy, &lod, lod.lod_len - 16);
+    assert(dh_lod_verify(&copy, nullptr) != DH_OK);
+    truncated(&copy, &lod, lod.lod_len / 2);
+    assert(dh_lod_verify(&copy, nullptr) != DH_OK);
+
+    printf("ok\n");
+
+    dh_lod_free(&copy);
+    dh_lod_free(&lod);
+    return 0;
+}
@@ -0,0 +1,224 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <assert.h>
+
+#include <dh.h>
+
+#include "test.h"
+
+// mip level 0 LODs from -RANGE to RANGE - 1 in each axis.
+#define RANGE 4
+
+// a LOD that's replaced before the store is first closed, and one replaced after it's reopened.
+#define REPLACED_X (-3)
+#define REPLACED_Z 2
+#define REOPENED_X 2
+#define REOPENED_Z (-4)
+
+// an area that's deleted.
+#define DELETED_MIN_X 1
+#define DELETED_MIN_Z (-1)
+#define DELETED_MAX_X 2
+#define DELETED_MAX_Z 0
+
+// set once the LOD at REOPENED_X, REOPENED_Z has been replaced.
+static bool reopened_replaced;
+
+static bool deleted(const int64_t x, const int64_t z) {
+    return x >= DELETED_MIN_X && x <= DELETED_MAX_X && z >= DELETED_MIN_Z && z <= DELETED_MAX_Z;
+}
+
+/**
+ * the LOD that should be stored at a position.
+ */
+static void expected_lod(struct dh_lod *lod, const int64_t mip_level, const int64_t x, const int64_t z) {
+    if (mip_level == 0 && (
+        (x == REPLACED_X && z == REPLACED_Z) ||
+        (x == REOPENED_X && z == REOPENED_Z && reopened_replaced)
+    )) {
+        test_random_seed((uint64_t)(x * 31 + z));
+        test_lod_random(lod, mip_level, x, z, 64, 8);
+    } else {
+        test_lod_terrain(lod, mip_level, x, z);
+    }
+}
+
+struct range {
+    int64_t min_x, min_z, max_x, max_z;
+    bool seen[2 * RANGE][2 * RANGE];
+    size_t count;
+};
+
+static int check_in_range(struct dh_lod *lod, void *user) {
+    struct range *range = user;
+    assert(lod->mip_level == 0);
+    assert(lod->x >= range->min_x && lod->x <= range->max_x);
+    assert(lod->z >= range->min_z && lod->z <= range->max_z);
+    assert(!deleted(lod->x, lod->z));
+
+    // each position is only read once, however many times it was stored.
+    assert(!range->seen[lod->x + RANGE][lod->z + RANGE]);
+    range->seen[lod->x + RANGE][lod->z + RANGE] = true;
+    range->count++;
+
+    struct dh_lod expected = DH_LOD_CLEAR;
+    expected_lod(&expected, 0, lod->x, lod->z);
+    assert(test_lod_equal(lod, &expected));
+    dh_lod_free(&expected);
+    return 0;
+}
+
+static int stop_early(struct dh_lod *lod, void *user) {
+    ++*(int*)user;
+    return 2;
+}
+
+/**
+ * reads every LOD back from a store, and checks ranges only read what's in them.
+ */
+static void check_store(struct dh_store *store) {
+    struct dh_lod lod = DH_LOD_CLEAR, expected = DH_LOD_CLEAR;
+
+    for (int64_t x = -RANGE; x < RANGE; x++) for (int64_t z = -RANGE; z < RANGE; z++) {
+        const int res = dh_store_get(store, 0, x, z, &lod);
+        if (deleted(x, z)) {
+            assert(res == 1);
+            continue;
+        }
+
+        assert(res == 0);
+        expected_lod(&expected, 0, x, z);
+        assert(test_lod_equal(&lod, &expected));
+    }
+
+    // the mip level 1 LOD wasn't in the deleted level 0 area.
+    assert(dh_store_get(store, 1, 0, 0, &lod) == 0);
+    expected_lod(&expected, 1, 0, 0);
+    assert(test_lod_equal(&lod, &expected));
+
+    assert(dh_store_get(store, 0, RANGE, 0, &lod) == 1);
+    assert(dh_store_get(store, 2, 0, 0, &lod) == 1);
+
+    // ranges crossing zero, where Morton codes of positions outside the range fall between its corners.
+    const int64_t ranges[][4] = {
+        { -3, -2, 1, 2 },
+        { -RANGE, -RANGE, RANGE - 1, RANGE - 1 },
+        { -1, -1, 0, 0 },
+        { DELETED_MIN_X, DELETED_MIN_Z, DELETED_MAX_X, DELETED_MAX_Z },
+    };
+
+    for (size_t r = 0; r < sizeof(ranges) / sizeof(*ranges); r++) {
+        struct range range = {
+            .min_x = ranges[r][0], .min_z = ranges[r][1],
+            .max_x = ranges[r][2], .max_z = ranges[r][3],
+        };
+        const int res = dh_store_range(store, 0, range.min_x, range.min_z, range.max_x, range.max_z, &lod, check_in_range, &range);
+        assert(res == 0);
+
+        size_t expected_count = 0;
+        for (int64_t x = range.min_x; x <= range.max_x; x++) for (int64_t z = range.min_z; z <= range.max_z; z++) {
+            if (!deleted(x, z)) expected_count++;
+        }
+        assert(range.count == expected_count);
+    }
+
+    int calls = 0;
+    assert(dh_store_range(store, 0, -RANGE, -RANGE, RANGE - 1, RANGE - 1, &lod, stop_early, &calls) == 2);
+    assert(calls == 1);
+
+    dh_lod_free(&lod);
+    dh_lod_free(&expected);
+}
+
+static void test_backend(const struct dh_store_backend *backend, const char *name) {
+    char *path = test_path(name);
+    reopened_replaced = false;
+
+    struct dh_store *store = dh_store_open(backend, path, 0);
+    assert(store != nullptr);
+
+    struct dh_lod lod = DH_LOD_CLEAR;
+    for (int64_t x = -RANGE; x < RANGE; x++) for (int64_t z = -RANGE; z < RANGE; z++) {
+        test_lod_terrain(&lod, 0, x, z);
+        assert(dh_store_put(store, &lod, false) == 0);
+    }
+
+    test_lod_terrain(&lod, 1, 0, 0);
+    assert(dh_store_put(store, &lod, false) == 0);
+
+    expected_lod(&lod, 0, REPLACED_X, REPLACED_Z);
+    assert(dh_store_put(store, &lod, true) == 0);
+
+    assert(dh_store_delete(store, 0, DELETED_MIN_X, DELETED_MIN_Z, DELETED_MAX_X, DELETED_MAX_Z) == 0);
+
+    check_store(store);
+    assert(dh_store_close(store) == 0);
+
+    // everything is there once it's reopened, and can still be replaced.
+    store = dh_store_open(backend, path, 0);
+    assert(store != nullptr);
+    check_store(store);
+
+    reopened_replaced = true;
+    expected_lod(&lod, 0, REOPENED_X, REOPENED_Z);
+    assert(dh_store_put(store, &lod, true) == 0);
+    assert(dh_store_close(store) == 0);
+
+    store = dh_store_open(backend, path, 0);
+    assert(store != nullptr);
+    check_store(store);
+    assert(dh_store_close(store) == 0);
+
+    printf("%s store ok\n", backend->name);
+
+    dh_lod_free(&lod);
+    free(path);
+}
+
+/**
+ * planar LODs keep their mode through the flat store, and decode to the LOD they were made from.
+ */
+static void test_planar(void) {
+    char *path = test_path("planar.lods");
+    const int64_t modes[] = { DH_DATA_COMPRESSION_LZ4, DH_DATA_COMPRESSION_LZMA2 };
+
+    struct dh_store *store = dh_store_open(&dh_store_flat, path, 0);
+    assert(store != nullptr);
+
+    struct dh_lod lod = DH_LOD_CLEAR;
+    for (size_t i = 0; i < sizeof(modes) / sizeof(*modes); i++) {
+        test_lod_terrain(&lod, 0, (int64_t)i, 0);
+        assert(dh_compress(&lod, modes[i] | DH_DATA_COMPRESSION_PLANAR, 0.5) == DH_OK);
+        assert(dh_store_put(store, &lod, false) == 0);
+    }
+    assert(dh_store_close(store) == 0);
+
+    store = dh_store_open(&dh_store_flat, path, 0);
+    assert(store != nullptr);
+
+    struct dh_lod expected = DH_LOD_CLEAR;
+    for (size_t i = 0; i < sizeof(modes) / sizeof(*modes); i++) {
+        assert(dh_store_get(store, 0, (int64_t)i, 0, &lod) == 0);
+        assert(lod.compression_mode == (modes[i] | DH_DATA_COMPRESSION_PLANAR));
+
+        assert(dh_compress(&lod, DH_DATA_COMPRESSION_UNCOMPRESSED, 0) == DH_OK);
+        test_lod_terrain(&expected, 0, (int64_t)i, 0);
+        assert(test_lod_equal(&lod, &expected));
+    }
+    assert(dh_store_close(store) == 0);
+
+    printf("planar flat store ok\n");
+
+    dh_lod_free(&lod);
+    dh_lod_free(&expected);
+    free(path);
+}
+
+int main(int argc, char **argv) {
+    test_backend(&dh_store_flat, "DistantHorizons.lods");
+    test_planar();
+    test_backend(&dh_store_sqlite, "DistantHorizons.sqlite");
+
+    test_dir_remove();
+    return 0;
+}
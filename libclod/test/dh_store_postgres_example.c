@@ -0,0 +1,65 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+
+#include <dh.h>
+
+#include "test.h"
+
+static int count_lod(struct dh_lod *lod, void *user) {
+    ++*(int*)user;
+    return 0;
+}
+
+int main(int argc, char **argv) {
+    // needs a server to talk to, i.e. CLOD_PG_CONNINFO="host=localhost dbname=clod_test".
+    const char *conninfo = getenv("CLOD_PG_CONNINFO");
+    if (conninfo == nullptr) {
+        printf("CLOD_PG_CONNINFO isn't set, skipping\n");
+        return 77;
+    }
+
+    struct dh_store *store = dh_store_open(&dh_store_postgres, conninfo, 0);
+    assert(store != nullptr);
+
+    assert(dh_store_delete(store, 0, -8, -8, 7, 7) == 0);
+
+    struct dh_lod lod = DH_LOD_CLEAR;
+    test_lod_terrain(&lod, 0, 0, 0);
+
+    for (int64_t x = -8; x < 8; x++) for (int64_t z = -8; z < 8; z++) {
+        lod.x = x;
+        lod.z = z;
+        lod.checksum = (int32_t)(x * 16 + z);
+        assert(dh_store_put(store, &lod, false) == 0);
+    }
+
+    // stored twice in the same batch, the second should win.
+    lod.x = 3;
+    lod.z = -2;
+    lod.min_y = 0;
+    lod.checksum = 12345;
+    assert(dh_store_put(store, &lod, true) == 0);
+
+    struct dh_lod read = DH_LOD_CLEAR;
+    assert(dh_store_get(store, 0, 3, -2, &read) == 0);
+    assert(read.min_y == 0 && read.checksum == 12345 && read.lod_len == lod.lod_len);
+    assert(dh_store_get(store, 0, 100, 100, &read) == 1);
+
+    int n = 0;
+    assert(dh_store_range(store, 0, -2, -2, 1, 5, &read, count_lod, &n) == 0);
+    assert(n == 4 * 8);
+
+    assert(dh_store_delete(store, 0, -8, -8, 7, 7) == 0);
+    assert(dh_store_get(store, 0, 3, -2, &read) == 1);
+
+    dh_lod_free(&read);
+    dh_lod_free(&lod);
+
+    // anything still batched is sent on close, which reports if it fails.
+    assert(dh_store_close(store) == 0);
+
+    printf("ok\n");
+    return 0;
+}
@@ -0,0 +1,102 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <sys/stat.h>
+
+#include <anvil.h>
+#include <dh.h>
+
+#include "test.h"
+
+// region files, and the seed each is written with.
+static const int64_t regions[][3] = {
+    { 0, 0, 1 },
+    { -1, 0, 2 },
+    { 2, -3, 3 },
+    { -5, -5, 4 },
+};
+#define REGIONS (sizeof(regions) / sizeof(*regions))
+
+/**
+ * reads every chunk back through a region file, checking it's the chunk it was written with, stored the given way.
+ */
+static void check_region(struct anvil_region_dir *region_dir, const size_t r, const anvil_compression compression) {
+    const int64_t region_x = regions[r][0], region_z = regions[r][1];
+
+    struct anvil_region_file *region_file;
+    anvil_result res = anvil_region_open_file(&region_file, region_dir, region_x, region_z);
+    assert(res == ANVIL_OK);
+
+    char expected[TEST_CHUNK_MAX], data[TEST_CHUNK_MAX];
+    for (size_t i = 0; i < 1024; i++) {
+        const int64_t chunk_x = region_x * 32 + (int64_t)i / 32, chunk_z = region_z * 32 + (int64_t)i % 32;
+        const size_t expected_len = test_chunk_data(regions[r][2], i, expected);
+
+        size_t len;
+        res = anvil_chunk_read(data, sizeof(data), &len, chunk_x, chunk_z, region_file);
+        assert(res == ANVIL_OK);
+        assert(len == expected_len);
+        assert(memcmp(data, expected, len) == 0);
+
+        assert(anvil_chunk_mtime(region_file, chunk_x, chunk_z) == (expected_len ? 1000 + i : 0));
+    }
+
+    assert(anvil_region_file_close(region_file) == ANVIL_OK);
+
+    // every chunk was recompressed.
+    char name[64];
+    snprintf(name, sizeof(name), "region/r.%ld.%ld.mca", region_x, region_z);
+    char *file = malloc(TEST_REGION_CAP);
+    assert(file != nullptr);
+    test_region_read(name, file);
+
+    for (size_t i = 0; i < 1024; i++) {
+        const uint32_t location = test_read_u32(file + i * 4);
+        if (location == 0) continue;
+        assert(file[(location >> 8) * TEST_SECTOR_SIZE + 4] == (char)compression);
+    }
+    free(file);
+}
+
+int main(void) {
+    char *region_path = test_path("region");
+    assert(mkdir(region_path, 0755) == 0);
+
+    for (size_t r = 0; r < REGIONS; r++) {
+        char name[64];
+        snprintf(name, sizeof(name), "region/r.%ld.%ld.mca", regions[r][0], regions[r][1]);
+        test_region_write(name, regions[r][2]);
+    }
+
+    struct anvil_region_dir *region_dir;
+    anvil_result res = anvil_region_dir_open(&region_dir, test_dir(), "region", nullptr, nullptr, nullptr);
+    assert(res == ANVIL_OK);
+
+    struct anvil_rewriter *rewriter;
+    res = anvil_rewriter_open(&rewriter, nullptr, nullptr);
+    assert(res == ANVIL_OK);
+
+    // through each compression in turn, on one thread and on several, each starting from the last.
+    const anvil_compression compressions[] = {
+        ANVIL_COMPRESSION_ZLIB,
+        ANVIL_COMPRESSION_GZIP,
+        ANVIL_COMPRESSION_NONE,
+        ANVIL_COMPRESSION_ZLIB,
+    };
+    const unsigned threads[] = { 3, 1, 8, 2 };
+
+    for (size_t c = 0; c < sizeof(compressions) / sizeof(*compressions); c++) {
+        res = anvil_region_dir_recompress(rewriter, region_dir, compressions[c], 0.5, threads[c]);
+        assert(res == ANVIL_OK);
+
+        for (size_t r = 0; r < REGIONS; r++) check_region(region_dir, r, compressions[c]);
+        printf("recompressed with %d on %u threads\n", compressions[c], threads[c]);
+    }
+
+    anvil_rewriter_close(rewriter);
+    anvil_region_dir_close(region_dir);
+    free(region_path);
+    test_dir_remove();
+    return 0;
+}
@@ -0,0 +1,398 @@
+#pragma once
+
+/**
+ * helpers shared by the tests.
+ *
+ * LODs are made without a world to generate them from, with the same mapping as dh_from_chunks makes -
+ * the biome, "_DH-BSW_", the block name, then "_STATE_" and its properties - so anything reading block names works on them.
+ * files are made in a temporary directory rather than wherever the test is run.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <assert.h>
+#include <dirent.h>
+
+#include <dh.h>
+
+//========//
+// Random //
+//========//
+
+static uint64_t test_random_state = 0x9E3779B97F4A7C15ULL;
+
+/**
+ * restarts the random sequence, so the same LODs can be made again.
+ */
+static inline void test_random_seed(const uint64_t seed) {
+    test_random_state = seed != 0 ? seed : 0x9E3779B97F4A7C15ULL;
+}
+
+static inline uint64_t test_random(void) {
+    test_random_state ^= test_random_state << 13;
+    test_random_state ^= test_random_state >> 7;
+    test_random_state ^= test_random_state << 17;
+    return test_random_state;
+}
+
+//======//
+// LODs //
+//======//
+
+// ids of the blocks in every test LOD's mapping.
+enum {
+    TEST_AIR,
+    TEST_STONE,
+    TEST_DIRT,
+    TEST_GRASS,
+    TEST_WATER,
+    TEST_DEEPSLATE,
+    TEST_IRON_ORE,
+    TEST_CAVE_AIR,
+    TEST_BLOCKS,
+};
+
+static const char *test_blocks[TEST_BLOCKS] = {
+    "minecraft:plains_DH-BSW_minecraft:air_STATE_",
+    "minecraft:plains_DH-BSW_minecraft:stone_STATE_",
+    "minecraft:plains_DH-BSW_minecraft:dirt_STATE_",
+    "minecraft:plains_DH-BSW_minecraft:grass_block_STATE_{snowy:false}",
+    "minecraft:river_DH-BSW_minecraft:water_STATE_{level:0}",
+    "minecraft:plains_DH-BSW_minecraft:deepslate_STATE_{axis:y}",
+    "minecraft:plains_DH-BSW_minecraft:iron_ore_STATE_",
+    "minecraft:plains_DH-BSW_minecraft:cave_air_STATE_",
+};
+
+static inline uint64_t test_datapoint(
+    const uint64_t block_light,
+    const uint64_t sky_light,
+    const uint64_t min_y,
+    const uint64_t height,
+    const uint64_t id
+) {
+    return block_light << 60 | sky_light << 56 | min_y << 44 | height << 32 | id;
+}
+
+static inline uint64_t test_read_u64(const char *data) {
+    uint64_t value = 0;
+    for (int i = 0; i < 8; i++) value = value << 8 | (uint8_t)data[i];
+    return value;
+}
+
+static inline void test_write_u64(char *data, const uint64_t value) {
+    for (int i = 0; i < 8; i++) data[i] = (char)(value >> (56 - i * 8));
+}
+
+/**
+ * CRC32 of LOD data, the same as dh_lod_serialise sets the checksum to.
+ */
+static inline int32_t test_checksum(const char *data, const size_t len) {
+    uint32_t crc = 0xFFFFFFFF;
+    for (size_t i = 0; i < len; i++) {
+        crc ^= (uint8_t)data[i];
+        for (int b = 0; b < 8; b++) crc = crc >> 1 ^ (0xEDB88320 & -(crc & 1));
+    }
+    return (int32_t)~crc;
+}
+
+/**
+ * starts an uncompressed LOD at a position with the test mapping and no columns.
+ * the LOD is either cleared or one made before, whose buffers are reused.
+ */
+static inline void test_lod_begin(struct dh_lod *lod, const int64_t mip_level, const int64_t x, const int64_t z) {
+    if (lod->realloc == nullptr) lod->realloc = realloc;
+
+    lod->mip_level = mip_level;
+    lod->x = x;
+    lod->z = z;
+    lod->height = 384;
+    lod->min_y = -64;
+    lod->compression_mode = DH_DATA_COMPRESSION_UNCOMPRESSED;
+    lod->lod_len = 0;
+    lod->has_data = false;
+
+    // the mapping goes in the way DH stores it: a count, then each entry's length and bytes.
+    char mapping[1024];
+    size_t len = 4;
+    mapping[0] = mapping[1] = mapping[2] = 0;
+    mapping[3] = TEST_BLOCKS;
+    for (int i = 0; i < TEST_BLOCKS; i++) {
+        const size_t block_len = strlen(test_blocks[i]);
+        mapping[len++] = (char)(block_len >> 8);
+        mapping[len++] = (char)(block_len >> 0);
+        memcpy(mapping + len, test_blocks[i], block_len);
+        len += block_len;
+    }
+
+    const dh_result res = dh_lod_deserialise_mapping(lod, mapping, len);
+    assert(res == DH_OK);
+}
+
+/**
+ * appends a column of datapoints, given from the top down.
+ */
+static inline void test_lod_column(struct dh_lod *lod, const uint64_t *datapoints, const size_t count) {
+    const size_t len = 2 + count * 8;
+    if (lod->lod_cap - lod->lod_len < len) {
+        size_t new_cap = lod->lod_cap ? lod->lod_cap * 2 : 64 * 1024;
+        while (new_cap - lod->lod_len < len) new_cap *= 2;
+        lod->lod_arr = lod->realloc(lod->lod_arr, new_cap);
+        assert(lod->lod_arr != nullptr);
+        lod->lod_cap = new_cap;
+    }
+
+    char *column = lod->lod_arr + lod->lod_len;
+    column[0] = (char)(count >> 8);
+    column[1] = (char)(count >> 0);
+    for (size_t i = 0; i < count; i++) test_write_u64(column + 2 + i * 8, datapoints[i]);
+
+    lod->lod_len += len;
+    if (count > 0) lod->has_data = true;
+}
+
+/**
+ * sets the checksum once every column has been added.
+ */
+static inline void test_lod_end(struct dh_lod *lod) {
+    lod->checksum = test_checksum(lod->lod_arr, lod->lod_len);
+}
+
+/**
+ * makes a plausible looking LOD, which is the same every time for the same position.
+ * hilly grass over dirt and stone, rivers where it dips low enough, and a lit cave over deepslate.
+ */
+static inline void test_lod_terrain(struct dh_lod *lod, const int64_t mip_level, const int64_t x, const int64_t z) {
+    test_lod_begin(lod, mip_level, x, z);
+
+    for (int64_t cx = 0; cx < 64; cx++) for (int64_t cz = 0; cz < 64; cz++) {
+        const int64_t wx = (x * 64 + cx) * ((int64_t)1 << mip_level);
+        const int64_t wz = (z * 64 + cz) * ((int64_t)1 << mip_level);
+
+        uint64_t hash = (uint64_t)wx * 0x9E3779B97F4A7C15ULL ^ (uint64_t)wz * 0xC2B2AE3D27D4EB4FULL;
+        hash ^= hash >> 29;
+        hash *= 0xBF58476D1CE4E5B9ULL;
+        hash ^= hash >> 32;
+
+        const uint64_t surface = 170 + (uint64_t)(((wx >> 3) + (wz >> 4)) & 31) + hash % 3;
+        const uint64_t sea = 184;
+        const uint64_t cave = 40 + (hash >> 8) % 8;
+        const uint64_t cave_height = 2 + (hash >> 16) % 5;
+
+        uint64_t dps[8];
+        size_t count = 0;
+        if (surface < sea) {
+            dps[count++] = test_datapoint(0, 15, sea + 1, 384 - sea - 1, TEST_AIR);
+            dps[count++] = test_datapoint(0, 12, surface + 1, sea - surface, TEST_WATER);
+            dps[count++] = test_datapoint(0, 10, surface, 1, TEST_DIRT);
+        } else {
+            dps[count++] = test_datapoint(0, 15, surface + 1, 384 - surface - 1, TEST_AIR);
+            dps[count++] = test_datapoint(0, 15, surface, 1, TEST_GRASS);
+        }
+        dps[count++] = test_datapoint(0, 0, surface - 4, 4, TEST_DIRT);
+        dps[count++] = test_datapoint(0, 0, cave + cave_height, surface - 4 - cave - cave_height, TEST_STONE);
+        dps[count++] = test_datapoint((hash >> 24) % 16, 0, cave, cave_height, TEST_CAVE_AIR);
+        dps[count++] = test_datapoint(0, 0, 0, cave, TEST_DEEPSLATE);
+
+        test_lod_column(lod, dps, count);
+    }
+
+    test_lod_end(lod);
+}
+
+/**
+ * makes a LOD of columns of runs of random blocks with random light, from top down to 0,
+ * each run up to max_run blocks tall. it follows test_random, so the same seed makes the same LOD.
+ */
+static inline void test_lod_random(
+    struct dh_lod *lod,
+    const int64_t mip_level,
+    const int64_t x,
+    const int64_t z,
+    const uint64_t top,
+    const uint64_t max_run
+) {
+    test_lod_begin(lod, mip_level, x, z);
+
+    uint64_t *dps = malloc(top * sizeof(uint64_t));
+    assert(dps != nullptr);
+
+    for (int column = 0; column < 64 * 64; column++) {
+        size_t count = 0;
+        for (uint64_t y = top; y > 0; count++) {
+            uint64_t height = 1 + test_random() % max_run;
+            if (height > y) height = y;
+            y -= height;
+
+            dps[count] = test_datapoint(test_random() % 16, test_random() % 16, y, height, test_random() % TEST_BLOCKS);
+        }
+
+        test_lod_column(lod, dps, count);
+    }
+
+    free(dps);
+    test_lod_end(lod);
+}
+
+/**
+ * whether two LODs hold the same data, mapping and position, as they'd be stored.
+ */
+static inline bool test_lod_equal(struct dh_lod *a, struct dh_lod *b) {
+    if (
+        a->mip_level != b->mip_level || a->x != b->x || a->z != b->z ||
+        a->min_y != b->min_y || a->checksum != b->checksum ||
+        a->compression_mode != b->compression_mode ||
+        a->lod_len != b->lod_len || memcmp(a->lod_arr, b->lod_arr, a->lod_len) != 0 ||
+        a->mapping_len != b->mapping_len
+    ) return false;
+
+    for (size_t i = 0; i < a->mapping_len; i++) {
+        if (strcmp(a->mapping_arr[i], b->mapping_arr[i]) != 0) return false;
+    }
+
+    return true;
+}
+
+//=======//
+// Files //
+//=======//
+
+static char test_dir_path[4096];
+
+/**
+ * the test's temporary directory, made the first time it's asked for.
+ */
+static inline const char *test_dir(void) {
+    if (test_dir_path[0] == '\0') {
+        const char *tmp = getenv("TMPDIR");
+        snprintf(test_dir_path, sizeof(test_dir_path), "%s/clod-test-XXXXXX", tmp != nullptr ? tmp : "/tmp");
+        const char *dir = mkdtemp(test_dir_path);
+        assert(dir != nullptr);
+    }
+
+    return test_dir_path;
+}
+
+/**
+ * path to a file in the test's temporary directory. must be freed.
+ */
+static inline char *test_path(const char *name) {
+    const size_t len = strlen(test_dir()) + 1 + strlen(name) + 1;
+    char *path = malloc(len);
+    assert(path != nullptr);
+    snprintf(path, len, "%s/%s", test_dir(), name);
+    return path;
+}
+
+static inline void test_remove(const char *path) {
+    // anything that isn't a directory just gets removed.
+    DIR *dir = opendir(path);
+    if (dir != nullptr) {
+        const struct dirent *ent;
+        while ((ent = readdir(dir)) != nullptr) {
+            if (strcmp(ent->d_name, ".") == 0 || strcmp(ent->d_name, "..") == 0) continue;
+
+            const size_t len = strlen(path) + 1 + strlen(ent->d_name) + 1;
+            char *child = malloc(len);
+            assert(child != nullptr);
+            snprintf(child, len, "%s/%s", path, ent->d_name);
+            test_remove(child);
+            free(child);
+        }
+        closedir(dir);
+    }
+
+    remove(path);
+}
+
+/**
+ * removes the test's temporary directory and everything in it.
+ */
+static inline void test_dir_remove(void) {
+    if (test_dir_path[0] == '\0') return;
+
+    test_remove(test_dir_path);
+    test_dir_path[0] = '\0';
+}
+
+//==============//
+// Region Files //
+//==============//
+
+#define TEST_SECTOR_SIZE 4096
+#define TEST_CHUNK_MAX (2 * TEST_SECTOR_SIZE)                               // largest chunk test_chunk_data makes.
+#define TEST_REGION_CAP (2 * TEST_SECTOR_SIZE + 1024 * 4 * TEST_SECTOR_SIZE) // largest region file test_region_write makes.
+
+static inline uint32_t test_read_u32(const char *data) {
+    uint32_t value = 0;
+    for (int i = 0; i < 4; i++) value = value << 8 | (uint8_t)data[i];
+    return value;
+}
+
+static inline void test_write_u32(char *data, const uint32_t value) {
+    for (int i = 0; i < 4; i++) data[i] = (char)(value >> (24 - i * 8));
+}
+
+/**
+ * the data of chunk i in a region file written with seed, returning its length, or 0 if there's no chunk there.
+ */
+static inline size_t test_chunk_data(const uint64_t seed, const size_t i, char *data) {
+    test_random_seed(seed * 1024 + i + 1);
+    if (test_random() % 3 == 0) return 0;
+
+    const size_t len = 1 + test_random() % TEST_CHUNK_MAX;
+    for (size_t j = 0; j < len; j++) data[j] = (char)test_random();
+    return len;
+}
+
+/**
+ * writes an uncompressed region file, named relative to the test's directory, the way one looks after a long time in use:
+ * chunks in reverse order with free sectors between some of them, and the last chunk's final sector cut short,
+ * as not every tool pads the file. chunk i's mtime is 1000 + i.
+ */
+static inline void test_region_write(const char *name, const uint64_t seed) {
+    char *file = calloc(1, TEST_REGION_CAP);
+    assert(file != nullptr);
+    char data[TEST_CHUNK_MAX];
+
+    size_t sector = 2, end = 2 * TEST_SECTOR_SIZE;
+    for (size_t i = 1024; i-- > 0;) {
+        const size_t len = test_chunk_data(seed, i, data);
+        if (len == 0) continue;
+
+        char *frame = file + sector * TEST_SECTOR_SIZE;
+        test_write_u32(frame, len + 1);
+        frame[4] = ANVIL_COMPRESSION_NONE;
+        memcpy(frame + 5, data, len);
+
+        const size_t count = (5 + len + TEST_SECTOR_SIZE - 1) / TEST_SECTOR_SIZE;
+        test_write_u32(file + i * 4, (uint32_t)(sector << 8 | count));
+        test_write_u32(file + TEST_SECTOR_SIZE + i * 4, 1000 + i);
+
+        end = sector * TEST_SECTOR_SIZE + 5 + len;
+        sector += count + (i % 4 == 0);
+    }
+
+    char *path = test_path(name);
+    FILE *f = fopen(path, "wb");
+    assert(f != nullptr);
+    assert(fwrite(file, end, 1, f) == 1);
+    assert(fclose(f) == 0);
+
+    free(path);
+    free(file);
+}
+
+/**
+ * reads a region file, named relative to the test's directory, into file, which holds TEST_REGION_CAP bytes.
+ */
+static inline size_t test_region_read(const char *name, char *file) {
+    char *path = test_path(name);
+    FILE *f = fopen(path, "rb");
+    assert(f != nullptr);
+    const size_t size = fread(file, 1, TEST_REGION_CAP, f);
+    assert(fclose(f) == 0);
+    free(path);
+    return size;
+}